@@ -4,6 +4,12 @@
 #include <string.h>
 #include <limits.h>
 #include <memory>
+#ifdef _M_IX86
+#include <crtdbg.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <signal.h>
+#endif
 #include "frames.h"
 #include "filewrite.h"
 #include "m2decoder.h"
@@ -25,6 +31,7 @@ class option_t {
 	FileWriter *fw_;
 	M2Decoder::type_t codec_;
 	int dpb_;
+	int threads_;
 	bool force_exec_;
 	bool dpb_emptify_;
 	M2Decoder *dec_;
@@ -88,7 +95,7 @@ class option_t {
 	void BlameUser() {
 		fprintf(stderr,
 			"Usage:\n"
-			"\th264dec [-b] [-d <dpb_size>] [-o|O ] <infile>\n"
+			"\th264dec [-b] [-d <dpb_size>] [-t <threads>] [-o|O ] <infile>\n"
 			"\t\t-b: Bypass DPB\n"
 			"\t\t-d <dpb_size>: Specify number of DPB frames -1, 1..16 (default: -1(auto))\n"
 			"\t\t-e: emptifiy DPB before next frames\n"
@@ -97,18 +104,19 @@ class option_t {
 			"\t\t-o: RAW output\n"
 			"\t\t-O: MD5 output\n"
 			"\t\t-s: MPEG2 PS input\n"
+			"\t\t-t <threads>: Specify number of decoding threads (default: 1)\n"
 			"\t\t-x: Mask SIGABRT on error."
 			);
 		exit(1);
 	}
 public:
 	option_t(int argc, char *argv[])
-		: pos_(0), skipped_num_(0), fw_(0), codec_(M2Decoder::MODE_NONE), dpb_(-1), force_exec_(false), dpb_emptify_(false), dec_(0) {
+		: pos_(0), skipped_num_(0), fw_(0), codec_(M2Decoder::MODE_NONE), dpb_(-1), threads_(1), force_exec_(false), dpb_emptify_(false), dec_(0) {
 		FILE *fi;
 		int opt;
 		int filewrite_mode = FileWriter::WRITE_NONE;
 		int skip_num = 0;
-		while ((opt = getopt(argc, argv, "bd:ef:moOsx")) != -1) {
+		while ((opt = getopt(argc, argv, "bd:ef:moOst:x")) != -1) {
 			switch (opt) {
 			case 'b':
 				dpb_ = 1;
@@ -138,6 +146,13 @@ public:
 			case 's':
 				codec_ = M2Decoder::MODE_MPEG2PS;
 				break;
+			case 't':
+				threads_ = strtol(optarg, 0, 0);
+				if (threads_ < 1) {
+					BlameUser();
+					/* NOTREACHED */
+				}
+				break;
 			case 'x':
 				force_exec_ = true;
 				break;
@@ -168,6 +183,7 @@ public:
 #endif
 		fclose(fi);
 		dec_ = new M2Decoder(codec_, 0, reread_file, this);
+		dec_->set_threads(threads_);
 		if (skip_num != 0) {
 			int skipped_bytes;
 			skipped_num_ = dec_->skip_frames(input_data_, input_len_, skip_num, skipped_bytes, headers_);
@@ -209,11 +225,7 @@ public:
 	}
 };
 
-#ifdef _M_IX86
-#include <crtdbg.h>
-#elif defined(__linux__)
-#include <pthread.h>
-#include <signal.h>
+#ifdef __linux__
 static void trap(int no)
 {
 	fprintf(stderr, "trap %d\n", no);
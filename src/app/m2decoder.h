@@ -87,6 +87,9 @@ public:
 	const m2d_func_table_t *func() {
 		return func_;
 	}
+	int set_threads(int num) {
+		return func_->set_threads(context_, num);
+	}
 	dec_bits *stream() {
 		return func_->stream_pos(context_);
 	}
@@ -251,11 +251,35 @@ static inline bool is_high_profile(uint32_t profile_idc)
 	return (profile_idc == 44) || (profile_idc == 83) || (profile_idc == 86) || (profile_idc == 100) || (profile_idc == 110) || (profile_idc == 118) || (profile_idc == 128) || (profile_idc == 122) || (profile_idc == 244);
 }
 
-static inline int scaling_list(dec_bits *st, int size, bool& use_default)
+static const uint8_t default_scaling4x4[2][16] = {
+	{6, 13, 13, 20, 20, 20, 28, 28, 28, 28, 32, 32, 32, 37, 37, 42},
+	{10, 14, 14, 20, 20, 20, 24, 24, 24, 24, 27, 27, 27, 30, 30, 34}
+};
+
+static const uint8_t default_scaling8x8[2][64] = {
+	{
+		6, 10, 10, 13, 11, 13, 16, 16, 16, 16, 18, 18, 18, 18, 18, 23,
+		23, 23, 23, 23, 23, 25, 25, 25, 25, 25, 25, 25, 27, 27, 27, 27,
+		27, 27, 27, 27, 29, 29, 29, 29, 29, 29, 29, 31, 31, 31, 31, 31,
+		31, 33, 33, 33, 33, 33, 36, 36, 36, 36, 38, 38, 38, 40, 40, 42
+	},
+	{
+		9, 13, 13, 15, 13, 15, 17, 17, 17, 17, 19, 19, 19, 19, 19, 21,
+		21, 21, 21, 21, 21, 22, 22, 22, 22, 22, 22, 22, 24, 24, 24, 24,
+		24, 24, 24, 24, 25, 25, 25, 25, 25, 25, 25, 27, 27, 27, 27, 27,
+		27, 28, 28, 28, 28, 28, 30, 30, 30, 30, 32, 32, 32, 33, 33, 35
+	}
+};
+
+/**Read one scaling list into list in zigzag order.
+ * default_list replaces it when useDefaultScalingMatrixFlag is inferred.
+ */
+static inline int scaling_list(dec_bits *st, uint8_t *list, int size, const uint8_t *default_list)
 {
 	int last_scale = 8;
 	int next_scale = 8;
 	int scale;
+	bool use_default = false;
 	for (int i = 0; i < size; ++i) {
 		if (next_scale != 0) {
 			int32_t delta_scale;
@@ -266,8 +290,41 @@ static inline int scaling_list(dec_bits *st, int size, bool& use_default)
 			}
 		}
 		scale = (next_scale == 0) ? last_scale : next_scale;
+		list[i] = scale;
 		last_scale = scale;
 	}
+	if (use_default) {
+		memcpy(list, default_list, size);
+	}
+	return 0;
+}
+
+static inline int read_seq_scaling_matrix(h264d_sps *sps, int list8x8_num, dec_bits *stream)
+{
+	uint8_t list_dummy[64];
+	for (int i = 0; i < 6; ++i) {
+		uint8_t *list = sps->scaling4x4[i];
+		if (get_onebit(stream)) {
+			if (scaling_list(stream, list, 16, default_scaling4x4[3 <= i]) < 0) {
+				return -1;
+			}
+		} else if ((i == 0) || (i == 3)) {
+			memcpy(list, default_scaling4x4[3 <= i], 16);
+		} else {
+			memcpy(list, list - 16, 16);
+		}
+	}
+	for (int i = 0; i < list8x8_num; ++i) {
+		/* chroma lists of 4:4:4 are parsed but not used */
+		uint8_t *list = (i < 2) ? sps->scaling8x8[i] : list_dummy;
+		if (get_onebit(stream)) {
+			if (scaling_list(stream, list, 64, default_scaling8x8[i & 1]) < 0) {
+				return -1;
+			}
+		} else if (i < 2) {
+			memcpy(list, default_scaling8x8[i], 64);
+		}
+	}
 	return 0;
 }
 
@@ -277,47 +334,34 @@ static inline int read_seq_high_extension(h264d_sps *sps, dec_bits *stream)
 	uint32_t tmp;
 
 	READ_UE_RANGE(chroma_idc, stream, 3);
+	sps->chroma_format_idc = chroma_idc;
 	if (chroma_idc == 3) {
 		get_onebit(stream);
 	}
 	READ_UE_RANGE(tmp, stream, 6);
 	READ_UE_RANGE(tmp, stream, 6);
 	get_onebit(stream);
-	if (get_onebit(stream)) {
-		int max = (chroma_idc != 3) ? 8 : 12;
-		bool use_default;
-		for (int i = 0; i < 6; ++i) {
-			if (get_onebit(stream)) {
-				if (scaling_list(stream, 16, use_default) < 0) {
-					return -1;
-				}
-			}
-		}
-		for (int i = 0; i < max; ++i) {
-			if (get_onebit(stream)) {
-				if (scaling_list(stream, 64, use_default) < 0) {
-					return -1;
-				}
-			}
+	if ((sps->seq_scaling_matrix_present_flag = get_onebit(stream)) != 0) {
+		if (read_seq_scaling_matrix(sps, (chroma_idc != 3) ? 2 : 6, stream) < 0) {
+			return -1;
 		}
 	}
 	return 0;
 }
 
-static int read_seq_parameter_set(h264d_sps *sps, dec_bits *stream)
+/**Read SPS following seq_parameter_set_id into sps.
+ */
+static int read_seq_parameter_set_body(h264d_sps *sps, uint32_t profile_idc, uint32_t constraint_set_flag, uint32_t level_idc, dec_bits *stream)
 {
-	uint32_t sps_profile_idc, sps_constraint_set_flag;
-	uint32_t sps_level_idc, sps_id;
 	uint32_t tmp;
 
-	sps_profile_idc = get_bits(stream, 8);
-	sps_constraint_set_flag = get_bits(stream, 8);
-	sps_level_idc = get_bits(stream, 8);
-	READ_UE_RANGE(sps_id, stream, 31);
-	sps += sps_id;
-	sps->profile_idc = sps_profile_idc;
-	sps->constraint_set_flag = sps_constraint_set_flag;
-	sps->level_idc = sps_level_idc;
+	sps->profile_idc = profile_idc;
+	sps->constraint_set_flag = constraint_set_flag;
+	sps->level_idc = level_idc;
+	sps->chroma_format_idc = 1;
+	sps->seq_scaling_matrix_present_flag = 0;
+	memset(sps->scaling4x4, 16, sizeof(sps->scaling4x4));
+	memset(sps->scaling8x8, 16, sizeof(sps->scaling8x8));
 	sps->is_high_profile = is_high_profile(sps->profile_idc);
 	if (sps->is_high_profile) {
 		if (read_seq_high_extension(sps, stream) < 0) {
@@ -359,7 +403,21 @@ static int read_seq_parameter_set(h264d_sps *sps, dec_bits *stream)
 			return err;
 		}
 	}
-	return sps_id;
+	return 0;
+}
+
+static int read_seq_parameter_set(h264d_sps *sps, dec_bits *stream)
+{
+	uint32_t sps_profile_idc, sps_constraint_set_flag;
+	uint32_t sps_level_idc, sps_id;
+	int err;
+
+	sps_profile_idc = get_bits(stream, 8);
+	sps_constraint_set_flag = get_bits(stream, 8);
+	sps_level_idc = get_bits(stream, 8);
+	READ_UE_RANGE(sps_id, stream, 31);
+	err = read_seq_parameter_set_body(sps + sps_id, sps_profile_idc, sps_constraint_set_flag, sps_level_idc, stream);
+	return (err < 0) ? err : (int)sps_id;
 }
 
 static int get_sei_message_size(dec_bits *stream);
@@ -405,7 +463,34 @@ static int get_sei_message_size(dec_bits *stream)
 
 static int more_rbsp_data(dec_bits *st);
 
-static int read_pic_parameter_set(h264d_pps *pps, dec_bits *stream)
+/**Read scaling lists of PPS. Absent lists are left to fall-back rule B on activation,
+ * as they may refer to SPS.
+ */
+static int read_pic_scaling_matrix(h264d_pps *pps, int list8x8_num, dec_bits *stream)
+{
+	uint8_t list_dummy[64];
+	uint32_t present = 0;
+	for (int i = 0; i < 6; ++i) {
+		if (get_onebit(stream)) {
+			if (scaling_list(stream, pps->scaling4x4[i], 16, default_scaling4x4[3 <= i]) < 0) {
+				return -1;
+			}
+			present |= 1 << i;
+		}
+	}
+	for (int i = 0; i < list8x8_num; ++i) {
+		if (get_onebit(stream)) {
+			if (scaling_list(stream, (i < 2) ? pps->scaling8x8[i] : list_dummy, 64, default_scaling8x8[i & 1]) < 0) {
+				return -1;
+			}
+			present |= (i < 2) << (i + 6);
+		}
+	}
+	pps->pic_scaling_list_present_flag = present;
+	return 0;
+}
+
+static int read_pic_parameter_set(h264d_pps *pps, const h264d_sps *sps, dec_bits *stream)
 {
 	uint8_t pps_id;
 	int tmp;
@@ -432,9 +517,15 @@ static int read_pic_parameter_set(h264d_pps *pps, dec_bits *stream)
 	pps->deblocking_filter_control_present_flag = get_onebit(stream);
 	pps->constrained_intra_pred_flag = get_onebit(stream);
 	pps->redundant_pic_cnt_present_flag = get_onebit(stream);
+	pps->transform_8x8_mode_flag = 0;
+	pps->pic_scaling_matrix_present_flag = 0;
 	if (more_rbsp_data(stream)) {
 		pps->transform_8x8_mode_flag = get_onebit(stream);
-		if ((pps->pic_scaling_list_present_flag = get_onebit(stream)) != 0) {
+		if ((pps->pic_scaling_matrix_present_flag = get_onebit(stream)) != 0) {
+			int list8x8_num = pps->transform_8x8_mode_flag ? ((sps[pps->seq_parameter_set_id].chroma_format_idc != 3) ? 2 : 6) : 0;
+			if (read_pic_scaling_matrix(pps, list8x8_num, stream) < 0) {
+				return -1;
+			}
 		}
 		READ_SE_RANGE(pps->chroma_qp_index[1], stream, -12, 12);
 	}
@@ -495,6 +586,7 @@ int h264d_read_header(h264d_context *h2d, const byte_t *data, size_t len)
 		nal_type = get_bits(st, 8) & 31;
 	} while (nal_type != SPS_NAL);
 	sps_id = read_seq_parameter_set(h2d->sps_i, st);
+	h2d->mb_current.qmat_pps = 0;
 	if (sps_id < 0) {
 		return sps_id;
 	}
@@ -502,13 +594,9 @@ int h264d_read_header(h264d_context *h2d, const byte_t *data, size_t len)
 	return 0;
 }
 
-int h264d_get_info(h264d_context *h2d, m2d_info_t *info)
+static void sps_to_info(const h264d_sps *sps, m2d_info_t *info)
 {
 	int src_width;
-	if (!h2d || !info) {
-		return -1;
-	}
-	h264d_sps *sps = &h2d->sps_i[h2d->pps_i[h2d->slice_header->pic_parameter_set_id].seq_parameter_set_id];
 	info->src_width = src_width = sps->pic_width;
 	info->src_height = sps->pic_height;
 	info->disp_width = sps->pic_width;
@@ -521,6 +609,67 @@ int h264d_get_info(h264d_context *h2d, m2d_info_t *info)
 		+ sizeof(uint32_t) * (src_width >> 2) * 2
 		+ (sizeof(deblock_info_t) + (sizeof(h264d_col_mb_t) * 17)) * ((src_width * info->src_height) >> 8)
 		+ sizeof(h264d_col_pic_t) * 17;
+	info->mb_info_num = (src_width * info->src_height) >> 8;
+}
+
+int h264d_get_info(h264d_context *h2d, m2d_info_t *info)
+{
+	if (!h2d || !info) {
+		return -1;
+	}
+	sps_to_info(&h2d->sps_i[h2d->pps_i[h2d->slice_header->pic_parameter_set_id].seq_parameter_set_id], info);
+	return 0;
+}
+
+static int probe_sps(h264d_sps *sps, dec_bits *stream)
+{
+	uint32_t profile_idc, constraint_set_flag, level_idc;
+
+	do {
+		if (m2d_find_mpeg_data(stream) < 0) {
+			return -1;
+		}
+	} while ((get_bits(stream, 8) & 31) != SPS_NAL);
+	profile_idc = get_bits(stream, 8);
+	constraint_set_flag = get_bits(stream, 8);
+	level_idc = get_bits(stream, 8);
+	if (31 < ue_golomb(stream)) {
+		/* seq_parameter_set_id */
+		return -1;
+	}
+	return read_seq_parameter_set_body(sps, profile_idc, constraint_set_flag, level_idc, stream);
+}
+
+/**Report stream parameters from the first SPS without context.
+ */
+int h264d_probe(const byte_t *data, size_t len, m2d_probe_t *probe)
+{
+	dec_bits stream;
+	h264d_sps sps;
+
+	if (!data || !len || !probe) {
+		return -1;
+	}
+	m2d_probe_stream_open(&stream, m2d_load_bytes_skip03, data, len);
+	if (setjmp(stream.jmp) != 0) {
+		return -1;
+	}
+	memset(&sps, 0, sizeof(sps));
+	if (probe_sps(&sps, &stream) < 0) {
+		return -1;
+	}
+	sps_to_info(&sps, &probe->info);
+	probe->profile = sps.profile_idc;
+	probe->level = sps.level_idc;
+	probe->chroma_format = sps.chroma_format_idc;
+	if (sps.vui_parameters_present_flag && sps.vui.timing_info_present_flag && sps.vui.num_units_in_tick) {
+		probe->frame_rate_num = sps.vui.time_scale;
+		probe->frame_rate_den = sps.vui.num_units_in_tick * 2;
+	} else {
+		probe->frame_rate_num = 0;
+		probe->frame_rate_den = 0;
+	}
+	m2d_probe_set_frame_size(probe);
 	return 0;
 }
 
@@ -639,6 +788,9 @@ static inline void frames_init(h264d_mb_current *mb, int num_frame, const m2d_fr
 	h264d_frame_info_t *frm = mb->frame;
 	frm->num = num_frame;
 	std::copy(frame, frame + num_frame, frm->frames);
+	for (int i = 0; i < num_frame; ++i) {
+		frm->frames[i].mb_info = 0;
+	}
 	memset(frm->lru, 0, sizeof(frm->lru));
 }
 
@@ -872,25 +1024,32 @@ static int h2d_dispatch_one_nal(h264d_context *h2d, int code_type)
 {
 	int err;
 	dec_bits *st = h2d->stream;
+	m2d_stream_mark_t mark;
 
 	switch(code_type & 31) {
 	case SLICE_NONIDR_NAL:
 	case SLICE_IDR_NAL:
 		h2d->id = code_type;
+		m2d_stream_mark(&mark, st);
 		err = read_slice(h2d, st);
+		if (h2d->mb_current.stats) {
+			h2d->mb_current.stats->bits += 32 + m2d_stream_bits_from(&mark, st);
+		}
 		break;
 	case SEI_NAL:
 		err = skip_sei(st);
 		break;
 	case SPS_NAL:
 		err = read_seq_parameter_set(h2d->sps_i, st);
+		h2d->mb_current.qmat_pps = 0;
 		if (0 <= err) {
 			set_mb_size(&h2d->mb_current, h2d->sps_i[err].pic_width, h2d->sps_i[err].pic_height);
 			h2d->header_callback(h2d->header_callback_arg, st->id);
 		}
 		break;
 	case PPS_NAL:
-		err = read_pic_parameter_set(h2d->pps_i, st);
+		err = read_pic_parameter_set(h2d->pps_i, h2d->sps_i, st);
+		h2d->mb_current.qmat_pps = 0;
 		break;
 	default:
 		err = 0;
@@ -959,6 +1118,7 @@ static inline void find_empty_frame(h264d_mb_current *mb)
 	frm->index = max_idx;
 	frm->curr_luma = frm->frames[max_idx].luma;
 	frm->curr_chroma = frm->frames[max_idx].chroma;
+	mb->mb_info = frm->frames[max_idx].mb_info = m2d_mb_info_frame(frm->mb_info, frm->mb_info_size, max_idx, mb->max_x * mb->max_y);
 }
 
 static void qp_matrix(int16_t *matrix, int scale, int shift)
@@ -1076,23 +1236,16 @@ static int qpc_adjust(int qpy, int qpc_diff)
 
 static void set_qpc(h264d_mb_current *mb, int qpy, int idx, int qpc_dif)
 {
-	int div, mod;
 	int qpc;
 	mb->qp_chroma[idx] = qpc = qpc_adjust(qpy, qpc_dif);
-	if (qpc != qpy) {
-		div = (unsigned)qpc / 6;
-		mod = qpc - div * 6;
-		mb->qmatc_p[idx] = mb->qmatc[idx];
-		qp_matrix(mb->qmatc[idx], mod, div);
-	} else {
-		mb->qmatc_p[idx] = mb->qmaty;
-	}
+	mb->qmatc[idx] = &mb->qmat_tbl[qpc];
 }
 
+/**Switch dequantization matrices to qpy.
+ * Matrices of all QPs are prepared by qmat_table_init() on activation of parameter sets.
+ */
 static void set_qp(h264d_mb_current *mb, int qpy)
 {
-	int div;
-	int mod;
 	int qpc_dif0, qpc_dif1;
 
 	if (qpy < 0) {
@@ -1101,18 +1254,13 @@ static void set_qp(h264d_mb_current *mb, int qpy)
 		qpy -= 52;
 	}
 	mb->qp = qpy;
-	div = (unsigned)qpy / 6;
-	mod = qpy - div * 6;
-	qp_matrix(mb->qmaty, mod, div);
-	if (mb->pps->transform_8x8_mode_flag) {
-		qp_matrix8x8(mb->qmaty8x8, mod, div - 2);
-	}
+	mb->qmaty = &mb->qmat_tbl[qpy];
 	qpc_dif0 = mb->pps->chroma_qp_index[0];
 	set_qpc(mb, qpy, 0, qpc_dif0);
 	qpc_dif1 = mb->pps->chroma_qp_index[1];
 	if (qpc_dif0 == qpc_dif1) {
 		mb->qp_chroma[1] = mb->qp_chroma[0];
-		mb->qmatc_p[1] = mb->qmatc_p[0];
+		mb->qmatc[1] = mb->qmatc[0];
 	} else {
 		set_qpc(mb, qpy, 1, qpc_dif1);
 	}
@@ -1379,10 +1527,12 @@ const h264d_bdirect_functions_t bdirect_functions[2][2][2] = {
 };
 
 static void set_mb_decode(h264d_mb_current *mb, const h264d_pps *pps);
+static void set_recon_func(h264d_mb_current *mb);
 static int pred_weight_table(h264d_weighted_table_pair_t *weight_offset, dec_bits *st, int active_num, const int8_t shift[]);
 static void inter_pred_basic(const h264d_mb_current *mb, const int8_t ref_idx[], const h264d_vector_t mv[], const h264d_vector_t& size, int offsetx, int offsety);
 static void inter_pred_weighted1(const h264d_mb_current *mb, const int8_t ref_idx[], const h264d_vector_t mv[], const h264d_vector_t& size, int offsetx, int offsety);
 static void inter_pred_weighted2(const h264d_mb_current *mb, const int8_t ref_idx[], const h264d_vector_t mv[], const h264d_vector_t& size, int offsetx, int offsety);
+static void inter_pred_none(const h264d_mb_current *mb, const int8_t ref_idx[], const h264d_vector_t mv[], const h264d_vector_t& size, int offsetx, int offsety) {}
 
 static int set_weighted_info(h264d_mb_current *mb, dec_bits *st, h264d_slice_header *hdr, int slice_type, int pred_type) {
 	mb->header = hdr;
@@ -1414,6 +1564,8 @@ static void build_4x4offset_table(int dst[], int stride) {
 	}
 }
 
+static void qmat_table_init(h264d_mb_current *mb, const h264d_sps *sps, const h264d_pps *pps);
+
 static int slice_header(h264d_context *h2d, dec_bits *st)
 {
 	h264d_slice_header *hdr = h2d->slice_header;
@@ -1430,16 +1582,29 @@ static int slice_header(h264d_context *h2d, dec_bits *st)
 		}
 		find_empty_frame(mb);
 		memset(mb->deblock_base, 0, sizeof(*mb->deblock_base) * mb->max_x * mb->max_y);
+		if (mb->stats) {
+			m2d_stats_init(mb->stats);
+		}
 	}
 	READ_UE_RANGE(slice_type, st, 9);
 	hdr->slice_type = slice_type_adjust(slice_type);
 	if (3U <= (unsigned)hdr->slice_type) {
 		return -1;
 	}
+	set_recon_func(mb);
+	if (mb->stats) {
+		static const int8_t pic_type[3] = {
+			M2D_PICTYPE_P, M2D_PICTYPE_B, M2D_PICTYPE_I
+		};
+		m2d_stats_pic_type(mb->stats, pic_type[hdr->slice_type]);
+	}
 	READ_UE_RANGE(hdr->pic_parameter_set_id, st, 255);
 	pps = &h2d->pps_i[hdr->pic_parameter_set_id];
 	sps = &h2d->sps_i[pps->seq_parameter_set_id];
 	mb->pps = pps;
+	if (mb->qmat_pps != pps) {
+		qmat_table_init(mb, sps, pps);
+	}
 	mb->is_constrained_intra = pps->constrained_intra_pred_flag;
 	set_mb_decode(mb, pps);
 
@@ -1539,6 +1704,9 @@ static int slice_header(h264d_context *h2d, dec_bits *st)
 			}
 		}
 		mb->bdirect->func = &bdirect_functions[sps->direct_8x8_inference_flag][pps->transform_8x8_mode_flag][hdr->direct_spatial_mv_pred_flag];
+		if (mb->stats) {
+			mb->inter_pred = inter_pred_none;
+		}
 	}
 	if (h2d->id & 0x60) {
 		if (dec_ref_pic_marking(h2d->id & 31, &hdr->marking, st) < 0) {
@@ -1993,16 +2161,89 @@ static const int8_t * const inverse_zigzag[6] = {
 	inverse_zigzag8x8[0]
 };
 
+/**Build dequantization matrices of all QPs from scaling lists of pps and its SPS.
+ * Lists absent in pps follow fall-back rule A when SPS has no matrix, and rule B otherwise.
+ * Each matrix holds LevelScale << (qp / 6), to be shifted back with rounding per coefficient,
+ * so that low QPs are dequantized as exactly as 8.5.12.1 does.
+ */
+static void qmat_table_init(h264d_mb_current *mb, const h264d_sps *sps, const h264d_pps *pps)
+{
+	const uint8_t *w4x4[6];
+	const uint8_t *w8x8[2];
+	if (!pps->pic_scaling_matrix_present_flag) {
+		for (int i = 0; i < 6; ++i) {
+			w4x4[i] = sps->scaling4x4[i];
+		}
+		for (int i = 0; i < 2; ++i) {
+			w8x8[i] = sps->scaling8x8[i];
+		}
+	} else {
+		uint32_t present = pps->pic_scaling_list_present_flag;
+		bool rule_b = sps->seq_scaling_matrix_present_flag;
+		for (int i = 0; i < 6; ++i) {
+			if (present & (1 << i)) {
+				w4x4[i] = pps->scaling4x4[i];
+			} else if ((i == 0) || (i == 3)) {
+				w4x4[i] = rule_b ? sps->scaling4x4[i] : default_scaling4x4[3 <= i];
+			} else {
+				w4x4[i] = w4x4[i - 1];
+			}
+		}
+		for (int i = 0; i < 2; ++i) {
+			if (present & (1 << (i + 6))) {
+				w8x8[i] = pps->scaling8x8[i];
+			} else {
+				w8x8[i] = rule_b ? sps->scaling8x8[i] : default_scaling8x8[i];
+			}
+		}
+	}
+	const int8_t *zigzag4x4 = inverse_zigzag4x4[0];
+	const int8_t *zigzag8x8 = inverse_zigzag8x8[0];
+	h264d_qmat_t *qmat = mb->qmat_tbl;
+	for (int qp = 0; qp < 52; ++qp) {
+		int16_t norm4x4[16];
+		int16_t norm8x8[64];
+		int div = (unsigned)qp / 6;
+		int mod = qp - div * 6;
+		qp_matrix(norm4x4, mod, 0);
+		qp_matrix8x8(norm8x8, mod, 0);
+		for (int i = 0; i < 6; ++i) {
+			const uint8_t *w = w4x4[i];
+			int32_t *dst = qmat->qmat4x4[i];
+			for (int j = 0; j < 16; ++j) {
+				int pos = zigzag4x4[j];
+				dst[pos] = (w[j] * norm4x4[pos]) << div;
+			}
+		}
+		for (int i = 0; i < 2; ++i) {
+			const uint8_t *w = w8x8[i];
+			int32_t *dst = qmat->qmat8x8[i];
+			for (int j = 0; j < 64; ++j) {
+				int pos = zigzag8x8[j];
+				dst[pos] = (w[j] * norm8x8[pos]) << div;
+			}
+		}
+		qmat++;
+	}
+	mb->qmat_pps = pps;
+}
+
 static const struct {
 	uint8_t cabac_coeff_abs_level_offset;
 	int8_t coeff_offset;
 	int8_t num_coeff;
 	int8_t coeff_dc_mask;
+	int8_t dequant_shift; /* DC of Intra16x16 and chroma are shifted after their DC transforms */
 } coeff_ofs[6] = {
-	{0, 0, 16, 0}, {10, 1, 15, 15}, {20, 0, 16, 15}, {30, 0, 4, 0}, {39, 1, 15, 15}, {426 - 227, 0, 64, 63}
+	{0, 0, 16, 0, 0}, {10, 1, 15, 15, 4}, {20, 0, 16, 15, 4}, {30, 0, 4, 0, 0}, {39, 1, 15, 15, 4}, {426 - 227, 0, 64, 63, 6}
 };
 
-static inline void coeff_writeback(int *coeff, int total_coeff, const int8_t *run, const int *level, const int16_t *qmat, int cat)
+static inline int dequantize(int level, int32_t scale, int shift)
+{
+	return (level * scale + ((1 << shift) >> 1)) >> shift;
+}
+
+static inline void coeff_writeback(int *coeff, int total_coeff, const int8_t *run, const int *level, const int32_t *qmat, int cat)
 {
 	static const int8_t error_idx_mask[6] = {
 		15, 15, 15, 3, 15, 63
@@ -2012,11 +2253,12 @@ static inline void coeff_writeback(int *coeff, int total_coeff, const int8_t *ru
 	memset(coeff + idx, 0, sizeof(*coeff) * coeff_ofs[cat].num_coeff);
 	uint32_t dc_mask = coeff_ofs[cat].coeff_dc_mask;
 	uint32_t err_mask = error_idx_mask[cat];
+	int shift = coeff_ofs[cat].dequant_shift;
 	idx--;
 	for (int i = total_coeff - 1; 0 <= i; --i) {
 		idx = (idx + 1 + run[i]) & err_mask;
 		int zig_idx = zigzag[idx];
-		coeff[zig_idx] = level[i] * qmat[zig_idx & dc_mask];
+		coeff[zig_idx] = dequantize(level[i], qmat[zig_idx & dc_mask], shift);
 	}
 	
 }
@@ -2036,7 +2278,7 @@ static inline int SQUARE(int x) {
 }
 
 struct residual_block_cavlc {
-	int operator()(h264d_mb_current *mb, int na, int nb, dec_bits *st, int *coeff, const int16_t *qmat, int avail, int pos4x4, int cat, uint32_t dc_mask) const {
+	int operator()(h264d_mb_current *mb, int na, int nb, dec_bits *st, int *coeff, const int32_t *qmat, int avail, int pos4x4, int cat, uint32_t dc_mask) const {
 		int level[16];
 		int8_t run[16];
 		const vlc_t *tbl;
@@ -2370,8 +2612,36 @@ static inline void ac4x4transform_acdc_chroma(uint8_t *dst, const int *coeff, in
 }
 #endif
 
+/** Intra prediction and inverse transforms, which are replaced by no-ops in analysis mode.
+ */
+struct h264d_recon_func_t {
+	int (* const *intra4x4pred)(uint8_t *dst, int stride, int avail);
+	int (* const *intra8x8pred)(uint8_t *dst, int stride, int avail);
+	int (* const *intra_chroma_pred)(uint8_t *dst, int stride, int avail);
+	int (*intra16x16pred)(int (*pred)(uint8_t *dst, int stride, int avail), uint8_t *dst, int stride, int avail);
+	void (*luma4x4)(uint8_t *dst, const int *coeff, int stride);
+	void (*luma4x4_dconly)(uint8_t *dst, int dc, int stride);
+	void (*luma8x8)(uint8_t *dst, const int *coeff, int stride, int coeff_num);
+	void (*chroma4x4)(uint8_t *dst, const int *coeff, int stride);
+	void (*chroma4x4_dconly)(uint8_t *dst, int dc, int stride);
+};
+
+static inline void chroma_acdc_transform(const h264d_mb_current *mb, uint8_t *dst, const int *coeff, int stride)
+{
+	if (!mb->luma_only) {
+		mb->recon->chroma4x4(dst, coeff, stride);
+	}
+}
+
+static inline void chroma_dconly_transform(const h264d_mb_current *mb, uint8_t *dst, int dc, int stride)
+{
+	if (!mb->luma_only) {
+		mb->recon->chroma4x4_dconly(dst, dc, stride);
+	}
+}
+
 template <typename F0>
-static inline int residual_chroma(h264d_mb_current *mb, uint32_t cbp, dec_bits *st, int avail, F0 ResidualBlock)
+static inline int residual_chroma(h264d_mb_current *mb, uint32_t cbp, dec_bits *st, int avail, bool inter, F0 ResidualBlock)
 {
 	int ALIGN16VC coeff[16] __attribute__((aligned(16)));
 	int dc[2][4];
@@ -2386,7 +2656,7 @@ static inline int residual_chroma(h264d_mb_current *mb, uint32_t cbp, dec_bits *
 		return 0;
 	}
 	for (int i = 0; i < 2; ++i) {
-		if (ResidualBlock(mb, 0, 0, st, coeff, mb->qmatc_p[i], avail, 16 + i, 3, 0)) {
+		if (ResidualBlock(mb, 0, 0, st, coeff, mb->qmatc[i]->qmat4x4[(inter ? 4 : 1) + i], avail, 16 + i, 3, 0)) {
 			intra_chroma_dc_transform(coeff, dc[i]);
 		} else {
 			memset(dc[i], 0, sizeof(dc[0][0]) * 4);
@@ -2400,6 +2670,7 @@ static inline int residual_chroma(h264d_mb_current *mb, uint32_t cbp, dec_bits *
 		uint32_t left = mb->left4x4coef >> 16;
 		uint32_t top = *mb->top4x4coef >> 16;
 		for (int i = 0; i < 2; ++i) {
+			const int32_t *qmatc = mb->qmatc[i]->qmat4x4[(inter ? 4 : 1) + i];
 			int c0left, c2left;
 			int c0top, c1top;
 			if (avail & 1) {
@@ -2414,29 +2685,29 @@ static inline int residual_chroma(h264d_mb_current *mb, uint32_t cbp, dec_bits *
 			} else {
 				c0top = c1top = -1;
 			}
-			if ((c0 = ResidualBlock(mb, c0left, c0top, st, coeff, mb->qmatc_p[i], avail, 18 + i * 4, 4, 0x1f)) != 0) {
+			if ((c0 = ResidualBlock(mb, c0left, c0top, st, coeff, qmatc, avail, 18 + i * 4, 4, 0x1f)) != 0) {
 				coeff[0] = *dcp++;
-				ac4x4transform_acdc_chroma(chroma, coeff, stride);
+				chroma_acdc_transform(mb, chroma, coeff, stride);
 			} else {
-				ac4x4transform_dconly_chroma(chroma, *dcp++, stride);
+				chroma_dconly_transform(mb, chroma, *dcp++, stride);
 			}
-			if ((c1 = ResidualBlock(mb, c0, c1top, st, coeff, mb->qmatc_p[i], avail, 19 + i * 4, 4, 0x1f)) != 0) {
+			if ((c1 = ResidualBlock(mb, c0, c1top, st, coeff, qmatc, avail, 19 + i * 4, 4, 0x1f)) != 0) {
 				coeff[0] = *dcp++;
-				ac4x4transform_acdc_chroma(chroma + 8, coeff, stride);
+				chroma_acdc_transform(mb, chroma + 8, coeff, stride);
 			} else {
-				ac4x4transform_dconly_chroma(chroma + 8, *dcp++, stride);
+				chroma_dconly_transform(mb, chroma + 8, *dcp++, stride);
 			}
-			if ((c2 = ResidualBlock(mb, c2left, c0, st, coeff, mb->qmatc_p[i], avail, 20 + i * 4, 4, 0x1f)) != 0) {
+			if ((c2 = ResidualBlock(mb, c2left, c0, st, coeff, qmatc, avail, 20 + i * 4, 4, 0x1f)) != 0) {
 				coeff[0] = *dcp++;
-				ac4x4transform_acdc_chroma(chroma + stride * 4, coeff, stride);
+				chroma_acdc_transform(mb, chroma + stride * 4, coeff, stride);
 			} else {
-				ac4x4transform_dconly_chroma(chroma + stride * 4, *dcp++, stride);
+				chroma_dconly_transform(mb, chroma + stride * 4, *dcp++, stride);
 			}
-			if ((c3 = ResidualBlock(mb, c2, c1, st, coeff, mb->qmatc_p[i], avail, 21 + i * 4, 4, 0x1f)) != 0) {
+			if ((c3 = ResidualBlock(mb, c2, c1, st, coeff, qmatc, avail, 21 + i * 4, 4, 0x1f)) != 0) {
 				coeff[0] = *dcp++;
-				ac4x4transform_acdc_chroma(chroma + stride * 4 + 8, coeff, stride);
+				chroma_acdc_transform(mb, chroma + stride * 4 + 8, coeff, stride);
 			} else {
-				ac4x4transform_dconly_chroma(chroma + stride * 4 + 8, *dcp++, stride);
+				chroma_dconly_transform(mb, chroma + stride * 4 + 8, *dcp++, stride);
 			}
 			left = ((left >> 8) & 0xff) | (c3 << 12) | (c1 << 8);
 			top = ((top >> 8) & 0xff)| (c3 << 12) | (c2 << 8);
@@ -2445,14 +2716,14 @@ static inline int residual_chroma(h264d_mb_current *mb, uint32_t cbp, dec_bits *
 		mb->left4x4coef = (mb->left4x4coef & 0x0000ffff) | (left << 16);
 		*mb->top4x4coef = (*mb->top4x4coef & 0x0000ffff) | (top << 16);
 	} else {
-		ac4x4transform_dconly_chroma(chroma, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + 8, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + stride * 4, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + stride * 4 + 8, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + 1, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + 9, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + stride * 4 + 1, *dcp++, stride);
-		ac4x4transform_dconly_chroma(chroma + stride * 4 + 9, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + 8, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + stride * 4, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + stride * 4 + 8, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + 1, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + 9, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + stride * 4 + 1, *dcp++, stride);
+		chroma_dconly_transform(mb, chroma + stride * 4 + 9, *dcp++, stride);
 		mb->left4x4coef &= 0x0000ffff;
 		*mb->top4x4coef &= 0x0000ffff;
 	}
@@ -3072,7 +3343,7 @@ static int (* const intra_chroma_pred[4])(uint8_t *dst, int stride, int avail) =
 	mb_intra_chroma_pred_planer
 };
 
-static inline void ac4x4transform_maybe(uint8_t *dst, const int *coeff, int stride, int num_coeff);
+static inline void ac4x4transform_maybe(const h264d_mb_current *mb, uint8_t *dst, const int *coeff, int stride, int num_coeff);
 static void mb_intra_save_info(h264d_mb_current *mb, int8_t transform8x8)
 {
 	mb->lefttop_ref[0] = mb->top4x4inter->ref[1][0];
@@ -3126,51 +3397,51 @@ static inline void luma_intra4x4_with_residual(h264d_mb_current *mb, dec_bits *s
 	int c0, c1, c2, c3, c4, c5;
 	uint8_t *luma = mb->luma;
 	const int *offset = mb->offset4x4;
-	const int16_t *qmat = mb->qmaty;
+	const int32_t *qmat = mb->qmaty->qmat4x4[0];
 
 	if (cbp & 1) {
-		intra4x4pred_func[*pr++](luma, stride, avail_intra | (avail_intra & 2 ? 4 : 0));
+		mb->recon->intra4x4pred[*pr++](luma, stride, avail_intra | (avail_intra & 2 ? 4 : 0));
 		c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1, avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1, st, coeff, qmat, avail_intra, 0, 2, 0xf);
-		ac4x4transform_maybe(luma, coeff, stride, c0);
-		intra4x4pred_func[*pr++](luma + 4, stride, avail_intra | (avail_intra & 2 ? 5 : 1));
+		ac4x4transform_maybe(mb, luma, coeff, stride, c0);
+		mb->recon->intra4x4pred[*pr++](luma + 4, stride, avail_intra | (avail_intra & 2 ? 5 : 1));
 		c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 1) : -1, st, coeff, qmat, avail_intra, 1, 2, 0xf);
-		ac4x4transform_maybe(luma + 4, coeff, stride, c1);
-		intra4x4pred_func[*pr++](luma + offset[2], stride, avail_intra | 6);
+		ac4x4transform_maybe(mb, luma + 4, coeff, stride, c1);
+		mb->recon->intra4x4pred[*pr++](luma + offset[2], stride, avail_intra | 6);
 		c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 1) : -1, c0, st, coeff, qmat, avail_intra, 2, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[2], coeff, stride, c2);
-		intra4x4pred_func[*pr++](luma + offset[3], stride, 3);
+		ac4x4transform_maybe(mb, luma + offset[2], coeff, stride, c2);
+		mb->recon->intra4x4pred[*pr++](luma + offset[3], stride, 3);
 		c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 3, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[3], coeff, stride, c3);
+		ac4x4transform_maybe(mb, luma + offset[3], coeff, stride, c3);
 	} else {
-		intra4x4pred_func[*pr++](luma, stride, avail_intra | (avail_intra & 2 ? 4 : 0));
-		intra4x4pred_func[*pr++](luma + 4, stride, avail_intra | (avail_intra & 2 ? 5 : 1));
-		intra4x4pred_func[*pr++](luma + offset[2], stride, avail_intra | 6);
-		intra4x4pred_func[*pr++](luma + offset[3], stride, 3);
+		mb->recon->intra4x4pred[*pr++](luma, stride, avail_intra | (avail_intra & 2 ? 4 : 0));
+		mb->recon->intra4x4pred[*pr++](luma + 4, stride, avail_intra | (avail_intra & 2 ? 5 : 1));
+		mb->recon->intra4x4pred[*pr++](luma + offset[2], stride, avail_intra | 6);
+		mb->recon->intra4x4pred[*pr++](luma + offset[3], stride, 3);
 		c0 = 0;
 		c1 = 0;
 		c2 = 0;
 		c3 = 0;
 	}
 	if (cbp & 2) {
-		intra4x4pred_func[*pr++](luma + offset[4], stride, avail_intra | (avail_intra & 2 ? 5 : 1));
+		mb->recon->intra4x4pred[*pr++](luma + offset[4], stride, avail_intra | (avail_intra & 2 ? 5 : 1));
 		c0 = ResidualBlock(mb, c1, avail & 2 ? UNPACK(*mb->top4x4coef, 2) : -1, st, coeff, qmat, avail_intra, 4, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[4], coeff, stride, c0);
-		intra4x4pred_func[*pr++](luma + offset[5], stride, avail_intra | 1);
+		ac4x4transform_maybe(mb, luma + offset[4], coeff, stride, c0);
+		mb->recon->intra4x4pred[*pr++](luma + offset[5], stride, avail_intra | 1);
 		c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 3) : -1, st, coeff, qmat, avail_intra, 5, 2, 0xf);
 		left = PACK(0, c1, 0);
-		ac4x4transform_maybe(luma + offset[5], coeff, stride, c1);
-		intra4x4pred_func[*pr++](luma + offset[6], stride, 7);
+		ac4x4transform_maybe(mb, luma + offset[5], coeff, stride, c1);
+		mb->recon->intra4x4pred[*pr++](luma + offset[6], stride, 7);
 		c4 = ResidualBlock(mb, c3, c0, st, coeff, qmat, avail_intra, 6, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[6], coeff, stride, c4);
-		intra4x4pred_func[*pr++](luma + offset[7], stride, 3);
+		ac4x4transform_maybe(mb, luma + offset[6], coeff, stride, c4);
+		mb->recon->intra4x4pred[*pr++](luma + offset[7], stride, 3);
 		c5 = ResidualBlock(mb, c4, c1, st, coeff, qmat, avail_intra, 7, 2, 0xf);
 		left = PACK(left, c5, 1);
-		ac4x4transform_maybe(luma + offset[7], coeff, stride, c5);
+		ac4x4transform_maybe(mb, luma + offset[7], coeff, stride, c5);
 	} else {
-		intra4x4pred_func[*pr++](luma + offset[4], stride, avail_intra | (avail_intra & 2 ? 5 : 1));
-		intra4x4pred_func[*pr++](luma + offset[5], stride, avail_intra | 1);
-		intra4x4pred_func[*pr++](luma + offset[6], stride, 7);
-		intra4x4pred_func[*pr++](luma + offset[7], stride, 3);
+		mb->recon->intra4x4pred[*pr++](luma + offset[4], stride, avail_intra | (avail_intra & 2 ? 5 : 1));
+		mb->recon->intra4x4pred[*pr++](luma + offset[5], stride, avail_intra | 1);
+		mb->recon->intra4x4pred[*pr++](luma + offset[6], stride, 7);
+		mb->recon->intra4x4pred[*pr++](luma + offset[7], stride, 3);
 		c0 = 0;
 		c1 = 0;
 		c4 = 0;
@@ -3178,25 +3449,25 @@ static inline void luma_intra4x4_with_residual(h264d_mb_current *mb, dec_bits *s
 		left = 0;
 	}
 	if (cbp & 4) {
-		intra4x4pred_func[*pr++](luma + offset[8], stride, avail_intra | 6);
+		mb->recon->intra4x4pred[*pr++](luma + offset[8], stride, avail_intra | 6);
 		c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 2) : -1, c2, st, coeff, qmat, avail_intra, 8, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[8], coeff, stride, c0);
-		intra4x4pred_func[*pr++](luma + offset[9], stride, 7);
+		ac4x4transform_maybe(mb, luma + offset[8], coeff, stride, c0);
+		mb->recon->intra4x4pred[*pr++](luma + offset[9], stride, 7);
 		c1 = ResidualBlock(mb, c0, c3, st, coeff, qmat, avail_intra, 9, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[9], coeff, stride, c1);
-		intra4x4pred_func[*pr++](luma + offset[10], stride, avail_intra | 6);
+		ac4x4transform_maybe(mb, luma + offset[9], coeff, stride, c1);
+		mb->recon->intra4x4pred[*pr++](luma + offset[10], stride, avail_intra | 6);
 		c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 3) : -1, c0, st, coeff, qmat, avail_intra, 10, 2, 0xf);
 		top = PACK(0, c2, 0);
-		ac4x4transform_maybe(luma + offset[10], coeff, stride, c2);
-		intra4x4pred_func[*pr++](luma + offset[11], stride, 3);
+		ac4x4transform_maybe(mb, luma + offset[10], coeff, stride, c2);
+		mb->recon->intra4x4pred[*pr++](luma + offset[11], stride, 3);
 		c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 11, 2, 0xf);
 		top = PACK(top, c3, 1);
-		ac4x4transform_maybe(luma + offset[11], coeff, stride, c3);
+		ac4x4transform_maybe(mb, luma + offset[11], coeff, stride, c3);
 	} else {
-		intra4x4pred_func[*pr++](luma + offset[8], stride, avail_intra | 6);
-		intra4x4pred_func[*pr++](luma + offset[9], stride, 7);
-		intra4x4pred_func[*pr++](luma + offset[10], stride, avail_intra | 6);
-		intra4x4pred_func[*pr++](luma + offset[11], stride, 3);
+		mb->recon->intra4x4pred[*pr++](luma + offset[8], stride, avail_intra | 6);
+		mb->recon->intra4x4pred[*pr++](luma + offset[9], stride, 7);
+		mb->recon->intra4x4pred[*pr++](luma + offset[10], stride, avail_intra | 6);
+		mb->recon->intra4x4pred[*pr++](luma + offset[11], stride, 3);
 		c0 = 0;
 		c1 = 0;
 		c2 = 0;
@@ -3204,25 +3475,25 @@ static inline void luma_intra4x4_with_residual(h264d_mb_current *mb, dec_bits *s
 		top = 0;
 	}
 	if (cbp & 8) {
-		intra4x4pred_func[*pr++](luma + offset[12], stride, 7);
+		mb->recon->intra4x4pred[*pr++](luma + offset[12], stride, 7);
 		c0 = ResidualBlock(mb, c1, c4, st, coeff, qmat, avail_intra, 12, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[12], coeff, stride, c0);
-		intra4x4pred_func[*pr++](luma + offset[13], stride, 3);
+		ac4x4transform_maybe(mb, luma + offset[12], coeff, stride, c0);
+		mb->recon->intra4x4pred[*pr++](luma + offset[13], stride, 3);
 		c1 = ResidualBlock(mb, c0, c5, st, coeff, qmat, avail_intra, 13, 2, 0xf);
 		left = PACK(left, c1, 2);
-		ac4x4transform_maybe(luma + offset[13], coeff, stride, c1);
-		intra4x4pred_func[*pr++](luma + offset[14], stride, 7);
+		ac4x4transform_maybe(mb, luma + offset[13], coeff, stride, c1);
+		mb->recon->intra4x4pred[*pr++](luma + offset[14], stride, 7);
 		c2 = ResidualBlock(mb, c3, c0, st, coeff, qmat, avail_intra, 14, 2, 0xf);
 		top = PACK(top, c2, 2);
-		ac4x4transform_maybe(luma + offset[14], coeff, stride, c2);
-		intra4x4pred_func[*pr++](luma + offset[15], stride, 3);
+		ac4x4transform_maybe(mb, luma + offset[14], coeff, stride, c2);
+		mb->recon->intra4x4pred[*pr++](luma + offset[15], stride, 3);
 		c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 15, 2, 0xf);
-		ac4x4transform_maybe(luma + offset[15], coeff, stride, c3);
+		ac4x4transform_maybe(mb, luma + offset[15], coeff, stride, c3);
 	} else {
-		intra4x4pred_func[*pr++](luma + offset[12], stride, 7);
-		intra4x4pred_func[*pr++](luma + offset[13], stride, 3);
-		intra4x4pred_func[*pr++](luma + offset[14], stride, 7);
-		intra4x4pred_func[*pr++](luma + offset[15], stride, 3);
+		mb->recon->intra4x4pred[*pr++](luma + offset[12], stride, 7);
+		mb->recon->intra4x4pred[*pr++](luma + offset[13], stride, 3);
+		mb->recon->intra4x4pred[*pr++](luma + offset[14], stride, 7);
+		mb->recon->intra4x4pred[*pr++](luma + offset[15], stride, 3);
 		c3 = 0; 
 	}
 	mb->left4x4coef = (mb->left4x4coef & 0xffff0000) | PACK(left, c3, 3);
@@ -3233,22 +3504,22 @@ static inline void luma_intra4x4_pred(h264d_mb_current *mb, int avail_intra, con
 {
 	uint8_t *luma = mb->luma;
 	const int *offset = mb->offset4x4;
-	intra4x4pred_func[*pr++](luma, stride, avail_intra | (avail_intra & 2 ? 4 : 0));
-	intra4x4pred_func[*pr++](luma + 4, stride, avail_intra | (avail_intra & 2 ? 5 : 1));
-	intra4x4pred_func[*pr++](luma + offset[2], stride, avail_intra | 6);
-	intra4x4pred_func[*pr++](luma + offset[3], stride, 3);
-	intra4x4pred_func[*pr++](luma + offset[4], stride, avail_intra | (avail_intra & 2 ? 5 : 1));
-	intra4x4pred_func[*pr++](luma + offset[5], stride, avail_intra | 1);
-	intra4x4pred_func[*pr++](luma + offset[6], stride, 7);
-	intra4x4pred_func[*pr++](luma + offset[7], stride, 3);
-	intra4x4pred_func[*pr++](luma + offset[8], stride, avail_intra | 6);
-	intra4x4pred_func[*pr++](luma + offset[9], stride, 7);
-	intra4x4pred_func[*pr++](luma + offset[10], stride, avail_intra | 6);
-	intra4x4pred_func[*pr++](luma + offset[11], stride, 3);
-	intra4x4pred_func[*pr++](luma + offset[12], stride, 7);
-	intra4x4pred_func[*pr++](luma + offset[13], stride, 3);
-	intra4x4pred_func[*pr++](luma + offset[14], stride, 7);
-	intra4x4pred_func[*pr](luma + offset[15], stride, 3);
+	mb->recon->intra4x4pred[*pr++](luma, stride, avail_intra | (avail_intra & 2 ? 4 : 0));
+	mb->recon->intra4x4pred[*pr++](luma + 4, stride, avail_intra | (avail_intra & 2 ? 5 : 1));
+	mb->recon->intra4x4pred[*pr++](luma + offset[2], stride, avail_intra | 6);
+	mb->recon->intra4x4pred[*pr++](luma + offset[3], stride, 3);
+	mb->recon->intra4x4pred[*pr++](luma + offset[4], stride, avail_intra | (avail_intra & 2 ? 5 : 1));
+	mb->recon->intra4x4pred[*pr++](luma + offset[5], stride, avail_intra | 1);
+	mb->recon->intra4x4pred[*pr++](luma + offset[6], stride, 7);
+	mb->recon->intra4x4pred[*pr++](luma + offset[7], stride, 3);
+	mb->recon->intra4x4pred[*pr++](luma + offset[8], stride, avail_intra | 6);
+	mb->recon->intra4x4pred[*pr++](luma + offset[9], stride, 7);
+	mb->recon->intra4x4pred[*pr++](luma + offset[10], stride, avail_intra | 6);
+	mb->recon->intra4x4pred[*pr++](luma + offset[11], stride, 3);
+	mb->recon->intra4x4pred[*pr++](luma + offset[12], stride, 7);
+	mb->recon->intra4x4pred[*pr++](luma + offset[13], stride, 3);
+	mb->recon->intra4x4pred[*pr++](luma + offset[14], stride, 7);
+	mb->recon->intra4x4pred[*pr](luma + offset[15], stride, 3);
 	mb->left4x4coef &= 0xffff0000;
 	*mb->top4x4coef &= 0xffff0000;
 }
@@ -3276,7 +3547,9 @@ static inline int mb_intra4x4(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	VC_CHECK;
 	intra_chroma_pred_mode = IntraChromaPredMode(mb, st, avail_intra);
 	stride = mb->max_x * 16;
-	intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	if (!mb->luma_only) {
+		mb->recon->intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	}
 	cbp = CodedBlockPattern(mb, st, avail);
 	if (cbp) {
 		int32_t qp_delta = QpDelta(mb, st, avail);
@@ -3295,7 +3568,7 @@ static inline int mb_intra4x4(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	mb_intra_save_info(mb, 0);
 	mb->cbp = cbp;
 	VC_CHECK;
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, cbp, st, avail, false, ResidualBlock);
 }
 
 template <typename F>
@@ -4088,37 +4361,37 @@ static inline void luma_intra8x8_with_residual(h264d_mb_current *mb, dec_bits *s
 	int c0, c1, c2, c3;
 	uint8_t *luma = mb->luma;
 	const int *offset = mb->offset4x4;
-	const int16_t *qmat = mb->qmaty8x8;
+	const int32_t *qmat = mb->qmaty->qmat8x8[0];
 
-	intra8x8pred_func[*pr++](luma, stride, (avail_intra & ~4) | ((avail_intra & 2) * 2));
+	mb->recon->intra8x8pred[*pr++](luma, stride, (avail_intra & ~4) | ((avail_intra & 2) * 2));
 	if (cbp & 1) {
 		c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1, avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1, st, coeff, qmat, avail_intra, 0, 5, 0x3f);
-		ac8x8transform(luma, coeff, stride, c0);
+		mb->recon->luma8x8(luma, coeff, stride, c0);
 	} else {
 		c0 = 0;
 	}
-	intra8x8pred_func[*pr++](luma + 8, stride, (avail_intra & ~8) | ((avail_intra & 2) * 4) | 1);
+	mb->recon->intra8x8pred[*pr++](luma + 8, stride, (avail_intra & ~8) | ((avail_intra & 2) * 4) | 1);
 	if (cbp & 2) {
 		c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 2) : -1, st, coeff, qmat, avail_intra, 4, 5, 0x3f);
-		ac8x8transform(luma + 8, coeff, stride, c1);
+		mb->recon->luma8x8(luma + 8, coeff, stride, c1);
 		left = c1 * 0x11;
 	} else {
 		c1 = 0;
 		left = 0;
 	}
-	intra8x8pred_func[*pr++](luma + offset[8], stride, 6 | ((avail_intra & 1) * 9));
+	mb->recon->intra8x8pred[*pr++](luma + offset[8], stride, 6 | ((avail_intra & 1) * 9));
 	if (cbp & 4) {
 		c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 2) : -1, c1, st, coeff, qmat, avail_intra, 8, 5, 0x3f);
-		ac8x8transform(luma + offset[8], coeff, stride, c2);
+		mb->recon->luma8x8(luma + offset[8], coeff, stride, c2);
 		top = c2 * 0x11;
 	} else {
 		c2 = 0;
 		top = 0;
 	}
-	intra8x8pred_func[*pr++](luma + offset[12], stride, 11);
+	mb->recon->intra8x8pred[*pr++](luma + offset[12], stride, 11);
 	if (cbp & 8) {
 		c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 12, 5, 0x3f);
-		ac8x8transform(luma + offset[12], coeff, stride, c3);
+		mb->recon->luma8x8(luma + offset[12], coeff, stride, c3);
 		left |= c3 * 0x1100;
 		top |= c3 * 0x1100;
 	}
@@ -4149,7 +4422,9 @@ static inline int mb_intra8x8(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	VC_CHECK;
 	intra_chroma_pred_mode = IntraChromaPredMode(mb, st, avail_intra);
 	stride = mb->max_x * 16;
-	intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	if (!mb->luma_only) {
+		mb->recon->intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	}
 	cbp = CodedBlockPattern(mb, st, avail);
 	if (cbp) {
 		int32_t qp_delta = QpDelta(mb, st, avail);
@@ -4164,7 +4439,7 @@ static inline int mb_intra8x8(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	mb_intra_save_info(mb, 1);
 	mb->cbp = cbp;
 	VC_CHECK;
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, cbp, st, avail, false, ResidualBlock);
 }
 
 template <typename F0, typename F1, typename F2, typename F3, typename F4, typename F5>
@@ -4317,12 +4592,12 @@ static void intra16x16_dc_transform(const int *src, int *dst)
 	c3 = src[12] + src[13] + src[14] + src[15];
 	t0 = c0 + c1;
 	t1 = c2 + c3;
-	dst[0] = (t0 + t1 + 2) >> 2;
-	dst[2] = (t0 - t1 + 2) >> 2;
+	dst[0] = (t0 + t1 + 32) >> 6;
+	dst[2] = (t0 - t1 + 32) >> 6;
 	t0 = c0 - c1;
 	t1 = c2 - c3;
-	dst[8] = (t0 - t1 + 2) >> 2;
-	dst[10] = (t0 + t1 + 2) >> 2;
+	dst[8] = (t0 - t1 + 32) >> 6;
+	dst[10] = (t0 + t1 + 32) >> 6;
 
 	c0 = src[0] + src[1] - src[2] - src[3];
 	c1 = src[4] + src[5] - src[6] - src[7];
@@ -4330,12 +4605,12 @@ static void intra16x16_dc_transform(const int *src, int *dst)
 	c3 = src[12] + src[13] - src[14] - src[15];
 	t0 = c0 + c1;
 	t1 = c2 + c3;
-	dst[1] = (t0 + t1 + 2) >> 2;
-	dst[3] = (t0 - t1 + 2) >> 2;
+	dst[1] = (t0 + t1 + 32) >> 6;
+	dst[3] = (t0 - t1 + 32) >> 6;
 	t0 = c0 - c1;
 	t1 = c2 - c3;
-	dst[9] = (t0 - t1 + 2) >> 2;
-	dst[11] = (t0 + t1 + 2) >> 2;
+	dst[9] = (t0 - t1 + 32) >> 6;
+	dst[11] = (t0 + t1 + 32) >> 6;
 
 	c0 = src[0] - src[1] - src[2] + src[3];
 	c1 = src[4] - src[5] - src[6] + src[7];
@@ -4343,12 +4618,12 @@ static void intra16x16_dc_transform(const int *src, int *dst)
 	c3 = src[12] - src[13] - src[14] + src[15];
 	t0 = c0 + c1;
 	t1 = c2 + c3;
-	dst[4] = (t0 + t1 + 2) >> 2;
-	dst[6] = (t0 - t1 + 2) >> 2;
+	dst[4] = (t0 + t1 + 32) >> 6;
+	dst[6] = (t0 - t1 + 32) >> 6;
 	t0 = c0 - c1;
 	t1 = c2 - c3;
-	dst[12] = (t0 - t1 + 2) >> 2;
-	dst[14] = (t0 + t1 + 2) >> 2;
+	dst[12] = (t0 - t1 + 32) >> 6;
+	dst[14] = (t0 + t1 + 32) >> 6;
 
 	c0 = src[0] - src[1] + src[2] - src[3];
 	c1 = src[4] - src[5] + src[6] - src[7];
@@ -4356,31 +4631,79 @@ static void intra16x16_dc_transform(const int *src, int *dst)
 	c3 = src[12] - src[13] + src[14] - src[15];
 	t0 = c0 + c1;
 	t1 = c2 + c3;
-	dst[5] = (t0 + t1 + 2) >> 2;
-	dst[7] = (t0 - t1 + 2) >> 2;
+	dst[5] = (t0 + t1 + 32) >> 6;
+	dst[7] = (t0 - t1 + 32) >> 6;
 	t0 = c0 - c1;
 	t1 = c2 - c3;
-	dst[13] = (t0 - t1 + 2) >> 2;
-	dst[15] = (t0 + t1 + 2) >> 2;
+	dst[13] = (t0 - t1 + 32) >> 6;
+	dst[15] = (t0 + t1 + 32) >> 6;
 }
 
-static inline void ac4x4transform_maybe(uint8_t *dst, const int *coeff, int stride, int num_coeff)
+static inline void ac4x4transform_maybe(const h264d_mb_current *mb, uint8_t *dst, const int *coeff, int stride, int num_coeff)
 {
 	if (num_coeff) {
-		ac4x4transform_acdc_luma(dst, coeff, stride);
+		mb->recon->luma4x4(dst, coeff, stride);
 	}
 }
 
-static inline void ac4x4transform(uint8_t *dst, int *coeff, int stride, int num_coeff, int dc)
+static inline void ac4x4transform(const h264d_mb_current *mb, uint8_t *dst, int *coeff, int stride, int num_coeff, int dc)
 {
 	if (num_coeff) {
 		coeff[0] = dc;
-		ac4x4transform_acdc_luma(dst, coeff, stride);
+		mb->recon->luma4x4(dst, coeff, stride);
 	} else {
-		acNxNtransform_dconly<4, 6, 0, uint32_t>(dst, dc, stride);
+		mb->recon->luma4x4_dconly(dst, dc, stride);
 	}
 }
 
+static int intra16x16pred(int (*pred)(uint8_t *dst, int stride, int avail), uint8_t *dst, int stride, int avail)
+{
+	return pred(dst, stride, avail);
+}
+
+static const h264d_recon_func_t recon_func = {
+	intra4x4pred_func,
+	intra8x8pred_func,
+	intra_chroma_pred,
+	intra16x16pred,
+	ac4x4transform_acdc_luma,
+	acNxNtransform_dconly<4, 6, 0, uint32_t>,
+	ac8x8transform,
+	ac4x4transform_acdc_chroma,
+	ac4x4transform_dconly_chroma
+};
+
+static int intra_pred_none(uint8_t *dst, int stride, int avail) { return 0; }
+static int intra16x16pred_none(int (*pred)(uint8_t *dst, int stride, int avail), uint8_t *dst, int stride, int avail) { return 0; }
+static void transform_none(uint8_t *dst, const int *coeff, int stride) {}
+static void transform_dconly_none(uint8_t *dst, int dc, int stride) {}
+static void transform8x8_none(uint8_t *dst, const int *coeff, int stride, int coeff_num) {}
+
+static int (* const intra_pred_none_func[9])(uint8_t *dst, int stride, int avail) = {
+	intra_pred_none, intra_pred_none, intra_pred_none,
+	intra_pred_none, intra_pred_none, intra_pred_none,
+	intra_pred_none, intra_pred_none, intra_pred_none
+};
+
+/** Analysis mode parses coefficients and prediction modes without reconstruction.
+ */
+static const h264d_recon_func_t recon_none = {
+	intra_pred_none_func,
+	intra_pred_none_func,
+	intra_pred_none_func,
+	intra16x16pred_none,
+	transform_none,
+	transform_dconly_none,
+	transform8x8_none,
+	transform_none,
+	transform_dconly_none
+};
+
+static void set_recon_func(h264d_mb_current *mb)
+{
+	mb->recon = mb->stats ? &recon_none : &recon_func;
+}
+
 /** Inverse 8x8 chroma DC transformation.
  * Output is 4x4 block scan order.
  */
@@ -4395,12 +4718,12 @@ static void intra_chroma_dc_transform(const int *src, int *dst)
 	c3 = src[3];
 	t0 = c0 + c1;
 	t1 = c2 + c3;
-	dst[0] = (t0 + t1) >> 1;
-	dst[2] = (t0 - t1) >> 1;
+	dst[0] = (t0 + t1) >> 5;
+	dst[2] = (t0 - t1) >> 5;
 	t0 = c0 - c1;
 	t1 = c2 - c3;
-	dst[1] = (t0 + t1) >> 1;
-	dst[3] = (t0 - t1) >> 1;
+	dst[1] = (t0 + t1) >> 5;
+	dst[3] = (t0 - t1) >> 5;
 }
 
 template <typename F0, typename F1, typename F2>
@@ -4424,18 +4747,20 @@ static int mb_intra16x16_dconly(h264d_mb_current *mb, const mb_code *mbc, dec_bi
 	if (mb->is_constrained_intra) {
 		avail_intra &= ~((MB_IPCM < mb->top4x4inter[1].type) * 4 | ((MB_IPCM < mb->top4x4inter->type) * 2) | (MB_IPCM < mb->left4x4inter->type));
 	}
-	mbc->mb_pred(luma, stride, avail_intra);
+	mb->recon->intra16x16pred(mbc->mb_pred, luma, stride, avail_intra);
 	intra_chroma_pred_mode = IntraChromaPredMode(mb, st, avail_intra);
-	intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	if (!mb->luma_only) {
+		mb->recon->intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	}
 	qp_delta = QpDelta(mb, st, avail);
 	if (qp_delta) {
 		set_qp(mb, mb->qp + qp_delta);
 	}
-	if (ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1, avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1, st, coeff, mb->qmaty, avail_intra, 26, 0, 0)) {
+	if (ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1, avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1, st, coeff, mb->qmaty->qmat4x4[0], avail_intra, 26, 0, 0)) {
 		intra16x16_dc_transform(coeff, dc);
 		offset = mb->offset4x4;
 		for (int i = 0; i < 16; ++i) {
-			acNxNtransform_dconly<4, 6, 0, uint32_t>(luma + *offset++, dc[i], stride);
+			mb->recon->luma4x4_dconly(luma + *offset++, dc[i], stride);
 		}
 	}
 	mb->left4x4coef &= 0xffff0000;
@@ -4445,7 +4770,7 @@ static int mb_intra16x16_dconly(h264d_mb_current *mb, const mb_code *mbc, dec_bi
 	store_strength_intra(mb);
 	mb_intra_save_info(mb, 0);
 	mb->cbp = mbc->cbp;
-	return residual_chroma(mb, mbc->cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, mbc->cbp, st, avail, false, ResidualBlock);
 }
 
 static int mb_intra16x16_dconly_cavlc(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st, int avail)
@@ -4466,7 +4791,7 @@ static int mb_intra16x16_acdc(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	int avail_intra;
 	uint32_t intra_chroma_pred_mode;
 	int32_t qp_delta;
-	const int16_t *qmat;
+	const int32_t *qmat;
 	uint32_t top, left;
 	int c0, c1, c2, c3, c4, c5;
 	int na, nb;
@@ -4479,9 +4804,11 @@ static int mb_intra16x16_acdc(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	if (mb->is_constrained_intra) {
 		avail_intra &= ~((MB_IPCM < mb->top4x4inter[1].type) * 4 | ((MB_IPCM < mb->top4x4inter->type) * 2) | (MB_IPCM < mb->left4x4inter->type));
 	}
-	mbc->mb_pred(luma, stride, avail_intra);
+	mb->recon->intra16x16pred(mbc->mb_pred, luma, stride, avail_intra);
 	intra_chroma_pred_mode = IntraChromaPredMode(mb, st, avail_intra);
-	intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	if (!mb->luma_only) {
+		mb->recon->intra_chroma_pred[intra_chroma_pred_mode](mb->chroma, stride, avail_intra);
+	}
 	qp_delta = QpDelta(mb, st, avail);
 	if (qp_delta) {
 		set_qp(mb, mb->qp + qp_delta);
@@ -4489,7 +4816,7 @@ static int mb_intra16x16_acdc(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 
 	na = avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1;
 	nb = avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1;
-	qmat = mb->qmaty;
+	qmat = mb->qmaty->qmat4x4[0];
 	if (ResidualBlock(mb, na, nb, st, coeff, qmat, avail_intra, 26, 0, 0)) {
 		intra16x16_dc_transform(coeff, dc);
 	} else {
@@ -4498,48 +4825,48 @@ static int mb_intra16x16_acdc(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	offset = mb->offset4x4;
 	dcp = dc;
 	c0 = ResidualBlock(mb, na, nb, st, coeff, qmat, avail_intra, 0, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c0, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c0, *dcp++);
 	c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 1) : -1, st, coeff, qmat, avail_intra, 1, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c1, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c1, *dcp++);
 	c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 1) : -1, c0, st, coeff, qmat, avail_intra, 2, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c2, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c2, *dcp++);
 	c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 3, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c3, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c3, *dcp++);
 
 	c0 = ResidualBlock(mb, c1, avail & 2 ? UNPACK(*mb->top4x4coef, 2) : -1, st, coeff, qmat, avail_intra, 4, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c0, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c0, *dcp++);
 	c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 3) : -1, st, coeff, qmat, avail_intra, 5, 1, 0x1f);
 	left = mb->left4x4coef & 0xffff0000;
 	left = PACK(left, c1, 0);
-	ac4x4transform(luma + *offset++, coeff, stride, c1, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c1, *dcp++);
 	c4 = ResidualBlock(mb, c3, c0, st, coeff, qmat, avail_intra, 6, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c4, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c4, *dcp++);
 	c5 = ResidualBlock(mb, c4, c1, st, coeff, qmat, avail_intra, 7, 1, 0x1f);
 	left = PACK(left, c5, 1);
-	ac4x4transform(luma + *offset++, coeff, stride, c5, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c5, *dcp++);
 
 	c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 2) : -1, c2, st, coeff, qmat, avail_intra, 8, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c0, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c0, *dcp++);
 	c1 = ResidualBlock(mb, c0, c3, st, coeff, qmat, avail_intra, 9, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c1, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c1, *dcp++);
 	c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 3) : -1, c0, st, coeff, qmat, avail_intra, 10, 1, 0x1f);
 	top = *mb->top4x4coef & 0xffff0000;
 	top = PACK(top, c2, 0);
-	ac4x4transform(luma + *offset++, coeff, stride, c2, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c2, *dcp++);
 	c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 11, 1, 0x1f);
 	top = PACK(top, c3, 1);
-	ac4x4transform(luma + *offset++, coeff, stride, c3, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c3, *dcp++);
 
 	c0 = ResidualBlock(mb, c1, c4, st, coeff, qmat, avail_intra, 12, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c0, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c0, *dcp++);
 	c1 = ResidualBlock(mb, c0, c5, st, coeff, qmat, avail_intra, 13, 1, 0x1f);
 	left = PACK(left, c1, 2);
-	ac4x4transform(luma + *offset++, coeff, stride, c1, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c1, *dcp++);
 	c2 = ResidualBlock(mb, c3, c0, st, coeff, qmat, avail_intra, 14, 1, 0x1f);
 	top = PACK(top, c2, 2);
-	ac4x4transform(luma + *offset++, coeff, stride, c2, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c2, *dcp++);
 	c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail_intra, 15, 1, 0x1f);
-	ac4x4transform(luma + *offset++, coeff, stride, c3, *dcp++);
+	ac4x4transform(mb, luma + *offset++, coeff, stride, c3, *dcp++);
 
 	mb->left4x4coef = PACK(left, c3, 3);
 	*mb->top4x4coef = PACK(top, c3, 3);
@@ -4548,7 +4875,7 @@ static int mb_intra16x16_acdc(h264d_mb_current *mb, const mb_code *mbc, dec_bits
 	store_strength_intra(mb);
 	mb_intra_save_info(mb, 0);
 	mb->cbp = mbc->cbp;
-	return residual_chroma(mb, mbc->cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, mbc->cbp, st, avail, false, ResidualBlock);
 }
 
 static int mb_intra16x16_acdc_cavlc(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st, int avail)
@@ -4740,8 +5067,14 @@ static int mb_intrapcm(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st, i
 	stride = mb->max_x * 16;
 	byte_align(st);
 	intrapcm_luma(mb->luma, stride, st);
-	intrapcm_block<2>(mb->chroma, stride, st);
-	intrapcm_block<2>(mb->chroma + 1, stride, st);
+	if (!mb->luma_only) {
+		intrapcm_block<2>(mb->chroma, stride, st);
+		intrapcm_block<2>(mb->chroma + 1, stride, st);
+	} else {
+		for (int i = 0; i < 8 * 8 * 2 * 8 / 32; ++i) {
+			get_bits32(st, 32);
+		}
+	}
 	mb->left4x4coef = 0xffffffff;
 	*mb->top4x4coef = 0xffffffff;
 	mb->left4x4pred = 0x22222222;
@@ -6422,7 +6755,7 @@ static inline void residual_luma_inter4x4(h264d_mb_current *mb, uint32_t cbp, de
 				    F0 ResidualBlock)
 {
 	int ALIGN16VC coeff[16] __attribute__((aligned(16)));
-	const int16_t *qmat;
+	const int32_t *qmat;
 	const int *offset;
 	uint32_t top, left;
 	int c0, c1, c2, c3, c4, c5;
@@ -6430,26 +6763,26 @@ static inline void residual_luma_inter4x4(h264d_mb_current *mb, uint32_t cbp, de
 	uint8_t *luma;
 	int stride;
 
-	qmat = mb->qmaty;
+	qmat = mb->qmaty->qmat4x4[3];
 	offset = mb->offset4x4;
 	luma = mb->luma;
 	stride = mb->max_x * 16;
 	str_map = 0;
 	if (cbp & 1) {
 		if ((c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1, avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1, st, coeff, qmat, avail, 0, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[0], coeff, stride);
+			mb->recon->luma4x4(luma + offset[0], coeff, stride);
 			str_map = 0x2;
 		}
 		if ((c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 1) : -1, st, coeff, qmat, avail, 1, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[1], coeff, stride);
+			mb->recon->luma4x4(luma + offset[1], coeff, stride);
 			str_map |= 0x8;
 		}
 		if ((c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 1) : -1, c0, st, coeff, qmat, avail, 2, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[2], coeff, stride);
+			mb->recon->luma4x4(luma + offset[2], coeff, stride);
 			str_map |= 0x200;
 		}
 		if ((c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail, 3, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[3], coeff, stride);
+			mb->recon->luma4x4(luma + offset[3], coeff, stride);
 			str_map |= 0x800;
 		}
 	} else {
@@ -6460,24 +6793,24 @@ static inline void residual_luma_inter4x4(h264d_mb_current *mb, uint32_t cbp, de
 	}
 	if (cbp & 2) {
 		if ((c0 = ResidualBlock(mb, c1, avail & 2 ? UNPACK(*mb->top4x4coef, 2) : -1, st, coeff, qmat, avail, 4, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[4], coeff, stride);
+			mb->recon->luma4x4(luma + offset[4], coeff, stride);
 			str_map |= 0x20;
 		}
 		if ((c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 3) : -1, st, coeff, qmat, avail, 5, 2, 0xf)) != 0) {
 			left = PACK(0, c1, 0);
 			str_map |= 0x80;
-			ac4x4transform_acdc_luma(luma + offset[5], coeff, stride);
+			mb->recon->luma4x4(luma + offset[5], coeff, stride);
 		} else {
 			left = 0;
 		}
 		if ((c4 = ResidualBlock(mb, c3, c0, st, coeff, qmat, avail, 6, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[6], coeff, stride);
+			mb->recon->luma4x4(luma + offset[6], coeff, stride);
 			str_map |= 0x2000;
 		}
 		if ((c5 = ResidualBlock(mb, c4, c1, st, coeff, qmat, avail, 7, 2, 0xf)) != 0) {
 			left = PACK(left, c5, 1);
 			str_map |= 0x8000;
-			ac4x4transform_acdc_luma(luma + offset[7], coeff, stride);
+			mb->recon->luma4x4(luma + offset[7], coeff, stride);
 		}
 	} else {
 		c0 = 0;
@@ -6488,24 +6821,24 @@ static inline void residual_luma_inter4x4(h264d_mb_current *mb, uint32_t cbp, de
 	}
 	if (cbp & 4) {
 		if ((c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 2) : -1, c2, st, coeff, qmat, avail, 8, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[8], coeff, stride);
+			mb->recon->luma4x4(luma + offset[8], coeff, stride);
 			str_map |= 0x20000;
 		}
 		if ((c1 = ResidualBlock(mb, c0, c3, st, coeff, qmat, avail, 9, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[9], coeff, stride);
+			mb->recon->luma4x4(luma + offset[9], coeff, stride);
 			str_map |= 0x80000;
 		}
 		if ((c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 3) : -1, c0, st, coeff, qmat, avail, 10, 2, 0xf)) != 0) {
 			top = PACK(0, c2, 0);
 			str_map |= 0x2000000;
-			ac4x4transform_acdc_luma(luma + offset[10], coeff, stride);
+			mb->recon->luma4x4(luma + offset[10], coeff, stride);
 		} else {
 			top = 0;
 		}
 		if ((c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail, 11, 2, 0xf)) != 0) {
 			top = PACK(top, c3, 1);
 			str_map |= 0x8000000;
-			ac4x4transform_acdc_luma(luma + offset[11], coeff, stride);
+			mb->recon->luma4x4(luma + offset[11], coeff, stride);
 		}
 	} else {
 		c0 = 0;
@@ -6516,22 +6849,22 @@ static inline void residual_luma_inter4x4(h264d_mb_current *mb, uint32_t cbp, de
 	}
 	if (cbp & 8) {
 		if ((c0 = ResidualBlock(mb, c1, c4, st, coeff, qmat, avail, 12, 2, 0xf)) != 0) {
-			ac4x4transform_acdc_luma(luma + offset[12], coeff, stride);
+			mb->recon->luma4x4(luma + offset[12], coeff, stride);
 			str_map |= 0x200000;
 		}
 		if ((c1 = ResidualBlock(mb, c0, c5, st, coeff, qmat, avail, 13, 2, 0xf)) != 0) {
 			left = PACK(left, c1, 2);
 			str_map |= 0x800000;
-			ac4x4transform_acdc_luma(luma + offset[13], coeff, stride);
+			mb->recon->luma4x4(luma + offset[13], coeff, stride);
 		}
 		if ((c2 = ResidualBlock(mb, c3, c0, st, coeff, qmat, avail, 14, 2, 0xf)) != 0) {
 			top = PACK(top, c2, 2);
 			str_map |= 0x20000000;
-			ac4x4transform_acdc_luma(luma + offset[14], coeff, stride);
+			mb->recon->luma4x4(luma + offset[14], coeff, stride);
 		}
 		if ((c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail, 15, 2, 0xf)) != 0) {
 			str_map |= 0x80000000;
-			ac4x4transform_acdc_luma(luma + offset[15], coeff, stride);
+			mb->recon->luma4x4(luma + offset[15], coeff, stride);
 		}
 	} else {
 		c3 = 0; 
@@ -6583,25 +6916,25 @@ static inline void residual_luma_inter8x8(h264d_mb_current *mb, uint32_t cbp, de
 				    F0 ResidualBlock)
 {
 	int coeff[64];
-	const int16_t *qmat;
+	const int32_t *qmat;
 	const int *offset;
 	uint32_t top, left;
 	int c0, c1, c2, c3;
 	int stride;
 
-	qmat = mb->qmaty8x8;
+	qmat = mb->qmaty->qmat8x8[1];
 	offset = mb->offset4x4;
 	stride = mb->max_x * 16;
 	cbp &= 15;
 	if (cbp & 1) {
 		c0 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 0) : -1, avail & 2 ? UNPACK(*mb->top4x4coef, 0) : -1, st, coeff, qmat, avail, 0, 5, 0x3f);
-		ac8x8transform(mb->luma, coeff, stride, c0);
+		mb->recon->luma8x8(mb->luma, coeff, stride, c0);
 	} else {
 		c0 = 0;
 	}
 	if (cbp & 2) {
 		c1 = ResidualBlock(mb, c0, avail & 2 ? UNPACK(*mb->top4x4coef, 2) : -1, st, coeff, qmat, avail, 4, 5, 0x3f);
-		ac8x8transform(mb->luma + 8, coeff, stride, c1);
+		mb->recon->luma8x8(mb->luma + 8, coeff, stride, c1);
 		left = c1 * 0x11;
 	} else {
 		c1 = 0;
@@ -6609,7 +6942,7 @@ static inline void residual_luma_inter8x8(h264d_mb_current *mb, uint32_t cbp, de
 	}
 	if (cbp & 4) {
 		c2 = ResidualBlock(mb, avail & 1 ? UNPACK(mb->left4x4coef, 2) : -1, c1, st, coeff, qmat, avail, 8, 5, 0x3f);
-		ac8x8transform(mb->luma + offset[8], coeff, stride, c2);
+		mb->recon->luma8x8(mb->luma + offset[8], coeff, stride, c2);
 		top = c2 * 0x11;
 	} else {
 		c2 = 0;
@@ -6617,7 +6950,7 @@ static inline void residual_luma_inter8x8(h264d_mb_current *mb, uint32_t cbp, de
 	}
 	if (cbp & 8) {
 		c3 = ResidualBlock(mb, c2, c1, st, coeff, qmat, avail, 12, 5, 0x3f);
-		ac8x8transform(mb->luma + offset[12], coeff, stride, c3);
+		mb->recon->luma8x8(mb->luma + offset[12], coeff, stride, c3);
 		left |= c3 * 0x1100;
 		top |= c3 * 0x1100;
 	}
@@ -6743,7 +7076,9 @@ static inline void inter_pred_basic(const h264d_mb_current *mb, const int8_t ref
 		int posx = (mvx >> 2) + offsetx;
 		int posy = (mvy >> 2) + offsety;
 		inter_pred_luma[bidir][mvy & 3][mvx & 3](frms->luma + inter_pred_mvoffset_luma(posx - 2, posy - 2, stride), posx, posy, size, stride, vert_size, dst_luma, stride);
-		inter_pred_chroma[bidir](frms->chroma, (mvx >> 3) * 2 + offsetx, (mvy >> 3) + (offsety >> 1), mv[lx], size, stride, vert_size >> 1, dst_chroma, stride);
+		if (!mb->luma_only) {
+			inter_pred_chroma[bidir](frms->chroma, (mvx >> 3) * 2 + offsetx, (mvy >> 3) + (offsety >> 1), mv[lx], size, stride, vert_size >> 1, dst_chroma, stride);
+		}
 		bidir++;
 	}
 }
@@ -6853,6 +7188,9 @@ static inline void inter_pred_weighted_onedir(const h264d_mb_current *mb, int fr
 	uint8_t *dst = mb->luma + offsety * stride + offsetx;
 	inter_pred_luma[0][mvy & 3][mvx & 3](frms.luma + inter_pred_mvoffset_luma(posx - 2, posy - 2, stride), posx, posy, size, stride, vert_size, dst, stride);
 	weighted_copy(&pred.weight_offset.e[0], pred.shift[0], dst, size.v[0], size.v[1], stride);
+	if (mb->luma_only) {
+		return;
+	}
 	dst = mb->chroma + (offsety >> 1) * stride + offsetx;
 	inter_pred_chroma[0](frms.chroma, (mvx >> 3) * 2 + ofsx, (mvy >> 3) + (ofsy >> 1), mv, size, stride, vert_size >> 1, dst, stride);
 	weighted_copy(&pred.weight_offset.e[1], pred.shift[1] | 256, dst, size.v[0], size.v[1] >> 1, stride);
@@ -6877,16 +7215,20 @@ static inline void inter_pred_weighted_bidir(const h264d_mb_current *mb, const i
 	uint8_t *dst_luma = mb->luma + offsety * stride + offsetx;
 	inter_pred_luma[0][mvy & 3][mvx & 3](frms->luma + inter_pred_mvoffset_luma(posx - 2, posy - 2, stride), posx, posy, size, stride, vert_size, dst_luma, stride);
 	uint8_t *dst_chroma = mb->chroma + (offsety >> 1) * stride + offsetx;
-	inter_pred_chroma[0](frms->chroma, (mvx >> 3) * 2 + ofsx, (mvy >> 3) + (ofsy >> 1), mv[0], size, stride, vert_size >> 1, dst_chroma, stride);
+	if (!mb->luma_only) {
+		inter_pred_chroma[0](frms->chroma, (mvx >> 3) * 2 + ofsx, (mvy >> 3) + (ofsy >> 1), mv[0], size, stride, vert_size >> 1, dst_chroma, stride);
+	}
 	mvx = mv[1].v[0];
 	mvy = mv[1].v[1];
 	posx = (mvx >> 2) + ofsx;
 	posy = (mvy >> 2) + ofsy;
 	frms = &mb->frame->frames[mb->frame->refs[1][ref_idx[1]].frame_idx];
 	inter_pred_luma[0][mvy & 3][mvx & 3](frms->luma + inter_pred_mvoffset_luma(posx - 2, posy - 2, stride), posx, posy, size, stride, vert_size, luma_buf, size.v[0]);
-	inter_pred_chroma[0](frms->chroma, (mvx >> 3) * 2 + ofsx, (mvy >> 3) + (ofsy >> 1), mv[1], size, stride, vert_size >> 1, chroma_buf, size.v[0]);
 	AddBidirWeightedLuma(pred, luma_buf, dst_luma, size.v[0], size.v[1], stride);
-	AddBidirWeightedChroma(pred, chroma_buf, dst_chroma, size.v[0], size.v[1] >> 1, stride);
+	if (!mb->luma_only) {
+		inter_pred_chroma[0](frms->chroma, (mvx >> 3) * 2 + ofsx, (mvy >> 3) + (ofsy >> 1), mv[1], size, stride, vert_size >> 1, chroma_buf, size.v[0]);
+		AddBidirWeightedChroma(pred, chroma_buf, dst_chroma, size.v[0], size.v[1] >> 1, stride);
+	}
 }
 
 template <int N>
@@ -7269,6 +7611,28 @@ static void store_str_inter16xedge(const h264d_mb_current *mb, const prev_mb_t *
 	}
 }
 
+static inline m2d_mb_info_t *mb_info_curr(const h264d_mb_current *mb)
+{
+	return mb->mb_info + mb->y * mb->max_x + mb->x;
+}
+
+/**Store MVs of both lists for 8x8 block blk of side data.
+ * Analysis mode records whether the block is bi-predicted.
+ */
+static inline void mb_info_mv(h264d_mb_current *mb, int blk, const int8_t ref_idx[], const h264d_vector_t mv[])
+{
+	if (mb->stats) {
+		mb->bipred |= (0 <= ref_idx[0]) && (0 <= ref_idx[1]);
+	}
+	if (!mb->mb_info) {
+		return;
+	}
+	m2d_mb_info_t *info = mb_info_curr(mb);
+	for (int lx = 0; lx < 2; ++lx) {
+		m2d_mb_info_mv(info, blk, lx, ref_idx[lx], mv[lx].v);
+	}
+}
+
 static void store_info_inter16x16(h264d_mb_current *mb, const h264d_vector_set_t mv[], const int8_t ref_idx[], uint32_t left4x4, uint32_t top4x4)
 {
 	deblock_info_t *deb = mb->deblock_curr;
@@ -7319,6 +7683,11 @@ static void store_info_inter16x16(h264d_mb_current *mb, const h264d_vector_set_t
 	for (int i = 0; i < 16; ++i) {
 		mvdst[i].vector = mvcol;
 	}
+	if (mb->mb_info || mb->stats) {
+		for (int blk = 0; blk < 4; ++blk) {
+			mb_info_mv(mb, blk, ref_idx, mv[0].mv);
+		}
+	}
 }
 
 static inline void no_residual_inter(h264d_mb_current *mb)
@@ -7373,7 +7742,7 @@ static int mb_inter16x16(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st,
 		no_residual_inter(mb);
 	}
 	store_info_inter16x16(mb, &mv[0], ref_idx, left4x4, top4x4);
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, cbp, st, avail, true, ResidualBlock);
 }
 
 static inline void calc_mv16x8top(h264d_mb_current *mb, int16_t pmv[], const int16_t *&mvd_a, const int16_t *&mvd_b, int lx, int ref_idx, int avail)
@@ -7601,6 +7970,11 @@ static void store_info_inter16x8(h264d_mb_current *mb, const h264d_vector_set_t
 	mb->left4x4inter->frmidx[1][0] = frm2;
 	mb->left4x4inter->frmidx[1][1] = frm3;
 	store_col16x8(mb->col_curr, ref_idx, mv);
+	if (mb->mb_info || mb->stats) {
+		for (int blk = 0; blk < 4; ++blk) {
+			mb_info_mv(mb, blk, &ref_idx[(blk >> 1) * 2], mv[blk >> 1].mv);
+		}
+	}
 }
 
 template <typename F0 ,typename F1, typename F2, typename F3, typename F4, typename F5, typename F6>
@@ -7651,7 +8025,7 @@ static int mb_inter16x8(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st,
 		no_residual_inter(mb);
 	}
 	store_info_inter16x8(mb, &mv[0][0], ref_idx, left4x4, top4x4);
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, cbp, st, avail, true, ResidualBlock);
 }
 
 static inline void calc_mv8x16left(h264d_mb_current *mb, int16_t pmv[], const int16_t *&mvd_a, const int16_t *&mvd_b, int lx, int ref_idx, int avail)
@@ -7818,6 +8192,11 @@ static void store_info_inter8x16(h264d_mb_current *mb, const h264d_vector_set_t
 		mb->left4x4inter->mvd[i] = mv[3];
 	}
 	store_col8x16(mb->col_curr, ref_idx, mv);
+	if (mb->mb_info || mb->stats) {
+		for (int blk = 0; blk < 4; ++blk) {
+			mb_info_mv(mb, blk, &ref_idx[(blk & 1) * 2], mv[blk & 1].mv);
+		}
+	}
 }
 
 template <typename F0 ,typename F1, typename F2, typename F3, typename F4, typename F5, typename F6>
@@ -7867,7 +8246,7 @@ static int mb_inter8x16(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st,
 		no_residual_inter(mb);
 	}
 	store_info_inter8x16(mb, &mv[0][0], ref_idx, left4x4, top4x4);
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, cbp, st, avail, true, ResidualBlock);
 }
 
 static inline void calc_mv8x8_sub8x8(h264d_mb_current *mb, int16_t *pmv, const int16_t *&mvd_a, const int16_t *&mvd_b, int avail, int lx, int ref_idx, int blk_idx, prev8x8_t *pblk)
@@ -9160,7 +9539,12 @@ static int mb_inter8x8(h264d_mb_current *mb, const mb_code *mbc, dec_bits *st, i
 	store_info_intermb8x8(mb, curr_blk, left4x4, top4x4);
 	StoreDirect8x8Info(mb, sub_mb_type);
 	store_col8x8(mb->col_curr, curr_blk);
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	if (mb->mb_info || mb->stats) {
+		for (int blk = 0; blk < 4; ++blk) {
+			mb_info_mv(mb, blk, curr_blk[blk].ref, curr_blk[blk].mv[0]);
+		}
+	}
+	return residual_chroma(mb, cbp, st, avail, true, ResidualBlock);
 }
 
 template <int N, int IS_HORIZ>
@@ -9343,6 +9727,12 @@ static void store_info_inter8x8(h264d_mb_current *mb, const h264d_vector_set_t m
 	memset(mb->top4x4inter->mvd, 0, sizeof(mb->top4x4inter->mvd));
 	memset(mb->left4x4inter->mvd, 0, sizeof(mb->left4x4inter->mvd));
 
+	if (mb->mb_info || mb->stats) {
+		for (int blk = 0; blk < 4; ++blk) {
+			mb_info_mv(mb, blk, &ref_idx[blk * 2], mv[(N == 4) ? (blk & 1) * 2 + (blk >> 1) * 8 : blk].mv);
+		}
+	}
+
 	h264d_col_mb_t *col_mb = mb->col_curr;
 	int8_t *refdst = col_mb->ref;
 	h264d_vector_t *mvdst = col_mb->mv;
@@ -9426,7 +9816,7 @@ static int mb_bdirect16x16(h264d_mb_current *mb, const mb_code *mbc, dec_bits *s
 	mb->bdirect->func->store_info_inter(mb, mv, ref_idx, left4x4, top4x4, col_mb->type);
 	mb->left4x4inter->direct8x8 = 3;
 	mb->top4x4inter->direct8x8 = 3;
-	return residual_chroma(mb, cbp, st, avail, ResidualBlock);
+	return residual_chroma(mb, cbp, st, avail, true, ResidualBlock);
 }
 
 struct sub_mb_type_p_cavlc {
@@ -9682,7 +10072,7 @@ static const mb_code mb_decode[2][54] = {
 /** Convert MB type number into unified order:
  * Intra < Inter < Bidirectional
  */
-static int adjust_mb_type(int mb_type, int slice_type)
+static inline int adjust_mb_type(int mb_type, int slice_type)
 {
 	if (slice_type == P_SLICE) {
 		if (mb_type <= 30) {
@@ -9714,8 +10104,10 @@ static inline int get_availability(h264d_mb_current *mb)
 		| (mbx != 0 && firstline != max_x); /* bit0: left */
 }
 
+template <int SLICE_TYPE>
 static inline int macroblock_layer_cabac(h264d_mb_current *mb, h264d_slice_header *hdr, dec_bits *st);
 
+template <int SLICE_TYPE>
 static inline int macroblock_layer(h264d_mb_current *mb, h264d_slice_header *hdr, dec_bits *st)
 {
 	const mb_code *mbc;
@@ -9723,7 +10115,7 @@ static inline int macroblock_layer(h264d_mb_current *mb, h264d_slice_header *hdr
 	int avail;
 
 	READ_UE_RANGE(mbtype, st, 48);
-	if ((mb->type = mbtype = adjust_mb_type(mbtype, hdr->slice_type)) < 0) {
+	if ((mb->type = mbtype = adjust_mb_type(mbtype, SLICE_TYPE)) < 0) {
 		return -1;
 	}
 	mbc = &mb->mb_decode[mbtype];
@@ -10125,7 +10517,45 @@ static void b_skip_mb_temporal(h264d_mb_current *mb, int8_t *ref_idx, h264d_vect
 	temporal_direct16x16[col_mb->type](mb, col_mb, ref_idx, mv);
 }
 
-static int skip_mbs(h264d_mb_current *mb, uint32_t skip_mb_num, int slice_type)
+/**Record current macroblock for analysis mode.
+ */
+static void stats_macroblock(h264d_mb_current *mb, int category, int slice_type)
+{
+	if (category != M2D_MBTYPE_INTRA) {
+		const h264d_col_mb_t *col = mb->col_curr;
+		for (int i = 0; i < 16; ++i) {
+			if (0 <= col->ref[((i >> 3) << 1) | ((i >> 1) & 1)]) {
+				m2d_stats_mv(mb->stats, col->mv[i].v);
+			}
+		}
+		if ((category == M2D_MBTYPE_INTER) && (slice_type == B_SLICE) && mb->bipred) {
+			category = M2D_MBTYPE_BI;
+		}
+	}
+	mb->bipred = 0;
+	m2d_stats_mb(mb->stats, category, mb->qp, 1);
+}
+
+/**Fill the rest of side data of current macroblock, after MVs are stored.
+ */
+static void mb_info_macroblock(h264d_mb_current *mb, int category)
+{
+	m2d_mb_info_t *info = mb_info_curr(mb);
+	if (category == M2D_MBTYPE_INTRA) {
+		m2d_mb_info_no_mv(info);
+	} else if (category == M2D_MBTYPE_INTER) {
+		for (int blk = 0; blk < 4; ++blk) {
+			if ((0 <= info->ref[blk][0]) && (0 <= info->ref[blk][1])) {
+				category = M2D_MBTYPE_BI;
+				break;
+			}
+		}
+	}
+	m2d_mb_info_set(info, category, mb->qp, mb->cbp);
+}
+
+template <int SLICE_TYPE>
+static int skip_mbs(h264d_mb_current *mb, uint32_t skip_mb_num)
 {
 	uint32_t max_mb_run = mb->max_x * mb->max_y - (mb->y * mb->max_x + mb->x);
 	uint32_t left4x4, top4x4;
@@ -10142,7 +10572,7 @@ static int skip_mbs(h264d_mb_current *mb, uint32_t skip_mb_num, int slice_type)
 	mb->left4x4coef = 0;
 	mb->cbp = 0;
 	mb->cbf = 0;
-	if (slice_type == P_SLICE) {
+	if (SLICE_TYPE == P_SLICE) {
 		ref_idx = (int8_t *)ref_idx_p;
 		skip_mb = p_skip_mb;
 	} else {
@@ -10157,7 +10587,7 @@ static int skip_mbs(h264d_mb_current *mb, uint32_t skip_mb_num, int slice_type)
 		*mb->top4x4pred = 0x22222222;
 		top4x4 = *mb->top4x4coef;
 		*mb->top4x4coef = 0;
-		if (slice_type == B_SLICE) {
+		if (SLICE_TYPE == B_SLICE) {
 			const h264d_ref_frame_t *colpic = &(mb->frame->refs[1][0]);
 			const h264d_col_mb_t *col_mb = &colpic->col->col_mb[mb->y * mb->max_x + mb->x];
 			col_mb_type = col_mb->type;
@@ -10175,6 +10605,12 @@ static int skip_mbs(h264d_mb_current *mb, uint32_t skip_mb_num, int slice_type)
 		mb->top4x4inter->type = MB_PSKIP;
 		mb->top4x4inter->direct8x8 = 3;
 		mb->top4x4inter->mb_skip = 1;
+		if (mb->stats) {
+			stats_macroblock(mb, M2D_MBTYPE_SKIP, SLICE_TYPE);
+		}
+		if (mb->mb_info) {
+			mb_info_macroblock(mb, M2D_MBTYPE_SKIP);
+		}
 		if (increment_mb_pos(mb) < 0) {
 			return -1;
 		}
@@ -10205,48 +10641,67 @@ static int more_rbsp_data(dec_bits *st)
 
 static int post_process(h264d_context *h2d, h264d_mb_current *mb);
 static inline int cabac_decode_terminate(h264d_cabac_t *cb, dec_bits *st);
-static int mb_skip_cabac(h264d_mb_current *mb, dec_bits *st, int slice_type);
+template <int SLICE_TYPE>
+static int mb_skip_cabac(h264d_mb_current *mb, dec_bits *st);
 
-static int slice_data(h264d_context *h2d, dec_bits *st)
+/* Macroblock loop specialized for entropy coding mode and slice type,
+ * so that neither is tested per macroblock.
+ */
+template <int IS_AE, int SLICE_TYPE>
+static void slice_data_loop(h264d_mb_current *mb, h264d_slice_header *hdr, dec_bits *st)
 {
-	h264d_slice_header *hdr = h2d->slice_header;
-	h264d_pps *pps = &h2d->pps_i[hdr->pic_parameter_set_id];
-	h264d_mb_current *mb = &h2d->mb_current;
-	int is_ae = pps->entropy_coding_mode_flag;
-	if (is_ae) {
-		int idc = (hdr->slice_type == I_SLICE) ? 0 : hdr->cabac_init_idc + 1;
-		init_cabac_context(&mb->cabac->cabac, mb->cabac->context, mb->qp, ctx_idx_mn_IPB[idc], NUM_ARRAY(ctx_idx_mn_IPB[idc]));
-		byte_align(st);
-		init_cabac_engine(&mb->cabac->cabac, st);
-	}
 	do {
 		uint32_t skip_num;
-		if ((hdr->slice_type != I_SLICE)
-		    && (hdr->slice_type != SI_SLICE)) {
-			skip_num = is_ae ? mb_skip_cabac(mb, st, hdr->slice_type) : ue_golomb(st);
+		if (SLICE_TYPE != I_SLICE) {
+			skip_num = IS_AE ? mb_skip_cabac<SLICE_TYPE>(mb, st) : ue_golomb(st);
 			if (skip_num) {
-				if (skip_mbs(mb, skip_num, hdr->slice_type) < 0) {
+				if (skip_mbs<(SLICE_TYPE == B_SLICE) ? B_SLICE : P_SLICE>(mb, skip_num) < 0) {
 					break;
 				}
-				if (is_ae) {
+				if (IS_AE) {
 					continue;
 				}
 			}
-			if (!is_ae && !more_rbsp_data(st)) {
+			if (!IS_AE && !more_rbsp_data(st)) {
 				break;
 			}
 		}
-		if (is_ae) {
-			macroblock_layer_cabac(mb, hdr, st);
+		if (IS_AE) {
+			macroblock_layer_cabac<SLICE_TYPE>(mb, hdr, st);
 		} else {
-			macroblock_layer(mb, hdr, st);
+			macroblock_layer<SLICE_TYPE>(mb, hdr, st);
+		}
+		if (mb->stats) {
+			stats_macroblock(mb, (mb->type <= MB_IPCM) ? M2D_MBTYPE_INTRA : M2D_MBTYPE_INTER, SLICE_TYPE);
+		}
+		if (mb->mb_info) {
+			mb_info_macroblock(mb, (mb->type <= MB_IPCM) ? M2D_MBTYPE_INTRA : M2D_MBTYPE_INTER);
 		}
 		mb->left4x4inter->mb_skip = 0;
 		mb->top4x4inter->mb_skip = 0;
 		if (increment_mb_pos(mb) < 0) {
 			break;
 		}
-	} while (is_ae ? !cabac_decode_terminate(mb->cabac, st) : more_rbsp_data(st));
+	} while (IS_AE ? !cabac_decode_terminate(mb->cabac, st) : more_rbsp_data(st));
+}
+
+static int slice_data(h264d_context *h2d, dec_bits *st)
+{
+	static void (* const slice_data_func[2][3])(h264d_mb_current *mb, h264d_slice_header *hdr, dec_bits *st) = {
+		{slice_data_loop<0, P_SLICE>, slice_data_loop<0, B_SLICE>, slice_data_loop<0, I_SLICE>},
+		{slice_data_loop<1, P_SLICE>, slice_data_loop<1, B_SLICE>, slice_data_loop<1, I_SLICE>}
+	};
+	h264d_slice_header *hdr = h2d->slice_header;
+	h264d_pps *pps = &h2d->pps_i[hdr->pic_parameter_set_id];
+	h264d_mb_current *mb = &h2d->mb_current;
+	int is_ae = pps->entropy_coding_mode_flag;
+	if (is_ae) {
+		int idc = (hdr->slice_type == I_SLICE) ? 0 : hdr->cabac_init_idc + 1;
+		init_cabac_context(&mb->cabac->cabac, mb->cabac->context, mb->qp, ctx_idx_mn_IPB[idc], NUM_ARRAY(ctx_idx_mn_IPB[idc]));
+		byte_align(st);
+		init_cabac_engine(&mb->cabac->cabac, st);
+	}
+	slice_data_func[is_ae][hdr->slice_type](mb, hdr, st);
 	return post_process(h2d, mb);
 }
 
@@ -10537,6 +10992,7 @@ static inline void deblock_luma_inner_vert(int a, int b, uint8_t *luma, uint32_t
 	}
 }
 
+template <int LUMA_ONLY>
 static inline void deblock_pb(h264d_mb_current *mb)
 {
 	int qp;
@@ -10575,7 +11031,7 @@ static inline void deblock_pb(h264d_mb_current *mb)
 						deblock_horiz_str1_3<4>(a, b, luma, str, stride);
 					}
 				}
-				for (int c = 0; c < 2; ++c) {
+				for (int c = 0; c < (LUMA_ONLY ? 0 : 2); ++c) {
 					qp = (curr->qpc[c] + (curr - 1)->qpc[c] + 1) >> 1;
 					AlphaBeta(a, b, qp, alpha_offset, beta_offset);
 					if (0 <= a) {
@@ -10593,7 +11049,7 @@ static inline void deblock_pb(h264d_mb_current *mb)
 					deblock_luma_inner_horiz(a, b, luma, str, stride);
 				}
 				str >>= 16;
-				if (str & 0xff) {
+				if (!LUMA_ONLY && (str & 0xff)) {
 					if (curr->qpy != curr->qpc[0]) {
 						AlphaBeta(a, b, curr->qpc[0], alpha_offset, beta_offset);
 					}
@@ -10620,7 +11076,7 @@ static inline void deblock_pb(h264d_mb_current *mb)
 						deblock_vert_str1_3<4>(a, b, luma, str, stride);
 					}
 				}
-				for (int c = 0; c < 2; ++c) {
+				for (int c = 0; c < (LUMA_ONLY ? 0 : 2); ++c) {
 					qp = (curr->qpc[c] + (curr - max_x)->qpc[c] + 1) >> 1;
 					AlphaBeta(a, b, qp, alpha_offset, beta_offset);
 					if (0 <= a) {
@@ -10638,7 +11094,7 @@ static inline void deblock_pb(h264d_mb_current *mb)
 					deblock_luma_inner_vert(a, b, luma, str, stride);
 				}
 				str >>= 16;
-				if (str & 0xff) {
+				if (!LUMA_ONLY && (str & 0xff)) {
 					if (curr->qpy != curr->qpc[0]) {
 						AlphaBeta(a, b, curr->qpc[0], alpha_offset, beta_offset);
 					}
@@ -11028,7 +11484,13 @@ static int post_process(h264d_context *h2d, h264d_mb_current *mb)
 	hdr = h2d->slice_header;
 	if (is_filled) {
 		h264d_frame_info_t *frame;
-		deblock_pb(mb);
+		if (!mb->stats) {
+			if (mb->luma_only) {
+				deblock_pb<1>(mb);
+			} else {
+				deblock_pb<0>(mb);
+			}
+		}
 		h264d_sps *sps = &h2d->sps_i[h2d->pps_i[hdr->pic_parameter_set_id].seq_parameter_set_id];
 		int max_frame_num = 1 << sps->log2_max_frame_num;
 		int num_ref_frames = sps->num_ref_frames;
@@ -11144,10 +11606,11 @@ static int mb_type_cabac_B(h264d_mb_current *mb, dec_bits *st, int avail, int ct
 	}
 }
 
-static int mb_skip_cabac(h264d_mb_current *mb, dec_bits *st, int slice_type)
+template <int SLICE_TYPE>
+static int mb_skip_cabac(h264d_mb_current *mb, dec_bits *st)
 {
 	int avail = get_availability(mb);
-	int offset = (slice_type == P_SLICE) ? 11 : 24;
+	int offset = (SLICE_TYPE == P_SLICE) ? 11 : 24;
 	if ((avail & 1) && (mb->left4x4inter->mb_skip == 0)) {
 		offset += 1;
 	}
@@ -11535,7 +11998,7 @@ static inline int cabac_decode_bypass_coeff(h264d_cabac_t *cb, dec_bits *st)
 	return v0;
 }
 
-static inline void get_coeff_from_map_cabac(h264d_cabac_t *cb, dec_bits *st, int cat, int *coeff_map, int map_cnt, int *coeff, const int16_t *qmat)
+static inline void get_coeff_from_map_cabac(h264d_cabac_t *cb, dec_bits *st, int cat, int *coeff_map, int map_cnt, int *coeff, const int32_t *qmat)
 {
 	static const int8_t coeff_abs_level_ctx[2][8] = {
 		{1, 2, 3, 4, 0, 0, 0, 0},
@@ -11549,6 +12012,7 @@ static inline void get_coeff_from_map_cabac(h264d_cabac_t *cb, dec_bits *st, int
 	memset(coeff + coeff_offset, 0, sizeof(*coeff) * coeff_ofs[cat].num_coeff);
 	int8_t *abs_offset = &cb->context[coeff_ofs[cat].cabac_coeff_abs_level_offset + 227];
 	uint32_t dc_mask = coeff_ofs[cat].coeff_dc_mask;
+	int shift = coeff_ofs[cat].dequant_shift;
 	int node_ctx = 0;
 	int mp = map_cnt;
 	const int8_t *zigzag = inverse_zigzag[cat];
@@ -11571,12 +12035,12 @@ static inline void get_coeff_from_map_cabac(h264d_cabac_t *cb, dec_bits *st, int
 			}
 		}
 		idx = zigzag[coeff_map[--mp] + coeff_offset];
-		coeff[idx] = (cabac_decode_bypass(cb, st) ? -abs_level : abs_level) * qmat[idx & dc_mask];
+		coeff[idx] = dequantize(cabac_decode_bypass(cb, st) ? -abs_level : abs_level, qmat[idx & dc_mask], shift);
 	} while (mp);
 }
 
 struct residual_block_cabac {
-	int operator()(h264d_mb_current *mb, int na, int nb, dec_bits *st, int *coeff, const int16_t *qmat, int avail, int pos4x4, int cat, uint32_t dc_mask) const {
+	int operator()(h264d_mb_current *mb, int na, int nb, dec_bits *st, int *coeff, const int32_t *qmat, int avail, int pos4x4, int cat, uint32_t dc_mask) const {
 		int coeff_map[8 * 8];
 		int coded_block_flag;
 		h264d_cabac_t *cb = mb->cabac;
@@ -12033,6 +12497,7 @@ static void set_mb_decode(h264d_mb_current *mb, const h264d_pps *pps)
 	mb->mb_decode = (pps->entropy_coding_mode_flag ? mb_decode_cabac : mb_decode)[pps->transform_8x8_mode_flag];
 }
 
+template <int SLICE_TYPE>
 static inline int macroblock_layer_cabac(h264d_mb_current *mb, h264d_slice_header *hdr, dec_bits *st)
 {
 	static int (* const mb_type_cabac[3])(h264d_mb_current *mb, dec_bits *st, int avail, int ctx_idx, int slice_type) = {
@@ -12044,8 +12509,7 @@ static inline int macroblock_layer_cabac(h264d_mb_current *mb, h264d_slice_heade
 	int mbtype;
 	int avail;
 	avail = get_availability(mb);
-	int slice_type = hdr->slice_type;
-	mb->type = mbtype = adjust_mb_type(mb_type_cabac[slice_type](mb, st, avail, 3, slice_type), slice_type);
+	mb->type = mbtype = adjust_mb_type(mb_type_cabac[SLICE_TYPE](mb, st, avail, 3, SLICE_TYPE), SLICE_TYPE);
 	mbc = &mb->mb_decode[mbtype];
 	mbc->mb_dec(mb, mbc, st, avail);
 	if (mbtype == MB_IPCM) {
@@ -12054,6 +12518,55 @@ static inline int macroblock_layer_cabac(h264d_mb_current *mb, h264d_slice_heade
 	return 0;
 }
 
+/**Switch to analysis mode, which skips motion compensation and deblocking.
+ * stats is filled with a record of each picture. NULL resumes decoding.
+ */
+int h264d_set_analysis(h264d_context *h2d, m2d_picture_stats_t *stats)
+{
+	if (!h2d) {
+		return -1;
+	}
+	h2d->mb_current.stats = stats;
+	return 0;
+}
+
+/**Export side data of macroblocks with each decoded frame.
+ * mb_info holds size entries, which are split among frames by mb_info_num
+ * of h264d_get_info(). Frames without room have NULL mb_info.
+ */
+int h264d_set_mb_info(h264d_context *h2d, m2d_mb_info_t *mb_info, int size)
+{
+	if (!h2d || (size < 0)) {
+		return -1;
+	}
+	h2d->mb_current.frame->mb_info = mb_info;
+	h2d->mb_current.frame->mb_info_size = size;
+	h2d->mb_current.mb_info = 0;
+	return 0;
+}
+
+/**Reconstruct luma only. Chroma is still parsed, and chroma of frames may be NULL.
+ */
+int h264d_set_luma_only(h264d_context *h2d, int luma_only)
+{
+	if (!h2d) {
+		return -1;
+	}
+	h2d->mb_current.luma_only = (luma_only != 0);
+	return 0;
+}
+
+/**Request number of decoding threads.
+ * Returns number of threads to be used, which is always 1 for now.
+ */
+int h264d_set_threads(h264d_context *h2d, int num)
+{
+	if (!h2d || (num < 1)) {
+		return -1;
+	}
+	return 1;
+}
+
 static const m2d_func_table_t h264d_func_ = {
 	sizeof(h264d_context),
 	(int (*)(void *, int, int (*)(void *, void *), void *))h264d_init,
@@ -12062,7 +12575,12 @@ static const m2d_func_table_t h264d_func_ = {
 	(int (*)(void *, int, m2d_frame_t *, uint8_t *, int))h264d_set_frames,
 	(int (*)(void *))h264d_decode_picture,
 	(int (*)(void *, m2d_frame_t *, int))h264d_peek_decoded_frame,
-	(int (*)(void *, m2d_frame_t *, int))h264d_get_decoded_frame
+	(int (*)(void *, m2d_frame_t *, int))h264d_get_decoded_frame,
+	(int (*)(void *, m2d_picture_stats_t *))h264d_set_analysis,
+	(int (*)(void *, m2d_mb_info_t *, int))h264d_set_mb_info,
+	(int (*)(void *, int))h264d_set_luma_only,
+	h264d_probe,
+	(int (*)(void *, int))h264d_set_threads
 };
 
 const m2d_func_table_t * const h264d_func = &h264d_func_;
@@ -141,6 +141,7 @@ typedef struct {
 typedef struct {
 	uint8_t profile_idc;
 	uint8_t level_idc;
+	uint8_t chroma_format_idc;
 	uint8_t poc_type;
 	int8_t log2_max_frame_num;
 	int8_t log2_max_poc_lsb;
@@ -159,9 +160,12 @@ typedef struct {
 	unsigned frame_cropping_flag : 1;
 	unsigned vui_parameters_present_flag : 1;
 	unsigned is_high_profile : 1;
+	unsigned seq_scaling_matrix_present_flag : 1;
 	int32_t offset_for_non_ref_pic;
 	int32_t offset_for_top_to_bottom_field;
 	int32_t offset_for_ref_frame[256];
+	uint8_t scaling4x4[6][16]; /* zigzag order, fall-back rule A applied */
+	uint8_t scaling8x8[2][64];
 	vui_parameters_t vui;
 } h264d_sps;
 
@@ -184,8 +188,16 @@ typedef struct {
 	uint8_t pic_scaling_list_present_flag; /* bitfield, LSB first */
 	uint32_t num_slice_groups_minus1;
 /*	uint32_t slice_group_map_type; */
+	uint8_t scaling4x4[6][16]; /* zigzag order, valid where pic_scaling_list_present_flag is set */
+	uint8_t scaling8x8[2][64];
 } h264d_pps;
 
+/** Dequantization matrices of one QP, in the coefficient order of residual blocks. */
+typedef struct {
+	int32_t qmat4x4[6][16]; /* Intra Y, Cb, Cr, Inter Y, Cb, Cr */
+	int32_t qmat8x8[2][64]; /* Intra Y, Inter Y */
+} h264d_qmat_t;
+
 typedef union {
 	int16_t v[2];
 	uint32_t vector;
@@ -321,6 +333,8 @@ typedef struct {
 	m2d_frame_t frames[H264D_MAX_FRAME_NUM];
 	int8_t lru[H264D_MAX_FRAME_NUM];
 	h264d_dpb_t dpb;
+	m2d_mb_info_t *mb_info; /* given by h264d_set_mb_info() */
+	int mb_info_size;
 } h264d_frame_info_t;
 
 typedef struct {
@@ -370,6 +384,7 @@ typedef struct {
 #define DEC_SLICEHDR(hdr, a, b) (a = ((hdr & 15) - 6) * 2), (b = (((uint8_t)hdr >> 4) - 6) * 2)
 
 struct mb_code;
+struct h264d_recon_func_t;
 
 typedef struct mb_current {
 	int8_t is_constrained_intra;
@@ -394,6 +409,11 @@ typedef struct mb_current {
 	h264d_col_mb_t *col_curr;
 	h264d_bdirect_t *bdirect;
 	void (*inter_pred)(const struct mb_current *mb, const int8_t ref_idx[], const h264d_vector_t mv[], const h264d_vector_t& size, int offsetx, int offsety);
+	const struct h264d_recon_func_t *recon; /* intra prediction and inverse transforms */
+	m2d_picture_stats_t *stats; /* not NULL in analysis mode */
+	int8_t bipred; /* any 8x8 block of current macroblock refers to both lists, in analysis mode */
+	m2d_mb_info_t *mb_info; /* side data of current frame, or NULL */
+	int8_t luma_only; /* chroma is parsed but not reconstructed */
 	h264d_slice_header *header;
 	const int8_t *sub_mb_ref_map;
 	uint32_t cbp, cbf;
@@ -407,11 +427,11 @@ typedef struct mb_current {
 	const struct mb_code *mb_decode;
 	h264d_pps *pps;
 	int8_t *num_ref_idx_lx_active_minus1[2];
-	int16_t *qmatc_p[2];
-	int16_t qmaty[16];
-	int16_t qmatc[2][16];
+	const h264d_qmat_t *qmaty;
+	const h264d_qmat_t *qmatc[2];
+	const h264d_pps *qmat_pps; /* parameter set of qmat_tbl, NULL when SPS/PPS are updated */
 	int offset4x4[16]; /* offset of each 4x4 block in a macroblock. */
-	int16_t qmaty8x8[64];
+	h264d_qmat_t qmat_tbl[52];
 	h264d_bdirect_t bdirect_i;
 	h264d_frame_info_t frame_i;
 	h264d_cabac_t cabac_i;
@@ -452,6 +472,11 @@ int h264d_set_frames(h264d_context *h2d, int num_frame, m2d_frame_t *frame, uint
 int h264d_decode_picture(h264d_context *h2d);
 int h264d_peek_decoded_frame(h264d_context *h2d, m2d_frame_t *frame, int bypass_dpb);
 int h264d_get_decoded_frame(h264d_context *h2d, m2d_frame_t *frame, int bypass_dpb);
+int h264d_set_analysis(h264d_context *h2d, m2d_picture_stats_t *stats);
+int h264d_set_mb_info(h264d_context *h2d, m2d_mb_info_t *mb_info, int size);
+int h264d_set_luma_only(h264d_context *h2d, int luma_only);
+int h264d_probe(const byte_t *data, size_t len, m2d_probe_t *probe);
+int h264d_set_threads(h264d_context *h2d, int num);
 void h264d_load_bytes_skip03(dec_bits *ths, intptr_t read_bytes);
 
 extern const m2d_func_table_t * const h264d_func;
@@ -28,8 +28,10 @@
 #include <limits.h>
 #include <cstdlib>
 #include <algorithm>
+#include <new>
 #include "h265modules.h"
 #include "m2d_macro.h"
+#include "m2d_thread.h"
 #include "h265tbl.h"
 
 #if (defined(__GNUC__) && defined(__SSE2__)) || defined(_M_IX86) || defined(_M_AMD64)
@@ -61,9 +63,13 @@ int h265d_init(h265d_context *h2, int dpb_max, int (*header_callback)(void *, vo
 	h265d_data_t& h2d = *reinterpret_cast<h265d_data_t*>(h2);
 	memset(&h2d, 0, sizeof(h2d));
 	h2d.coding_tree_unit.cabac.context = &h2d.coding_tree_unit.context;
+	h2d.threads = 1;
 	h2d.header_callback = header_callback ? header_callback : header_dummyfunc;
 	h2d.header_callback_arg = arg;
 	dec_bits_open(&h2d.stream_i, m2d_load_bytes_skip03);
+#ifdef M2D_THREADS
+	h2d.frame_threads = new (&h2d.frame_threads_buf) h265d_frame_threads_t;
+#endif
 	return 0;
 }
 
@@ -71,20 +77,44 @@ dec_bits *h265d_stream_pos(h265d_context *h2) {
 	return &reinterpret_cast<h265d_data_t*>(h2)->stream_i;
 }
 
-static int set_second_frame(const h265d_sps_t& sps, h265d_ctu_t* ctu, uint8_t* pool) {
+/** Buffers used while decoding one picture.
+ */
+static size_t set_work_buffers(const h265d_sps_t& sps, h265d_ctu_t* ctu, uint8_t* pool) {
 	uint8_t* next = pool;
 	int col = sps.ctb_info.columns;
+	if (ctu) {
+		/* allocated regardless of scaling_list_enabled_flag, as following SPS may enable it */
+		ctu->scaling_table_buf = reinterpret_cast<h265d_scaling_table_t*>(next);
+		memset(&ctu->scaling_table_buf->lists, 0, sizeof(ctu->scaling_table_buf->lists));
+	}
+	next += sizeof(*ctu->scaling_table_buf);
+	if (ctu) {
+		ctu->row_progress = reinterpret_cast<int32_t*>(next);
+	}
+	next += sizeof(ctu->row_progress[0]) * sps.ctb_info.rows;
+	if (ctu) {
+		ctu->deblocked = reinterpret_cast<int32_t*>(next);
+	}
+	next += sizeof(ctu->deblocked[0]) * sps.ctb_info.rows;
 	if (ctu) {
 		ctu->neighbour_top = reinterpret_cast<h265d_neighbour_t*>(next);
 	}
 	next += sizeof(ctu->neighbour_top[0]) * H265D_NEIGHBOUR_NUM * col;
+	if (ctu) {
+		ctu->tile_edge_top = reinterpret_cast<h265d_neighbour_t*>(next);
+	}
+	next += sizeof(ctu->tile_edge_top[0]) * H265D_NEIGHBOUR_NUM * col;
+	if (ctu) {
+		ctu->tile_edge_left = reinterpret_cast<h265d_tile_edge_t*>(next);
+	}
+	next += sizeof(ctu->tile_edge_left[0]) * MINV(col, H265D_MAX_TILE_COLUMNS) * sps.ctb_info.rows;
 	if (ctu) {
 		ctu->deblocking.init(next);
 	}
 	next += ctu->deblocking.allocate_size(sps.ctb_info.size_log2, col);
-	size_t sao_right_len = sizeof(ctu->sao_vlines.right[0][0][0]) << sps.ctb_info.size_log2;
-	size_t sao_line_len = (sizeof(ctu->sao_hlines[0][0].bottom[0]) * col) << sps.ctb_info.size_log2;
-	size_t sao_map_len = (sizeof(ctu->sao_hlines[0][0].reserved_flag[0]) * col + 7) >> 3;
+	size_t sao_right_len = sizeof(ctu->sao.vlines.right[0][0][0]) << sps.ctb_info.size_log2;
+	size_t sao_line_len = (sizeof(ctu->sao.hlines[0][0].bottom[0]) * col) << sps.ctb_info.size_log2;
+	size_t sao_map_len = (sizeof(ctu->sao.hlines[0][0].reserved_flag[0]) * col + 7) >> 3;
 #ifdef X86ASM
 #define ALIGN16(x) (((x) + 15) & ~15)
 	next = (uint8_t*)ALIGN16((uintptr_t)next);
@@ -94,8 +124,8 @@ static int set_second_frame(const h265d_sps_t& sps, h265d_ctu_t* ctu, uint8_t* p
 #endif
 	for (int i = 0; i < 2; ++i) {
 		for (int col = 0; col < 2; ++col) {
-			h265d_sao_hlines_t& hlines = ctu->sao_hlines[i][col];
-			h265d_sao_vlines_t& vlines = ctu->sao_vlines;
+			h265d_sao_hlines_t& hlines = ctu->sao.hlines[i][col];
+			h265d_sao_vlines_t& vlines = ctu->sao.vlines;
 			if (ctu) {
 				vlines.right[i][col] = reinterpret_cast<uint8_t*>(next);
 			}
@@ -111,16 +141,39 @@ static int set_second_frame(const h265d_sps_t& sps, h265d_ctu_t* ctu, uint8_t* p
 		}
 	}
 	if (ctu) {
-		ctu->sao_signbuf = reinterpret_cast<uint8_t*>(next);
+		ctu->sao.signbuf = reinterpret_cast<uint8_t*>(next);
+	}
+	next += (sizeof(ctu->sao.signbuf[0]) * col) << (sps.ctb_info.size_log2 - 2);
+#ifdef X86ASM
+	next = (uint8_t*)ALIGN16((uintptr_t)next);
+	if (ctu) {
+		ctu->sao.lines = reinterpret_cast<uint8_t*>(next);
 	}
-	next += (sizeof(ctu->sao_signbuf[0]) * col) << (sps.ctb_info.size_log2 - 2);
+	next += 3 * ((col << sps.ctb_info.size_log2) + 96);
+#endif
 	if (ctu) {
 		ctu->sao_map = reinterpret_cast<h265d_sao_map_t*>(next);
 	}
 	next += sizeof(ctu->sao_map[0]) * col * sps.ctb_info.rows;
-	int frame_num = std::min(sps.num_long_term_ref_pics_sps + sps.num_short_term_ref_pic_sets, H265D_MAX_FRAME_NUM);
+	if (ctu) {
+		ctu->wpp_context = reinterpret_cast<h265d_cabac_context_t*>(next);
+	}
+	next += sizeof(ctu->wpp_context[0]) * sps.ctb_info.rows;
+	return next - pool;
+}
+
+/** Frames needed for decoding, as DPB size of the highest sub-layer or number of RPS if larger.
+ */
+static inline int sps_frame_num(const h265d_sps_t& sps) {
+	int dpb_size = MINV(sps.max_buffering[sps.prefix.max_sub_layers_minus1].max_dec_pic_buffering_minus1, static_cast<uint32_t>(H265D_MAX_FRAME_NUM)) + 1;
+	return MINV(MAXV(dpb_size, sps.num_long_term_ref_pics_sps + sps.num_short_term_ref_pic_sets), H265D_MAX_FRAME_NUM);
+}
+
+static int set_second_frame(const h265d_sps_t& sps, h265d_ctu_t* ctu, uint8_t* pool) {
+	uint8_t* next = pool + ((set_work_buffers(sps, ctu, pool) + 7) & ~7);
 	size_t col_size = ctu->colpics.colpic_size(sps.pic_width_in_luma_samples, sps.pic_height_in_luma_samples);
-	for (int i = 0; i < frame_num; ++i) {
+	/* colpic is indexed by frame, and any of frames given by h265d_set_frames() may be current one */
+	for (int i = 0; i < H265D_MAX_FRAME_NUM; ++i) {
 		if (ctu) {
 			ctu->colpics.set_colpic(i, next);
 		}
@@ -129,28 +182,83 @@ static int set_second_frame(const h265d_sps_t& sps, h265d_ctu_t* ctu, uint8_t* p
 	return static_cast<int>(next - pool);
 }
 
-int h265d_get_info(h265d_context *h2, m2d_info_t *info) {
-	if (!h2 || !info) {
-		return -1;
-	}
-	h265d_data_t& h2d = *reinterpret_cast<h265d_data_t*>(h2);
-	h265d_sps_t& sps = h2d.sps[h2d.pps[h2d.slice_header.pps_id].sps_id];
+#ifdef M2D_THREADS
+#define ALIGN64(x) (((x) + 63) & ~63)
+static inline size_t frame_job_stream_size(const h265d_sps_t& sps) {
+	return ALIGN64(static_cast<size_t>(sps.ctb_info.stride) * (sps.ctb_info.rows << sps.ctb_info.size_log2));
+}
+
+/** Work buffers and slice data copy of one frame job.
+ */
+static inline size_t frame_job_size(const h265d_sps_t& sps) {
+	return ALIGN64(set_work_buffers(sps, 0, 0)) + frame_job_stream_size(sps);
+}
+
+static void frame_threads_flush(h265d_data_t& h2d);
+
+static void frame_threads_setup(h265d_frame_threads_t& ft, const h265d_sps_t& sps, uint8_t* pool, int size) {
+	size_t work_size = ALIGN64(set_work_buffers(sps, 0, 0));
+	size_t stream_size = frame_job_stream_size(sps);
+	uint8_t* next = reinterpret_cast<uint8_t*>(ALIGN64(reinterpret_cast<uintptr_t>(pool)));
+	uint8_t* tail = pool + MAXV(size, 0);
+	int num = 0;
+	while ((num < H265D_MAX_FRAME_JOBS) && (next < tail) && (work_size + stream_size <= static_cast<size_t>(tail - next))) {
+		h265d_frame_job_t& job = ft.jobs[num++];
+		job.work = next;
+		next += work_size;
+		job.stream = next;
+		job.stream_size = stream_size;
+		next += stream_size;
+	}
+	ft.num = num;
+	ft.next = 0;
+	ft.current = -1;
+}
+#endif
+
+static inline int mb_info_width(const h265d_sps_t& sps) {
+	return (sps.pic_width_in_luma_samples + 15) >> 4;
+}
+
+static inline int mb_info_num(const h265d_sps_t& sps) {
+	return mb_info_width(sps) * ((sps.pic_height_in_luma_samples + 15) >> 4);
+}
+
+static void sps_to_info(const h265d_sps_t& sps, m2d_info_t *info) {
 	int width = sps.ctb_info.columns << sps.ctb_info.size_log2;
 	int height = sps.ctb_info.rows << sps.ctb_info.size_log2;
 	info->src_width = width;
 	info->src_height = height;
 	info->disp_width = width;
 	info->disp_height = height;
-	info->frame_num = std::min(sps.num_long_term_ref_pics_sps + sps.num_short_term_ref_pic_sets, H265D_MAX_FRAME_NUM);
+	info->frame_num = sps_frame_num(sps);
 	info->crop[0] = sps.cropping[0];
 	info->crop[1] = width - sps.pic_width_in_luma_samples + sps.cropping[1];
 	info->crop[2] = sps.cropping[2];
 	info->crop[3] = height - sps.pic_height_in_luma_samples + sps.cropping[3];
 	info->additional_size = set_second_frame(sps, 0, 0);
+	info->mb_info_num = mb_info_num(sps);
+}
+
+int h265d_get_info(h265d_context *h2, m2d_info_t *info) {
+	if (!h2 || !info) {
+		return -1;
+	}
+	h265d_data_t& h2d = *reinterpret_cast<h265d_data_t*>(h2);
+	const h265d_sps_t& sps = h2d.sps[h2d.pps[h2d.slice_header.pps_id].sps_id];
+	sps_to_info(sps, info);
+#ifdef M2D_THREADS
+	if (1 < h2d.threads) {
+		info->additional_size += 63 + MINV(static_cast<int>(h2d.threads), H265D_MAX_FRAME_JOBS) * frame_job_size(sps);
+	}
+#endif
 	return 0;
 }
-static void init_dpb(h265d_dpb_t& dpb) {
-	dpb.max = 16;
+/** One of frames is always left out of DPB for the picture being decoded,
+ * so that it never predicts from itself.
+ */
+static void init_dpb(h265d_dpb_t& dpb, int num_frame) {
+	dpb.max = MAXV(num_frame - 1, 1);
 	dpb.size = 0;
 	dpb.output = -1;
 }
@@ -158,8 +266,11 @@ static void init_dpb(h265d_dpb_t& dpb) {
 static void init_frame_info(h265d_frame_info_t& frame_info, int num_frame, m2d_frame_t *frame) {
 	frame_info.num = num_frame;
 	std::copy(frame, frame + num_frame, frame_info.frames);
+	for (int i = 0; i < num_frame; ++i) {
+		frame_info.frames[i].mb_info = 0;
+	}
 	memset(frame_info.lru, 0, sizeof(frame_info.lru));
-	init_dpb(frame_info.dpb);
+	init_dpb(frame_info.dpb, num_frame);
 }
 
 class is_same_frame {
@@ -177,7 +288,9 @@ static inline bool dpb_exist(const h265d_dpb_t& dpb, int frame_idx) {
 	return (target != dpb.data + dpb.size);
 }
 
-static inline void find_empty_frame(h265d_frame_info_t& frm) {
+/** Frames in busy mask are being decoded by frame threads, and treated as in DPB.
+ */
+static inline void find_empty_frame(h265d_frame_info_t& frm, uint32_t busy = 0) {
 	int8_t *lru = frm.lru;
 	int lru_len = NUM_ELEM(frm.lru);
 	int max_idx = 0;
@@ -185,7 +298,7 @@ static inline void find_empty_frame(h265d_frame_info_t& frm) {
 	int frm_num = frm.num;
 	h265d_dpb_t dpb = frm.dpb;
 	for (int i = 0; i < frm_num; ++i) {
-		if (dpb_exist(dpb, i)) {
+		if (((busy >> i) & 1) || dpb_exist(dpb, i)) {
 			lru[i] = 0;
 		} else {
 			lru[i] += 1;
@@ -210,8 +323,15 @@ int h265d_set_frames(h265d_context *h2, int num_frame, m2d_frame_t *frame, uint8
 		return -1;
 	}
 	h265d_ctu_t& ctu = h2d.coding_tree_unit;
+	const h265d_sps_t& sps = h2d.sps[h2d.pps[h2d.slice_header.pps_id].sps_id];
+#ifdef M2D_THREADS
+	frame_threads_flush(h2d);
+#endif
 	init_frame_info(ctu.frame_info, std::min(NUM_ELEM(h2d.coding_tree_unit.frame_info.frames), num_frame), frame);
-	set_second_frame(h2d.sps[h2d.pps[h2d.slice_header.pps_id].sps_id], &ctu, second_frame);
+	int size = set_second_frame(sps, &ctu, second_frame);
+#ifdef M2D_THREADS
+	frame_threads_setup(*h2d.frame_threads, sps, second_frame + size, second_frame_size - size);
+#endif
 /*
 	h2d->slice_header->reorder[0].ref_frames = mb->frame->refs[0];
 	h2d->slice_header->reorder[1].ref_frames = mb->frame->refs[1];
@@ -277,8 +397,7 @@ static void sub_layer_reordering_info(h265d_sub_layer_reordering_info_t dst[], u
 	}
 }
 
-static void video_parameter_set(h265d_data_t& h2d, dec_bits& st) {
-	h265d_vps_t& vps = h2d.vps;
+static void vps_read(h265d_vps_t& vps, dec_bits& st) {
 	vps.id = get_bits(&st, 4);
 	skip_bits(&st, 2);
 	vps.max_layer = get_bits(&st, 6);
@@ -300,6 +419,10 @@ static void video_parameter_set(h265d_data_t& h2d, dec_bits& st) {
 	}
 }
 
+static void video_parameter_set(h265d_data_t& h2d, dec_bits& st) {
+	vps_read(h2d.vps, st);
+}
+
 static void conformance_window_read(h265d_sps_t& dst, dec_bits& st) {
 	if ((dst.conformance_window_flag = get_onebit(&st)) != 0) {
 		for (int i = 0; i < 4; ++i) {
@@ -310,34 +433,7 @@ static void conformance_window_read(h265d_sps_t& dst, dec_bits& st) {
 	}
 }
 
-static void scaling_list_read(uint8_t list[], int len, bool upper, dec_bits& st) {
-	uint8_t coef = upper ? (se_golomb(&st) + 8) : 8;
-	for (int i = 0; i < len; ++i) {
-		coef = se_golomb(&st) + coef;
-		list[i] = coef;
-	}
-}
-
-static void scaling_list_read_all(uint8_t list[], int list_num, int list_len, bool upper, dec_bits& st) {
-	for (int i = 0; i < list_num; ++i) {
-		if (get_onebit(&st) == 0) {
-			ue_golomb(&st);
-		} else {
-			scaling_list_read(list, list_len, upper, st);
-		}
-		list += list_len;
-	}
-}
-
-static void scaling_list_data(h265d_scaling_list_data_t& dst, dec_bits& st) {
-	assert(0);
-	scaling_list_read_all(dst.scale0[0], 6, 16, false, st);
-	scaling_list_read_all(dst.scale1[0], 6, 64, false, st);
-	scaling_list_read_all(dst.scale2[0], 6, 64, true, st);
-	scaling_list_read_all(dst.scale3[0], 2, 64, true, st);
-}
-
-static inline void scaling_list_default(h265d_ctu_t& dst, uint32_t size_log2, uint32_t qp) {
+static const uint8_t* scaling_list_default(int size_id, int matrix_id) {
 	static const uint8_t scaling_default4x4[16] = {
 		16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16
 	};
@@ -353,39 +449,68 @@ static inline void scaling_list_default(h265d_ctu_t& dst, uint32_t size_log2, ui
 		24, 24, 24, 24, 25, 25, 25, 25, 25, 25, 25, 28, 28, 28, 28, 28,
 		28, 33, 33, 33, 33, 33, 41, 41, 41, 41, 54, 54, 54, 71, 71, 91
 	};
-	static const uint8_t* const scaling_default[4][6] = {
-		{
-			scaling_default4x4,
-			scaling_default4x4,
-			scaling_default4x4,
-			scaling_default4x4,
-			scaling_default4x4,
-			scaling_default4x4
-		},
-		{
-			scaling_default1,
-			scaling_default1,
-			scaling_default1,
-			scaling_default2,
-			scaling_default2,
-			scaling_default2
-		},
-		{
-			scaling_default1,
-			scaling_default1,
-			scaling_default1,
-			scaling_default2,
-			scaling_default2,
-			scaling_default2
-		},
-		{
-			scaling_default1,
-			scaling_default2,
-			0, 0, 0, 0
-		}
-	};
-	if (dst.pps->pps_scaling_list_data_present_flag) {
+	if (size_id == 0) {
+		return scaling_default4x4;
 	} else {
+		return (matrix_id < 3) ? scaling_default1 : scaling_default2;
+	}
+}
+
+/** Default scaling lists, used when scaling_list_enabled_flag is set without scaling_list_data().
+ */
+static void scaling_list_data_default(h265d_scaling_list_data_t& dst) {
+	for (int i = 0; i < 6; ++i) {
+		memcpy(dst.scale0[i], scaling_list_default(0, i), sizeof(dst.scale0[0]));
+		memcpy(dst.scale1[i], scaling_list_default(1, i), sizeof(dst.scale1[0]));
+		memcpy(dst.scale2[i], scaling_list_default(2, i), sizeof(dst.scale2[0]));
+	}
+	for (int i = 0; i < 2; ++i) {
+		memcpy(dst.scale3[i], scaling_list_default(3, i * 3), sizeof(dst.scale3[0]));
+	}
+	memset(dst.dc2, 16, sizeof(dst.dc2));
+	memset(dst.dc3, 16, sizeof(dst.dc3));
+}
+
+static void scaling_list_data(h265d_scaling_list_data_t& dst, dec_bits& st) {
+	uint8_t* const lists[4] = {
+		dst.scale0[0], dst.scale1[0], dst.scale2[0], dst.scale3[0]
+	};
+	for (int size_id = 0; size_id < 4; ++size_id) {
+		int len = (size_id == 0) ? 16 : 64;
+		int step = (size_id == 3) ? 3 : 1;
+		uint8_t* dc = (size_id == 2) ? dst.dc2 : dst.dc3;
+		for (int matrix_id = 0; matrix_id < 6; matrix_id += step) {
+			int idx = matrix_id / step;
+			uint8_t* list = lists[size_id] + idx * len;
+			if (get_onebit(&st) == 0) {
+				uint32_t delta;
+				READ_CHECK_RANGE(ue_golomb(&st), delta, static_cast<uint32_t>(idx), st);
+				if (delta == 0) {
+					memcpy(list, scaling_list_default(size_id, matrix_id), len);
+					if (1 < size_id) {
+						dc[idx] = 16;
+					}
+				} else {
+					memcpy(list, list - delta * len, len);
+					if (1 < size_id) {
+						dc[idx] = dc[idx - delta];
+					}
+				}
+			} else {
+				int32_t coef = 8;
+				if (1 < size_id) {
+					READ_CHECK_RANGE2(se_golomb(&st), coef, -7, 247, st);
+					coef += 8;
+					dc[idx] = coef;
+				}
+				for (int i = 0; i < len; ++i) {
+					int32_t delta;
+					READ_CHECK_RANGE2(se_golomb(&st), delta, -128, 127, st);
+					coef = (coef + delta + 256) & 255;
+					list[i] = coef;
+				}
+			}
+		}
 	}
 }
 
@@ -518,6 +643,23 @@ static void vui_parameters(h265d_vui_parameters_t& dst, dec_bits& st) {
 			dst.matrix_coeffs = get_bits(&st, 8);
 		}
 	}
+	if ((dst.chroma_loc_info_present_flag = get_onebit(&st)) != 0) {
+		READ_CHECK_RANGE(ue_golomb(&st), dst.chroma_sample_loc_type_top_field, 5, st);
+		READ_CHECK_RANGE(ue_golomb(&st), dst.chroma_sample_loc_type_bottom_field, 5, st);
+	}
+	dst.neutral_chroma_indication_flag = get_onebit(&st);
+	dst.field_seq_flag = get_onebit(&st);
+	dst.frame_field_info_present_flag = get_onebit(&st);
+	if ((dst.default_display_window_flag = get_onebit(&st)) != 0) {
+		for (int i = 0; i < 4; ++i) {
+			dst.def_disp_win_offset[i] = ue_golomb(&st);
+		}
+	}
+	if ((dst.timing_info_present_flag = get_onebit(&st)) != 0) {
+		dst.num_units_in_tick = get_bits32(&st, 32);
+		dst.time_scale = get_bits32(&st, 32);
+	}
+	/* current version omits rest of data */
 }
 
 static inline uint32_t log2ceil(uint32_t num) {
@@ -576,6 +718,7 @@ static void sps_residual(h265d_sps_t& dst, const h265d_sps_prefix_t& prefix, dec
 	sub_layer_reordering_info(dst.max_buffering, dst.sub_layer_ordering_info_present_flag, prefix.max_sub_layers_minus1, st);
 	READ_CHECK_RANGE(ue_golomb(&st), dst.log2_min_luma_coding_block_size_minus3, 2, st);
 	READ_CHECK_RANGE(ue_golomb(&st), dst.log2_diff_max_min_luma_coding_block_size, 3, st);
+	CHECK_RANGE2(dst.log2_min_luma_coding_block_size_minus3 + 3 + dst.log2_diff_max_min_luma_coding_block_size, 4, 6, st);
 	READ_CHECK_RANGE(ue_golomb(&st), dst.log2_min_transform_block_size_minus2, 2, st);
 	READ_CHECK_RANGE(ue_golomb(&st), dst.log2_diff_max_min_transform_block_size, 3, st);
 	READ_CHECK_RANGE(ue_golomb(&st), dst.max_transform_hierarchy_depth_inter, 5, st);
@@ -583,6 +726,8 @@ static void sps_residual(h265d_sps_t& dst, const h265d_sps_prefix_t& prefix, dec
 	if ((dst.scaling_list_enabled_flag = get_onebit(&st)) != 0) {
 		if ((dst.scaling_list_data_present_flag = get_onebit(&st)) != 0) {
 			scaling_list_data(dst.scaling_list_data, st);
+		} else {
+			scaling_list_data_default(dst.scaling_list_data);
 		}
 	}
 	dst.amp_enabled_flag = get_onebit(&st);
@@ -624,20 +769,84 @@ static void seq_parameter_set(h265d_data_t& h2d, dec_bits& st) {
 	sps_residual(h2d.sps[sps_prefix(prefix, st)], prefix, st);
 }
 
+/**Read VPS and SPS up to the first SPS; VPS is kept for its timing_info
+ * in case VUI of SPS lacks it.
+ */
+static void probe_headers(h265d_sps_t& sps, h265d_vps_t& vps, bool& found, dec_bits& st) {
+	for (;;) {
+		if (m2d_find_mpeg_data(&st) < 0) {
+			return;
+		}
+		h265d_nal_t nal_type = static_cast<h265d_nal_t>((get_bits(&st, 16) >> 9) & 63);
+		if (nal_type == VPS_NAL) {
+			vps_read(vps, st);
+		} else if (nal_type == SPS_NAL) {
+			h265d_sps_prefix_t prefix;
+			sps_prefix(prefix, st);
+			sps_residual(sps, prefix, st);
+			found = true;
+			return;
+		}
+	}
+}
+
+/**Report stream parameters from the first SPS without context.
+ */
+int h265d_probe(const byte_t *data, size_t len, m2d_probe_t *probe) {
+	if (!data || !len || !probe) {
+		return -1;
+	}
+	dec_bits st;
+	h265d_sps_t sps;
+	h265d_vps_t vps;
+	bool found = false;
+	memset(&sps, 0, sizeof(sps));
+	memset(&vps, 0, sizeof(vps));
+	m2d_probe_stream_open(&st, m2d_load_bytes_skip03, data, len);
+	if (setjmp(st.jmp) == 0) {
+		probe_headers(sps, vps, found, st);
+	}
+	if (!found) {
+		return -1;
+	}
+	sps_to_info(sps, &probe->info);
+	probe->profile = sps.prefix.profile_tier_level.general_profile_first8bit & 31;
+	probe->level = sps.prefix.profile_tier_level.general_level_idc;
+	probe->chroma_format = sps.chroma_format_idc;
+	const h265d_vui_parameters_t& vui = sps.vui_parameters;
+	if (sps.vui_parameters_present_flag && vui.timing_info_present_flag && vui.num_units_in_tick) {
+		probe->frame_rate_num = vui.time_scale;
+		probe->frame_rate_den = vui.num_units_in_tick;
+	} else if (vps.timing_info_present_flag && vps.timing_info.num_units_in_tick) {
+		probe->frame_rate_num = vps.timing_info.time_scale;
+		probe->frame_rate_den = vps.timing_info.num_units_in_tick;
+	} else {
+		probe->frame_rate_num = 0;
+		probe->frame_rate_den = 0;
+	}
+	m2d_probe_set_frame_size(probe);
+	return 0;
+}
+
+static void pps_tile_sizes(uint16_t size_minus1[], uint32_t num_minus1, uint32_t total, dec_bits& st) {
+	uint32_t sum = 0;
+	for (uint32_t i = 0; i < num_minus1; ++i) {
+		READ_CHECK_RANGE(ue_golomb(&st), size_minus1[i], total - 2, st);
+		sum += size_minus1[i] + 1;
+		CHECK_RANGE(sum, total - 1, st);
+	}
+}
+
 static void pps_tiles(h265d_tiles_t& dst, dec_bits& st, const h265d_sps_t& sps) {
 	uint32_t columns_minus1;
-	READ_CHECK_RANGE(ue_golomb(&st), columns_minus1, (uint32_t)(sps.ctb_info.columns - 1), st);
+	READ_CHECK_RANGE(ue_golomb(&st), columns_minus1, (uint32_t)MINV(sps.ctb_info.columns, H265D_MAX_TILE_COLUMNS) - 1, st);
 	dst.num_tile_columns_minus1 = columns_minus1;
 	uint32_t rows_minus1;
-	READ_CHECK_RANGE(ue_golomb(&st), rows_minus1, (uint32_t)(sps.ctb_info.rows - 1), st);
+	READ_CHECK_RANGE(ue_golomb(&st), rows_minus1, (uint32_t)MINV(sps.ctb_info.rows, H265D_MAX_TILE_ROWS) - 1, st);
 	dst.num_tile_rows_minus1 = rows_minus1;
 	if ((dst.uniform_spacing_flag = get_onebit(&st)) == 0) {
-		for (uint32_t i = 0; i < columns_minus1; ++i) {
-			READ_CHECK_RANGE(ue_golomb(&st), dst.column_width_minus1[i], columns_minus1, st);
-		}
-		for (uint32_t i = 0; i < rows_minus1; ++i) {
-			READ_CHECK_RANGE(ue_golomb(&st), dst.row_height_minus1[i], rows_minus1, st);
-		}
+		pps_tile_sizes(dst.column_width_minus1, columns_minus1, sps.ctb_info.columns, st);
+		pps_tile_sizes(dst.row_height_minus1, rows_minus1, sps.ctb_info.rows, st);
 	}
 	dst.loop_filter_across_tiles_enabled_flag = get_onebit(&st);
 }
@@ -712,10 +921,12 @@ static void entry_points(h265d_entry_point_t& dst, const h265d_pps_t& pps, const
 	if (0 < num_points) {
 		READ_CHECK_RANGE(ue_golomb(&st), dst.offset_len_minus1, 31, st);
 		uint32_t offset_bits = dst.offset_len_minus1 + 1;
-		uint32_t* points = dst.entry_point_offset_minus1;
-		do {
-			*points++ = ue_golomb(&st);
-		} while (--num_points);
+		for (uint32_t i = 0; i < num_points; ++i) {
+			uint32_t offset = get_bits32(&st, offset_bits);
+			if (i < static_cast<uint32_t>(H265D_MAX_ENTRY_POINTS)) {
+				dst.entry_point_offset_minus1[i] = offset;
+			}
+		}
 	}
 }
 
@@ -739,7 +950,7 @@ static void update_pic_order_cnt(h265d_slice_header_body_t& hdr, unsigned curr_l
 	unsigned prev_msb = poc.msb;
 	unsigned max_lsb_div2 = 8 << sps.log2_max_pic_order_cnt_lsb_minus4;
 	poc.lsb = curr_lsb;
-	if ((BLA_W_LP <= hdr.nal_type) && (hdr.nal_type <= BLA_N_LP)) {
+	if (hdr.no_rasl_output_flag) {
 		poc.msb = 0;
 	} else if ((curr_lsb < prev_lsb) && (max_lsb_div2 <= prev_lsb - curr_lsb)) {
 		poc.msb++;
@@ -1114,22 +1325,29 @@ static int sao_search_nonmerged_left(const h265d_sao_map_t* sao_map, int max) {
 
 static void sao_read(h265d_ctu_t& ctu, const h265d_slice_header_t& hdr, dec_bits& st) {
 	h265d_sao_map_t* sao_map = ctu.sao_map + ctu.pos_y * ctu.size->columns + ctu.pos_x;
-	if (ctu.pos_x != 0) {
+	uint32_t tile_left = ctu.tile_column_bd[ctu.tile_col];
+	sao_map[0].merge_left = 0;
+	if (ctu.pos_x != tile_left) {
 		if ((sao_map[0].merge_left = sao_merge_flag(ctu.cabac, st)) != 0) {
 			return;
 		}
 	}
-	if (ctu.pos_y != 0) {
+	if (ctu.pos_y != ctu.tile_row_bd[ctu.tile_row]) {
 		if (sao_merge_flag(ctu.cabac, st)) {
 			const h265d_sao_map_t* upper = &sao_map[-ctu.size->columns];
-			sao_map[0] = upper[sao_search_nonmerged_left(upper, ctu.pos_x)];
+			sao_map[0] = upper[sao_search_nonmerged_left(upper, ctu.pos_x - tile_left)];
 			return;
 		}
 	}
 	sao_read_block(*sao_map, ctu, hdr, st);
 }
 
-static void sao_ignore(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, dec_bits& st) {}
+static void sao_ignore(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, dec_bits& st) {
+	h265d_sao_map_t& sao_map = dst.sao_map[dst.pos_y * dst.size->columns + dst.pos_x];
+	sao_map.merge_left = 0;
+	sao_map.luma_idx = 0;
+	sao_map.chroma_idx = 0;
+}
 
 static inline uint32_t split_cu_flag(h265d_cabac_t& cabac, dec_bits& st, int size_log2, const h265d_neighbour_t* left, const h265d_neighbour_t* top) {
 	return cabac_decode_decision_raw(cabac, st, cabac.context->split_cu_flag + (6 < size_log2 + left->depth) + (6 < size_log2 + top->depth));
@@ -1316,14 +1534,6 @@ static inline uint32_t coded_sub_block_flag(h265d_cabac_t& cabac, dec_bits& st,
 	return cabac_decode_decision_raw(cabac, st, cabac.context->coded_sub_block_flag + ((prev_sbf & 1) | (prev_sbf >> 1)) + ((colour + 1) & 2));
 }
 
-static inline uint32_t sig_coeff_flag(h265d_cabac_t& cabac, dec_bits& st, uint8_t inc) {
-	return cabac_decode_decision_raw(cabac, st, cabac.context->sig_coeff_flag + inc);
-}
-
-static inline uint32_t coeff_abs_level_greater1_flag(h265d_cabac_t& cabac, dec_bits& st, uint8_t inc) {
-	return cabac_decode_decision_raw(cabac, st, cabac.context->coeff_abs_level_greater1_flag + inc);
-}
-
 static inline uint32_t coeff_abs_level_greater2_flag(h265d_cabac_t& cabac, dec_bits& st, uint8_t inc) {
 	return cabac_decode_decision_raw(cabac, st, cabac.context->coeff_abs_level_greater2_flag + inc);
 }
@@ -1572,44 +1782,53 @@ typedef struct {
 	}
 } h265d_sigcoeff_t;
 
-static inline uint32_t sig_coeff_flags_read(h265d_cabac_t& cabac, dec_bits& st, const int8_t sig_coeff_flag_inc[], int sig_coeff_flag_inc_ofset, bool is_last, int32_t pos, h265d_sigcoeff_t coeffs[], uint32_t sxy) {
+/** ctx points sig_coeff_flag contexts of current TU size, scanIdx and cIdx,
+ * and sig_coeff_flag_inc[] is ctxInc of each position for neighbouring coded_sub_block_flags.
+ */
+static inline uint32_t sig_coeff_flags_read(h265d_cabac_t& cabac, dec_bits& st, const int8_t sig_coeff_flag_inc[], int8_t* ctx, bool is_last, int32_t pos, h265d_sigcoeff_t coeffs[], uint32_t sxy) {
 	int32_t idx = -1;
 	if (is_last) {
 		coeffs[++idx].set(pos, 1);
 		pos--;
 	}
 	while (0 < pos) {
-		if (sig_coeff_flag(cabac, st, sig_coeff_flag_inc_ofset + sig_coeff_flag_inc[pos])) {
+		if (cabac_decode_decision_raw(cabac, st, ctx + sig_coeff_flag_inc[pos])) {
 			coeffs[++idx].set(pos, 1);
 		}
 		pos--;
 	}
-	if ((pos == 0) && (((idx < 0) && sxy) || sig_coeff_flag(cabac, st, sig_coeff_flag_inc_ofset + sig_coeff_flag_inc[0]))) {
+	if ((pos == 0) && (((idx < 0) && sxy) || cabac_decode_decision_raw(cabac, st, ctx + sig_coeff_flag_inc[0]))) {
 		coeffs[++idx].set(0, 1);
 	}
 	return static_cast<uint32_t>(idx + 1);
 }
 
+/** greater1Ctx after each coeff_abs_level_greater1_flag, indexed by [flag][greater1Ctx].
+ */
+static const uint8_t greater1ctx_next[2][4] = {
+	{0, 2, 3, 3}, {0, 0, 0, 0}
+};
+
 static inline uint32_t sig_coeff_greater(int colour, int subblock_idx, uint8_t& greater1ctx, h265d_sigcoeff_t coeff[], uint32_t num_coeff, h265d_cabac_t& cabac, dec_bits& st) {
 	uint32_t ctxset = (((colour == 0) && (subblock_idx != 0)) ? 2 : 0) + (greater1ctx == 0);
-	uint32_t greater1offset = ctxset * 4 + ((colour == 0) ? 0 : 16);
-	greater1ctx = 1;
+	int8_t* ctx = cabac.context->coeff_abs_level_greater1_flag + ctxset * 4 + ((colour == 0) ? 0 : 16);
+	uint32_t ctx_idx = 1;
 	uint32_t max_flags = 0;
 	int last_greater1_idx = -1;
 	uint32_t max_num = MINV(num_coeff, 8U);
 	for (uint32_t j = 0; j < max_num; ++j) {
-		if (coeff_abs_level_greater1_flag(cabac, st, greater1offset + greater1ctx)) {
-			greater1ctx = 0;
+		uint32_t greater1 = cabac_decode_decision_raw(cabac, st, ctx + ctx_idx);
+		ctx_idx = greater1ctx_next[greater1][ctx_idx];
+		if (greater1) {
 			coeff[j].val = 2;
 			if (0 <= last_greater1_idx) {
 				max_flags |= 1 << j;
 			} else {
 				last_greater1_idx = j;
 			}
-		} else if ((uint32_t)(greater1ctx - 1) < 2) {
-			greater1ctx++;
 		}
 	}
+	greater1ctx = ctx_idx;
 	if (0 <= last_greater1_idx) {
 		if (coeff_abs_level_greater2_flag(cabac, st, (colour == 0) ? ctxset : ctxset + 4)) {
 			coeff[last_greater1_idx].val = 3;
@@ -1690,6 +1909,95 @@ static const h265d_scaling_func_t scaling_default_func[4] = {
 	scaling_default_base<5>
 };
 
+/** With scaling lists, levels are stored as they are and scaled by scaling_list_apply().
+ */
+static int16_t scaling_list_level(int32_t val, const h265d_scaling_info_t& scale, int idx) {
+	return SATURATE16BIT(val);
+}
+
+static const h265d_scaling_func_t scaling_list_func[4] = {
+	scaling_list_level,
+	scaling_list_level,
+	scaling_list_level,
+	scaling_list_level
+};
+
+static const int scaling_factor_offset[4] = {
+	0, 6 * 6 * 16, 6 * 6 * (16 + 64), 6 * 6 * (16 + 64 + 256)
+};
+
+/** Expand scaling lists into factors of each block size, matrixId and qp % 6.
+ */
+static void scaling_table_build(h265d_scaling_table_t& dst, const h265d_scaling_list_data_t& lists) {
+	static const int16_t level_scale[6] = {
+		40, 45, 51, 57, 64, 72
+	};
+	const uint8_t* const src[4] = {
+		lists.scale0[0], lists.scale1[0], lists.scale2[0], lists.scale3[0]
+	};
+	int16_t* factor = dst.factor;
+	for (int size_id = 0; size_id < 4; ++size_id) {
+		uint32_t size_log2 = size_id + 2;
+		uint32_t base_log2 = (size_id == 0) ? 2 : 3;
+		uint32_t ratio_log2 = size_log2 - base_log2;
+		const int8_t* scan = (size_id == 0) ? h265d_scan_order4x4diag : h265d_scan_order8x8diag;
+		int matrix_num = (size_id == 3) ? 2 : 6;
+		for (int m = 0; m < matrix_num; ++m) {
+			uint8_t mat[32 * 32];
+			const uint8_t* list = src[size_id] + (m << (base_log2 * 2));
+			for (int i = 0; i < (1 << (base_log2 * 2)); ++i) {
+				uint32_t pos = scan[i];
+				uint32_t x0 = (pos & ((1 << base_log2) - 1)) << ratio_log2;
+				uint32_t y0 = (pos >> base_log2) << ratio_log2;
+				for (uint32_t y = 0; y < (1U << ratio_log2); ++y) {
+					memset(&mat[((y0 + y) << size_log2) + x0], list[i], 1 << ratio_log2);
+				}
+			}
+			if (size_id == 2) {
+				mat[0] = lists.dc2[m];
+			} else if (size_id == 3) {
+				mat[0] = lists.dc3[m];
+			}
+			for (int rem = 0; rem < 6; ++rem) {
+				for (int i = 0; i < (1 << (size_log2 * 2)); ++i) {
+					*factor++ = mat[i] * level_scale[rem];
+				}
+			}
+		}
+	}
+	dst.lists = lists;
+}
+
+/** Scale levels of a block by factors of scaling lists, within the extent of xy_pos_sum.
+ * (level * m * levelScale << (qp / 6) + round) >> bdShift, with bdShift = log2 + 3 for 8 bit.
+ */
+static void scaling_list_apply(int16_t coeff[], const int16_t factor[], uint32_t size_log2, int qp, uint32_t xy_pos_sum) {
+	uint32_t width = (xy_pos_sum & ((1 << size_log2) - 1)) + 1;
+	uint32_t height = (xy_pos_sum >> size_log2) + 1;
+	int shift = size_log2 + 3 - qp / 6;
+	if (0 < shift) {
+		int32_t round = 1 << (shift - 1);
+		for (uint32_t y = 0; y < height; ++y) {
+			int16_t* line = coeff + (y << size_log2);
+			const int16_t* fline = factor + (y << size_log2);
+			for (uint32_t x = 0; x < width; ++x) {
+				int32_t v = (line[x] * fline[x] + round) >> shift;
+				line[x] = SATURATE16BIT(v);
+			}
+		}
+	} else {
+		shift = -shift;
+		for (uint32_t y = 0; y < height; ++y) {
+			int16_t* line = coeff + (y << size_log2);
+			const int16_t* fline = factor + (y << size_log2);
+			for (uint32_t x = 0; x < width; ++x) {
+				int64_t v = static_cast<int64_t>(line[x] * fline[x]) << shift;
+				line[x] = SATURATE16BIT(v);
+			}
+		}
+	}
+}
+
 template<int N, int SHIFT, int GAP, typename T>
 static inline void NxNtransform_dconly(uint8_t *dst, int16_t* coeff, int stride) {
 	acNxNtransform_dconly<N, SHIFT, GAP - 1, T>(dst, coeff[0], stride);
@@ -1772,6 +2080,7 @@ void transform_ac4x4chroma(uint8_t* dst, int16_t* coeff, int stride);
 void transform_ac8x8chroma(uint8_t* dst, int16_t* coeff, int stride);
 void transform_ac16x16chroma(uint8_t* dst, int16_t* src, int stride);
 void transform_ac32x32chroma(uint8_t* dst, int16_t* src, int stride);
+void transform_ac_x86(uint8_t* dst, int16_t* coeff, int stride, int size_log2, bool chroma, uint32_t xy_pos_sum);
 #else
 template <typename F>
 static inline void transformdst_line4(int16_t *dst, const int16_t* coeff, F Saturate) {
@@ -2141,7 +2450,14 @@ static void (* const transform_func[2][4][2][4])(uint8_t *dst, int16_t* coeff, i
 
 static inline void transform(int16_t coeff[], uint32_t size_log2, uint8_t* frame, uint32_t stride, int colour, uint32_t xy_pos_sum, bool is_intra) {
 	uint32_t size = 1 << size_log2;
-	transform_func[is_intra][(size <= xy_pos_sum) * 2 + ((xy_pos_sum & (size - 1)) != 0)][(colour + 1) >> 1][size_log2 - 2](frame + (colour >> 1), coeff, stride);
+	uint32_t kind = (size <= xy_pos_sum) * 2 + ((xy_pos_sum & (size - 1)) != 0);
+#ifdef X86ASM
+	if ((kind == 3) && (2 < size_log2)) {
+		transform_ac_x86(frame + (colour >> 1), coeff, stride, size_log2, colour != 0, xy_pos_sum);
+		return;
+	}
+#endif
+	transform_func[is_intra][kind][(colour + 1) >> 1][size_log2 - 2](frame + (colour >> 1), coeff, stride);
 }
 
 template <int N>
@@ -2200,7 +2516,7 @@ static void residual_coding(h265d_ctu_t& dst, dec_bits& st, uint32_t size_log2,
 	}
 	const residual_scan_order_t& order = residual_scan_order[order_idx][size_log2 - 2];
 	const int8_t (*sig_coeff_flag_inc_idx)[4] = sig_coeff_flag_inc_tblidx[order_idx][(colour + 1) >> 1][size_log2 - 2];
-	int sig_coeff_flag_incofs = sig_coeff_flag_inc_ofset[order_idx][(colour + 1) >> 1][size_log2 - 2];
+	int8_t* sig_coeff_flag_ctx = dst.cabac.context->sig_coeff_flag + sig_coeff_flag_inc_ofset[order_idx][(colour + 1) >> 1][size_log2 - 2];
 	uint32_t last_subblock_pos = order.sub_block_num[scan_order_index(last_sig_coeff_x >> 2, last_sig_coeff_y >> 2, size_log2 - 2)];
 	int i = last_subblock_pos;
 	uint8_t greater1ctx = 1;
@@ -2214,7 +2530,7 @@ static void residual_coding(h265d_ctu_t& dst, dec_bits& st, uint32_t size_log2,
 		if (((unsigned)(last_subblock_pos - 1) <= (unsigned)(i - 1)) || coded_sub_block_flag(dst.cabac, st, prev_sbf, colour)) {
 			sub_block_info.set_flag();
 			h265d_sigcoeff_t sig_coeff_flags[4 * 4];
-			uint32_t num_coeff = sig_coeff_flags_read(dst.cabac, st, sig_coeff_flag_inc_tbl[sig_coeff_flag_inc_idx[sxy != 0][prev_sbf]], sig_coeff_flag_incofs, ((uint32_t)i == last_subblock_pos), num, sig_coeff_flags, sxy);
+			uint32_t num_coeff = sig_coeff_flags_read(dst.cabac, st, sig_coeff_flag_inc_tbl[sig_coeff_flag_inc_idx[sxy != 0][prev_sbf]], sig_coeff_flag_ctx, ((uint32_t)i == last_subblock_pos), num, sig_coeff_flags, sxy);
 			if (num_coeff == 0) {
 				break;
 			}
@@ -2225,8 +2541,16 @@ static void residual_coding(h265d_ctu_t& dst, dec_bits& st, uint32_t size_log2,
 		}
 		num = 15;
 	} while (0 <= --i);
+	if (dst.stats || (colour && dst.luma_only)) {
+		return;
+	}
+	if (dst.scaling_table) {
+		int matrix_id = (size_log2 == 5) ? !is_intra : (colour + (is_intra ? 0 : 3));
+		const int16_t* factor = dst.scaling_table->factor + scaling_factor_offset[size_log2 - 2] + ((matrix_id * 6 + scaling_info.qp % 6) << (size_log2 * 2));
+		scaling_list_apply(dst.coeff_buf, factor, size_log2, scaling_info.qp, xy_pos_sum);
+	}
 	if (!transform_skip) {
-		transform(dst.coeff_buf, size_log2, frame, dst.size->stride, colour, xy_pos_sum, is_intra);
+		transform(dst.coeff_buf, size_log2, frame, dst.size->stride, colour, xy_pos_sum, is_intra && (colour == 0));
 	} else {
 		skip_transform(dst.coeff_buf, frame, dst.size->stride, colour, xy_pos_sum);
 	}
@@ -2261,10 +2585,10 @@ static void transform_unit(h265d_ctu_t& dst, dec_bits& st, uint32_t size_log2, u
 		int order = (is_intra && (size_log2 == 2)) ? order_map(dst.order_chroma) : 0;
 		int offset_chroma = (offset_y >> 1) * stride + offset_x;
 		if (cbf & 4) {
-			residual_coding(dst, st, size_log2, 1, pred_idx, dst.chroma + offset_chroma, order, false);
+			residual_coding(dst, st, size_log2, 1, pred_idx, dst.chroma + offset_chroma, order, is_intra);
 		}
 		if (cbf & 2) {
-			residual_coding(dst, st, size_log2, 2, pred_idx, dst.chroma + offset_chroma, order, false);
+			residual_coding(dst, st, size_log2, 2, pred_idx, dst.chroma + offset_chroma, order, is_intra);
 		}
 	}
 }
@@ -2388,12 +2712,31 @@ static inline void intra_dc_filter_both(uint8_t* dst, uint32_t cnt, int stride,
 	intra_dc_filter_left(dst + stride, cnt - 1, stride, dc);
 }
 
+#ifdef X86ASM
+void intra_angular_x86(uint8_t* dst, int stride, const uint8_t* ref, const int8_t* coef, const int8_t* inc, int size_log2, int unit, bool transposed);
+void intra_planar_x86(uint8_t* dst, int stride, const uint8_t* ref, int size_log2, int unit);
+uint32_t intra_dc_x86(uint8_t* dst, int stride, int size_log2, int unit);
+void intra_ref_filter_x86(uint8_t* dst, const uint8_t* line, int len);
+#endif
+
 template <int N>
-static inline void intra_pred_dc(uint8_t* dst, int size_log2, int stride, int valid_x, int valid_y) {
-	uint32_t size = 1 << size_log2;
+static inline uint32_t intra_pred_dc_fill(uint8_t* dst, int size_log2, int stride, int valid_x, int valid_y) {
+	int size = 1 << size_log2;
+#ifdef X86ASM
+	if ((size <= valid_x) && (size <= valid_y)) {
+		return intra_dc_x86(dst, stride, size_log2, N);
+	}
+#endif
 	uint32_t dc = sum_edge<N>(dst, size, valid_x, valid_y, N, stride) + sum_edge<N>(dst, size, valid_y, valid_x, stride, N) + (((N == 1) ? 1 : 0x00010001) << size_log2);
 	dc = dc >> (size_log2 + 1);
 	fill_dc<N>(dst, size_log2, stride, dc);
+	return dc;
+}
+
+template <int N>
+static inline void intra_pred_dc(uint8_t* dst, int size_log2, int stride, int valid_x, int valid_y) {
+	uint32_t size = 1 << size_log2;
+	uint32_t dc = intra_pred_dc_fill<N>(dst, size_log2, stride, valid_x, valid_y);
 	if ((N == 1) && (size < 32)) {
 		if (0 < valid_x) {
 			if (0 < valid_y) {
@@ -2653,9 +2996,13 @@ static void intra_pred_planar(uint8_t* dst, int size_log2, int stride, int valid
 		} else {
 			fillmem<N>(&neighbour[((1 << size_log2) + 1) * N], dst - N, (1 << size_log2) + 1);
 		}
+#ifdef X86ASM
+		intra_planar_x86(dst, stride, neighbour, size_log2, N);
+#else
 		for (int i = 0; i < N; ++i) {
 			intra_pred_planar_core<N>(dst + i, neighbour + i, size_log2, stride);
 		}
+#endif
 	}
 }
 
@@ -2712,6 +3059,62 @@ static void intra_pred_get_ref(uint8_t dst[], const uint8_t src[], int size_log2
 	}
 }
 
+/** Reference samples when 2 * size samples of both sides are available, where no substitution is needed.
+ */
+template <int N>
+static void intra_pred_get_ref_raw_avail(uint8_t dst[], const uint8_t src[], int main_stride, int sub_stride, const int8_t* pos_tbl) {
+	int extra_len = *pos_tbl++;
+	const uint8_t* sub = src - main_stride;
+	for (int i = 0; i < extra_len; ++i) {
+		memcpy(dst, sub + pos_tbl[i] * sub_stride, N);
+		dst += N;
+	}
+	int base_len = pos_tbl[extra_len + 1];
+	src = src - sub_stride + pos_tbl[extra_len] * main_stride;
+	if (main_stride == N) {
+		memcpy(dst, src, base_len * N);
+	} else if (N == 1) {
+		memcpy_from_vertical(dst, src, base_len, main_stride);
+	} else {
+		memcpy_from_vertical(reinterpret_cast<uint16_t*>(dst), src, base_len, main_stride);
+	}
+}
+
+static void intra_pred_get_ref_filtered_avail(uint8_t dst[], const uint8_t src[], int size_log2, int main_stride, int sub_stride, const int8_t* pos_tbl) {
+	int extra_len = *pos_tbl++;
+	const uint8_t* sub = src - main_stride;
+	for (int i = 0; i < extra_len; ++i) {
+		*dst++ = get_pix_filtered()(sub, pos_tbl[i], -1, 2 << size_log2, sub_stride);
+	}
+	int base_pos = pos_tbl[extra_len];
+	int base_len = pos_tbl[extra_len + 1];
+	int end = MINV(base_pos + base_len + 1, 2 << size_log2);
+	uint8_t line[2 * 32 + 2 + 8];
+	src -= sub_stride;
+	line[0] = (base_pos < 0) ? src[sub_stride - main_stride] : src[(base_pos - 1) * main_stride];
+	if (main_stride == 1) {
+		memcpy(line + 1, src + base_pos, end - base_pos);
+	} else {
+		memcpy_from_vertical(line + 1, src + base_pos * main_stride, end - base_pos, main_stride);
+	}
+	int last = end - base_pos;
+	line[last + 1] = line[last];
+#ifdef X86ASM
+	intra_ref_filter_x86(dst, line, base_len);
+#else
+	for (int i = 0; i < base_len; ++i) {
+		dst[i] = (line[i] + line[i + 1] * 2 + line[i + 2] + 2) >> 2;
+	}
+#endif
+	if (last == base_len) {
+		dst[base_len - 1] = line[base_len];
+	}
+}
+
+static inline bool intra_pred_ref_available(int size_log2, int valid_x, int valid_y) {
+	return ((2 << size_log2) <= valid_x) && ((2 << size_log2) <= valid_y);
+}
+
 static void intra_pred_get_ref_filtered_strong(uint8_t dst[], const uint8_t src[], int size_log2, int stride, int valid_x, int valid_y, uint32_t mode) {
 	const int8_t* pos_tbl = intra_pred_pos[mode][size_log2 - 2];
 	if (mode < 16) {
@@ -2723,7 +3126,13 @@ static void intra_pred_get_ref_filtered_strong(uint8_t dst[], const uint8_t src[
 
 static void intra_pred_get_ref_filtered(uint8_t dst[], const uint8_t src[], int size_log2, int stride, int valid_x, int valid_y, uint32_t mode) {
 	const int8_t* pos_tbl = intra_pred_pos[mode][size_log2 - 2];
-	if (mode < 16) {
+	if (intra_pred_ref_available(size_log2, valid_x, valid_y)) {
+		if (mode < 16) {
+			intra_pred_get_ref_filtered_avail(dst, src, size_log2, stride, 1, pos_tbl);
+		} else {
+			intra_pred_get_ref_filtered_avail(dst, src, size_log2, 1, stride, pos_tbl);
+		}
+	} else if (mode < 16) {
 		intra_pred_get_ref<1>(dst, src, size_log2, stride, 1, valid_y, valid_x, pos_tbl, get_pix_filtered(), get_multipix_filtered());
 	} else {
 		intra_pred_get_ref<1>(dst, src, size_log2, 1, stride, valid_x, valid_y, pos_tbl, get_pix_filtered(), get_multipix_filtered());
@@ -2733,7 +3142,13 @@ static void intra_pred_get_ref_filtered(uint8_t dst[], const uint8_t src[], int
 template <int N>
 static void intra_pred_get_ref_raw(uint8_t dst[], const uint8_t src[], int size_log2, int stride, int valid_x, int valid_y, uint32_t mode) {
 	const int8_t* pos_tbl = intra_pred_pos[mode][size_log2 - 2];
-	if (mode < 16) {
+	if (intra_pred_ref_available(size_log2, valid_x, valid_y)) {
+		if (mode < 16) {
+			intra_pred_get_ref_raw_avail<N>(dst, src, stride, N, pos_tbl);
+		} else {
+			intra_pred_get_ref_raw_avail<N>(dst, src, N, stride, pos_tbl);
+		}
+	} else if (mode < 16) {
 		intra_pred_get_ref<N>(dst, src, size_log2, stride, N, valid_y, valid_x, pos_tbl, get_pix_raw<N>(), get_multipix_raw<N>());
 	} else {
 		intra_pred_get_ref<N>(dst, src, size_log2, N, stride, valid_x, valid_y, pos_tbl, get_pix_raw<N>(), get_multipix_raw<N>());
@@ -2789,7 +3204,7 @@ static void intra_pred_angular(uint8_t* dst, int size_log2, int stride, int vali
 	static const int8_t filter_thr[16] = {
 		56, 48, 48, 48, 48, 48, 48, 32, 0, 32, 48, 48, 48, 48, 48, 48
 	};
-	uint8_t neighbour[64];
+	uint8_t neighbour[64 + 32];
 	if ((N == 1) && (filter_thr[mode & 15] & (1 << size_log2))) {
 		if (intra_pred_detect_strong_filter(strong_enabled, dst, size_log2, stride, valid_x, valid_y)) {
 			intra_pred_get_ref_filtered_strong(neighbour, dst, size_log2, stride, valid_x, valid_y, mode);
@@ -2800,11 +3215,15 @@ static void intra_pred_angular(uint8_t* dst, int size_log2, int stride, int vali
 		intra_pred_get_ref_raw<N>(neighbour, dst, size_log2, stride, valid_x, valid_y, mode);
 	}
 	if (mode & 7) {
+#ifdef X86ASM
+		intra_angular_x86(dst, stride, neighbour, intra_pred_coef[mode][0], intra_pred_coef[mode][1], size_log2, N, mode < 16);
+#else
 		if (mode < 16) {
 			intra_pred_angular_filter<N>(dst, neighbour, size_log2, stride, N, mode, Load, Store);
 		} else {
 			intra_pred_angular_filter<N>(dst, neighbour, size_log2, N, stride, mode, Load, Store);
 		}
+#endif
 	} else {
 		intra_pred_diagonal<N>(dst, neighbour, size_log2, stride, mode);
 	}
@@ -2904,9 +3323,12 @@ static inline void intra_prediction_dispatch(uint8_t* dst, int size_log2, int st
 }
 
 static inline void intra_prediction(const h265d_ctu_t& dst, int size_log2, int offset_x, int valid_x, int offset_y, int valid_y, int pred_idx) {
+	if (dst.stats) {
+		return;
+	}
 	uint32_t stride = dst.size->stride;
 	intra_prediction_dispatch<1>(dst.luma + offset_y * stride + offset_x, size_log2, stride, valid_x, valid_y, dst.order_luma[pred_idx], dst.sps->strong_intra_smoothing_enabled_flag, load_1pix(), store_1pix());
-	if (size_log2 == 2) {
+	if ((size_log2 == 2) || dst.luma_only) {
 		return;
 	}
 	intra_prediction_dispatch<2>(dst.chroma + (offset_y >> 1) * stride + offset_x, size_log2 - 1, stride, valid_x >> 1, valid_y >> 1, dst.order_chroma, false, load_2pix(), store_2pix());
@@ -2984,9 +3406,14 @@ static inline void qp_to_scale(h265d_scaling_info_t dst[], uint32_t qpy, const i
 		5120, 5760, 6528, 7296, 8192, 9216,
 		10240, 11520, 13056, 14592
 	};
+	int qpc0 = qpi_to_qpc(qpy + cbcr_delta[0]);
+	int qpc1 = qpi_to_qpc(qpy + cbcr_delta[1]);
 	dst[0].scale = qp_scale[qpy];
-	dst[1].scale = qp_scale[qpi_to_qpc(qpy + cbcr_delta[0])];
-	dst[2].scale = qp_scale[qpi_to_qpc(qpy + cbcr_delta[1])];
+	dst[0].qp = qpy;
+	dst[1].scale = qp_scale[qpc0];
+	dst[1].qp = qpc0;
+	dst[2].scale = qp_scale[qpc1];
+	dst[2].qp = qpc1;
 }
 
 static inline void qpy_update(h265d_ctu_t& dst, uint8_t qp_left[], uint8_t qp_top[], int32_t qp_delta) {
@@ -3036,7 +3463,7 @@ static void transform_tree(h265d_ctu_t& dst, dec_bits& st, int size_log2, uint32
 			pinc = 0;
 		}
 		size_log2 -= 1;
-		if (is_intra && (size_log2 == 2)) {
+		if (is_intra && (size_log2 == 2) && !dst.stats && !dst.luma_only) {
 			uint32_t stride = dst.size->stride;
 			intra_prediction_dispatch<2>(dst.chroma + (offset_y >> 1) * stride + offset_x, size_log2, stride, (unavail & 2) ? -1 : (valid_x >> 1), (unavail & 1) ? -1 : (valid_y >> 1), dst.order_chroma, false, load_2pix(), store_2pix());
 		}
@@ -3065,9 +3492,9 @@ static void transform_tree(h265d_ctu_t& dst, dec_bits& st, int size_log2, uint32
 			transform_unit(dst, st, size_log2, cbf, idx, pred_idx, offset_x, offset_y, is_intra);
 		}
 		if (is_intra) {
-			dst.deblocking.record_tu_intra(dst.qpy, size_log2, offset_x, offset_y, unavail);
+			dst.deblocking.record_tu_intra(dst.qpy, size_log2, offset_x, offset_y);
 		} else {
-			dst.deblocking.record_tu(dst.qpy, size_log2, offset_x, offset_y, unavail, cbf & 1, left, top);
+			dst.deblocking.record_tu(dst.qpy, size_log2, offset_x, offset_y, cbf & 1, left, top);
 			cu_inter_tu_fill(left, top, cbf, 1 << (size_log2 - 2));
 		}
 		qpy_fill(&dst.qp_history[0][offset_y >> 2], &dst.qp_history[1][offset_x >> 2], dst.qpy, 1 << (size_log2 - 2));
@@ -3445,18 +3872,19 @@ static void interp_luma(T0* dst, int16_t* tmp, const T1* ref, int src_stride, in
 	}
 }
 
+/** Address of Cb-Cr pair of interleaved chroma.
+ */
 struct load2pixumv {
 	template <typename T0>
-	uint64_t operator()(const T0* in, int xpos, int xpos_max) const {
-		int pos = CLAMPX(xpos, xpos_max) * 2;
-		return ((uint64_t)in[pos] << 32) | in[pos + 1];
+	const T0* operator()(const T0* in, int xpos, int xpos_max) const {
+		return in + CLAMPX(xpos, xpos_max) * 2;
 	}
 };
 
 struct load2pix {
 	template <typename T0>
-	uint64_t operator()(const T0* in, int xpos, int xpos_max) const {
-		return ((uint64_t)in[xpos * 2] << 32) | in[xpos * 2 + 1];
+	const T0* operator()(const T0* in, int xpos, int xpos_max) const {
+		return in + xpos * 2;
 	}
 };
 
@@ -3471,18 +3899,18 @@ static const int8_t inter_chroma_coeff[][4] = {
 	{2, 10, 58, 2}
 };
 
+/** Cb and Cr are filtered separately, each horizontal intermediate taking an int32_t.
+ */
 template <typename T0, typename F0, typename F1>
-static inline void interp_chroma1hline_base(const T0* ref, uint64_t* out, int width, int src_ystride, int xpos, int ypos, int xpos_max, int ypos_max, int c0, int c1, int c2, int c3, F0 AddressX, F1 AddressY) {
+static inline void interp_chroma1hline_base(const T0* ref, int32_t* out, int width, int src_ystride, int xpos, int ypos, int xpos_max, int ypos_max, int c0, int c1, int c2, int c3, F0 AddressX, F1 AddressY) {
 	const T0* in = ref + src_ystride * AddressY(ypos, ypos_max);
-	uint64_t a0, a1, a2;
-	a0 = AddressX(in, xpos, xpos_max);
-	a1 = AddressX(in, xpos + 1, xpos_max);
-	a2 = AddressX(in, xpos + 2, xpos_max);
+	const T0* a0 = AddressX(in, xpos, xpos_max);
+	const T0* a1 = AddressX(in, xpos + 1, xpos_max);
+	const T0* a2 = AddressX(in, xpos + 2, xpos_max);
 	for (int x = 0; x < width; ++x) {
-		uint64_t a3;
-		a3 = AddressX(in, x + xpos + 3, xpos_max);
-		uint64_t v = ((((c1 * a1 + c2 * a2) | 0x80000000) - (c0 * a0 + c3 * a3)) >> 0) & ~0xf8000000LLU;
-		out[x] = v;
+		const T0* a3 = AddressX(in, x + xpos + 3, xpos_max);
+		out[x * 2] = c1 * a1[0] + c2 * a2[0] - c0 * a0[0] - c3 * a3[0];
+		out[x * 2 + 1] = c1 * a1[1] + c2 * a2[1] - c0 * a0[1] - c3 * a3[1];
 		a0 = a1;
 		a1 = a2;
 		a2 = a3;
@@ -3490,20 +3918,20 @@ static inline void interp_chroma1hline_base(const T0* ref, uint64_t* out, int wi
 }
 
 template <typename T0, typename T1, typename F0, typename F1, typename F2>
-static inline void interp_chroma1hline_vert_base(const T0* ref, uint64_t* hlines[], T1* out, int width, int src_ystride, int xpos, int ypos, int xpos_max, int ypos_max, int c0, int c1, int c2, int c3, int fracy, int shift, F0 AddressX, F1 AddressY, F2 Store) {
+static inline void interp_chroma1hline_vert_base(const T0* ref, int32_t* hlines[], T1* out, int width, int src_ystride, int xpos, int ypos, int xpos_max, int ypos_max, int c0, int c1, int c2, int c3, int fracy, int shift, F0 AddressX, F1 AddressY, F2 Store) {
 	const T0* in = ref + src_ystride * AddressY(ypos, ypos_max);
-	uint64_t a0, a1, a2;
-	a0 = AddressX(in, xpos, xpos_max);
-	a1 = AddressX(in, xpos + 1, xpos_max);
-	a2 = AddressX(in, xpos + 2, xpos_max);
+	const T0* a0 = AddressX(in, xpos, xpos_max);
+	const T0* a1 = AddressX(in, xpos + 1, xpos_max);
+	const T0* a2 = AddressX(in, xpos + 2, xpos_max);
 	const int8_t* coef = inter_chroma_coeff[fracy];
-	for (int x = 0; x < width; ++x) {
-		uint64_t a3 = AddressX(in, x + xpos + 3, xpos_max);
-		uint64_t v = ((((c1 * a1 + c2 * a2) | 0x80000000) - (c0 * a0 + c3 * a3)) >> 0) & ~0xf8000000LLU;
-		uint64_t w = ((hlines[1][x] * coef[1]  + hlines[2][x] * coef[2]) | 0x80000000) - (hlines[0][x] * coef[0] + v * coef[3]);
-		Store(out[x * 2], (int32_t)(w >> 32), shift);
-		Store(out[x * 2 + 1], (int32_t)((uint32_t)w ^ 0x80000000U), shift);
-		hlines[0][x] = v;
+	for (int x = 0; x < width * 2; x += 2) {
+		const T0* a3 = AddressX(in, (x >> 1) + xpos + 3, xpos_max);
+		for (int c = 0; c < 2; ++c) {
+			int32_t v = c1 * a1[c] + c2 * a2[c] - c0 * a0[c] - c3 * a3[c];
+			int32_t w = hlines[1][x + c] * coef[1] + hlines[2][x + c] * coef[2] - hlines[0][x + c] * coef[0] - v * coef[3];
+			Store(out[x + c], w, shift);
+			hlines[0][x + c] = v;
+		}
 		a0 = a1;
 		a1 = a2;
 		a2 = a3;
@@ -3511,14 +3939,14 @@ static inline void interp_chroma1hline_vert_base(const T0* ref, uint64_t* hlines
 }
 
 template <typename T0, typename T1, typename F0, typename F1, typename F2>
-static inline void interp_chroma_base(const T0* in, uint64_t tmp[], T1* out, int width, int height, int src_stride, int dst_stride, int xpos, int ypos, int xmax, int ymax, int fracx, int fracy, int shift, F0 AddressX, F1 AddressY, F2 Store) {
+static inline void interp_chroma_base(const T0* in, int32_t tmp[], T1* out, int width, int height, int src_stride, int dst_stride, int xpos, int ypos, int xmax, int ymax, int fracx, int fracy, int shift, F0 AddressX, F1 AddressY, F2 Store) {
 	int c0 = inter_chroma_coeff[fracx][0];
 	int c1 = inter_chroma_coeff[fracx][1];
 	int c2 = inter_chroma_coeff[fracx][2];
 	int c3 = inter_chroma_coeff[fracx][3];
-	uint64_t* hlines[3];
+	int32_t* hlines[3];
 	for (int y = 0; y < 3; ++y) {
-		uint64_t* t = tmp + y * width;
+		int32_t* t = tmp + y * width * 2;
 		hlines[y] = t;
 		interp_chroma1hline_base(in, t, width, src_stride, xpos, ypos + y, xmax, ymax, c0, c1, c2, c3, AddressX, AddressY);
 	}
@@ -3530,7 +3958,7 @@ static inline void interp_chroma_base(const T0* in, uint64_t tmp[], T1* out, int
 }
 
 template <typename T, typename F>
-static void interp_chroma(T* dst, uint64_t* tmp, const uint8_t* ref, int src_stride, int dst_stride, int width, int height, int xpos, int ypos, int xmax, int ymax, const int16_t mvxy[], int shift, F Store) {
+static void interp_chroma(T* dst, int32_t* tmp, const uint8_t* ref, int src_stride, int dst_stride, int width, int height, int xpos, int ypos, int xmax, int ymax, const int16_t mvxy[], int shift, F Store) {
 	int mvx = mvxy[0];
 	int mvy = mvxy[1];
 	int mvxint = mvx >> 3;
@@ -3548,17 +3976,121 @@ static void interp_chroma(T* dst, uint64_t* tmp, const uint8_t* ref, int src_str
 	}
 }
 
+/** Wait until a frame decoded by another frame thread has its first rows CTU rows completed.
+ * Only pictures decoded by frame threads have frame_progress.
+ */
+static inline void frame_wait_rows(h265d_frame_info_t& frm, int frame_idx, int32_t rows) {
+#ifdef M2D_THREADS
+	if ((static_cast<unsigned>(frame_idx) < static_cast<unsigned>(H265D_MAX_FRAME_NUM)) && (frame_idx != frm.index) && (frm.rows_ready[frame_idx] < rows)) {
+		frm.frame_progress->wait(frame_idx, rows);
+		frm.rows_ready[frame_idx] = rows;
+	}
+#endif
+}
+
+/** Co-located motion vectors are looked up within current CTU row.
+ */
+static inline void frame_wait_colpic(h265d_ctu_t& ctu) {
+	const h265d_slice_header_body_t& header = ctu.slice_header->body;
+	if (ctu.frame_info.frame_progress && header.slice_temporal_mvp_enabled_flag && (header.slice_type < 2)) {
+		frame_wait_rows(ctu.frame_info, header.ref_list[header.colocated_from_l0_flag ^ 1][header.collocated_ref_idx].frame_idx, ctu.pos_y + 1);
+	}
+}
+
+/** Reference picture of a prediction unit, whose referred rows are waited for when decoded by another frame thread.
+ */
+static const m2d_frame_t& inter_pred_ref(h265d_ctu_t& ctu, int lx, int ref_idx, int ypos, int height, const int16_t mvxy[]) {
+	int frame_idx = ctu.slice_header->body.ref_list[lx][ref_idx].frame_idx;
+	if (ctu.frame_info.frame_progress) {
+		int bottom = CLIP3(0, static_cast<int>(ctu.sps->pic_height_in_luma_samples) - 1, ypos + height + (mvxy[1] >> 2) + 4);
+		frame_wait_rows(ctu.frame_info, frame_idx, (bottom >> ctu.size->size_log2) + 1);
+	}
+	return ctu.frame_info.frames[frame_idx];
+}
+
 template <typename T, typename F0>
 static void inter_pred_onedir(h265d_ctu_t& ctu, T* dst0, T* dst1, int offset_x, int offset_y, int width, int height, int dst_stride, int lx, int ref_idx, const int16_t mvxy[], int shift, F0 Store) {
+	if (ctu.stats) {
+		return;
+	}
 	int src_stride = ctu.size->stride;
 	int xpos = (ctu.pos_x << ctu.size->size_log2) + offset_x;
 	int ypos = (ctu.pos_y << ctu.size->size_log2) + offset_y;
-	const m2d_frame_t& ref = ctu.frame_info.frames[ctu.slice_header->body.ref_list[lx][ref_idx].frame_idx];
+	const m2d_frame_t& ref = inter_pred_ref(ctu, lx, ref_idx, ypos, height, mvxy);
 	interp_luma(dst0, ctu.coeff_buf, ref.luma, src_stride, dst_stride, width, height, xpos, ypos, ctu.sps->pic_width_in_luma_samples, ctu.sps->pic_height_in_luma_samples, mvxy, shift, Store);
-	interp_chroma(dst1, (uint64_t*)(((uintptr_t)ctu.coeff_buf + 63) & ~63), ref.chroma, src_stride, dst_stride, width, height, xpos, ypos, ctu.sps->pic_width_in_luma_samples, ctu.sps->pic_height_in_luma_samples, mvxy, shift, Store);
+	if (ctu.luma_only) {
+		return;
+	}
+	interp_chroma(dst1, (int32_t*)(((uintptr_t)ctu.coeff_buf + 63) & ~63), ref.chroma, src_stride, dst_stride, width, height, xpos, ypos, ctu.sps->pic_width_in_luma_samples, ctu.sps->pic_height_in_luma_samples, mvxy, shift, Store);
 }
 
-// FIXME: to be eliminated
+/** Call func(info, blk) for each 8x8 block of side data covered by a block of current CTU.
+ */
+template <typename F>
+static void mb_info_each8x8(h265d_ctu_t& ctu, int offset_x, int offset_y, int width, int height, F func) {
+	int stride = mb_info_width(*ctu.sps);
+	int x0 = (ctu.pos_x << ctu.size->size_log2) + offset_x;
+	int y0 = (ctu.pos_y << ctu.size->size_log2) + offset_y;
+	for (int y = y0 & ~7; y < y0 + height; y += 8) {
+		for (int x = x0 & ~7; x < x0 + width; x += 8) {
+			func(ctu.mb_info[(y >> 4) * stride + (x >> 4)], ((y >> 2) & 2) | ((x >> 3) & 1));
+		}
+	}
+}
+
+struct mb_info_pu_t {
+	int ref0_, ref1_;
+	const int16_t (*mvxy_)[2];
+	mb_info_pu_t(int ref0, int ref1, const int16_t mvxy[][2]) : ref0_(ref0), ref1_(ref1), mvxy_(mvxy) {}
+	void operator()(m2d_mb_info_t& info, int blk) const {
+		m2d_mb_info_mv(&info, blk, 0, ref0_, mvxy_[0]);
+		m2d_mb_info_mv(&info, blk, 1, ref1_, mvxy_[1]);
+	}
+};
+
+struct mb_info_cu_t {
+	int type_, qp_, cbf_;
+	mb_info_cu_t(int type, int qp, int cbf) : type_(type), qp_(qp), cbf_(cbf) {}
+	void operator()(m2d_mb_info_t& info, int blk) const {
+		static const int16_t zero_mv[2] = {0, 0};
+		m2d_mb_info_set(&info, type_, qp_, cbf_);
+		if (type_ == M2D_MBTYPE_INTRA) {
+			m2d_mb_info_mv(&info, blk, 0, -1, zero_mv);
+			m2d_mb_info_mv(&info, blk, 1, -1, zero_mv);
+		}
+	}
+};
+
+/** Record a prediction unit of current CU for analysis mode and side data.
+ */
+static void stats_pu(h265d_ctu_t& ctu, int offset_x, int offset_y, int width, int height, int ref0, int ref1, const int16_t mvxy[][2]) {
+	if ((0 <= ref0) && (0 <= ref1)) {
+		ctu.stats_cu_type = M2D_MBTYPE_BI;
+	}
+	if (ctu.stats) {
+		if (0 <= ref0) {
+			m2d_stats_mv(ctu.stats, mvxy[0]);
+		}
+		if (0 <= ref1) {
+			m2d_stats_mv(ctu.stats, mvxy[1]);
+		}
+	}
+	if (ctu.mb_info) {
+		mb_info_each8x8(ctu, offset_x, offset_y, width, height, mb_info_pu_t(ref0, ref1, mvxy));
+	}
+}
+
+typedef enum {
+	INTER_PRED_UNI,
+	INTER_PRED_BI0,
+	INTER_PRED_BI1
+} h265d_inter_pred_mode_t;
+
+#ifdef X86ASM
+void interp_luma_x86(const uint8_t* ref, int src_stride, int xpos, int ypos, int xmax, int ymax, int fracx, int fracy, int width, int height, uint8_t* dst, int dst_stride, int16_t* pred, int mode);
+void interp_chroma_x86(const uint8_t* ref, int src_stride, int xpos, int ypos, int xmax, int ymax, int fracx, int fracy, int width, int height, uint8_t* dst, int dst_stride, int16_t* pred, int mode);
+#else
+// FIXME: to be eliminated
 static void writeback_bidir(const int16_t src[], uint8_t dst[], int stride, int width, int height) {
 	for (int y = 0; y < height; ++y) {
 		const int16_t* s0 = src + y * width;
@@ -3568,27 +4100,68 @@ static void writeback_bidir(const int16_t src[], uint8_t dst[], int stride, int
 		}
 	}
 }
+#endif
+
+/** Uni-prediction is written to frame directly.
+ * Bi-prediction keeps first direction in pred0 and pred1 (width samples per line),
+ * then second direction is averaged with them into frame.
+ */
+static void inter_pred(h265d_ctu_t& ctu, int16_t* pred0, int16_t* pred1, int offset_x, int offset_y, int width, int height, int lx, int ref_idx, const int16_t mvxy[], int mode) {
+	if (ctu.stats) {
+		return;
+	}
+	int stride = ctu.size->stride;
+	uint8_t* luma = ctu.luma + stride * offset_y + offset_x;
+	uint8_t* chroma = ctu.chroma + stride * (offset_y >> 1) + offset_x;
+#ifdef X86ASM
+	int xpos = (ctu.pos_x << ctu.size->size_log2) + offset_x;
+	int ypos = (ctu.pos_y << ctu.size->size_log2) + offset_y;
+	int xmax = ctu.sps->pic_width_in_luma_samples;
+	int ymax = ctu.sps->pic_height_in_luma_samples;
+	const m2d_frame_t& ref = inter_pred_ref(ctu, lx, ref_idx, ypos, height, mvxy);
+	interp_luma_x86(ref.luma, stride, xpos + (mvxy[0] >> 2), ypos + (mvxy[1] >> 2), xmax, ymax, mvxy[0] & 3, mvxy[1] & 3, width, height, luma, stride, pred0, mode);
+	if (!ctu.luma_only) {
+		interp_chroma_x86(ref.chroma, stride, (xpos >> 1) + (mvxy[0] >> 3), (ypos >> 1) + (mvxy[1] >> 3), xmax >> 1, ymax >> 1, mvxy[0] & 7, mvxy[1] & 7, width >> 1, height >> 1, chroma, stride, pred1, mode);
+	}
+#else
+	switch (mode) {
+	case INTER_PRED_UNI:
+		inter_pred_onedir(ctu, luma, chroma, offset_x, offset_y, width, height, stride, lx, ref_idx, mvxy, 12, store_pix<1>());
+		break;
+	case INTER_PRED_BI0:
+		inter_pred_onedir(ctu, pred0, pred1, offset_x, offset_y, width, height, width, lx, ref_idx, mvxy, 6, store_pix<0>());
+		break;
+	default:
+		inter_pred_onedir(ctu, pred0, pred1, offset_x, offset_y, width, height, width, lx, ref_idx, mvxy, 6, add_store_pix());
+		writeback_bidir(pred0, luma, stride, width, height);
+		if (!ctu.luma_only) {
+			writeback_bidir(pred1, chroma, stride, width, height >> 1);
+		}
+		break;
+	}
+#endif
+}
 
 static void merge_pred(h265d_ctu_t& ctu, const pred_info_t& base, uint32_t unavail, int offset_x, int offset_y, int width, int height, h265d_neighbour_t* left, h265d_neighbour_t* top) {
 	int ref0 = base.ref_idx[0];
 	int ref1 = base.ref_idx[1];
-	int stride = ctu.size->stride;
 	bool no_bidir = false;
 	if (0 <= ref0) {
 		if ((0 <= ref1) && !(no_bidir = (width + height == 12))) {
 			int16_t dstbuf0[64 * 64];
 			int16_t dstbuf1[64 * 32];
-			inter_pred_onedir(ctu, dstbuf0, dstbuf1, offset_x, offset_y, width, height, width, 0, ref0, base.mvd[0], 6, store_pix<0>());
-			inter_pred_onedir(ctu, dstbuf0, dstbuf1, offset_x, offset_y, width, height, width, 1, ref1, base.mvd[1], 6, add_store_pix());
-			writeback_bidir(dstbuf0, ctu.luma + stride * offset_y + offset_x, stride, width, height);
-			writeback_bidir(dstbuf1, ctu.chroma + stride * (offset_y >> 1) + offset_x, stride, width, height >> 1);
+			inter_pred(ctu, dstbuf0, dstbuf1, offset_x, offset_y, width, height, 0, ref0, base.mvd[0], INTER_PRED_BI0);
+			inter_pred(ctu, dstbuf0, dstbuf1, offset_x, offset_y, width, height, 1, ref1, base.mvd[1], INTER_PRED_BI1);
 		} else {
-			inter_pred_onedir(ctu, ctu.luma + stride * offset_y + offset_x, ctu.chroma + stride * (offset_y >> 1) + offset_x, offset_x, offset_y, width, height, stride, 0, ref0, base.mvd[0], 12, store_pix<1>());
+			inter_pred(ctu, 0, 0, offset_x, offset_y, width, height, 0, ref0, base.mvd[0], INTER_PRED_UNI);
 		}
 	} else {
-		inter_pred_onedir(ctu, ctu.luma + stride * offset_y + offset_x, ctu.chroma + stride * (offset_y >> 1) + offset_x, offset_x, offset_y, width, height, stride, 1, ref1, base.mvd[1], 12, store_pix<1>());
+		inter_pred(ctu, 0, 0, offset_x, offset_y, width, height, 1, ref1, base.mvd[1], INTER_PRED_UNI);
+	}
+	ctu.deblocking.record_pu(ctu.qpy, width, height, offset_x, offset_y, left, top, ref0, no_bidir ? -1 : ref1, base.mvd);
+	if (ctu.stats || ctu.mb_info) {
+		stats_pu(ctu, offset_x, offset_y, width, height, ref0, no_bidir ? -1 : ref1, base.mvd);
 	}
-	ctu.deblocking.record_pu(ctu.qpy, width, height, offset_x, offset_y, unavail, left, top, ref0, no_bidir ? -1 : ref1, base.mvd);
 	copy_predinfo(left, height, base, no_bidir);
 	copy_predinfo(top, width, base, no_bidir);
 	ctu.colpics.fill(offset_x, offset_y, width, height, colpics_t::fill_inter(base.mvd, base.ref_idx[0], base.ref_idx[1]));
@@ -3652,7 +4225,12 @@ static bool add_colpic_candidate_merge(const h265d_ctu_t& ctu, pred_info_t& pred
 	if (col->pu_intra) {
 		return false;
 	}
-	return add_colpic_candidate(ctu, pred, col, 0, 0) && ((ctu.slice_header->body.slice_type != 0) || add_colpic_candidate(ctu, pred, col, 1, 0));
+	if (ctu.slice_header->body.slice_type != 0) {
+		pred.ref_idx[1] = -1;
+		memset(pred.mvd[1], 0, sizeof(pred.mvd[1]));
+		return add_colpic_candidate(ctu, pred, col, 0, 0);
+	}
+	return add_colpic_candidate(ctu, pred, col, 0, 0) && add_colpic_candidate(ctu, pred, col, 1, 0);
 }
 
 static void add_merge_combind_candidate(const h265d_ctu_t& ctu, pred_info_t list[], int& idx, int idx_max) {
@@ -3871,12 +4449,7 @@ static int pred_amvp_l0(h265d_ctu_t& ctu, dec_bits& st, int pred_idc, int16_t* b
 	mvd_coding(ctu.cabac, st, mvd);
 	int mvp_idx = mvp_lx_flag(ctu.cabac, st);
 	calc_mv(ctu, unavail, width, height, left, top, lefttop, 0, ref_idx, mvp_idx, mvd, col, mvxy);
-	if (pred_idc == 0) {
-		int stride = ctu.size->stride;
-		inter_pred_onedir(ctu, ctu.luma + stride * offset_y + offset_x, ctu.chroma + stride * (offset_y >> 1) + offset_x, offset_x, offset_y, width, height, stride, 0, ref_idx, mvxy, 12, store_pix<1>());
-	} else {
-		inter_pred_onedir(ctu, bidir_buf0, bidir_buf1, offset_x, offset_y, width, height, width, 0, ref_idx, mvxy, 6, store_pix<0>());
-	}
+	inter_pred(ctu, bidir_buf0, bidir_buf1, offset_x, offset_y, width, height, 0, ref_idx, mvxy, (pred_idc == 0) ? INTER_PRED_UNI : INTER_PRED_BI0);
 	return ref_idx;
 }
 
@@ -3890,15 +4463,7 @@ static int pred_amvp_l1(h265d_ctu_t& ctu, dec_bits& st, int pred_idc, int16_t* b
 	}
 	int mvp_idx = mvp_lx_flag(ctu.cabac, st);
 	calc_mv(ctu, unavail, width, height, left, top, lefttop, 1, ref_idx, mvp_idx, mvd, col, mvxy);
-	if (pred_idc == 1) {
-		int stride = ctu.size->stride;
-		inter_pred_onedir(ctu, ctu.luma + stride * offset_y + offset_x, ctu.chroma + stride * (offset_y >> 1) + offset_x, offset_x, offset_y, width, height, stride, 1, ref_idx, mvxy, 12, store_pix<1>());
-	} else {
-		inter_pred_onedir(ctu, bidir_buf0, bidir_buf1, offset_x, offset_y, width, height, width, 1, ref_idx, mvxy, 6, add_store_pix());
-		int stride = ctu.size->stride;
-		writeback_bidir(bidir_buf0, ctu.luma + stride * offset_y + offset_x, stride, width, height);
-		writeback_bidir(bidir_buf1, ctu.chroma + stride * (offset_y >> 1) + offset_x, stride, width, height >> 1);
-	}
+	inter_pred(ctu, bidir_buf0, bidir_buf1, offset_x, offset_y, width, height, 1, ref_idx, mvxy, (pred_idc == 1) ? INTER_PRED_UNI : INTER_PRED_BI1);
 	return ref_idx;
 }
 
@@ -3917,13 +4482,16 @@ static bool prediction_unit(h265d_ctu_t& ctu, dec_bits& st, int size_log2, uint3
 			pred_idc = 0;
 		}
 		const h265d_neighbour_t* col = ctu.slice_header->body.slice_temporal_mvp_enabled_flag ? ctu.colpics.get_ref(ctu.pos_x, ctu.pos_y, offset_x, offset_y, width, height) : 0;
-		if (col->pu_intra) {
+		if (col && col->pu_intra) {
 			col = 0;
 		}
-		int16_t mvxy[2][2];
+		int16_t mvxy[2][2] = {{0}};
 		int ref_idx0 = (pred_idc == 1) ? -1 : pred_amvp_l0(ctu, st, pred_idc, bidir_buf0, bidir_buf1, unavail, offset_x, offset_y, width, height, left, top, lefttop, col, mvxy[0]);
 		int ref_idx1 = (pred_idc == 0) ? -1 : pred_amvp_l1(ctu, st, pred_idc, bidir_buf0, bidir_buf1, unavail, offset_x, offset_y, width, height, left, top, lefttop, col, mvxy[1]);
-		ctu.deblocking.record_pu(ctu.qpy, width, height, offset_x, offset_y, unavail, left, top, ref_idx0, ref_idx1, mvxy);
+		ctu.deblocking.record_pu(ctu.qpy, width, height, offset_x, offset_y, left, top, ref_idx0, ref_idx1, mvxy);
+		if (ctu.stats || ctu.mb_info) {
+			stats_pu(ctu, offset_x, offset_y, width, height, ref_idx0, ref_idx1, mvxy);
+		}
 		fill_pred(left, height, top, width, ref_idx0, ref_idx1, mvxy);
 		ctu.colpics.fill(offset_x, offset_y, width, height, colpics_t::fill_inter(mvxy, ref_idx0, ref_idx1));
 		return false;
@@ -4053,6 +4621,8 @@ static void cu_header_intra(h265d_ctu_t& dst, dec_bits& st, int size_log2, h265d
 }
 
 static void pred_intra(h265d_ctu_t& dst, dec_bits& st, int size_log2, uint32_t unavail, int offset_x, int offset_y, int valid_x, int valid_y, h265d_neighbour_t* left, h265d_neighbour_t* top) {
+	dst.stats_cu_type = M2D_MBTYPE_INTRA;
+	dst.stats_cu_cbf = 1;
 	cu_header_intra(dst, st, size_log2, left, top);
 	dst.colpics.fill(offset_x, offset_y, 1 << size_log2, 1 << size_log2, colpics_t::fill_intra());
 	transform_tree(dst, st, size_log2, unavail, 0, 3, offset_x, valid_x, offset_y, valid_y, left, top, 0, 0, true);
@@ -4063,6 +4633,8 @@ static void pred_inter(h265d_ctu_t& dst, dec_bits& st, int size_log2, uint32_t u
 	if (skip) {
 		int len = 1 << size_log2;
 		prediction_unit_merge(dst, st, unavail, offset_x, offset_y, len, len, left, top, lefttop);
+		dst.stats_cu_type = M2D_MBTYPE_SKIP;
+		dst.stats_cu_cbf = 0;
 		cu_inter_skip_mode_fill(left, top, 1, 1 << (size_log2 - 2));
 		cu_inter_zerocoef_fill(left, top, 1 << (size_log2 - 2));
 	} else {
@@ -4071,7 +4643,8 @@ static void pred_inter(h265d_ctu_t& dst, dec_bits& st, int size_log2, uint32_t u
 		} else {
 			bool rqt_root_cbf_inferred;
 			h265d_inter_part_mode_t mode = prediction_unit_cases(dst, st, size_log2, unavail, offset_x, offset_y, valid_x, valid_y, left, top, lefttop, rqt_root_cbf_inferred);
-			if (rqt_root_cbf_inferred || rqt_root_cbf(dst.cabac, st)) {
+			dst.stats_cu_cbf = rqt_root_cbf_inferred || rqt_root_cbf(dst.cabac, st);
+			if (dst.stats_cu_cbf) {
 				zero_scan_order(dst);
 				dst.intra_split = (mode != PART_2Nx2N) && (dst.sps->max_transform_hierarchy_depth_inter == 0);
 				transform_tree(dst, st, size_log2, unavail, 0, 3, offset_x, valid_x, offset_y, valid_y, left, top, 0, 0, false);
@@ -4097,27 +4670,38 @@ static inline bool frame_boundary(int size_log2, int valid_x, int valid_y) {
 	return (valid_x < (1 << size_log2)) || (valid_y < (1 << size_log2));
 }
 
-static void quad_tree(h265d_ctu_t& dst, dec_bits& st, int size_log2, uint32_t unavail, int offset_x, int valid_x, int offset_y, int valid_y, h265d_neighbour_t* left, h265d_neighbour_t* top, const h265d_neighbour_t& lefttop) {
+/** Coding quadtree of CU size 1 << LOG2, instantiated down to 8x8 from each CTB size.
+ */
+template <int LOG2>
+static void quad_tree(h265d_ctu_t& dst, dec_bits& st, uint32_t unavail, int offset_x, int valid_x, int offset_y, int valid_y, h265d_neighbour_t* left, h265d_neighbour_t* top, const h265d_neighbour_t& lefttop) {
 	if ((valid_x <= 0) || (valid_y <= 0)) {
 		return;
 	}
-	if ((dst.size->size_log2_min < size_log2) && (frame_boundary(size_log2, valid_x, valid_y) || split_cu_flag(dst.cabac, st, size_log2, left, top))) {
-		size_log2 -= 1;
-		uint32_t block_len = 1 << size_log2;
-		uint32_t info_offset = 1 << (size_log2 - 2);
+	if ((3 < LOG2) && (dst.size->size_log2_min < LOG2) && (frame_boundary(LOG2, valid_x, valid_y) || split_cu_flag(dst.cabac, st, LOG2, left, top))) {
+		const int SUB_LOG2 = (3 < LOG2) ? LOG2 - 1 : 3;
+		const uint32_t block_len = 1 << SUB_LOG2;
+		const uint32_t info_offset = 1 << (SUB_LOG2 - 2);
 		h265d_neighbour_t lefttop1 = top[info_offset - 1];
 		h265d_neighbour_t lefttop2 = left[info_offset - 1];
-		quad_tree(dst, st, size_log2, avail4x4idx0(unavail), offset_x, valid_x, offset_y, valid_y, left, top, lefttop);
+		quad_tree<SUB_LOG2>(dst, st, avail4x4idx0(unavail), offset_x, valid_x, offset_y, valid_y, left, top, lefttop);
 		h265d_neighbour_t lefttop3 = left[info_offset - 1];
-		quad_tree(dst, st, size_log2, avail4x4idx1(unavail), offset_x + block_len, valid_x - block_len, offset_y, MINV(static_cast<uint32_t>(valid_y), block_len), left, top + info_offset, lefttop1);
-		quad_tree(dst, st, size_log2, avail4x4idx2(unavail), offset_x, MINV(static_cast<uint32_t>(valid_x), block_len * 2), offset_y + block_len, valid_y - block_len, left + info_offset, top, lefttop2);
-		quad_tree(dst, st, size_log2, avail4x4idx3(unavail), offset_x + block_len, MINV(static_cast<uint32_t>(valid_x - block_len), block_len), offset_y + block_len, MINV(static_cast<uint32_t>(valid_y - block_len), block_len), left + info_offset, top + info_offset, lefttop3);
+		quad_tree<SUB_LOG2>(dst, st, avail4x4idx1(unavail), offset_x + block_len, valid_x - block_len, offset_y, MINV(static_cast<uint32_t>(valid_y), block_len), left, top + info_offset, lefttop1);
+		quad_tree<SUB_LOG2>(dst, st, avail4x4idx2(unavail), offset_x, MINV(static_cast<uint32_t>(valid_x), block_len * 2), offset_y + block_len, valid_y - block_len, left + info_offset, top, lefttop2);
+		quad_tree<SUB_LOG2>(dst, st, avail4x4idx3(unavail), offset_x + block_len, MINV(static_cast<uint32_t>(valid_x - block_len), block_len), offset_y + block_len, MINV(static_cast<uint32_t>(valid_y - block_len), block_len), left + info_offset, top + info_offset, lefttop3);
 	} else {
-		coding_unit_header(dst, st, size_log2, unavail, left, top);
+		coding_unit_header(dst, st, LOG2, unavail, left, top);
+		dst.stats_cu_type = M2D_MBTYPE_INTER;
 		if (dst.slice_header->body.slice_type < 2) {
-			pred_inter(dst, st, size_log2, unavail, offset_x, offset_y, valid_x, valid_y, left, top, lefttop);
+			pred_inter(dst, st, LOG2, unavail, offset_x, offset_y, valid_x, valid_y, left, top, lefttop);
 		} else {
-			pred_intra(dst, st, size_log2, unavail, offset_x, offset_y, valid_x, valid_y, left, top);
+			pred_intra(dst, st, LOG2, unavail, offset_x, offset_y, valid_x, valid_y, left, top);
+		}
+		if (dst.stats) {
+			m2d_stats_mb(dst.stats, dst.stats_cu_type, dst.qpy, 1);
+		}
+		if (dst.mb_info) {
+			const int len = 1 << LOG2;
+			mb_info_each8x8(dst, offset_x, offset_y, len, len, mb_info_cu_t(dst.stats_cu_type, dst.qpy, dst.stats_cu_cbf));
 		}
 	}
 }
@@ -4217,7 +4801,7 @@ static const int8_t q_thr[54 - 16][2] = {
 	{58, 14}, {60, 16}, {62, 18}, {64, 20}, {64, 22}, {64, 24}
 };
 
-static inline void deblock_edge_luma(uint8_t* dst, int beta_qpy, int tc_qpy, int xofs, int stride) {
+static inline void deblock_edge_luma(uint8_t* dst, int beta, int tc, int xofs, int stride) {
 	const uint8_t* src3 = dst + stride * 3;
 	int dp0 = dst[xofs * 1] - 2 * dst[xofs * 2] + dst[xofs * 3];
 	int dq0 = dst[xofs * 4] - 2 * dst[xofs * 5] + dst[xofs * 6];
@@ -4230,9 +4814,7 @@ static inline void deblock_edge_luma(uint8_t* dst, int beta_qpy, int tc_qpy, int
 	int dpq0 = dp0 + dq0;
 	int dpq3 = dp3 + dq3;
 	int d = dpq0 + dpq3;
-	int beta = q_thr[beta_qpy][0];
 	if (d < beta) {
-		int tc = q_thr[tc_qpy][1];
 		if (dsam0(dpq0, dst[0], dst[xofs * 3], dst[xofs * 4], dst[xofs * 7], beta, tc) && dsam0(dpq3, src3[0], src3[xofs * 3], src3[xofs * 4], src3[xofs * 7], beta, tc)) {
 			deblock_filter2(dst, tc, stride, xofs);
 		} else {
@@ -4241,37 +4823,89 @@ static inline void deblock_edge_luma(uint8_t* dst, int beta_qpy, int tc_qpy, int
 	}
 }
 
-static inline void deblocking_edge_luma_block(const h265d_deblocking_strength_t& strength, int beta_offset, int tc_offset, uint8_t* dst, int xstride, int ystride) {
-	int str = strength.str;
-	if (str != 0) {
-		int qp = strength.qp;
+/** beta and tc of each 4-line segment, looked up once per CTU.
+ * Segments with beta == 0 are not filtered.
+ */
+static void deblocking_luma_param(const h265d_deblocking_strength_t str[], int num, int beta_offset, int tc_offset, int16_t beta[], int16_t tc[]) {
+	for (int i = 0; i < num; ++i) {
+		int strength = str[i].str;
+		int qp = str[i].qp;
 		int beta_qp = (beta_offset ? clip2(qp + beta_offset, 51) : qp) - 16;
-		if (0 <= beta_qp) {
-			int ofs = tc_offset + (str & 2);
-			int tc_qp = (ofs ? clip2(qp + ofs, 51) : qp) - 16;
-			if (0 <= tc_qp) {
-				deblock_edge_luma(dst, beta_qp, tc_qp, xstride, ystride);
-			}
+		int ofs = tc_offset + (strength & 2);
+		int tc_qp = (ofs ? clip2(qp + ofs, 51) : qp) - 16;
+		if ((strength != 0) && (0 <= beta_qp) && (0 <= tc_qp)) {
+			beta[i] = q_thr[beta_qp][0];
+			tc[i] = q_thr[tc_qp][1];
+		} else {
+			beta[i] = 0;
+			tc[i] = 0;
 		}
 	}
 }
 
-static void deblocking_vert_edge_luma_lines(const h265d_deblocking_strength_t str[], int beta_offset, int tc_offset, uint8_t* dst, int stride, int blknum, int edgenum) {
+#ifdef X86ASM
+void deblock_luma_vert_x86(uint8_t* dst, int stride, const int16_t beta[], const int16_t tc[], int segments);
+void deblock_luma_horiz_x86(uint8_t* dst, int stride, const int16_t beta[], const int16_t tc[], int segments);
+void deblock_chroma_vert_x86(uint8_t* dst, int stride, const int16_t tc[], int blocks);
+void deblock_chroma_horiz_x86(uint8_t* dst, int stride, const int16_t tc[], int blocks);
+#endif
+
+static void deblocking_vert_edge_luma_lines(const int16_t beta[], const int16_t tc[], uint8_t* dst, int stride, int blknum, int edgenum) {
+#ifdef X86ASM
+	for (int y = 0; y < blknum; y += 2) {
+		int segments = MINV(blknum - y, 2);
+		for (int x = 0; x < edgenum; ++x) {
+			int idx = y * edgenum + x;
+			int16_t b[2] = {beta[idx], 0};
+			int16_t t[2] = {tc[idx], 0};
+			if (segments == 2) {
+				b[1] = beta[idx + edgenum];
+				t[1] = tc[idx + edgenum];
+			}
+			/* segments without edge are neither loaded nor stored, as the first one may lie above the picture */
+			if (b[0]) {
+				deblock_luma_vert_x86(dst + x * 8, stride, b, t, b[1] ? segments : 1);
+			} else if (b[1]) {
+				deblock_luma_vert_x86(dst + x * 8 + stride * 4, stride, b + 1, t + 1, 1);
+			}
+		}
+		dst += stride * 8;
+	}
+#else
 	for (int y = 0; y < blknum; ++y) {
 		for (int x = 0; x < edgenum; ++x) {
-			deblocking_edge_luma_block(str[x], beta_offset, tc_offset, dst + x * 8, 1, stride);
+			if (beta[x]) {
+				deblock_edge_luma(dst + x * 8, beta[x], tc[x], 1, stride);
+			}
 		}
-		str += edgenum;
+		beta += edgenum;
+		tc += edgenum;
 		dst += stride * 4;
 	}
+#endif
 }
 
-static void deblocking_horiz_edge_luma_lines(const h265d_deblocking_strength_t str[], int beta_offset, int tc_offset, uint8_t* dst, int stride, int blknum, int edgenum) {
+static void deblocking_horiz_edge_luma_lines(const int16_t beta[], const int16_t tc[], uint8_t* dst, int stride, int blknum, int edgenum) {
 	for (int y = 0; y < edgenum; ++y) {
+#ifdef X86ASM
+		for (int x = 0; x < blknum; x += 2) {
+			int segments = MINV(blknum - x, 2);
+			int beta1 = (segments == 2) ? beta[x + 1] : 0;
+			if (beta[x]) {
+				deblock_luma_horiz_x86(dst + x * 4, stride, beta + x, tc + x, beta1 ? segments : 1);
+			} else if (beta1) {
+				deblock_luma_horiz_x86(dst + x * 4 + 4, stride, beta + x + 1, tc + x + 1, 1);
+			}
+		}
+#else
 		for (int x = 0; x < blknum; ++x) {
-			deblocking_edge_luma_block(str[x], beta_offset, tc_offset, dst + x * 4, stride, 1);
+			if (beta[x]) {
+				deblock_edge_luma(dst + x * 4, beta[x], tc[x], stride, 1);
+			}
 		}
-		str = str + edgenum * 2 + 1;
+#endif
+		beta += edgenum * 2 + 1;
+		tc += edgenum * 2 + 1;
 		dst += stride * 8;
 	}
 }
@@ -4292,12 +4926,16 @@ static inline int tc_qpc(int qp, int qpc_offset, int tc_offset) {
 	return clip2(qp + 2 + tc_offset, 53);
 }
 
-static inline void deblocking_edge_chroma_block(int qp, int pps_offset, int tc_offset, uint8_t* dst, int xofs, int stride) {
-	qp = tc_qpc(qp, pps_offset, tc_offset) - 16;
-	if (qp < 0) {
-		return;
+/** tc of each chroma block with boundary strength 2, and 0 for the others.
+ */
+static void deblocking_chroma_param(const h265d_deblocking_strength_t str[], int num, int qpc_offset, int tc_offset, int16_t tc[]) {
+	for (int i = 0; i < num; ++i) {
+		int qp = (str[i].str == 2) ? tc_qpc(str[i].qp, qpc_offset, tc_offset) - 16 : -1;
+		tc[i] = (0 <= qp) ? q_thr[qp][1] : 0;
 	}
-	int tc = q_thr[qp][1];
+}
+
+static inline void deblocking_edge_chroma_block(int tc, uint8_t* dst, int xofs, int stride) {
 	for (int x = 0; x < 2; ++x) {
 		int p1 = dst[0];
 		int p0 = dst[xofs * 1];
@@ -4312,31 +4950,79 @@ static inline void deblocking_edge_chroma_block(int qp, int pps_offset, int tc_o
 	}
 }
 
-static void deblocking_vert_edge_chroma_lines(const h265d_deblocking_strength_t str[], int cb_offset, int cr_offset, int tc_offset, uint8_t* dst, int stride, int blknum, int edgenum) {
+static void deblocking_vert_edge_chroma_lines(const int16_t tc_cb[], const int16_t tc_cr[], uint8_t* dst, int stride, int blknum, int edgenum) {
+#ifdef X86ASM
+	for (int y = 0; y < blknum; y += 4) {
+		int blocks = MINV(blknum - y, 4);
+		for (int x = 0; x < edgenum; ++x) {
+			int first = blocks;
+			int last = 0;
+			for (int i = 0; i < blocks; ++i) {
+				int idx = (y + i) * edgenum * 2 + x * 2;
+				if (tc_cb[idx] | tc_cr[idx]) {
+					first = MINV(first, i);
+					last = i + 1;
+				}
+			}
+			/* blocks outside the filtered ones are not touched, as the first one may lie above the picture */
+			int16_t t[8] = {0};
+			for (int i = first; i < last; ++i) {
+				int idx = (y + i) * edgenum * 2 + x * 2;
+				t[(i - first) * 2] = tc_cb[idx];
+				t[(i - first) * 2 + 1] = tc_cr[idx];
+			}
+			if (first < last) {
+				deblock_chroma_vert_x86(dst + x * 16 + stride * first * 2, stride, t, last - first);
+			}
+		}
+		dst += stride * 8;
+	}
+#else
 	for (int y = 0; y < blknum; ++y) {
 		for (int x = 0; x < edgenum; ++x) {
-			if (str[x * 2].str == 2) {
-				int qp = str[x * 2].qp;
-				deblocking_edge_chroma_block(qp, cb_offset, tc_offset, dst + x * 16, 2, stride);
-				deblocking_edge_chroma_block(qp, cr_offset, tc_offset, dst + x * 16 + 1, 2, stride);
+			if (tc_cb[x * 2]) {
+				deblocking_edge_chroma_block(tc_cb[x * 2], dst + x * 16, 2, stride);
+			}
+			if (tc_cr[x * 2]) {
+				deblocking_edge_chroma_block(tc_cr[x * 2], dst + x * 16 + 1, 2, stride);
 			}
 		}
-		str += edgenum * 2;
+		tc_cb += edgenum * 2;
+		tc_cr += edgenum * 2;
 		dst += stride * 2;
 	}
+#endif
 }
 
-static void deblocking_horiz_edge_chroma_lines(const h265d_deblocking_strength_t str[], int cb_offset, int cr_offset, int tc_offset, uint8_t* dst, int stride, int blknum, int edgenum) {
+static void deblocking_horiz_edge_chroma_lines(const int16_t tc_cb[], const int16_t tc_cr[], uint8_t* dst, int stride, int blknum, int edgenum) {
 	for (int y = 0; y < edgenum; ++y) {
+#ifdef X86ASM
+		for (int x = 0; x < blknum; x += 2) {
+			int blocks = MINV(blknum - x, 2);
+			int16_t t[6] = {tc_cb[x], tc_cr[x], 0, 0, 0, 0};
+			if (blocks == 2) {
+				t[2] = tc_cb[x + 1];
+				t[3] = tc_cr[x + 1];
+			}
+			if (t[0] | t[1]) {
+				deblock_chroma_horiz_x86(dst + x * 4, stride, t, (t[2] | t[3]) ? blocks : 1);
+			} else if (t[2] | t[3]) {
+				deblock_chroma_horiz_x86(dst + x * 4 + 4, stride, t + 2, 1);
+			}
+		}
+#else
 		for (int x = 0; x < blknum; ++x) {
-			if (str[x].str == 2) {
-				int qp = str[x].qp;
-				deblocking_edge_chroma_block(qp, cb_offset, tc_offset, dst + x * 4, stride, 2);
-				deblocking_edge_chroma_block(qp, cr_offset, tc_offset, dst + x * 4 + 1, stride, 2);
+			if (tc_cb[x]) {
+				deblocking_edge_chroma_block(tc_cb[x], dst + x * 4, stride, 2);
+			}
+			if (tc_cr[x]) {
+				deblocking_edge_chroma_block(tc_cr[x], dst + x * 4 + 1, stride, 2);
 			}
 		}
+#endif
 		dst += stride * 8;
-		str = str + (edgenum * 4 + 1) * 2;
+		tc_cb += (edgenum * 4 + 1) * 2;
+		tc_cr += (edgenum * 4 + 1) * 2;
 	}
 }
 
@@ -4361,7 +5047,7 @@ static void sanity(const h265d_ctu_t& ctu) {
 }
 
 static void deblock_ctu(h265d_ctu_t& ctu) {
-	if (ctu.slice_header->body.deblocking_filter_disabled_flag) {
+	if (ctu.slice_header->body.deblocking_filter_disabled_flag || ctu.stats) {
 		return;
 	}
 	int edgenum = 1 << (ctu.size->size_log2 - 3);
@@ -4371,14 +5057,27 @@ static void deblock_ctu(h265d_ctu_t& ctu) {
 	int stride = ctu.size->stride;
 	int beta_offset = ctu.slice_header->body.slice_beta_offset_div2 * 2;
 	int tc_offset = ctu.slice_header->body.slice_tc_offset_div2 * 2;
+	int param_num = edgenum * (edgenum * 2 + 1);
+	int16_t beta[8 * 17];
+	int16_t tc[8 * 17];
 	uint8_t* luma = ctu.luma - stride * 4 - 4;
-	deblocking_vert_edge_luma_lines(ctu.deblocking.boundary(0), beta_offset, tc_offset, luma, stride, edgenum * 2 + (ctu.pos_y == ctu.size->rows - 1), edgenum);
-	deblocking_horiz_edge_luma_lines(ctu.deblocking.boundary(1), beta_offset, tc_offset, luma, stride, edgenum * 2 + (ctu.pos_x == ctu.size->columns - 1), edgenum);
-	uint8_t* chroma = ctu.chroma - stride * 2 - 4;
-	int cb_offset = ctu.pps->pps_cb_qp_offset;
-	int cr_offset = ctu.pps->pps_cr_qp_offset;
-	deblocking_vert_edge_chroma_lines(ctu.deblocking.boundary(0), cb_offset, cr_offset, tc_offset, chroma, stride, edgenum * 2 + (ctu.pos_y == ctu.size->rows - 1), edgenum >> 1);
-	deblocking_horiz_edge_chroma_lines(ctu.deblocking.boundary(1), cb_offset, cr_offset, tc_offset, chroma, stride, edgenum * 2 + (ctu.pos_x == ctu.size->columns - 1), edgenum >> 1);
+	deblocking_luma_param(ctu.deblocking.boundary(0), param_num, beta_offset, tc_offset, beta, tc);
+	deblocking_vert_edge_luma_lines(beta, tc, luma, stride, edgenum * 2 + (ctu.pos_y == ctu.size->rows - 1), edgenum);
+	deblocking_luma_param(ctu.deblocking.boundary(1), param_num, beta_offset, tc_offset, beta, tc);
+	deblocking_horiz_edge_luma_lines(beta, tc, luma, stride, edgenum * 2 + (ctu.pos_x == ctu.size->columns - 1), edgenum);
+	if (!ctu.luma_only) {
+		uint8_t* chroma = ctu.chroma - stride * 2 - 4;
+		int cb_offset = ctu.pps->pps_cb_qp_offset;
+		int cr_offset = ctu.pps->pps_cr_qp_offset;
+		int16_t* tc_cb = beta;
+		int16_t* tc_cr = tc;
+		deblocking_chroma_param(ctu.deblocking.boundary(0), param_num, cb_offset, tc_offset, tc_cb);
+		deblocking_chroma_param(ctu.deblocking.boundary(0), param_num, cr_offset, tc_offset, tc_cr);
+		deblocking_vert_edge_chroma_lines(tc_cb, tc_cr, chroma, stride, edgenum * 2 + (ctu.pos_y == ctu.size->rows - 1), edgenum >> 1);
+		deblocking_chroma_param(ctu.deblocking.boundary(1), param_num, cb_offset, tc_offset, tc_cb);
+		deblocking_chroma_param(ctu.deblocking.boundary(1), param_num, cr_offset, tc_offset, tc_cr);
+		deblocking_horiz_edge_chroma_lines(tc_cb, tc_cr, chroma, stride, edgenum * 2 + (ctu.pos_x == ctu.size->columns - 1), edgenum >> 1);
+	}
 	ctu.deblocking.post_deblocking(ctu.pos_x, ctu.size->columns);
 	VC_CHECK;
 }
@@ -4506,43 +5205,75 @@ static inline void sao_diag_edge(uint8_t* dst, const int8_t offset[], int width,
 	}
 }
 
-static void sao_eo_block(const h265d_sao_map_t& sao_map, int cidx, uint8_t* dst, h265d_ctu_t& ctu, int width, int height, int xgap, int stride, uint32_t unavail) {
-	int edge = sao_map.elem[(cidx + 1) >> 1].opt.edge;
-	const int8_t* offset = sao_map.elem[cidx].offset;
+#ifdef X86ASM
+void sao_edge_x86(uint8_t* dst, const int8_t* offset0, const int8_t* offset1, int edge, int width, int height, int xgap, int stride, uint32_t unavail, uint8_t* lines);
+void sao_band_x86(uint8_t* dst, const int8_t* offset0, const int8_t* offset1, int band0, int band1, int width, int height, int xgap, int stride);
+#endif
+
+static inline void sao_eo_plane(const int8_t* offset, int edge, uint8_t* dst, uint8_t* signbuf, int width, int height, int xgap, int stride, uint32_t unavail) {
 	switch (edge) {
 	case 0:
 		sao_edge0(dst, offset, width, height, xgap, stride, unavail);
 		break;
 	case 1:
-		sao_diag_edge<0>(dst, offset, width, height, ctu.sao_signbuf, xgap, stride, unavail);
+		sao_diag_edge<0>(dst, offset, width, height, signbuf, xgap, stride, unavail);
 		break;
 	case 2:
-		sao_diag_edge<-1>(dst, offset, width, height, ctu.sao_signbuf, xgap, stride, unavail);
+		sao_diag_edge<-1>(dst, offset, width, height, signbuf, xgap, stride, unavail);
 		break;
 	case 3:
-		sao_diag_edge<1>(dst, offset, width, height, ctu.sao_signbuf, xgap, stride, unavail);
+		sao_diag_edge<1>(dst, offset, width, height, signbuf, xgap, stride, unavail);
 		break;
 	}
 }
 
-static void sao_bo_block(const h265d_sao_map_t& sao_map, int cidx, uint8_t* dst, int width, int height, int xgap, int stride) {
-	int bandtop = sao_map.elem[cidx].opt.band_pos;
-	const int8_t* offset = sao_map.elem[cidx].offset;
+/** Edge offset of luma (xgap == 1), or of interleaved Cb and Cr (xgap == 2).
+ */
+static void sao_eo_block(const h265d_sao_map_t& sao_map, int cidx, uint8_t* dst, h265d_sao_t& sao, int width, int height, int xgap, int stride, uint32_t unavail) {
+	int edge = sao_map.elem[(cidx + 1) >> 1].opt.edge;
+	const int8_t* offset0 = sao_map.elem[cidx].offset;
+	const int8_t* offset1 = sao_map.elem[cidx + (xgap >> 1)].offset;
+#ifdef X86ASM
+	sao_edge_x86(dst, offset0, offset1, edge, width, height, xgap, stride, unavail, sao.lines);
+#else
+	sao_eo_plane(offset0, edge, dst, sao.signbuf, width, height, xgap, stride, unavail);
+	if (xgap == 2) {
+		sao_eo_plane(offset1, edge, dst + 1, sao.signbuf, width, height, xgap, stride, unavail);
+	}
+#endif
+}
+
+/** Band table wraps around, as bands are (band_pos + k) & 31.
+ */
+static inline void sao_bo_plane(const h265d_sao_map_elem_t& elem, uint8_t* dst, int width, int height, int xgap, int stride) {
+	int bandtop = elem.opt.band_pos;
+	const int8_t* offset = elem.offset;
 	int shift = sizeof(*dst) * 8 - 5;
-	unsigned lim = 4U << shift;
-	bandtop <<= shift;
 	for (int y = 0; y < height; ++y) {
 		for (int x = 0; x < width; ++x) {
 			int d0 = dst[x * xgap];
-			int dif = d0 - bandtop;
-			if ((unsigned)dif < lim) {
-				dst[x * xgap] = clip2(d0 + offset[dif >> shift], 255);
+			unsigned band = ((d0 >> shift) - bandtop) & 31;
+			if (band < 4) {
+				dst[x * xgap] = clip2(d0 + offset[band], 255);
 			}
 		}
 		dst += stride;
 	}
 }
 
+static void sao_bo_block(const h265d_sao_map_t& sao_map, int cidx, uint8_t* dst, int width, int height, int xgap, int stride) {
+	const h265d_sao_map_elem_t& elem0 = sao_map.elem[cidx];
+	const h265d_sao_map_elem_t& elem1 = sao_map.elem[cidx + (xgap >> 1)];
+#ifdef X86ASM
+	sao_band_x86(dst, elem0.offset, elem1.offset, elem0.opt.band_pos, elem1.opt.band_pos, width, height, xgap, stride);
+#else
+	sao_bo_plane(elem0, dst, width, height, xgap, stride);
+	if (xgap == 2) {
+		sao_bo_plane(elem1, dst + 1, width, height, xgap, stride);
+	}
+#endif
+}
+
 struct swap_hline {
 	void operator()(uint8_t* a, uint8_t* b, int len) const {
 		uint32_t* a32 = reinterpret_cast<uint32_t*>(a);
@@ -4632,112 +5363,221 @@ static inline int sao_merged_num(const h265d_sao_map_t* sao_map, int max) {
 	return i;
 }
 
-static int sao_region(h265d_ctu_t& ctu, const h265d_sao_map_t* sao_map, int width, int height, int stride, uint32_t unavail, int max, int xphase, int pos_y, int valid_width) {
+static int sao_region(h265d_sao_t& sao, bool luma_only, const h265d_sao_map_t* sao_map, int width, int height, int stride, uint32_t unavail, int max, int xphase, int pos_y, int valid_width) {
 	int x_num;
-	sao_clear_vline(ctu.sao_vlines, xphase ^ 1, 0);
-	sao_clear_vline(ctu.sao_vlines, xphase ^ 1, 1);
+	sao_clear_vline(sao.vlines, xphase ^ 1, 0);
+	sao_clear_vline(sao.vlines, xphase ^ 1, 1);
 	x_num = sao_merged_num(sao_map, max);
 	int hlen = MINV(width * x_num, valid_width);
 	int idx = sao_map[0].luma_idx;
 	if (idx) {
 		if (x_num < max) {
 			if (sao_map[x_num].luma_idx == 2) {
-				sao_reserve_vline(ctu.sao_vlines, xphase ^ 1, 0, ctu.luma + hlen - 1, height, stride);
+				sao_reserve_vline(sao.vlines, xphase ^ 1, 0, sao.luma + hlen - 1, height, stride);
 			}
 		} else {
 			unavail |= 4;
 		}
-		sao_reserve_hline(ctu.sao_hlines[(pos_y ^ 1) & 1][0], ctu.luma + stride * (height - 1), ctu.pos_x, x_num, width);
+		sao_reserve_hline(sao.hlines[(pos_y ^ 1) & 1][0], sao.luma + stride * (height - 1), sao.pos_x, x_num, width);
 		if (idx == 1) {
-			sao_bo_block(sao_map[0], 0, ctu.luma, hlen, height, 1, stride);
+			sao_bo_block(sao_map[0], 0, sao.luma, hlen, height, 1, stride);
 		} else {
-			sao_swap_vline(ctu.sao_vlines, xphase, 0, ctu.sao_vlines.right[xphase & 1][0], ctu.luma - 1, 1, stride, height);
-			sao_eo_block(sao_map[0], 0, ctu.luma, ctu, hlen, height, 1, stride, unavail);
-			sao_swap_vline(ctu.sao_vlines, xphase, 0, ctu.luma - 1, ctu.sao_vlines.right[xphase & 1][0], stride, 1, height);
+			sao_swap_vline(sao.vlines, xphase, 0, sao.vlines.right[xphase & 1][0], sao.luma - 1, 1, stride, height);
+			sao_eo_block(sao_map[0], 0, sao.luma, sao, hlen, height, 1, stride, unavail);
+			sao_swap_vline(sao.vlines, xphase, 0, sao.luma - 1, sao.vlines.right[xphase & 1][0], stride, 1, height);
 		}
 	}
-	idx = sao_map[0].chroma_idx;
+	idx = luma_only ? 0 : sao_map[0].chroma_idx;
 	if (idx) {
 		if (x_num < max) {
 			if (sao_map[x_num].chroma_idx == 2) {
-				sao_reserve_vline(ctu.sao_vlines, xphase ^ 1, 1, reinterpret_cast<uint16_t*>(ctu.chroma + hlen - 2), height >> 1, stride);
+				sao_reserve_vline(sao.vlines, xphase ^ 1, 1, reinterpret_cast<uint16_t*>(sao.chroma + hlen - 2), height >> 1, stride);
 			}
 		} else {
 			unavail |= 4;
 		}
-		sao_reserve_hline(ctu.sao_hlines[(pos_y ^ 1) & 1][1], ctu.chroma + stride * ((height >> 1) - 1), ctu.pos_x, x_num, width);
+		sao_reserve_hline(sao.hlines[(pos_y ^ 1) & 1][1], sao.chroma + stride * ((height >> 1) - 1), sao.pos_x, x_num, width);
 		if (idx == 1) {
-			sao_bo_block(sao_map[0], 1, ctu.chroma, hlen >> 1, height >> 1, 2, stride);
-			sao_bo_block(sao_map[0], 2, ctu.chroma + 1, hlen >> 1, height >> 1, 2, stride);
+			sao_bo_block(sao_map[0], 1, sao.chroma, hlen >> 1, height >> 1, 2, stride);
 		} else if (1 < idx) {
-			sao_swap_vline(ctu.sao_vlines, xphase, 1, reinterpret_cast<uint16_t*>(ctu.sao_vlines.right[xphase & 1][1]), reinterpret_cast<uint16_t*>(ctu.chroma - 2), 1, stride >> 1, height >> 1);
-			sao_eo_block(sao_map[0], 1, ctu.chroma, ctu, hlen >> 1, height >> 1, 2, stride, unavail);
-			sao_eo_block(sao_map[0], 2, ctu.chroma + 1, ctu, hlen >> 1, height >> 1, 2, stride, unavail);
-			sao_swap_vline(ctu.sao_vlines, xphase, 1, reinterpret_cast<uint16_t*>(ctu.chroma - 2), reinterpret_cast<uint16_t*>(ctu.sao_vlines.right[xphase & 1][1]), stride >> 1, 1, height >> 1);
+			sao_swap_vline(sao.vlines, xphase, 1, reinterpret_cast<uint16_t*>(sao.vlines.right[xphase & 1][1]), reinterpret_cast<uint16_t*>(sao.chroma - 2), 1, stride >> 1, height >> 1);
+			sao_eo_block(sao_map[0], 1, sao.chroma, sao, hlen >> 1, height >> 1, 2, stride, unavail);
+			sao_swap_vline(sao.vlines, xphase, 1, reinterpret_cast<uint16_t*>(sao.chroma - 2), reinterpret_cast<uint16_t*>(sao.vlines.right[xphase & 1][1]), stride >> 1, 1, height >> 1);
 		}
 	}
 	return x_num;
 }
 
-static void sao_oneframe(h265d_ctu_t& ctu) {
-	if (!ctu.slice_header->body.slice_sao_luma_flag && !ctu.slice_header->body.slice_sao_chroma_flag) {
-		return;
+static inline int tile_index(const uint16_t bd[], int num, uint32_t pos) {
+	int i = 0;
+	while ((i < num - 1) && (bd[i + 1] <= pos)) {
+		++i;
 	}
+	return i;
+}
+
+/** SAO of CTU row y, after rows y and y + 1 are deblocked and rows above are filtered.
+ * Reads only what stays unchanged while a picture is decoded, so that it may run on a filter thread.
+ */
+static void sao_row(h265d_sao_t& sao, const h265d_ctu_t& ctu, int y) {
 	int ymax = ctu.size->rows;
 	int xmax = ctu.size->columns;
 	int stride = ctu.size->stride;
 	int len = 1 << ctu.size->size_log2;
 	int width = ctu.sps->pic_width_in_luma_samples;
-	const h265d_sao_map_t* sao_map = ctu.sao_map;
-	uint32_t unavail = 3;
-	for (int y = 0; y < ymax; ++y) {
-		ctu.pos_y = y;
-		ctu.luma = ctu.frame_info.curr_luma + stride * len * y;
-		ctu.chroma = ctu.frame_info.curr_chroma + stride * (len >> 1) * y;
-		if (y != 0) {
-			h265d_sao_hlines_t* prev = ctu.sao_hlines[y & 1];
-			sao_swap_hline(prev[0].reserved_flag, prev[0].bottom, ctu.luma - stride, 0, xmax, len, swap_hline());
-			sao_swap_hline(prev[1].reserved_flag, prev[1].bottom, ctu.chroma - stride, 0, xmax, len, swap_hline());
-		}
-		h265d_sao_hlines_t* next = ctu.sao_hlines[(y ^ 1) & 1];
-		memset(next[0].reserved_flag, 0, (sizeof(next[0].reserved_flag[0]) * xmax + 7) >> 3);
-		memset(next[1].reserved_flag, 0, (sizeof(next[0].reserved_flag[0]) * xmax + 7) >> 3);
-		int vlen = (y < ymax - 1) ? len : ((ctu.sps->pic_height_in_luma_samples - 1) & (len - 1)) + 1;
-		int x = 0;
-		int phase = 0;
-		int valid_width = width;
-		ctu.sao_vlines.reserved_flag = 0;
-		while (x < xmax) {
-			ctu.pos_x = x;
-			int run = sao_region(ctu, sao_map + x, len, vlen, stride, unavail, xmax - x, phase++, y, valid_width);
-			x += run;
-			valid_width -= len * run;
-			ctu.luma += len * run;
-			ctu.chroma += len * run;
-			unavail &= ~1;
-		}
-		if (y != 0) {
-			h265d_sao_hlines_t* prev = ctu.sao_hlines[y & 1];
-			ctu.luma = ctu.frame_info.curr_luma + stride * len * y;
-			ctu.chroma = ctu.frame_info.curr_chroma + stride * (len >> 1) * y;
-			sao_swap_hline(prev[0].reserved_flag, ctu.luma - stride, prev[0].bottom, 0, xmax, len, memcpy);
-			sao_swap_hline(prev[1].reserved_flag, ctu.chroma - stride, prev[1].bottom, 0, xmax, len, memcpy);
-		}
-		sao_map += xmax;
-		unavail = (y < ymax - 2) ? 1 : 9;
+	const h265d_sao_map_t* sao_map = ctu.sao_map + xmax * y;
+	uint32_t unavail = 1 | ((y == 0) * 2) | ((y == ymax - 1) * 8);
+	bool tile_cut = ctu.pps->tiles_enabled_flag && !ctu.pps->tiles.loop_filter_across_tiles_enabled_flag;
+	if (tile_cut) {
+		int tile_row = tile_index(ctu.tile_row_bd, ctu.tile_rows, y);
+		unavail |= ((y == ctu.tile_row_bd[tile_row]) * 2) | ((y + 1 == ctu.tile_row_bd[tile_row + 1]) * 8);
+	}
+	uint8_t* luma = ctu.frame_info.curr_luma + stride * len * y;
+	uint8_t* chroma = ctu.frame_info.curr_chroma + stride * (len >> 1) * y;
+	if (y != 0) {
+		h265d_sao_hlines_t* prev = sao.hlines[y & 1];
+		sao_swap_hline(prev[0].reserved_flag, prev[0].bottom, luma - stride, 0, xmax, len, swap_hline());
+		sao_swap_hline(prev[1].reserved_flag, prev[1].bottom, chroma - stride, 0, xmax, len, swap_hline());
+	}
+	h265d_sao_hlines_t* next = sao.hlines[(y ^ 1) & 1];
+	memset(next[0].reserved_flag, 0, (sizeof(next[0].reserved_flag[0]) * xmax + 7) >> 3);
+	memset(next[1].reserved_flag, 0, (sizeof(next[0].reserved_flag[0]) * xmax + 7) >> 3);
+	int vlen = (y < ymax - 1) ? len : ((ctu.sps->pic_height_in_luma_samples - 1) & (len - 1)) + 1;
+	int x = 0;
+	int phase = 0;
+	int valid_width = width;
+	int tile_col = 0;
+	sao.luma = luma;
+	sao.chroma = chroma;
+	sao.vlines.reserved_flag = 0;
+	while (x < xmax) {
+		int max = xmax - x;
+		if (tile_cut) {
+			/* regions end at tile boundaries, where samples of either side are not compared */
+			if (x == ctu.tile_column_bd[tile_col + 1]) {
+				tile_col++;
+			}
+			if (x == ctu.tile_column_bd[tile_col]) {
+				unavail |= 1;
+			}
+			max = ctu.tile_column_bd[tile_col + 1] - x;
+		}
+		sao.pos_x = x;
+		int run = sao_region(sao, ctu.luma_only, sao_map + x, len, vlen, stride, unavail, max, phase++, y, valid_width);
+		x += run;
+		valid_width -= len * run;
+		sao.luma += len * run;
+		sao.chroma += len * run;
+		unavail &= ~1;
+	}
+	if (y != 0) {
+		h265d_sao_hlines_t* prev = sao.hlines[y & 1];
+		sao_swap_hline(prev[0].reserved_flag, luma - stride, prev[0].bottom, 0, xmax, len, memcpy);
+		sao_swap_hline(prev[1].reserved_flag, chroma - stride, prev[1].bottom, 0, xmax, len, memcpy);
+	}
+}
+
+/** Filter rows whose lower neighbour has been deblocked, then pass them to frame threads.
+ * A row becomes final once the next row is filtered, since SAO of a row borrows the bottom line of the row above.
+ */
+static void filter_row(h265d_sao_t& sao, const h265d_ctu_t& ctu, int y) {
+	if (!ctu.stats && ctu.sps->sample_adaptive_offset_enabled_flag) {
+		sao_row(sao, ctu, y);
+	}
+	sao.rows_done = y + 1;
+#ifdef M2D_THREADS
+	if (ctu.frame_info.frame_progress) {
+		ctu.frame_info.frame_progress->set(ctu.frame_info.index, (y + 1 < static_cast<int>(ctu.size->rows)) ? y : H265D_FRAME_COMPLETE);
 	}
+#endif
+}
+
+static inline bool row_deblocked(const h265d_ctu_t& ctu, int y) {
+	return (static_cast<int>(ctu.size->rows) <= y) || (static_cast<int>(ctu.size->columns) <= ctu.deblocked[y]);
+}
+
+static void filter_rows(h265d_sao_t& sao, const h265d_ctu_t& ctu) {
+	int y;
+	while (((y = sao.rows_done) < static_cast<int>(ctu.size->rows)) && row_deblocked(ctu, y) && row_deblocked(ctu, y + 1)) {
+		filter_row(sao, ctu, y);
+	}
+}
+
+/** Called after each CTU is deblocked.
+ */
+static inline void filter_ctu_deblocked(h265d_ctu_t& ctu) {
+#ifdef M2D_THREADS
+	if (ctu.deblocked_progress) {
+		ctu.deblocked_progress->add(ctu.pos_y, 1);
+		return;
+	}
+#endif
+	ctu.deblocked[ctu.pos_y]++;
+	filter_rows(ctu.sao, ctu);
 }
 
 static inline uint32_t get_avail(int xpos, int ypos, int cols, int rows) {
 	return (xpos == 0) + (ypos == 0) * 2 + (xpos == cols - 1) * 4 + (ypos == rows - 1) * 8;
 }
 
+static uint32_t ctb_addr_rs_to_ts(const h265d_ctu_t& dst, uint32_t pos_x, uint32_t pos_y) {
+	int col = tile_index(dst.tile_column_bd, dst.tile_columns, pos_x);
+	int row = tile_index(dst.tile_row_bd, dst.tile_rows, pos_y);
+	uint32_t left = dst.tile_column_bd[col];
+	uint32_t top = dst.tile_row_bd[row];
+	uint32_t width = dst.tile_column_bd[col + 1] - left;
+	uint32_t height = dst.tile_row_bd[row + 1] - top;
+	return top * dst.size->columns + left * height + (pos_y - top) * width + (pos_x - left);
+}
+
+static inline h265d_tile_edge_t& tile_edge_left(const h265d_ctu_t& dst, uint32_t pos_y, int tile_col) {
+	return dst.tile_edge_left[pos_y * MINV(dst.size->columns, static_cast<uint32_t>(H265D_MAX_TILE_COLUMNS)) + tile_col];
+}
+
+/** Tile boundary is filtered if allowed and the CTB across it belongs to current slice.
+ */
+static inline bool tile_edge_filtered(const h265d_ctu_t& dst, uint32_t pos_x, uint32_t pos_y) {
+	return dst.pps->tiles.loop_filter_across_tiles_enabled_flag && (dst.slice_addr_ts <= ctb_addr_rs_to_ts(dst, pos_x, pos_y));
+}
+
+static void deblocking_set_edge(h265d_ctu_t& dst, uint32_t unavail, uint32_t tile_left, uint32_t tile_top) {
+	uint32_t pos_x = dst.pos_x;
+	uint32_t pos_y = dst.pos_y;
+	const h265d_neighbour_t* left = 0;
+	const h265d_neighbour_t* top = 0;
+	if ((pos_x == tile_left) && (pos_x != 0)) {
+		left = tile_edge_left(dst, pos_y, dst.tile_col - 1).neighbour;
+		unavail = (unavail & ~1) | !tile_edge_filtered(dst, pos_x - 1, pos_y);
+	}
+	if ((pos_y == tile_top) && (pos_y != 0)) {
+		top = dst.tile_edge_top + pos_x * H265D_NEIGHBOUR_NUM;
+		unavail = (unavail & ~2) | (!tile_edge_filtered(dst, pos_x, pos_y - 1) * 2);
+	}
+	dst.deblocking.set_edge(unavail, left, top);
+}
+
+template <int CTB_LOG2>
 static void coding_tree_unit(h265d_ctu_t& dst, dec_bits& st) {
 	dst.sao_read(dst, *dst.slice_header, st);
 	uint32_t idx_in_slice = dst.idx_in_slice;
-	uint32_t unavail = ((!dst.pos_y || (idx_in_slice < dst.size->columns)) * 10) | ((!dst.pos_x || !idx_in_slice) * 5) | 4;
-	quad_tree(dst, st, dst.size->size_log2, unavail, 0, dst.valid_x, 0, dst.valid_y, dst.neighbour_left + 2, dst.neighbour_top + dst.pos_x * H265D_NEIGHBOUR_NUM, dst.neighbour_left[1]);
+	uint32_t pos_x = dst.pos_x;
+	uint32_t columns = dst.size->columns;
+	uint32_t tile_left = dst.tile_column_bd[dst.tile_col];
+	uint32_t tile_right = dst.tile_column_bd[dst.tile_col + 1];
+	uint32_t tile_top = dst.tile_row_bd[dst.tile_row];
+	bool tile_right_edge = (pos_x + 1 == tile_right) && (tile_right < columns);
+	uint32_t unavail = (((dst.pos_y == tile_top) || (idx_in_slice < tile_right - tile_left)) * 10) | (((pos_x == tile_left) || !idx_in_slice) * 5) | (tile_right_edge * 8) | 4;
+	uint32_t valid_x = MINV(dst.valid_x, (tile_right - pos_x) << CTB_LOG2);
+	frame_wait_colpic(dst);
+	deblocking_set_edge(dst, unavail, tile_left, tile_top);
+	quad_tree<CTB_LOG2>(dst, st, unavail, 0, valid_x, 0, dst.valid_y, dst.neighbour_left + 2, dst.neighbour_top + pos_x * H265D_NEIGHBOUR_NUM, dst.neighbour_left[1]);
 	deblock_ctu(dst);
+	if (tile_right_edge) {
+		h265d_tile_edge_t& edge = tile_edge_left(dst, dst.pos_y, dst.tile_col);
+		memcpy(edge.neighbour, dst.neighbour_left + 2, sizeof(edge.neighbour));
+		dst.deblocking.save_left(edge.strength);
+	}
+	filter_ctu_deblocked(dst);
 }
 
 static inline void neighbour_init(h265d_neighbour_t neighbour[], int num) {
@@ -4749,131 +5589,901 @@ static inline void neighbour_init(h265d_neighbour_t neighbour[], int num) {
 	}
 }
 
-static void ctu_init(h265d_ctu_t& dst, h265d_data_t& h2d, const h265d_pps_t& pps, const h265d_sps_t& sps) {
-	const h265d_slice_header_t& hdr = h2d.slice_header;
-	const h265d_slice_header_body_t& header = hdr.body;
+static void cabac_context_init(h265d_ctu_t& dst, const h265d_slice_header_body_t& header) {
 	int slice_type = header.slice_type;
 	int idc = (slice_type < 2) ? (2 - (slice_type ^ header.cabac_init_flag)) : 0;
 	init_cabac_context(&dst.cabac.cabac, reinterpret_cast<int8_t*>(dst.cabac.context), header.slice_qpy, cabac_initial_value[idc], NUM_ELEM(cabac_initial_value[idc]));
-	dst.sao_read = (hdr.body.slice_sao_luma_flag || hdr.body.slice_sao_chroma_flag) ? sao_read : sao_ignore;
-	dst.sps = &sps;
-	if (sps.scaling_list_enabled_flag) {
-		dst.scaling_func = 0;
-		if (sps.scaling_list_data_present_flag) {
+}
+
+static void ctu_reset_qpy(h265d_ctu_t& dst, const h265d_slice_header_body_t& header) {
+	if (dst.qpy != header.slice_qpy) {
+		dst.qpy = header.slice_qpy;
+		qp_to_scale(dst.qp_scale, header.slice_qpy, header.slice_qpc_delta);
+		dst.qpc_delta[0] = header.slice_qpc_delta[0];
+		dst.qpc_delta[1] = header.slice_qpc_delta[1];
+	}
+}
+
+static inline void ctu_align_coeff_buf(h265d_ctu_t& dst) {
+	dst.coeff_buf = reinterpret_cast<int16_t*>((reinterpret_cast<uintptr_t>(dst.coeff_buffer) + 15) & ~15);
+}
+
+static void ctu_set_pos(h265d_ctu_t& dst, uint32_t pos_x, uint32_t pos_y) {
+	const h265d_ctb_info_t& ctb = *dst.size;
+	int size_log2 = ctb.size_log2;
+	dst.pos_x = pos_x;
+	dst.pos_y = pos_y;
+	dst.valid_x = dst.sps->pic_width_in_luma_samples - (pos_x << size_log2);
+	dst.valid_y = MINV(dst.sps->pic_height_in_luma_samples - (pos_y << size_log2), 1U << size_log2);
+	uint32_t luma_offset = (((ctb.columns * pos_y) << size_log2) + pos_x) << size_log2;
+	const m2d_frame_t& frm = dst.frame_info.frames[dst.frame_info.index];
+	dst.luma = frm.luma + luma_offset;
+	dst.chroma = frm.chroma + (luma_offset >> 1);
+}
+
+/** Upper neighbour at the right end of CTU in column pos_x, which becomes top-left of the next CTU.
+ */
+static inline const h265d_neighbour_t& neighbour_top_last(const h265d_ctu_t& dst, uint32_t pos_x) {
+	return dst.neighbour_top[pos_x * H265D_NEIGHBOUR_NUM + (1 << (dst.size->size_log2 - 2)) - 1];
+}
+
+static inline void neighbour_top_reset_mode(h265d_ctu_t& dst, uint32_t pos_x) {
+	h265d_neighbour_t* top = dst.neighbour_top + pos_x * H265D_NEIGHBOUR_NUM;
+	for (uint32_t i = 0; i < H265D_NEIGHBOUR_NUM; ++i) {
+		top[i].pred_mode = INTRA_DC;
+	}
+}
+
+static void tile_boundaries(uint16_t bd[], const uint16_t size_minus1[], int num, uint32_t total, bool uniform, dec_bits& st) {
+	bd[0] = 0;
+	for (int i = 1; i < num; ++i) {
+		bd[i] = uniform ? (i * total) / num : bd[i - 1] + size_minus1[i - 1] + 1;
+	}
+	bd[num] = total;
+	for (int i = 0; i < num; ++i) {
+		if (bd[i + 1] <= bd[i]) {
+			error_report(st);
 		}
+	}
+}
+
+static void tile_init(h265d_ctu_t& dst, const h265d_pps_t& pps, const h265d_sps_t& sps, dec_bits& st) {
+	if (pps.tiles_enabled_flag) {
+		const h265d_tiles_t& tiles = pps.tiles;
+		dst.tile_columns = tiles.num_tile_columns_minus1 + 1;
+		dst.tile_rows = tiles.num_tile_rows_minus1 + 1;
+		tile_boundaries(dst.tile_column_bd, tiles.column_width_minus1, dst.tile_columns, sps.ctb_info.columns, tiles.uniform_spacing_flag, st);
+		tile_boundaries(dst.tile_row_bd, tiles.row_height_minus1, dst.tile_rows, sps.ctb_info.rows, tiles.uniform_spacing_flag, st);
 	} else {
-		dst.scaling_func = scaling_default_func;
+		dst.tile_columns = 1;
+		dst.tile_rows = 1;
+		dst.tile_column_bd[0] = 0;
+		dst.tile_column_bd[1] = sps.ctb_info.columns;
+		dst.tile_row_bd[0] = 0;
+		dst.tile_row_bd[1] = sps.ctb_info.rows;
 	}
-	dst.coeff_buf = reinterpret_cast<int16_t*>((reinterpret_cast<uintptr_t>(dst.coeff_buffer) + 15) & ~15);
-	int ctu_address = hdr.slice_segment_address;
-	dst.idx_in_slice = 0;
-	dst.pos_y = ctu_address / sps.ctb_info.columns;
-	uint32_t y_offset = sps.ctb_info.columns * dst.pos_y;
-	dst.pos_x = ctu_address - y_offset;
-	dst.valid_x = sps.pic_width_in_luma_samples - (dst.pos_x << sps.ctb_info.size_log2);
-	dst.valid_y = MINV(sps.pic_height_in_luma_samples - (dst.pos_y << sps.ctb_info.size_log2), 1U << sps.ctb_info.size_log2);
-	uint32_t luma_offset = ((y_offset << sps.ctb_info.size_log2) + dst.pos_x) << sps.ctb_info.size_log2;
-	m2d_frame_t& frm = dst.frame_info.frames[dst.frame_info.index];
-	dst.frame_info.poc[dst.frame_info.index] = header.slice_pic_order_cnt.poc;
+}
+
+/** Size and POC of current frame.
+ */
+static void frame_set_info(h265d_frame_info_t& frame_info, const h265d_sps_t& sps, int32_t poc) {
+	m2d_frame_t& frm = frame_info.frames[frame_info.index];
+	frame_info.poc[frame_info.index] = poc;
 	frm.width = sps.ctb_info.stride;
 	frm.height = sps.ctb_info.rows << sps.ctb_info.size_log2;
 	frm.crop[0] = sps.cropping[0];
 	frm.crop[1] = sps.cropping[1] + frm.width - sps.pic_width_in_luma_samples;
 	frm.crop[2] = sps.cropping[2];
 	frm.crop[3] = sps.cropping[3] + frm.height - sps.pic_height_in_luma_samples;
-	dst.luma = frm.luma + luma_offset;
-	dst.chroma = frm.chroma + (luma_offset >> 1);
-	dst.colpics.init(header, dst.frame_info, sps.ctb_info.size_log2, sps.pic_width_in_luma_samples, sps.pic_height_in_luma_samples, dst.pos_x, dst.pos_y, header.slice_pic_order_cnt.poc);
-	dst.deblocking.set_ctu(hdr.body.deblocking_filter_disabled_flag, dst.qp_history, hdr.body.ref_list, sps.ctb_info.size_log2, sps.ctb_info.columns, dst.pos_x);
+}
+
+/** Settings of each slice segment, either independent or dependent.
+ */
+static void ctu_set_slice(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, const h265d_pps_t& pps, const h265d_sps_t& sps) {
+	dst.sao_read = (hdr.body.slice_sao_luma_flag || hdr.body.slice_sao_chroma_flag) ? sao_read : sao_ignore;
+	dst.sps = &sps;
+	if (sps.scaling_list_enabled_flag) {
+		const h265d_scaling_list_data_t& lists = pps.pps_scaling_list_data_present_flag ? pps.scaling_list_data : sps.scaling_list_data;
+		h265d_scaling_table_t& table = *dst.scaling_table_buf;
+		if (memcmp(&table.lists, &lists, sizeof(lists)) != 0) {
+			scaling_table_build(table, lists);
+		}
+		dst.scaling_table = &table;
+		dst.scaling_func = scaling_list_func;
+	} else {
+		dst.scaling_table = 0;
+		dst.scaling_func = scaling_default_func;
+	}
+	ctu_align_coeff_buf(dst);
+	frame_set_info(dst.frame_info, sps, hdr.body.slice_pic_order_cnt.poc);
 	dst.pps = &pps;
 	dst.slice_header = &hdr;
-	if (dst.qpy != header.slice_qpy) {
-		dst.qpy = header.slice_qpy;
-		qp_to_scale(dst.qp_scale, header.slice_qpy, header.slice_qpc_delta);
-		dst.qpc_delta[0] = header.slice_qpc_delta[0];
-		dst.qpc_delta[1] = header.slice_qpc_delta[1];
+}
+
+static void ctu_init(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, const h265d_pps_t& pps, const h265d_sps_t& sps, dec_bits& st) {
+	const h265d_slice_header_body_t& header = hdr.body;
+	cabac_context_init(dst, header);
+	ctu_set_slice(dst, hdr, pps, sps);
+	int ctu_address = hdr.slice_segment_address;
+	dst.idx_in_slice = 0;
+	if (hdr.first_slice_segment_in_pic_flag) {
+		memset(dst.deblocked, 0, sizeof(dst.deblocked[0]) * sps.ctb_info.rows);
+		dst.sao.rows_done = 0;
+	}
+	ctu_set_pos(dst, ctu_address % sps.ctb_info.columns, ctu_address / sps.ctb_info.columns);
+	tile_init(dst, pps, sps, st);
+	dst.tile_col = tile_index(dst.tile_column_bd, dst.tile_columns, dst.pos_x);
+	dst.tile_row = tile_index(dst.tile_row_bd, dst.tile_rows, dst.pos_y);
+	dst.slice_addr_ts = ctb_addr_rs_to_ts(dst, dst.pos_x, dst.pos_y);
+	dst.colpics.init(header, dst.frame_info, sps.ctb_info.size_log2, sps.pic_width_in_luma_samples, sps.pic_height_in_luma_samples, dst.pos_x, dst.pos_y, header.slice_pic_order_cnt.poc);
+	dst.deblocking.set_ctu(hdr.body.deblocking_filter_disabled_flag || dst.stats, dst.qp_history, hdr.body.ref_list, sps.ctb_info.size_log2, sps.ctb_info.columns, dst.pos_x);
+	if ((dst.pos_x != 0) && (dst.pos_x == dst.tile_column_bd[dst.tile_col])) {
+		dst.deblocking.restore_left(tile_edge_left(dst, dst.pos_y, dst.tile_col - 1).strength);
 	}
+	ctu_reset_qpy(dst, header);
 	neighbour_init(dst.neighbour_left, NUM_ELEM(dst.neighbour_left));
 	neighbour_init(dst.neighbour_top, sps.ctb_info.columns * H265D_NEIGHBOUR_NUM);
 	memset(dst.qp_history[0], dst.qpy, sizeof(dst.qp_history));
 }
 
+/** Move to the head of CTU row in current tile, as ctu_pos_increment() does at the end of row.
+ */
+static void ctu_start_row(h265d_ctu_t& dst, uint32_t pos_x, uint32_t pos_y) {
+	neighbour_init(dst.neighbour_left + 1, NUM_ELEM(dst.neighbour_left) - 1);
+	ctu_set_pos(dst, pos_x, pos_y);
+	dst.idx_in_slice = ctb_addr_rs_to_ts(dst, pos_x, pos_y) - dst.slice_addr_ts;
+	dst.colpics.set_curr_pos(pos_x, pos_y);
+	dst.deblocking.set_pos(dst.size->size_log2, pos_x);
+	dst.deblocking.restore_left(pos_x ? tile_edge_left(dst, pos_y, dst.tile_col - 1).strength : 0);
+	dst.neighbour_left[0] = neighbour_top_last(dst, pos_x);
+	neighbour_top_reset_mode(dst, pos_x);
+	memset(dst.qp_history[0], dst.qpy, sizeof(dst.qp_history));
+}
+
+/** Move to the first CTU of tile. Upper neighbours are kept for deblocking across tile boundary,
+ * and reset since they are unavailable for prediction.
+ */
+static void ctu_start_tile(h265d_ctu_t& dst, int tile_col, int tile_row) {
+	dst.tile_col = tile_col;
+	dst.tile_row = tile_row;
+	uint32_t left = dst.tile_column_bd[tile_col];
+	uint32_t num = (dst.tile_column_bd[tile_col + 1] - left) * H265D_NEIGHBOUR_NUM;
+	h265d_neighbour_t* top = dst.neighbour_top + left * H265D_NEIGHBOUR_NUM;
+	memcpy(dst.tile_edge_top + left * H265D_NEIGHBOUR_NUM, top, sizeof(top[0]) * num);
+	neighbour_init(top, num);
+	ctu_start_row(dst, left, dst.tile_row_bd[tile_row]);
+}
+
+static uint32_t ctu_next_tile(h265d_ctu_t& dst) {
+	int tile_col = dst.tile_col + 1;
+	int tile_row = dst.tile_row;
+	if (dst.tile_columns <= tile_col) {
+		tile_col = 0;
+		if (dst.tile_rows <= ++tile_row) {
+			return 1;
+		}
+	}
+	ctu_start_tile(dst, tile_col, tile_row);
+	return 0;
+}
+
+/** Move to the next CTU in tile scan. Returns 1 at the end of picture.
+ */
+template <int CTB_LOG2>
 static uint32_t ctu_pos_increment(h265d_ctu_t& dst) {
 	uint32_t pos_x = dst.pos_x + 1;
-	int size_log2 = dst.size->size_log2;
-	if (dst.size->columns <= pos_x) {
-		neighbour_init(dst.neighbour_left + 1, NUM_ELEM(dst.neighbour_left) - 1);
-		dst.pos_y++;
-		dst.valid_x = dst.sps->pic_width_in_luma_samples;
-		if (dst.pos_y == dst.size->rows - 1) {
-			dst.valid_y = MINV(dst.sps->pic_height_in_luma_samples - (dst.pos_y << size_log2), 1U << size_log2);
-		}
-		pos_x = 0;
-		uint32_t y_offset = dst.size->columns << (size_log2 * 2);
-		uint32_t line_offset = dst.size->columns << size_log2;
-		dst.luma = dst.luma + y_offset - line_offset;
-		dst.chroma = dst.chroma + (y_offset >> 1) - line_offset;
-		dst.colpics.set_curr_pos(pos_x, dst.pos_y);
-	} else {
-		dst.valid_x -= 1 << size_log2;
-		dst.colpics.inc_curr_pos();
-		dst.neighbour_left[1] = dst.neighbour_left[0];
-	}
-	dst.neighbour_left[0] = dst.neighbour_top[((pos_x + 1) << (size_log2 - 2)) - 1];
-	dst.luma += static_cast<ptrdiff_t>(1 << size_log2);
-	dst.chroma += static_cast<ptrdiff_t>(1 << size_log2);
-	dst.deblocking.set_pos(size_log2, pos_x);
+	if (dst.tile_column_bd[dst.tile_col + 1] <= pos_x) {
+		uint32_t pos_y = dst.pos_y + 1;
+		if (dst.tile_row_bd[dst.tile_row + 1] <= pos_y) {
+			return ctu_next_tile(dst);
+		}
+		ctu_start_row(dst, dst.tile_column_bd[dst.tile_col], pos_y);
+		return 0;
+	}
+	dst.valid_x -= 1 << CTB_LOG2;
+	dst.colpics.inc_curr_pos();
+	dst.neighbour_left[1] = dst.neighbour_left[0];
+	dst.neighbour_left[0] = dst.neighbour_top[pos_x * H265D_NEIGHBOUR_NUM + (1 << (CTB_LOG2 - 2)) - 1];
+	dst.luma += static_cast<ptrdiff_t>(1 << CTB_LOG2);
+	dst.chroma += static_cast<ptrdiff_t>(1 << CTB_LOG2);
+	dst.deblocking.set_pos(CTB_LOG2, pos_x);
 	dst.pos_x = pos_x;
 	dst.idx_in_slice++;
-	h265d_neighbour_t* top = dst.neighbour_top + pos_x * H265D_NEIGHBOUR_NUM;
-	for (uint32_t i = 0; i < H265D_NEIGHBOUR_NUM; ++i) {
-		top[i].pred_mode = INTRA_DC;
+	neighbour_top_reset_mode(dst, pos_x);
+	memset(dst.qp_history[0], dst.qpy, sizeof(dst.qp_history));
+	return 0;
+}
+
+/** CTU decoder and scan increment specialized for each CTB size of 16x16, 32x32 and 64x64.
+ */
+template <int CTB_LOG2>
+static void ctu_set_funcs(h265d_ctu_t& dst) {
+	dst.ctu_decode = coding_tree_unit<CTB_LOG2>;
+	dst.ctu_next = ctu_pos_increment<CTB_LOG2>;
+}
+
+static void (* const ctu_set_funcs_func[3])(h265d_ctu_t& dst) = {
+	ctu_set_funcs<4>, ctu_set_funcs<5>, ctu_set_funcs<6>
+};
+
+/** Contexts of WPP are stored after the 2nd CTU of each row in tile.
+ */
+static inline void wpp_store_context(h265d_ctu_t& dst) {
+	if (dst.pps->entropy_coding_sync_enabled_flag && (dst.pos_x == dst.tile_column_bd[dst.tile_col] + 1)) {
+		dst.wpp_context[dst.pos_y] = *dst.cabac.context;
+	}
+}
+
+/** Contexts at the head of substream, that is each tile or each CTU row with WPP.
+ * WPP inherits them from the row above if its 2nd CTU is in the same slice and tile.
+ */
+static void substream_start(h265d_ctu_t& dst) {
+	const h265d_slice_header_t& hdr = *dst.slice_header;
+	uint32_t width = dst.tile_column_bd[dst.tile_col + 1] - dst.tile_column_bd[dst.tile_col];
+	if (dst.pps->entropy_coding_sync_enabled_flag && (1 < width) && (dst.tile_row_bd[dst.tile_row] < dst.pos_y) && (width - 1 <= dst.idx_in_slice)) {
+		*dst.cabac.context = dst.wpp_context[dst.pos_y - 1];
+	} else {
+		cabac_context_init(dst, hdr.body);
 	}
+	ctu_reset_qpy(dst, hdr.body);
 	memset(dst.qp_history[0], dst.qpy, sizeof(dst.qp_history));
-	return (dst.size->rows <= dst.pos_y);
 }
 
-static void slice_data(h265d_ctu_t& dst, h265d_data_t& h2d, const h265d_pps_t& pps, const h265d_sps_t& sps, dec_bits& st) {
-	ctu_init(dst, h2d, pps, sps);
+/** Whether current CTU is the head of substream.
+ */
+static inline bool substream_head(const h265d_ctu_t& dst) {
+	const h265d_pps_t& pps = *dst.pps;
+	return (dst.pos_x == dst.tile_column_bd[dst.tile_col]) && (pps.entropy_coding_sync_enabled_flag || (pps.tiles_enabled_flag && (dst.pos_y == dst.tile_row_bd[dst.tile_row])));
+}
+
+/** Dependent slice segment continues on the state of the preceding slice segment, which has
+ * already moved to the next CTU: slice address, QpY prediction and neighbours are kept.
+ * Contexts are restored from the end of preceding segment unless a substream starts here.
+ * Returns false if it does not follow the preceding segment, then it is initialized as a new slice.
+ */
+static bool ctu_resume(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, const h265d_pps_t& pps, const h265d_sps_t& sps) {
+	if (!hdr.dependent_slice_segment_flag || (hdr.slice_segment_address != static_cast<uint32_t>(dst.pos_y * sps.ctb_info.columns + dst.pos_x))) {
+		return false;
+	}
+	ctu_set_slice(dst, hdr, pps, sps);
+	dst.colpics.init(hdr.body, dst.frame_info, sps.ctb_info.size_log2, sps.pic_width_in_luma_samples, sps.pic_height_in_luma_samples, dst.pos_x, dst.pos_y, hdr.body.slice_pic_order_cnt.poc);
+	dst.deblocking.set_ref_list(hdr.body.ref_list);
+	if (substream_head(dst)) {
+		substream_start(dst);
+	} else {
+		*dst.cabac.context = dst.ds_context;
+	}
+	return true;
+}
+
+#ifdef M2D_THREADS
+/** Substreams of one slice, which are CTU rows with WPP or tiles, decoded in parallel.
+ * progress counts CTUs of each row with WPP, or completed CTU rows of each tile.
+ */
+struct h265d_substream_job_t {
+	const h265d_ctu_t* base;
+	const dec_bits* parent;
+	const byte_t* substream[H265D_MAX_ENTRY_POINTS + 2];
+	int num;
+	int first; // CTU row of WPP, or tile
+	std::atomic<int> next;
+	m2d_progress_t progress;
+	h265d_substream_job_t(const h265d_ctu_t* ctu, const dec_bits* st, int32_t* count, int substream_num, int first_unit) : base(ctu), parent(st), num(substream_num), first(first_unit), next(0), progress(count, substream_num) {}
+};
+
+typedef bool (*h265d_substream_func_t)(h265d_substream_job_t& job, h265d_ctu_t& ctu, int idx);
+
+/** Each CTU waits until the row above has decoded up to its upper-right CTU.
+ */
+static bool wpp_substream(h265d_substream_job_t& job, h265d_ctu_t& ctu, int idx) {
+	dec_bits st;
+	m2d_substream_open(&st, job.parent, job.substream[idx], job.substream[idx + 1] - job.substream[idx]);
+	if (setjmp(st.jmp) != 0) {
+		return false;
+	}
+	uint32_t columns = ctu.size->columns;
+	if (idx != 0) {
+		if (!job.progress.wait(idx - 1, MINV(2U, columns))) {
+			return false;
+		}
+		ctu_start_row(ctu, 0, job.first + idx);
+		substream_start(ctu);
+	}
+	init_cabac_engine(&ctu.cabac.cabac, &st);
+	for (;;) {
+		uint32_t pos_x = ctu.pos_x;
+		if ((idx != 0) && !job.progress.wait(idx - 1, MINV(pos_x + 2, columns))) {
+			return false;
+		}
+		ctu.ctu_decode(ctu, st);
+		wpp_store_context(ctu);
+		job.progress.set(idx, pos_x + 1);
+		if ((pos_x + 1 == columns) || end_of_slice_segment_flag(ctu.cabac, st)) {
+			break;
+		}
+		ctu.ctu_next(ctu);
+	}
+	job.progress.set(idx, columns);
+	return true;
+}
+
+/** Deblocking crosses tile boundaries, so that each tile waits until the tile above is completed,
+ * and each of its CTU rows waits until the tile at left has completed the same row.
+ */
+static bool tile_substream(h265d_substream_job_t& job, h265d_ctu_t& ctu, int idx) {
+	dec_bits st;
+	m2d_substream_open(&st, job.parent, job.substream[idx], job.substream[idx + 1] - job.substream[idx]);
+	if (setjmp(st.jmp) != 0) {
+		return false;
+	}
+	int tile = job.first + idx;
+	int tile_col = tile % ctu.tile_columns;
+	int tile_row = tile / ctu.tile_columns;
+	int above = idx - ctu.tile_columns;
+	if (idx != 0) {
+		if ((0 <= above) && !job.progress.wait(above, ctu.tile_row_bd[tile_row])) {
+			return false;
+		}
+		ctu_start_tile(ctu, tile_col, tile_row);
+		substream_start(ctu);
+	}
+	init_cabac_engine(&ctu.cabac.cabac, &st);
+	bool left_in_slice = (idx != 0) && (tile_col != 0);
+	uint32_t left = ctu.tile_column_bd[tile_col];
+	uint32_t right = ctu.tile_column_bd[tile_col + 1];
+	uint32_t bottom = ctu.tile_row_bd[tile_row + 1];
+	for (;;) {
+		uint32_t pos_y = ctu.pos_y;
+		bool row_end = (ctu.pos_x + 1U == right);
+		if (left_in_slice && (ctu.pos_x == left) && !job.progress.wait(idx - 1, pos_y + 1)) {
+			return false;
+		}
+		ctu.ctu_decode(ctu, st);
+		if (row_end) {
+			job.progress.set(idx, pos_y + 1);
+		}
+		if ((row_end && (pos_y + 1 == bottom)) || end_of_slice_segment_flag(ctu.cabac, st)) {
+			break;
+		}
+		ctu.ctu_next(ctu);
+	}
+	job.progress.set(idx, bottom);
+	return true;
+}
+
+static void substream_worker(h265d_substream_job_t& job, h265d_substream_func_t decode) {
+	h265d_ctu_t ctu = *job.base;
+	ctu.cabac.context = &ctu.context;
+	ctu_align_coeff_buf(ctu);
+	ctu.deblocking.set_qp_history(ctu.qp_history);
+	int idx;
+	while ((idx = job.next++) < job.num) {
+		if (!decode(job, ctu, idx)) {
+			job.progress.abort();
+			break;
+		}
+	}
+}
+
+/** Returns number of substreams to be decoded in parallel, or 0 if they are not addressable in current buffer.
+ */
+static int substreams_locate(h265d_substream_job_t& job, const h265d_entry_point_t& entry, dec_bits& st) {
+	uint32_t num = entry.num_entry_point_offsets;
+	if ((num == 0) || (static_cast<uint32_t>(H265D_MAX_ENTRY_POINTS) < num)) {
+		return 0;
+	}
+	const byte_t* tail = dec_bits_tail(&st);
+	const byte_t* pos = m2d_stream_raw_pos_skip03(&st);
+	if (!pos || (pos < st.buf_head_ + 2)) {
+		return 0;
+	}
+	job.substream[0] = pos;
+	for (uint32_t i = 0; i < num; ++i) {
+		uint32_t len = entry.entry_point_offset_minus1[i] + 1;
+		if (static_cast<size_t>(tail - pos) <= len) {
+			return 0;
+		}
+		pos += len;
+		job.substream[i + 1] = pos;
+	}
+	int len = m2d_next_start_code(pos, static_cast<int>(tail - pos));
+	if (len < 3) {
+		return 0;
+	}
+	job.substream[num + 1] = pos + len - 3;
+	return num + 1;
+}
+
+/** Decode substreams by thread_max threads including the caller.
+ */
+static bool substreams_run(h265d_substream_job_t& job, const h265d_slice_header_t& hdr, int thread_max, dec_bits& st, h265d_substream_func_t decode, bool& aborted) {
+	if (substreams_locate(job, hdr.entry_points, st) == 0) {
+		return false;
+	}
+	int thread_num = MINV(thread_max, job.num) - 1;
+	std::thread threads[M2D_MAX_THREADS];
+	int spawned = 0;
+	try {
+		while (spawned < thread_num) {
+			threads[spawned] = std::thread(substream_worker, std::ref(job), decode);
+			spawned++;
+		}
+	} catch (const std::system_error&) {
+		/* remaining substreams are taken by running threads */
+	}
+	substream_worker(job, decode);
+	for (int i = 0; i < spawned; ++i) {
+		threads[i].join();
+	}
+	aborted = job.progress.aborted();
+	return true;
+}
+
+/** SAO stage on its own thread, which follows rows deblocked by substream threads.
+ */
+static void filter_worker(const h265d_ctu_t* ctu, h265d_sao_t* sao, m2d_progress_t* deblocked) {
+	int rows = ctu->size->rows;
+	int columns = ctu->size->columns;
+	for (int y = sao->rows_done; y < rows; ++y) {
+		if (!deblocked->wait(y, columns) || ((y + 1 < rows) && !deblocked->wait(y + 1, columns))) {
+			break;
+		}
+		filter_row(*sao, *ctu, y);
+	}
+}
+
+/** Run substreams with the filter thread, which is released when they are completed.
+ * Rows it did not reach are filtered by the caller.
+ */
+static bool substreams_filtered(h265d_ctu_t& dst, h265d_substream_job_t& job, const h265d_slice_header_t& hdr, int thread_max, dec_bits& st, h265d_substream_func_t decode, bool& aborted) {
+	m2d_progress_t deblocked(dst.deblocked);
+	h265d_sao_t sao = dst.sao;
+	std::thread filter;
+	dst.deblocked_progress = &deblocked;
+	try {
+		filter = std::thread(filter_worker, &dst, &sao, &deblocked);
+	} catch (const std::system_error&) {
+		/* filtered after substreams */
+	}
+	bool decoded = substreams_run(job, hdr, thread_max, st, decode, aborted);
+	deblocked.abort();
+	if (filter.joinable()) {
+		filter.join();
+	}
+	dst.deblocked_progress = 0;
+	dst.sao = sao;
+	filter_rows(dst.sao, dst);
+	return decoded;
+}
+
+/** Decode WPP rows or tiles of a slice in parallel.
+ * Returns false if slice is not suitable, then it shall be decoded serially.
+ */
+static bool slice_data_parallel(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, int threads, dec_bits& st, bool& aborted) {
+	const h265d_pps_t& pps = *dst.pps;
+	bool wpp = pps.entropy_coding_sync_enabled_flag;
+	bool tiles = pps.tiles_enabled_flag;
+	if ((threads <= 1) || dst.stats || (wpp == tiles) || pps.dependent_slice_segments_enabled_flag) {
+		/* dependent slice segment would need the state at the end of substreams */
+		return false;
+	}
+	uint32_t num = hdr.entry_points.num_entry_point_offsets + 1;
+	if (wpp) {
+		if (dst.size->rows < dst.pos_y + num) {
+			return false;
+		}
+		h265d_substream_job_t job(&dst, &st, dst.row_progress, num, dst.pos_y);
+		return substreams_filtered(dst, job, hdr, threads, st, wpp_substream, aborted);
+	} else {
+		int32_t tile_progress[H265D_MAX_TILE_COLUMNS * H265D_MAX_TILE_ROWS];
+		uint32_t first_tile = dst.tile_row * dst.tile_columns + dst.tile_col;
+		if (static_cast<uint32_t>(dst.tile_columns * dst.tile_rows) < first_tile + num) {
+			return false;
+		}
+		h265d_substream_job_t job(&dst, &st, tile_progress, num, first_tile);
+		return substreams_filtered(dst, job, hdr, threads, st, tile_substream, aborted);
+	}
+}
+#endif
+
+static inline uint32_t end_of_subset_one_bit(h265d_cabac_t& cabac, dec_bits& st) {
+	return end_of_slice_segment_flag(cabac, st);
+}
+
+static void slice_data(h265d_ctu_t& dst, const h265d_slice_header_t& hdr, int threads, const h265d_pps_t& pps, const h265d_sps_t& sps, dec_bits& st) {
+	if (!ctu_resume(dst, hdr, pps, sps)) {
+		ctu_init(dst, hdr, pps, sps, st);
+	}
+	ctu_set_funcs_func[sps.ctb_info.size_log2 - 4](dst);
+#ifdef M2D_THREADS
+	bool aborted = false;
+	if (slice_data_parallel(dst, hdr, threads, st, aborted)) {
+		if (aborted) {
+			error_report(st);
+		}
+		return;
+	}
+#endif
 	init_cabac_engine(&dst.cabac.cabac, &st);
-	do {
-		coding_tree_unit(dst, st);
-		if (ctu_pos_increment(dst)) {
+	for (;;) {
+		dst.ctu_decode(dst, st);
+		wpp_store_context(dst);
+		if (dst.ctu_next(dst) || end_of_slice_segment_flag(dst.cabac, st)) {
+			if (pps.dependent_slice_segments_enabled_flag) {
+				dst.ds_context = *dst.cabac.context;
+			}
 			break;
 		}
-	} while (!end_of_slice_segment_flag(dst.cabac, st));
+		if (substream_head(dst)) {
+			end_of_subset_one_bit(dst.cabac, st);
+			byte_align(&st);
+			init_cabac_engine(&dst.cabac.cabac, &st);
+			substream_start(dst);
+		}
+	}
+}
+
+#ifdef M2D_THREADS
+/** Frame thread: decode slices of one picture as caller passes them.
+ */
+static void frame_job_main(h265d_frame_threads_t* ft, h265d_frame_job_t* job) {
+	h265d_ctu_t& ctu = job->ctu;
+	for (;;) {
+		h265d_frame_slice_t* slice;
+		{
+			std::unique_lock<std::mutex> lock(job->mutex);
+			while ((job->slice_num == 0) && !job->closed) {
+				job->cond.wait(lock);
+			}
+			if (job->slice_num == 0) {
+				break;
+			}
+			slice = &job->slices[job->slice_head];
+		}
+		if (setjmp(slice->st.jmp) == 0) {
+			slice_data(ctu, slice->header, 1, job->pps, job->sps, slice->st);
+		}
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->slice_head = (job->slice_head + 1) % H265D_FRAME_JOB_SLICES;
+			job->slice_num--;
+		}
+		job->cond.notify_all();
+	}
+	ft->progress.set(ctu.frame_info.index, H265D_FRAME_COMPLETE);
+	std::lock_guard<std::mutex> lock(job->mutex);
+	job->done = true;
+}
+
+/** Wait until a frame job decoded every slice passed so far.
+ */
+static void frame_job_drain(h265d_frame_job_t& job) {
+	std::unique_lock<std::mutex> lock(job.mutex);
+	while (job.slice_num != 0) {
+		job.cond.wait(lock);
+	}
+}
+
+/** No more slices for current picture.
+ */
+static void frame_threads_close(h265d_frame_threads_t& ft) {
+	if (ft.current < 0) {
+		return;
+	}
+	h265d_frame_job_t& job = ft.jobs[ft.current];
+	{
+		std::lock_guard<std::mutex> lock(job.mutex);
+		job.closed = true;
+	}
+	job.cond.notify_all();
+	ft.current = -1;
+}
+
+/** Complete every picture being decoded by frame threads.
+ */
+static void frame_threads_flush(h265d_data_t& h2d) {
+	h265d_frame_threads_t& ft = *h2d.frame_threads;
+	frame_threads_close(ft);
+	for (int i = 0; i < H265D_MAX_FRAME_JOBS; ++i) {
+		h265d_frame_job_t& job = ft.jobs[i];
+		if (job.thread.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(job.mutex);
+				job.closed = true;
+			}
+			job.cond.notify_all();
+			job.thread.join();
+		}
+	}
+}
+
+/** Frames which running frame threads write or refer to.
+ * Flushes them instead if no frame would be left for next picture.
+ */
+static uint32_t frame_threads_busy(h265d_data_t& h2d) {
+	h265d_frame_threads_t& ft = *h2d.frame_threads;
+	uint32_t busy = 0;
+	for (int i = 0; i < ft.num; ++i) {
+		h265d_frame_job_t& job = ft.jobs[i];
+		if (job.thread.joinable()) {
+			std::lock_guard<std::mutex> lock(job.mutex);
+			if (!job.done) {
+				busy |= job.frames_used;
+			}
+		}
+	}
+	const h265d_frame_info_t& frm = h2d.coding_tree_unit.frame_info;
+	uint32_t used = busy;
+	for (int i = 0; i < frm.num; ++i) {
+		if (dpb_exist(frm.dpb, i)) {
+			used |= 1 << i;
+		}
+	}
+	uint32_t all = (1 << frm.num) - 1;
+	if (busy && ((used & all) == all)) {
+		frame_threads_flush(h2d);
+		busy = 0;
+	}
+	return busy;
+}
+
+static uint32_t slice_ref_frames(const h265d_slice_header_body_t& header) {
+	uint32_t frames = 0;
+	int lx_num = (header.slice_type == 0) ? 2 : (header.slice_type == 1) ? 1 : 0;
+	for (int lx = 0; lx < lx_num; ++lx) {
+		for (int i = 0; i <= header.num_ref_idx_lx_active_minus1[lx]; ++i) {
+			int frame_idx = header.ref_list[lx][i].frame_idx;
+			if (static_cast<unsigned>(frame_idx) < static_cast<unsigned>(H265D_MAX_FRAME_NUM)) {
+				frames |= 1 << frame_idx;
+			}
+		}
+	}
+	return frames;
+}
+
+/** Start a frame thread for current picture, with a copy of CTU state which owns its work buffers.
+ */
+static h265d_frame_job_t* frame_job_start(h265d_data_t& h2d, const h265d_pps_t& pps, const h265d_sps_t& sps) {
+	h265d_frame_threads_t& ft = *h2d.frame_threads;
+	int idx = ft.next % MINV(ft.num, static_cast<int>(h2d.threads));
+	h265d_frame_job_t& job = ft.jobs[idx];
+	if (job.thread.joinable()) {
+		job.thread.join();
+	}
+	job.sps = sps;
+	job.pps = pps;
+	job.ctu = h2d.coding_tree_unit;
+	h265d_ctu_t& ctu = job.ctu;
+	set_work_buffers(job.sps, &ctu, job.work);
+	ctu.cabac.context = &ctu.context;
+	ctu.size = &job.sps.ctb_info;
+	h265d_frame_info_t& frm = ctu.frame_info;
+	frm.frame_progress = &ft.progress;
+	memset(frm.rows_ready, 0, sizeof(frm.rows_ready));
+	job.slice_head = 0;
+	job.slice_num = 0;
+	job.closed = false;
+	job.done = false;
+	job.frames_used = 1 << frm.index;
+	job.stream_used = 0;
+	ft.progress.set(frm.index, 0);
+	try {
+		job.thread = std::thread(frame_job_main, &ft, &job);
+	} catch (const std::system_error&) {
+		ft.progress.set(frm.index, H265D_FRAME_COMPLETE);
+		ft.num = 0;
+		return 0;
+	}
+	ft.current = idx;
+	ft.next = idx + 1;
+	return &job;
+}
+
+/** Pass current slice to a frame thread.
+ * Returns false if the slice shall be decoded by caller, after every frame thread completed.
+ */
+static bool frame_threads_submit(h265d_data_t& h2d, const h265d_pps_t& pps, const h265d_sps_t& sps, dec_bits& st) {
+	h265d_frame_threads_t& ft = *h2d.frame_threads;
+	h265d_ctu_t& ctu = h2d.coding_tree_unit;
+	const h265d_slice_header_t& hdr = h2d.slice_header;
+	const byte_t* data = 0;
+	size_t len = 0;
+	if ((1 < h2d.threads) && (0 < ft.num) && !ctu.stats && !pps.entropy_coding_sync_enabled_flag && !pps.tiles_enabled_flag) {
+		const byte_t* tail = dec_bits_tail(&st);
+		data = m2d_stream_raw_pos_skip03(&st);
+		int code = (data && (st.buf_head_ + 2 <= data)) ? m2d_next_start_code(data, static_cast<int>(tail - data)) : -1;
+		if (3 <= code) {
+			len = code - 3;
+		} else {
+			data = 0;
+		}
+	}
+	h265d_frame_job_t* job = 0;
+	if (data) {
+		if (hdr.first_slice_segment_in_pic_flag) {
+			if (len + 2 <= ft.jobs[0].stream_size) {
+				job = frame_job_start(h2d, pps, sps);
+			}
+		} else if ((0 <= ft.current) && (ft.jobs[ft.current].stream_used + len + 2 <= ft.jobs[ft.current].stream_size)) {
+			job = &ft.jobs[ft.current];
+		}
+	}
+	if (!job && (hdr.first_slice_segment_in_pic_flag || (ft.current < 0))) {
+		frame_threads_flush(h2d);
+		return false;
+	}
+	frame_set_info(ctu.frame_info, sps, hdr.body.slice_pic_order_cnt.poc);
+	ctu.colpics.register_reflist(ctu.frame_info.index, hdr.body.ref_list);
+	if (!job) {
+		/* continue on the state of current picture, while its thread waits for slices */
+		job = &ft.jobs[ft.current];
+		frame_job_drain(*job);
+		{
+			std::lock_guard<std::mutex> lock(job->mutex);
+			job->frames_used |= slice_ref_frames(hdr.body);
+		}
+		slice_data(job->ctu, hdr, 1, job->pps, job->sps, st);
+		return true;
+	}
+	byte_t* dst = job->stream + job->stream_used;
+	memcpy(dst, data - 2, len + 2);
+	job->stream_used += len + 2;
+	{
+		std::unique_lock<std::mutex> lock(job->mutex);
+		while (job->slice_num == H265D_FRAME_JOB_SLICES) {
+			job->cond.wait(lock);
+		}
+		h265d_frame_slice_t& slice = job->slices[(job->slice_head + job->slice_num) % H265D_FRAME_JOB_SLICES];
+		slice.header = hdr;
+		m2d_substream_open(&slice.st, &st, dst + 2, len);
+		job->frames_used |= slice_ref_frames(hdr.body);
+		job->slice_num++;
+	}
+	job->cond.notify_all();
+	return true;
+}
+
+/** Wait until a frame to be output is completed by frame threads.
+ */
+static void frame_threads_wait_output(h265d_data_t& h2d, const m2d_frame_t& frame) {
+	h265d_frame_threads_t& ft = *h2d.frame_threads;
+	const h265d_frame_info_t& frm = h2d.coding_tree_unit.frame_info;
+	for (int i = 0; i < frm.num; ++i) {
+		if (frm.frames[i].luma != frame.luma) {
+			continue;
+		}
+		if ((0 <= ft.current) && (ft.jobs[ft.current].ctu.frame_info.index == i)) {
+			/* same as serial decoding: slices passed so far */
+			frame_job_drain(ft.jobs[ft.current]);
+		} else {
+			ft.progress.wait(i, H265D_FRAME_COMPLETE);
+		}
+		break;
+	}
 }
+#endif
 
 static void insert_dpb(h265d_dpb_t& dpb, int frame_idx, uint32_t poc, bool is_idr);
 
-static void slice_layer(h265d_data_t& h2d, dec_bits& st) {
+static inline bool is_irap(h265d_nal_t nal_type) {
+	return (BLA_W_LP <= nal_type) && (nal_type <= RSV_IRAP_VCL23);
+}
+
+/** Random access: pictures before the first IRAP picture, and RASL pictures associated with
+ * an IRAP picture of NoRaslOutputFlag, are skipped without being decoded.
+ */
+static bool random_access_decodable(h265d_data_t& h2d, h265d_nal_t nal_type, bool first_slice) {
+	if (is_irap(nal_type)) {
+		if (first_slice) {
+			h2d.no_rasl_output = (nal_type != CRA_NUT) || !h2d.irap_decoded;
+			h2d.irap_decoded = true;
+		}
+		return h2d.irap_decoded;
+	} else if ((nal_type == RASL_N) || (nal_type == RASL_R)) {
+		return h2d.irap_decoded && !h2d.no_rasl_output;
+	} else {
+		return h2d.irap_decoded;
+	}
+}
+
+static bool slice_layer(h265d_data_t& h2d, dec_bits& st) {
 	h265d_slice_header_t& header = h2d.slice_header;
+	uint8_t first_slice = get_onebit(&st);
+	if (!random_access_decodable(h2d, h2d.current_nal, first_slice)) {
+		return false;
+	}
 	header.body.nal_type = h2d.current_nal;
-	if ((header.first_slice_segment_in_pic_flag = get_onebit(&st)) != 0) {
+	header.body.no_rasl_output_flag = is_irap(h2d.current_nal) && h2d.no_rasl_output;
+	if ((header.first_slice_segment_in_pic_flag = first_slice) != 0) {
+#ifdef M2D_THREADS
+		frame_threads_close(*h2d.frame_threads);
+		find_empty_frame(h2d.coding_tree_unit.frame_info, frame_threads_busy(h2d));
+#else
 		find_empty_frame(h2d.coding_tree_unit.frame_info);
+#endif
+		if (h2d.coding_tree_unit.stats) {
+			m2d_stats_init(h2d.coding_tree_unit.stats);
+		}
 	}
-	if ((BLA_W_LP <= h2d.current_nal) &&  (h2d.current_nal <= RSV_IRAP_VCL23)) {
+	if (is_irap(h2d.current_nal)) {
 		header.no_output_of_prior_pics_flag = get_onebit(&st);
 	}
 	READ_CHECK_RANGE(ue_golomb(&st), header.pps_id, 63, st);
 	const h265d_pps_t& pps = h2d.pps[header.pps_id];
 	const h265d_sps_t& sps = h2d.sps[pps.sps_id];
 	h2d.coding_tree_unit.size = &sps.ctb_info;
+	if (header.first_slice_segment_in_pic_flag) {
+		h265d_frame_info_t& frm = h2d.coding_tree_unit.frame_info;
+		h2d.coding_tree_unit.mb_info = frm.frames[frm.index].mb_info = m2d_mb_info_frame(frm.mb_info, frm.mb_info_size, frm.index, mb_info_num(sps));
+	}
 	slice_header(header, h2d.coding_tree_unit.frame_info.dpb, pps, sps, st);
-	slice_data(h2d.coding_tree_unit, h2d, pps, sps, st);
-	sao_oneframe(h2d.coding_tree_unit);
-	insert_dpb(h2d.coding_tree_unit.frame_info.dpb, h2d.coding_tree_unit.frame_info.index, h2d.slice_header.body.slice_pic_order_cnt.poc, (header.body.nal_type == IDR_W_RADL) || (header.body.nal_type == IDR_N_LP));
+	if (h2d.coding_tree_unit.stats) {
+		static const int8_t pic_type[3] = {
+			M2D_PICTYPE_B, M2D_PICTYPE_P, M2D_PICTYPE_I
+		};
+		m2d_stats_pic_type(h2d.coding_tree_unit.stats, pic_type[header.body.slice_type]);
+	}
+#ifdef M2D_THREADS
+	if (!frame_threads_submit(h2d, pps, sps, st))
+#endif
+	{
+		slice_data(h2d.coding_tree_unit, header, h2d.threads, pps, sps, st);
+	}
+	return true;
+}
+
+/** Finish current picture after its last slice segment: store it into DPB.
+ * Returns false if no picture is open.
+ */
+static bool picture_finish(h265d_data_t& h2d) {
+	if (!h2d.picture_open) {
+		return false;
+	}
+	h2d.picture_open = false;
+	const h265d_slice_header_body_t& body = h2d.slice_header.body;
+	insert_dpb(h2d.coding_tree_unit.frame_info.dpb, h2d.coding_tree_unit.frame_info.index, body.slice_pic_order_cnt.poc, (body.nal_type == IDR_W_RADL) || (body.nal_type == IDR_N_LP));
+	return true;
+}
+
+/** Whether next NAL unit begins a new picture, peeked without consuming it.
+ * Dependent and following slice segments have first_slice_segment_in_pic_flag unset.
+ */
+static bool picture_boundary(dec_bits& st) {
+	uint32_t nal_type = (show_bits(&st, 16) >> 9) & 63;
+	if (nal_type < VPS_NAL) {
+		return (show_bits(&st, 17) & 1) != 0;
+	}
+	return (nal_type == AUD_NAL) || (nal_type == EOS_NAL) || (nal_type == EOB_NAL);
 }
 
 static int dispatch_one_nal(h265d_data_t& h2d, uint32_t nalu_header) {
 	int err = 0;
 	dec_bits& st = h2d.stream_i;
+	m2d_stream_mark_t mark;
 	switch (h2d.current_nal = static_cast<h265d_nal_t>((nalu_header >> 9) & 63)) {
 	case TRAIL_N:
 	case TRAIL_R:
+	case TSA_N:
+	case TSA_R:
+	case STSA_N:
+	case STSA_R:
+	case RADL_N:
+	case RADL_R:
+	case RASL_N:
+	case RASL_R:
+	case BLA_W_LP:
+	case BLA_W_RADL:
+	case BLA_N_LP:
 	case IDR_W_RADL:
-		slice_layer(h2d, st);
-		err = 1;
+	case IDR_N_LP:
+	case CRA_NUT:
+		m2d_stream_mark(&mark, &st);
+		if (slice_layer(h2d, st)) {
+			if (h2d.coding_tree_unit.stats) {
+				h2d.coding_tree_unit.stats->bits += 40 + m2d_stream_bits_from(&mark, &st);
+			}
+			h2d.picture_open = true;
+		}
 		break;
 	case VPS_NAL:
 		video_parameter_set(h2d, st);
@@ -4888,6 +6498,9 @@ static int dispatch_one_nal(h265d_data_t& h2d, uint32_t nalu_header) {
 	case AUD_NAL:
 		au_delimiter(h2d, st);
 		break;
+	case EOS_NAL:
+		h2d.irap_decoded = false;
+		break;
 	default:
 		skip_nal(h2d, st);
 		break;
@@ -4902,15 +6515,26 @@ int h265d_decode_picture(h265d_context *h2) {
 	h265d_data_t& h2d = *reinterpret_cast<h265d_data_t*>(h2);
 	dec_bits* stream = &h2d.stream_i;
 	if (setjmp(stream->jmp) != 0) {
+		h2d.nal_pending = false;
 		return -2;
 	}
 /*	h2d->slice_header->first_mb_in_slice = UINT_MAX;*/
 	int err = 0;
 	uint32_t nalu_header = 0;
 	do {
-		if (0 <= (err = m2d_find_mpeg_data(stream))) {
+		if (h2d.nal_pending || (0 <= (err = m2d_find_mpeg_data(stream)))) {
+			h2d.nal_pending = false;
+			if (h2d.picture_open && picture_boundary(*stream)) {
+				/* leave the NAL unit to next call, so that the picture returns with its own stats */
+				h2d.nal_pending = true;
+				picture_finish(h2d);
+				err = 1;
+				break;
+			}
 			nalu_header = get_bits(stream, 16);
 			err = dispatch_one_nal(h2d, nalu_header);
+		} else if (picture_finish(h2d)) {
+			err = 1;
 		} else {
 			error_report(*stream);
 		}
@@ -4994,7 +6618,19 @@ int h265d_peek_decoded_frame(h265d_context *h2, m2d_frame_t *frame, int bypass_d
 	if (!h2 || !frame) {
 		return -1;
 	}
-	return peek_decoded_frame(reinterpret_cast<h265d_data_t*>(h2)->coding_tree_unit.frame_info, frame, bypass_dpb);
+	h265d_data_t& h2d = *reinterpret_cast<h265d_data_t*>(h2);
+#ifdef M2D_THREADS
+	if (bypass_dpb) {
+		frame_threads_flush(h2d);
+	}
+#endif
+	int idx = peek_decoded_frame(h2d.coding_tree_unit.frame_info, frame, bypass_dpb);
+#ifdef M2D_THREADS
+	if (0 < idx) {
+		frame_threads_wait_output(h2d, *frame);
+	}
+#endif
+	return idx;
 }
 
 int h265d_get_decoded_frame(h265d_context *h2, m2d_frame_t *frame, int bypass_dpb)
@@ -5007,6 +6643,62 @@ int h265d_get_decoded_frame(h265d_context *h2, m2d_frame_t *frame, int bypass_dp
 	return idx;
 }
 
+/** Switch to analysis mode, which parses streams without reconstruction.
+ * stats is filled with a record of each picture. NULL resumes decoding.
+ */
+int h265d_set_analysis(h265d_context *h2, m2d_picture_stats_t *stats) {
+	if (!h2) {
+		return -1;
+	}
+	reinterpret_cast<h265d_data_t*>(h2)->coding_tree_unit.stats = stats;
+	return 0;
+}
+
+/** Export side data of 16x16 blocks with each decoded frame.
+ * mb_info holds size entries, which are split among frames by mb_info_num
+ * of h265d_get_info(). Frames without room have NULL mb_info.
+ */
+int h265d_set_mb_info(h265d_context *h2, m2d_mb_info_t *mb_info, int size) {
+	if (!h2 || (size < 0)) {
+		return -1;
+	}
+	h265d_ctu_t& ctu = reinterpret_cast<h265d_data_t*>(h2)->coding_tree_unit;
+	ctu.frame_info.mb_info = mb_info;
+	ctu.frame_info.mb_info_size = size;
+	ctu.mb_info = 0;
+	return 0;
+}
+
+/** Reconstruct luma only. Chroma is still parsed, and chroma of frames may be NULL.
+ */
+int h265d_set_luma_only(h265d_context *h2, int luma_only) {
+	if (!h2) {
+		return -1;
+	}
+	reinterpret_cast<h265d_data_t*>(h2)->coding_tree_unit.luma_only = (luma_only != 0);
+	return 0;
+}
+
+/** Request number of threads including the caller's, which decode CTU rows of WPP slices, tiles,
+ * or else following pictures in parallel while referring to completed CTU rows of preceding ones.
+ * Frame threads are used only if second_frame has room for them, as reported by h265d_get_info()
+ * after this call. They keep running between calls, so that remaining frames shall be got with
+ * bypass_dpb before the context is discarded.
+ * Returns number of threads to be used.
+ */
+int h265d_set_threads(h265d_context *h2, int num) {
+	if (!h2 || (num < 1)) {
+		return -1;
+	}
+#ifdef M2D_THREADS
+	num = MINV(num, M2D_MAX_THREADS);
+#else
+	num = 1;
+#endif
+	reinterpret_cast<h265d_data_t*>(h2)->threads = num;
+	return num;
+}
+
 static const m2d_func_table_t h265d_func_ = {
 	sizeof(h265d_data_t),
 	(int (*)(void *, int, int (*)(void *, void *), void *))h265d_init,
@@ -5015,7 +6707,12 @@ static const m2d_func_table_t h265d_func_ = {
 	(int (*)(void *, int, m2d_frame_t *, uint8_t *, int))h265d_set_frames,
 	(int (*)(void *))h265d_decode_picture,
 	(int (*)(void *, m2d_frame_t *, int))h265d_peek_decoded_frame,
-	(int (*)(void *, m2d_frame_t *, int))h265d_get_decoded_frame
+	(int (*)(void *, m2d_frame_t *, int))h265d_get_decoded_frame,
+	(int (*)(void *, m2d_picture_stats_t *))h265d_set_analysis,
+	(int (*)(void *, m2d_mb_info_t *, int))h265d_set_mb_info,
+	(int (*)(void *, int))h265d_set_luma_only,
+	h265d_probe,
+	(int (*)(void *, int))h265d_set_threads
 };
 
 extern "C" {
@@ -25,6 +25,11 @@
 #if (defined(__GNUC__) && defined(__SSE2__)) || defined(_M_IX86) || defined(_M_AMD64)
 #define X86ASM
 #include <emmintrin.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
 
 #include <assert.h>
 #include <string.h>
@@ -958,4 +963,1267 @@ void transform_ac32x32chroma(uint8_t* dst, int16_t* src, int stride) {
 	transform_ac32x32bit(dst, src, src + 32 * 32, stride, 8, idct32x32writechroma());
 }
 
+/* Inverse transform of blocks whose non-zero coefficients are within top-left kx x ky,
+ * as one level of even/odd decomposition over the kx columns and ky rows only.
+ * Outputs are bit-exact with full-size transforms.
+ */
+
+struct idct_vec128 {
+	typedef __m128i type;
+	enum { N = 8 };
+	static type load(const int16_t* src) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+	static void store(int16_t* dst, const type& v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v); }
+	static type set1_32(int v) { return _mm_set1_epi32(v); }
+	static type unpacklo(const type& a, const type& b) { return _mm_unpacklo_epi16(a, b); }
+	static type unpackhi(const type& a, const type& b) { return _mm_unpackhi_epi16(a, b); }
+	static type madd(const type& a, const type& b) { return _mm_madd_epi16(a, b); }
+	static type add32(const type& a, const type& b) { return _mm_add_epi32(a, b); }
+	static type sub32(const type& a, const type& b) { return _mm_sub_epi32(a, b); }
+	static type sra32(const type& a, int shift) { return _mm_srai_epi32(a, shift); }
+	static type packs32(const type& lo, const type& hi) { return _mm_packs_epi32(lo, hi); }
+	static type reverse32(const type& a) { return _mm_shuffle_epi32(a, 0x1b); }
+	static type pair_order(const type& a) { return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xd8), 0xd8); }
+	static void pack_row(const type src[], int num, __m128i dst[]) {
+		for (int i = 0; i < num; i += 2) {
+			dst[i >> 1] = _mm_packs_epi32(src[i], src[i + 1]);
+		}
+	}
+};
+
+#ifdef __AVX2__
+struct idct_vec256 {
+	typedef __m256i type;
+	enum { N = 16 };
+	static type load(const int16_t* src) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)); }
+	static void store(int16_t* dst, const type& v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v); }
+	static type set1_32(int v) { return _mm256_set1_epi32(v); }
+	static type unpacklo(const type& a, const type& b) { return _mm256_unpacklo_epi16(a, b); }
+	static type unpackhi(const type& a, const type& b) { return _mm256_unpackhi_epi16(a, b); }
+	static type madd(const type& a, const type& b) { return _mm256_madd_epi16(a, b); }
+	static type add32(const type& a, const type& b) { return _mm256_add_epi32(a, b); }
+	static type sub32(const type& a, const type& b) { return _mm256_sub_epi32(a, b); }
+	static type sra32(const type& a, int shift) { return _mm256_srai_epi32(a, shift); }
+	static type packs32(const type& lo, const type& hi) { return _mm256_packs_epi32(lo, hi); }
+	static type reverse32(const type& a) { return _mm256_permutevar8x32_epi32(a, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0)); }
+	static type pair_order(const type& a) { return _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(a, 0xd8), 0xd8); }
+	static void pack_row(const type src[], int num, __m128i dst[]) {
+		for (int i = 0; i < num; ++i) {
+			dst[i] = _mm_packs_epi32(_mm256_castsi256_si128(src[i]), _mm256_extracti128_si256(src[i], 1));
+		}
+	}
+};
+typedef idct_vec256 idct_vec;
+#else
+typedef idct_vec128 idct_vec;
+#endif
+
+/** Transform matrices of 16 and 32 points, as pairs of rows for pmaddwd.
+ * Pair p of N-point matrix holds rows (4p, 4p + 2) for p < N / 4, and rows (4p' + 1, 4p' + 3) for p' = p - N / 4,
+ * with the first N / 2 columns interleaved.
+ */
+struct idct_pair_matrix_t {
+	ALIGNVC(32) int16_t pair[2][16 * 32];
+	idct_pair_matrix_t() {
+		static const int8_t cos64[33] = {
+			64, 90, 90, 90, 89, 88, 87, 85, 83, 82, 80, 78, 75, 73, 70, 67,
+			64, 61, 57, 54, 50, 46, 43, 38, 36, 31, 25, 22, 18, 13, 9, 4, 0
+		};
+		for (int log2 = 4; log2 <= 5; ++log2) {
+			int size = 1 << log2;
+			for (int p = 0; p < size / 2; ++p) {
+				int row = (p < size / 4) ? p * 4 : (p - size / 4) * 4 + 1;
+				for (int i = 0; i < 2; ++i) {
+					int k = (row + i * 2) << (5 - log2);
+					for (int j = 0; j < size / 2; ++j) {
+						int m = (k * (j * 2 + 1)) & 127;
+						int c = (m <= 32) ? cos64[m] : (m <= 64) ? -cos64[64 - m] : (m <= 96) ? -cos64[m - 64] : cos64[128 - m];
+						pair[log2 - 4][p * size + j * 2 + i] = static_cast<int16_t>(c);
+					}
+				}
+			}
+		}
+	}
+};
+
+static const idct_pair_matrix_t idct_pair_matrix;
+
+static inline int idct_pair_at(const int16_t* pair) {
+	return *reinterpret_cast<const int32_t*>(pair);
+}
+
+/** Vertical pass of kx columns, ky rows of src into N x N tmp, which is rounded and saturated to 16 bits.
+ * Each 4 samples of tmp rows are stored as 0, 2, 1, 3, to be read as pairs in the horizontal pass.
+ */
+template <typename V, int LOG2>
+static void idct_sparse_vert(const int16_t* src, int16_t* tmp, int kx, int ky) {
+	typedef typename V::type vec;
+	const int size = 1 << LOG2;
+	const int16_t* matrix = idct_pair_matrix.pair[LOG2 - 4];
+	const vec rnd = V::set1_32(64);
+	int pairs = ky >> 2;
+	for (int x = 0; x < kx; x += V::N) {
+		vec even[size / 4][2], odd[size / 4][2];
+		for (int p = 0; p < pairs; ++p) {
+			const int16_t* s = src + size * 4 * p + x;
+			vec r0 = V::load(s);
+			vec r1 = V::load(s + size);
+			vec r2 = V::load(s + size * 2);
+			vec r3 = V::load(s + size * 3);
+			even[p][0] = V::unpacklo(r0, r2);
+			even[p][1] = V::unpackhi(r0, r2);
+			odd[p][0] = V::unpacklo(r1, r3);
+			odd[p][1] = V::unpackhi(r1, r3);
+		}
+		for (int y = 0; y < size / 2; ++y) {
+			vec e[2], o[2];
+			for (int p = 0; p < pairs; ++p) {
+				vec ce = V::set1_32(idct_pair_at(matrix + p * size + y * 2));
+				vec co = V::set1_32(idct_pair_at(matrix + (p + size / 4) * size + y * 2));
+				for (int i = 0; i < 2; ++i) {
+					vec te = V::madd(even[p][i], ce);
+					vec to = V::madd(odd[p][i], co);
+					e[i] = p ? V::add32(e[i], te) : te;
+					o[i] = p ? V::add32(o[i], to) : to;
+				}
+			}
+			for (int i = 0; i < 2; ++i) {
+				e[i] = V::add32(e[i], rnd);
+			}
+			V::store(tmp + size * y + x, V::pair_order(V::packs32(V::sra32(V::add32(e[0], o[0]), 7), V::sra32(V::add32(e[1], o[1]), 7))));
+			V::store(tmp + size * (size - 1 - y) + x, V::pair_order(V::packs32(V::sra32(V::sub32(e[0], o[0]), 7), V::sra32(V::sub32(e[1], o[1]), 7))));
+		}
+	}
+}
+
+struct idct_sparse_write {
+	void operator()(uint8_t* dst, const __m128i& res) const {
+		__m128i s0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(dst)), _mm_setzero_si128());
+		__m128i d0 = _mm_adds_epi16(s0, res);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(d0, d0));
+	}
+};
+
+struct idct_sparse_write_chroma {
+	void operator()(uint8_t* dst, const __m128i& res) const {
+		__m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst));
+		__m128i other = _mm_srli_epi16(s0, 8);
+		__m128i d0 = _mm_adds_epi16(_mm_and_si128(s0, *reinterpret_cast<const __m128i*>(cmask)), res);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_unpacklo_epi8(_mm_packus_epi16(d0, d0), _mm_packus_epi16(other, other)));
+	}
+};
+
+/** Horizontal pass of kx columns in every row of tmp, added to dst.
+ */
+template <typename V, int LOG2, int UNIT, typename F>
+static void idct_sparse_horiz(const int16_t* tmp, uint8_t* dst, int stride, int kx, F Write) {
+	typedef typename V::type vec;
+	const int size = 1 << LOG2;
+	const int half = (size / 2) / (V::N / 2);
+	const int16_t* matrix = idct_pair_matrix.pair[LOG2 - 4];
+	const vec rnd = V::set1_32(1 << 11);
+	int pairs = kx >> 2;
+	for (int y = 0; y < size; ++y) {
+		const int16_t* s = tmp + size * y;
+		vec e[half], o[half];
+		for (int p = 0; p < pairs; ++p) {
+			vec ce = V::set1_32(idct_pair_at(s + p * 4));
+			vec co = V::set1_32(idct_pair_at(s + p * 4 + 2));
+			for (int i = 0; i < half; ++i) {
+				vec te = V::madd(ce, V::load(matrix + p * size + i * V::N));
+				vec to = V::madd(co, V::load(matrix + (p + size / 4) * size + i * V::N));
+				e[i] = p ? V::add32(e[i], te) : te;
+				o[i] = p ? V::add32(o[i], to) : to;
+			}
+		}
+		vec out[half * 2];
+		for (int i = 0; i < half; ++i) {
+			vec e0 = V::add32(e[i], rnd);
+			out[i] = V::sra32(V::add32(e0, o[i]), 12);
+			out[half * 2 - 1 - i] = V::reverse32(V::sra32(V::sub32(e0, o[i]), 12));
+		}
+		__m128i res[size / 8];
+		V::pack_row(out, half * 2, res);
+		for (int i = 0; i < size / 8; ++i) {
+			Write(dst + i * 8 * UNIT, res[i]);
+		}
+		dst += stride;
+	}
+}
+
+template <typename V, int LOG2, int UNIT, typename F>
+static void idct_sparse(uint8_t* dst, int16_t* coeff, int stride, int kx, int ky, F Write) {
+	int16_t* tmp = coeff + (1 << (LOG2 * 2));
+	idct_sparse_vert<V, LOG2>(coeff, tmp, kx, ky);
+	idct_sparse_horiz<V, LOG2, UNIT>(tmp, dst, stride, kx, Write);
+}
+
+static inline int idct_extent(uint32_t pos_sum) {
+	return (pos_sum < 4) ? 4 : (pos_sum < 8) ? 8 : (pos_sum < 16) ? 16 : 32;
+}
+
+/** Whether transform of kx x ky columns and rows is faster than full-size butterflies.
+ */
+static inline bool idct_sparse_preferred(int size_log2, int kx, int ky) {
+#ifdef __AVX2__
+	return (size_log2 == 4) ? ((kx < 16) || (ky < 16)) : (kx < 32);
+#else
+	return (kx <= 8) && (kx * ky <= (1 << (size_log2 * 2 - 2)));
+#endif
+}
+
+/** Inverse transform of 8x8 to 32x32 blocks with AC coefficients.
+ * xy_pos_sum is bitwise OR of raster positions of all non-zero coefficients,
+ * which bounds columns and rows to be transformed in powers of two.
+ */
+void transform_ac_x86(uint8_t* dst, int16_t* coeff, int stride, int size_log2, bool chroma, uint32_t xy_pos_sum) {
+	static void (* const full_func[2][3])(uint8_t* dst, int16_t* coeff, int stride) = {
+		{transform_ac8x8, transform_ac16x16, transform_ac32x32},
+		{transform_ac8x8chroma, transform_ac16x16chroma, transform_ac32x32chroma}
+	};
+	int kx = idct_extent(xy_pos_sum & ((1 << size_log2) - 1));
+	int ky = idct_extent(xy_pos_sum >> size_log2);
+	if ((size_log2 == 3) || !idct_sparse_preferred(size_log2, kx, ky)) {
+		full_func[chroma][size_log2 - 3](dst, coeff, stride);
+	} else if (size_log2 == 4) {
+		if (chroma) {
+			idct_sparse<idct_vec, 4, 2>(dst, coeff, stride, kx, ky, idct_sparse_write_chroma());
+		} else {
+			idct_sparse<idct_vec, 4, 1>(dst, coeff, stride, kx, ky, idct_sparse_write());
+		}
+	} else {
+		if (chroma) {
+			idct_sparse<idct_vec, 5, 2>(dst, coeff, stride, kx, ky, idct_sparse_write_chroma());
+		} else {
+			idct_sparse<idct_vec, 5, 1>(dst, coeff, stride, kx, ky, idct_sparse_write());
+		}
+	}
+}
+
+/* SAO: 16 or 32 bytes of luma, or of interleaved Cb and Cr, at once.
+ * Lookup of offsets uses pshufb where available.
+ */
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define SAO_SHUFFLE
+#endif
+
+struct sao_vec128 {
+	typedef __m128i type;
+	enum { BYTES = 16 };
+	static type load(const void* src) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+	static void store(void* dst, const type& v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v); }
+	static type table(const int8_t* src) { return load(src); }
+	static type set1(int v) { return _mm_set1_epi8(static_cast<char>(v)); }
+	static type set2(int even, int odd) { return _mm_set1_epi16(static_cast<short>(static_cast<uint16_t>((even & 255) | ((odd & 255) << 8)))); }
+	static type and_(const type& a, const type& b) { return _mm_and_si128(a, b); }
+	static type or_(const type& a, const type& b) { return _mm_or_si128(a, b); }
+	static type xor_(const type& a, const type& b) { return _mm_xor_si128(a, b); }
+	static type add(const type& a, const type& b) { return _mm_add_epi8(a, b); }
+	static type sub(const type& a, const type& b) { return _mm_sub_epi8(a, b); }
+	static type adds(const type& a, const type& b) { return _mm_adds_epi8(a, b); }
+	static type subs_u(const type& a, const type& b) { return _mm_subs_epu8(a, b); }
+	static type cmpeq(const type& a, const type& b) { return _mm_cmpeq_epi8(a, b); }
+	static type cmpgt(const type& a, const type& b) { return _mm_cmpgt_epi8(a, b); }
+	static type srl3(const type& a) { return _mm_srli_epi16(a, 3); }
+#ifdef SAO_SHUFFLE
+	static type shuffle(const type& t, const type& idx) { return _mm_shuffle_epi8(t, idx); }
+#endif
+};
+
+#ifdef __AVX2__
+struct sao_vec256 {
+	typedef __m256i type;
+	enum { BYTES = 32 };
+	static type load(const void* src) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)); }
+	static void store(void* dst, const type& v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v); }
+	static type table(const int8_t* src) { return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))); }
+	static type set1(int v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+	static type set2(int even, int odd) { return _mm256_set1_epi16(static_cast<short>(static_cast<uint16_t>((even & 255) | ((odd & 255) << 8)))); }
+	static type and_(const type& a, const type& b) { return _mm256_and_si256(a, b); }
+	static type or_(const type& a, const type& b) { return _mm256_or_si256(a, b); }
+	static type xor_(const type& a, const type& b) { return _mm256_xor_si256(a, b); }
+	static type add(const type& a, const type& b) { return _mm256_add_epi8(a, b); }
+	static type sub(const type& a, const type& b) { return _mm256_sub_epi8(a, b); }
+	static type adds(const type& a, const type& b) { return _mm256_adds_epi8(a, b); }
+	static type subs_u(const type& a, const type& b) { return _mm256_subs_epu8(a, b); }
+	static type cmpeq(const type& a, const type& b) { return _mm256_cmpeq_epi8(a, b); }
+	static type cmpgt(const type& a, const type& b) { return _mm256_cmpgt_epi8(a, b); }
+	static type srl3(const type& a) { return _mm256_srli_epi16(a, 3); }
+	static type shuffle(const type& t, const type& idx) { return _mm256_shuffle_epi8(t, idx); }
+};
+typedef sao_vec256 sao_vec;
+#else
+typedef sao_vec128 sao_vec;
+#endif
+
+/** Offsets of 4 categories; Cb in even bytes and Cr in odd bytes, or luma in both.
+ * map gives table position of each category, and -1 for no offset.
+ */
+template <typename V>
+class sao_offset_lookup {
+	typedef typename V::type vec;
+#ifdef SAO_SHUFFLE
+	vec table_;
+#else
+	vec offset_[4];
+#endif
+public:
+	sao_offset_lookup(const int8_t* offset0, const int8_t* offset1, const int8_t map[8]) {
+#ifdef SAO_SHUFFLE
+		ALIGNVC(16) int8_t table[16];
+		for (int i = 0; i < 8; ++i) {
+			table[i] = (0 <= map[i]) ? offset0[map[i]] : 0;
+			table[i + 8] = (0 <= map[i]) ? offset1[map[i]] : 0;
+		}
+		table_ = V::table(table);
+#else
+		for (int i = 0; i < 8; ++i) {
+			if (0 <= map[i]) {
+				offset_[map[i]] = V::set2(offset0[map[i]], offset1[map[i]]);
+			}
+		}
+#endif
+	}
+	/** idx: table position, 8 shall be added to odd bytes, and negative gives no offset.
+	 */
+	vec lookup(const vec& idx, const int8_t map[8]) const {
+#ifdef SAO_SHUFFLE
+		return V::shuffle(table_, idx);
+#else
+		vec parity = V::set2(0, 8);
+		vec dst = V::set1(0);
+		for (int i = 0; i < 8; ++i) {
+			if (0 <= map[i]) {
+				dst = V::or_(dst, V::and_(V::cmpeq(idx, V::add(parity, V::set1(i))), offset_[map[i]]));
+			}
+		}
+		return dst;
+#endif
+	}
+};
+
+static const int8_t sao_edge_map[8] = {
+	0, 1, -1, 2, 3, -1, -1, -1
+};
+
+static const int8_t sao_band_map[8] = {
+	0, 1, 2, 3, -1, -1, -1, -1
+};
+
+/** Unsigned add of signed offsets, saturated to 0..255.
+ */
+template <typename V>
+static inline typename V::type sao_apply(const typename V::type& src, const typename V::type& offset) {
+	typename V::type bias = V::set1(0x80);
+	return V::xor_(V::adds(V::xor_(src, bias), offset), bias);
+}
+
+/** 1, 0 or -1 for each byte as signed difference of a and b.
+ */
+template <typename V>
+static inline typename V::type sao_sign(const typename V::type& a, const typename V::type& b) {
+	typename V::type zero = V::set1(0);
+	return V::sub(V::cmpeq(V::subs_u(a, b), zero), V::cmpeq(V::subs_u(b, a), zero));
+}
+
+template <typename V>
+static inline void sao_store(uint8_t* dst, const typename V::type& v, int len) {
+	if (V::BYTES <= len) {
+		V::store(dst, v);
+	} else {
+		ALIGNVC(32) uint8_t tmp[V::BYTES];
+		V::store(tmp, v);
+		memcpy(dst, tmp, len);
+	}
+}
+
+/** Rows of original samples are copied to lines, since row above is modified in advance.
+ * line[i] + 32 corresponds to dst + x0 of each row, with xgap bytes of margin except for vertical edge.
+ */
+template <typename V, int EDGE>
+static void sao_edge_rows(uint8_t* dst, const int8_t* offset0, const int8_t* offset1, int x0, int x1, int y0, int y1, int xgap, int stride, uint8_t* lines) {
+	typedef typename V::type vec;
+	sao_offset_lookup<V> lut(offset0, offset1, sao_edge_map);
+	vec base = V::set2(2, 10);
+	int len = x1 - x0;
+	int margin = (EDGE == 1) ? 0 : xgap;
+	int line_size = (len + 96) & ~31;
+	uint8_t* line[3] = {
+		lines, lines + line_size, lines + line_size * 2
+	};
+	dst += x0;
+	if (EDGE != 0) {
+		memcpy(line[0] + 32 - margin, dst + (y0 - 1) * stride - margin, len + margin * 2);
+		memcpy(line[1] + 32 - margin, dst + y0 * stride - margin, len + margin * 2);
+	}
+	for (int y = y0; y < y1; ++y) {
+		uint8_t* out = dst + y * stride;
+		if (EDGE != 0) {
+			memcpy(line[2] + 32 - margin, out + stride - margin, len + margin * 2);
+		} else {
+			memcpy(line[1] + 32 - margin, out - margin, len + margin * 2);
+		}
+		const uint8_t* up = line[0] + 32;
+		const uint8_t* cur = line[1] + 32;
+		const uint8_t* down = line[2] + 32;
+		for (int x = 0; x < len; x += V::BYTES) {
+			vec p = V::load(cur + x);
+			vec a, b;
+			switch (EDGE) {
+			case 0:
+				a = V::load(cur + x - xgap);
+				b = V::load(cur + x + xgap);
+				break;
+			case 1:
+				a = V::load(up + x);
+				b = V::load(down + x);
+				break;
+			case 2:
+				a = V::load(up + x - xgap);
+				b = V::load(down + x + xgap);
+				break;
+			default:
+				a = V::load(up + x + xgap);
+				b = V::load(down + x - xgap);
+				break;
+			}
+			vec idx = V::add(V::add(sao_sign<V>(p, a), sao_sign<V>(p, b)), base);
+			sao_store<V>(out + x, sao_apply<V>(p, lut.lookup(idx, sao_edge_map)), len - x);
+		}
+		if (EDGE != 0) {
+			uint8_t* tmp = line[0];
+			line[0] = line[1];
+			line[1] = line[2];
+			line[2] = tmp;
+		}
+	}
+}
+
+/** Edge offset of a block, whose neighbours outside are unmodified by SAO.
+ * lines shall have 3 * (width * xgap + 96) bytes.
+ */
+void sao_edge_x86(uint8_t* dst, const int8_t* offset0, const int8_t* offset1, int edge, int width, int height, int xgap, int stride, uint32_t unavail, uint8_t* lines) {
+	int x0 = 0;
+	int x1 = width * xgap;
+	int y0 = 0;
+	int y1 = height;
+	if (edge != 1) {
+		x0 += (unavail & 1) ? xgap : 0;
+		x1 -= (unavail & 4) ? xgap : 0;
+	}
+	if (edge != 0) {
+		y0 += (unavail & 2) ? 1 : 0;
+		y1 -= (unavail & 8) ? 1 : 0;
+	}
+	if ((x1 <= x0) || (y1 <= y0)) {
+		return;
+	}
+	switch (edge) {
+	case 0:
+		sao_edge_rows<sao_vec, 0>(dst, offset0, offset1, x0, x1, y0, y1, xgap, stride, lines);
+		break;
+	case 1:
+		sao_edge_rows<sao_vec, 1>(dst, offset0, offset1, x0, x1, y0, y1, xgap, stride, lines);
+		break;
+	case 2:
+		sao_edge_rows<sao_vec, 2>(dst, offset0, offset1, x0, x1, y0, y1, xgap, stride, lines);
+		break;
+	case 3:
+		sao_edge_rows<sao_vec, 3>(dst, offset0, offset1, x0, x1, y0, y1, xgap, stride, lines);
+		break;
+	}
+}
+
+/** Band offset, where band table wraps around as (band + k) & 31.
+ */
+void sao_band_x86(uint8_t* dst, const int8_t* offset0, const int8_t* offset1, int band0, int band1, int width, int height, int xgap, int stride) {
+	typedef sao_vec V;
+	typedef V::type vec;
+	sao_offset_lookup<V> lut(offset0, offset1, sao_band_map);
+	vec band = V::set2(band0, (xgap == 2) ? band1 : band0);
+	vec parity = V::set2(0, 8);
+	vec mask = V::set1(31);
+	vec three = V::set1(3);
+	int len = width * xgap;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < len; x += V::BYTES) {
+			vec p;
+			if (V::BYTES <= len - x) {
+				p = V::load(dst + x);
+			} else {
+				ALIGNVC(32) uint8_t tmp[V::BYTES];
+				memcpy(tmp, dst + x, len - x);
+				p = V::load(tmp);
+			}
+			vec k = V::and_(V::sub(V::and_(V::srl3(p), mask), band), mask);
+			vec idx = V::or_(V::or_(k, parity), V::cmpgt(k, three));
+			sao_store<V>(dst + x, sao_apply<V>(p, lut.lookup(idx, sao_band_map)), len - x);
+		}
+		dst += stride;
+	}
+}
+
+/* Deblocking: two 4-line luma segments, or four 2-line chroma blocks, at once.
+ * Samples across an edge are widened to 16 bits, one line per lane.
+ */
+static inline __m128i deblock_abs(const __m128i& a) {
+	return _mm_max_epi16(a, _mm_sub_epi16(_mm_setzero_si128(), a));
+}
+
+static inline __m128i deblock_clip(const __m128i& a, const __m128i& lim) {
+	return _mm_max_epi16(_mm_min_epi16(a, lim), _mm_sub_epi16(_mm_setzero_si128(), lim));
+}
+
+static inline __m128i deblock_select(const __m128i& mask, const __m128i& a, const __m128i& b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+/** Line 0 and line 3 of each segment broadcast to its 4 lanes.
+ */
+static inline __m128i deblock_line0(const __m128i& a) {
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0x00), 0x00);
+}
+
+static inline __m128i deblock_line3(const __m128i& a) {
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(a, 0xff), 0xff);
+}
+
+static inline __m128i deblock_segment_param(const int16_t param[], int segments) {
+	int p1 = (segments == 2) ? param[1] : 0;
+	return _mm_set_epi16(p1, p1, p1, p1, param[0], param[0], param[0], param[0]);
+}
+
+/** v[0] to v[7] are p3, p2, p1, p0, q0, q1, q2, q3.
+ */
+static void deblock_luma_lines(__m128i v[8], const __m128i& beta, const __m128i& tc) {
+	const __m128i p3 = v[0], p2 = v[1], p1 = v[2], p0 = v[3];
+	const __m128i q0 = v[4], q1 = v[5], q2 = v[6], q3 = v[7];
+	__m128i dp = deblock_abs(_mm_add_epi16(_mm_sub_epi16(p2, _mm_slli_epi16(p1, 1)), p0));
+	__m128i dq = deblock_abs(_mm_add_epi16(_mm_sub_epi16(q2, _mm_slli_epi16(q1, 1)), q0));
+	__m128i dpq = _mm_add_epi16(dp, dq);
+	__m128i dp03 = _mm_add_epi16(deblock_line0(dp), deblock_line3(dp));
+	__m128i dq03 = _mm_add_epi16(deblock_line0(dq), deblock_line3(dq));
+	__m128i filtered = _mm_cmpgt_epi16(beta, _mm_add_epi16(dp03, dq03));
+	if (_mm_movemask_epi8(filtered) == 0) {
+		return;
+	}
+
+	/* strong filter decision on line 0 and 3 */
+	__m128i tc25 = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(tc, 2), tc), _mm_set1_epi16(1)), 1);
+	__m128i dsam = _mm_cmpgt_epi16(_mm_srai_epi16(beta, 2), _mm_slli_epi16(dpq, 1));
+	dsam = _mm_and_si128(dsam, _mm_cmpgt_epi16(_mm_srai_epi16(beta, 3), _mm_add_epi16(deblock_abs(_mm_sub_epi16(p3, p0)), deblock_abs(_mm_sub_epi16(q0, q3)))));
+	dsam = _mm_and_si128(dsam, _mm_cmpgt_epi16(tc25, deblock_abs(_mm_sub_epi16(p0, q0))));
+	__m128i strong = _mm_and_si128(_mm_and_si128(deblock_line0(dsam), deblock_line3(dsam)), filtered);
+
+	/* weak filter */
+	__m128i delta = _mm_sub_epi16(_mm_mullo_epi16(_mm_sub_epi16(q0, p0), _mm_set1_epi16(9)), _mm_mullo_epi16(_mm_sub_epi16(q1, p1), _mm_set1_epi16(3)));
+	delta = _mm_srai_epi16(_mm_add_epi16(delta, _mm_set1_epi16(8)), 4);
+	__m128i weak = _mm_andnot_si128(strong, _mm_and_si128(filtered, _mm_cmpgt_epi16(_mm_mullo_epi16(tc, _mm_set1_epi16(10)), deblock_abs(delta))));
+	delta = deblock_clip(delta, tc);
+	__m128i beta2 = _mm_srai_epi16(_mm_add_epi16(beta, _mm_srai_epi16(beta, 1)), 3);
+	__m128i weak_p1 = _mm_and_si128(weak, _mm_cmpgt_epi16(beta2, dp03));
+	__m128i weak_q1 = _mm_and_si128(weak, _mm_cmpgt_epi16(beta2, dq03));
+	__m128i tc_half = _mm_srai_epi16(tc, 1);
+	__m128i p1w = _mm_add_epi16(p1, deblock_clip(_mm_srai_epi16(_mm_add_epi16(_mm_sub_epi16(_mm_avg_epu16(p2, p0), p1), delta), 1), tc_half));
+	__m128i q1w = _mm_add_epi16(q1, deblock_clip(_mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(_mm_avg_epu16(q2, q0), q1), delta), 1), tc_half));
+
+	/* strong filter */
+	__m128i tc2 = _mm_slli_epi16(tc, 1);
+	__m128i four = _mm_set1_epi16(4);
+	__m128i pq0 = _mm_add_epi16(p0, q0);
+	__m128i sum_p = _mm_add_epi16(_mm_add_epi16(p2, p1), pq0);
+	__m128i sum_q = _mm_add_epi16(_mm_add_epi16(q2, q1), pq0);
+	__m128i p2s = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(p3, p2), 1), sum_p), four), 3);
+	__m128i p1s = _mm_srai_epi16(_mm_add_epi16(sum_p, _mm_set1_epi16(2)), 2);
+	__m128i p0s = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(sum_p, _mm_add_epi16(p1, pq0)), q1), four), 3);
+	__m128i q0s = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_add_epi16(sum_q, _mm_add_epi16(q1, pq0)), p1), four), 3);
+	__m128i q1s = _mm_srai_epi16(_mm_add_epi16(sum_q, _mm_set1_epi16(2)), 2);
+	__m128i q2s = _mm_srai_epi16(_mm_add_epi16(_mm_add_epi16(_mm_slli_epi16(_mm_add_epi16(q3, q2), 1), sum_q), four), 3);
+
+	v[1] = deblock_select(strong, _mm_add_epi16(p2, deblock_clip(_mm_sub_epi16(p2s, p2), tc2)), p2);
+	v[2] = deblock_select(strong, _mm_add_epi16(p1, deblock_clip(_mm_sub_epi16(p1s, p1), tc2)), deblock_select(weak_p1, p1w, p1));
+	v[3] = deblock_select(strong, _mm_add_epi16(p0, deblock_clip(_mm_sub_epi16(p0s, p0), tc2)), deblock_select(weak, _mm_add_epi16(p0, delta), p0));
+	v[4] = deblock_select(strong, _mm_add_epi16(q0, deblock_clip(_mm_sub_epi16(q0s, q0), tc2)), deblock_select(weak, _mm_sub_epi16(q0, delta), q0));
+	v[5] = deblock_select(strong, _mm_add_epi16(q1, deblock_clip(_mm_sub_epi16(q1s, q1), tc2)), deblock_select(weak_q1, q1w, q1));
+	v[6] = deblock_select(strong, _mm_add_epi16(q2, deblock_clip(_mm_sub_epi16(q2s, q2), tc2)), q2);
+}
+
+/** Transpose of 8x8 bytes, each row in lower 8 bytes of src.
+ * dst[i] has row 2i of result in lower half, and row 2i+1 in upper half.
+ */
+static inline void transpose8x8_u8(const __m128i src[8], __m128i dst[4]) {
+	__m128i r01 = _mm_unpacklo_epi8(src[0], src[1]);
+	__m128i r23 = _mm_unpacklo_epi8(src[2], src[3]);
+	__m128i r45 = _mm_unpacklo_epi8(src[4], src[5]);
+	__m128i r67 = _mm_unpacklo_epi8(src[6], src[7]);
+	__m128i a0 = _mm_unpacklo_epi16(r01, r23);
+	__m128i a1 = _mm_unpackhi_epi16(r01, r23);
+	__m128i b0 = _mm_unpacklo_epi16(r45, r67);
+	__m128i b1 = _mm_unpackhi_epi16(r45, r67);
+	dst[0] = _mm_unpacklo_epi32(a0, b0);
+	dst[1] = _mm_unpackhi_epi32(a0, b0);
+	dst[2] = _mm_unpacklo_epi32(a1, b1);
+	dst[3] = _mm_unpackhi_epi32(a1, b1);
+}
+
+static inline __m128i load_u32(const uint8_t* src) {
+	uint32_t d;
+	memcpy(&d, src, sizeof(d));
+	return _mm_cvtsi32_si128(static_cast<int>(d));
+}
+
+static inline void store_u32(uint8_t* dst, const __m128i& v) {
+	uint32_t d = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+	memcpy(dst, &d, sizeof(d));
+}
+
+/** Vertical edge between dst[3] and dst[4], of 4 or 8 lines.
+ */
+void deblock_luma_vert_x86(uint8_t* dst, int stride, const int16_t beta[], const int16_t tc[], int segments) {
+	int lines = segments * 4;
+	__m128i row[8];
+	for (int y = 0; y < 8; ++y) {
+		row[y] = (y < lines) ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(dst + stride * y)) : _mm_setzero_si128();
+	}
+	__m128i col[4];
+	transpose8x8_u8(row, col);
+	__m128i zero = _mm_setzero_si128();
+	__m128i v[8];
+	for (int i = 0; i < 4; ++i) {
+		v[i * 2] = _mm_unpacklo_epi8(col[i], zero);
+		v[i * 2 + 1] = _mm_unpackhi_epi8(col[i], zero);
+	}
+	deblock_luma_lines(v, deblock_segment_param(beta, segments), deblock_segment_param(tc, segments));
+	for (int i = 0; i < 4; ++i) {
+		__m128i c = _mm_packus_epi16(v[i * 2], v[i * 2 + 1]);
+		row[i * 2] = c;
+		row[i * 2 + 1] = _mm_srli_si128(c, 8);
+	}
+	transpose8x8_u8(row, col);
+	for (int y = 0; y < lines; y += 2) {
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + stride * y), col[y >> 1]);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + stride * (y + 1)), _mm_srli_si128(col[y >> 1], 8));
+	}
+}
+
+/** Horizontal edge between row 3 and row 4 from dst, of 4 or 8 columns.
+ */
+void deblock_luma_horiz_x86(uint8_t* dst, int stride, const int16_t beta[], const int16_t tc[], int segments) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i v[8];
+	for (int y = 0; y < 8; ++y) {
+		const uint8_t* src = dst + stride * y;
+		__m128i d = (segments == 2) ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)) : load_u32(src);
+		v[y] = _mm_unpacklo_epi8(d, zero);
+	}
+	deblock_luma_lines(v, deblock_segment_param(beta, segments), deblock_segment_param(tc, segments));
+	for (int y = 1; y < 7; ++y) {
+		__m128i d = _mm_packus_epi16(v[y], v[y]);
+		if (segments == 2) {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + stride * y), d);
+		} else {
+			store_u32(dst + stride * y, d);
+		}
+	}
+}
+
+/** p1, p0, q0 and q1 with Cb and Cr in alternate lanes.
+ */
+static inline void deblock_chroma_lines(__m128i& p1, __m128i& p0, __m128i& q0, __m128i& q1, const __m128i& tc) {
+	__m128i delta = _mm_add_epi16(_mm_slli_epi16(_mm_sub_epi16(q0, p0), 2), _mm_sub_epi16(p1, q1));
+	delta = deblock_clip(_mm_srai_epi16(_mm_add_epi16(delta, _mm_set1_epi16(4)), 3), tc);
+	p0 = _mm_add_epi16(p0, delta);
+	q0 = _mm_sub_epi16(q0, delta);
+}
+
+/** tc of two blocks, 2 lines of Cb and Cr each.
+ */
+static inline __m128i deblock_chroma_param(const int16_t tc[]) {
+	return _mm_set_epi16(tc[3], tc[2], tc[3], tc[2], tc[1], tc[0], tc[1], tc[0]);
+}
+
+/** Vertical edge between dst[3] and dst[4], with Cb and Cr interleaved, of up to 4 blocks of 2 lines.
+ */
+void deblock_chroma_vert_x86(uint8_t* dst, int stride, const int16_t tc[], int blocks) {
+	int lines = blocks * 2;
+	__m128i row[8];
+	for (int y = 0; y < 8; ++y) {
+		row[y] = (y < lines) ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(dst + stride * y)) : _mm_setzero_si128();
+	}
+	/* transpose of Cb-Cr pairs */
+	__m128i r01 = _mm_unpacklo_epi16(row[0], row[1]);
+	__m128i r23 = _mm_unpacklo_epi16(row[2], row[3]);
+	__m128i r45 = _mm_unpacklo_epi16(row[4], row[5]);
+	__m128i r67 = _mm_unpacklo_epi16(row[6], row[7]);
+	__m128i a0 = _mm_unpacklo_epi32(r01, r23);
+	__m128i a1 = _mm_unpackhi_epi32(r01, r23);
+	__m128i b0 = _mm_unpacklo_epi32(r45, r67);
+	__m128i b1 = _mm_unpackhi_epi32(r45, r67);
+	__m128i p1 = _mm_unpacklo_epi64(a0, b0);
+	__m128i p0 = _mm_unpackhi_epi64(a0, b0);
+	__m128i q0 = _mm_unpacklo_epi64(a1, b1);
+	__m128i q1 = _mm_unpackhi_epi64(a1, b1);
+	__m128i zero = _mm_setzero_si128();
+	__m128i p1l = _mm_unpacklo_epi8(p1, zero);
+	__m128i p0l = _mm_unpacklo_epi8(p0, zero);
+	__m128i q0l = _mm_unpacklo_epi8(q0, zero);
+	__m128i q1l = _mm_unpacklo_epi8(q1, zero);
+	__m128i p1h = _mm_unpackhi_epi8(p1, zero);
+	__m128i p0h = _mm_unpackhi_epi8(p0, zero);
+	__m128i q0h = _mm_unpackhi_epi8(q0, zero);
+	__m128i q1h = _mm_unpackhi_epi8(q1, zero);
+	deblock_chroma_lines(p1l, p0l, q0l, q1l, deblock_chroma_param(tc));
+	deblock_chroma_lines(p1h, p0h, q0h, q1h, deblock_chroma_param(tc + 4));
+	p0 = _mm_packus_epi16(p0l, p0h);
+	q0 = _mm_packus_epi16(q0l, q0h);
+	__m128i x0 = _mm_unpacklo_epi16(p1, p0);
+	__m128i x1 = _mm_unpackhi_epi16(p1, p0);
+	__m128i y0 = _mm_unpacklo_epi16(q0, q1);
+	__m128i y1 = _mm_unpackhi_epi16(q0, q1);
+	row[0] = _mm_unpacklo_epi32(x0, y0);
+	row[1] = _mm_unpackhi_epi32(x0, y0);
+	row[2] = _mm_unpacklo_epi32(x1, y1);
+	row[3] = _mm_unpackhi_epi32(x1, y1);
+	for (int y = 0; y < lines; y += 2) {
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + stride * y), row[y >> 1]);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + stride * (y + 1)), _mm_srli_si128(row[y >> 1], 8));
+	}
+}
+
+/** Horizontal edge between row 1 and row 2 from dst, with Cb and Cr interleaved, of 1 or 2 blocks.
+ */
+void deblock_chroma_horiz_x86(uint8_t* dst, int stride, const int16_t tc[], int blocks) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i v[4];
+	for (int y = 0; y < 4; ++y) {
+		const uint8_t* src = dst + stride * y;
+		__m128i d = (blocks == 2) ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)) : load_u32(src);
+		v[y] = _mm_unpacklo_epi8(d, zero);
+	}
+	deblock_chroma_lines(v[0], v[1], v[2], v[3], deblock_chroma_param(tc));
+	for (int y = 1; y < 3; ++y) {
+		__m128i d = _mm_packus_epi16(v[y], v[y]);
+		if (blocks == 2) {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + stride * y), d);
+		} else {
+			store_u32(dst + stride * y, d);
+		}
+	}
+}
+
+/* Inter prediction: 8 (SSE2, SSSE3) or 16 (AVX2) samples at once, with 14-bit intermediates in 16-bit lanes.
+ * Chroma is filtered with Cb and Cr interleaved, taps being 2 bytes apart.
+ */
+struct interp_vec128 {
+	typedef __m128i type;
+	enum { N = 8 };
+	static type load_u8(const uint8_t* src) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src)), _mm_setzero_si128()); }
+	static type load_s16(const int16_t* src) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+	static void store_s16(int16_t* dst, const type& v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v); }
+	static void store_u8(uint8_t* dst, const type& v) { _mm_storel_epi64(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(v, v)); }
+	static type set1(int v) { return _mm_set1_epi16(static_cast<short>(v)); }
+	static type set1_32(int v) { return _mm_set1_epi32(v); }
+	static type add(const type& a, const type& b) { return _mm_add_epi16(a, b); }
+	static type adds(const type& a, const type& b) { return _mm_adds_epi16(a, b); }
+	static type mullo(const type& a, const type& b) { return _mm_mullo_epi16(a, b); }
+	static type shl6(const type& a) { return _mm_slli_epi16(a, 6); }
+	static type sra6(const type& a) { return _mm_srai_epi16(a, 6); }
+	static type sra7(const type& a) { return _mm_srai_epi16(a, 7); }
+	static type add32(const type& a, const type& b) { return _mm_add_epi32(a, b); }
+	static type madd_lo(const type& a, const type& b, const type& c) { return _mm_madd_epi16(_mm_unpacklo_epi16(a, b), c); }
+	static type madd_hi(const type& a, const type& b, const type& c) { return _mm_madd_epi16(_mm_unpackhi_epi16(a, b), c); }
+	static type pack_sra6(const type& lo, const type& hi) { return _mm_packs_epi32(_mm_srai_epi32(lo, 6), _mm_srai_epi32(hi, 6)); }
+#ifdef SAO_SHUFFLE
+	static type load_pair(const uint8_t* src0, const uint8_t* src1) { return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src0)), _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src1))); }
+	static type maddubs(const type& a, const type& b) { return _mm_maddubs_epi16(a, b); }
+#endif
+};
+
+#ifdef __AVX2__
+struct interp_vec256 {
+	typedef __m256i type;
+	enum { N = 16 };
+	static type load_u8(const uint8_t* src) { return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))); }
+	static type load_s16(const int16_t* src) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)); }
+	static void store_s16(int16_t* dst, const type& v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v); }
+	static void store_u8(uint8_t* dst, const type& v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08))); }
+	static type set1(int v) { return _mm256_set1_epi16(static_cast<short>(v)); }
+	static type set1_32(int v) { return _mm256_set1_epi32(v); }
+	static type add(const type& a, const type& b) { return _mm256_add_epi16(a, b); }
+	static type adds(const type& a, const type& b) { return _mm256_adds_epi16(a, b); }
+	static type mullo(const type& a, const type& b) { return _mm256_mullo_epi16(a, b); }
+	static type shl6(const type& a) { return _mm256_slli_epi16(a, 6); }
+	static type sra6(const type& a) { return _mm256_srai_epi16(a, 6); }
+	static type sra7(const type& a) { return _mm256_srai_epi16(a, 7); }
+	static type add32(const type& a, const type& b) { return _mm256_add_epi32(a, b); }
+	static type madd_lo(const type& a, const type& b, const type& c) { return _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), c); }
+	static type madd_hi(const type& a, const type& b, const type& c) { return _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), c); }
+	static type pack_sra6(const type& lo, const type& hi) { return _mm256_packs_epi32(_mm256_srai_epi32(lo, 6), _mm256_srai_epi32(hi, 6)); }
+	static type load_pair(const uint8_t* src0, const uint8_t* src1) { return _mm256_or_si256(load_u8(src0), _mm256_slli_epi16(load_u8(src1), 8)); }
+	static type maddubs(const type& a, const type& b) { return _mm256_maddubs_epi16(a, b); }
+};
+typedef interp_vec256 interp_vec;
+#else
+typedef interp_vec128 interp_vec;
+#endif
+
+static const int8_t interp_luma_coef[4][8] = {
+	{0, 0, 0, 64, 0, 0, 0, 0},
+	{-1, 4, -10, 58, 17, -5, 1, 0},
+	{-1, 4, -11, 40, 40, -11, 4, -1},
+	{0, 1, -5, 17, 58, -10, 4, -1}
+};
+
+static const int8_t interp_chroma_coef[8][4] = {
+	{0, 64, 0, 0},
+	{-2, 58, 10, -2},
+	{-4, 54, 16, -2},
+	{-6, 46, 28, -4},
+	{-4, 36, 36, -4},
+	{-4, 28, 46, -6},
+	{-2, 16, 54, -4},
+	{-2, 10, 58, -2}
+};
+
+template <typename V, int TAPS>
+struct interp_coef {
+	typedef typename V::type vec;
+	vec tap[TAPS];
+	vec pair[TAPS / 2];
+	vec madd[TAPS / 2];
+	explicit interp_coef(const int8_t* coef) {
+		for (int i = 0; i < TAPS; ++i) {
+			tap[i] = V::set1(coef[i]);
+		}
+		for (int i = 0; i < TAPS / 2; ++i) {
+			int c0 = coef[i * 2];
+			int c1 = coef[i * 2 + 1];
+			pair[i] = V::set1((c0 & 255) | ((c1 & 255) << 8));
+			madd[i] = V::set1_32((c0 & 0xffff) | (c1 << 16));
+		}
+	}
+};
+
+/** Filter of 8-bit samples, taps being step bytes apart, with gain of 64.
+ */
+template <typename V, int TAPS>
+static inline typename V::type interp_fir_u8(const uint8_t* src, int step, const interp_coef<V, TAPS>& coef) {
+	typedef typename V::type vec;
+#ifdef SAO_SHUFFLE
+	vec sum = V::maddubs(V::load_pair(src, src + step), coef.pair[0]);
+	for (int i = 1; i < TAPS / 2; ++i) {
+		sum = V::add(sum, V::maddubs(V::load_pair(src + step * (i * 2), src + step * (i * 2 + 1)), coef.pair[i]));
+	}
+#else
+	vec sum = V::mullo(V::load_u8(src), coef.tap[0]);
+	for (int i = 1; i < TAPS; ++i) {
+		sum = V::add(sum, V::mullo(V::load_u8(src + step * i), coef.tap[i]));
+	}
+#endif
+	return sum;
+}
+
+/** Vertical filter of first pass results, shifted down to 14 bits.
+ */
+template <typename V, int TAPS>
+static inline typename V::type interp_fir_s16(const int16_t* src, int stride, const interp_coef<V, TAPS>& coef) {
+	typedef typename V::type vec;
+	vec a = V::load_s16(src);
+	vec b = V::load_s16(src + stride);
+	vec lo = V::madd_lo(a, b, coef.madd[0]);
+	vec hi = V::madd_hi(a, b, coef.madd[0]);
+	for (int i = 1; i < TAPS / 2; ++i) {
+		a = V::load_s16(src + stride * (i * 2));
+		b = V::load_s16(src + stride * (i * 2 + 1));
+		lo = V::add32(lo, V::madd_lo(a, b, coef.madd[i]));
+		hi = V::add32(hi, V::madd_hi(a, b, coef.madd[i]));
+	}
+	return V::pack_sra6(lo, hi);
+}
+
+struct interp_dst_t {
+	uint8_t* pix;
+	int16_t* pred;
+	int stride;
+	int pred_stride;
+};
+
+/** 14-bit prediction of len samples is stored as:
+ * 0: rounded into frame, 1: as is for bi-prediction, 2: averaged with pred into frame.
+ */
+template <typename V, int MODE>
+static inline void interp_store(const interp_dst_t& dst, int x, int y, const typename V::type& val, int len) {
+	typedef typename V::type vec;
+	ALIGNVC(32) uint8_t tmp8[V::N];
+	ALIGNVC(32) int16_t tmp16[V::N];
+	if (MODE == 1) {
+		int16_t* d = dst.pred + dst.pred_stride * y + x;
+		if (len == V::N) {
+			V::store_s16(d, val);
+		} else {
+			V::store_s16(tmp16, val);
+			memcpy(d, tmp16, len * sizeof(d[0]));
+		}
+		return;
+	}
+	vec pix;
+	if (MODE == 0) {
+		pix = V::sra6(V::adds(val, V::set1(32)));
+	} else {
+		pix = V::sra7(V::adds(V::adds(val, V::load_s16(dst.pred + dst.pred_stride * y + x)), V::set1(64)));
+	}
+	uint8_t* d = dst.pix + dst.stride * y + x;
+	if (len == V::N) {
+		V::store_u8(d, pix);
+	} else {
+		V::store_u8(tmp8, pix);
+		memcpy(d, tmp8, len);
+	}
+}
+
+/** src points the block, with (TAPS / 2 - 1) samples of margin on the left and above, and (TAPS / 2) plus a vector on the right and below.
+ */
+template <typename V, int TAPS, int MODE>
+static void interp_block(const uint8_t* src, int stride, int xgap, const int8_t* coefx, const int8_t* coefy, int width, int height, const interp_dst_t& dst) {
+	const int margin = TAPS / 2 - 1;
+	if (!coefy) {
+		if (!coefx) {
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; x += V::N) {
+					interp_store<V, MODE>(dst, x, y, V::shl6(V::load_u8(src + stride * y + x)), std::min(width - x, static_cast<int>(V::N)));
+				}
+			}
+		} else {
+			interp_coef<V, TAPS> cx(coefx);
+			src -= margin * xgap;
+			for (int y = 0; y < height; ++y) {
+				for (int x = 0; x < width; x += V::N) {
+					interp_store<V, MODE>(dst, x, y, interp_fir_u8<V, TAPS>(src + stride * y + x, xgap, cx), std::min(width - x, static_cast<int>(V::N)));
+				}
+			}
+		}
+	} else if (!coefx) {
+		interp_coef<V, TAPS> cy(coefy);
+		src -= margin * stride;
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; x += V::N) {
+				interp_store<V, MODE>(dst, x, y, interp_fir_u8<V, TAPS>(src + stride * y + x, stride, cy), std::min(width - x, static_cast<int>(V::N)));
+			}
+		}
+	} else {
+		const int tmp_stride = 64;
+		ALIGNVC(32) int16_t tmp[(64 + TAPS - 1) * tmp_stride];
+		interp_coef<V, TAPS> cx(coefx);
+		interp_coef<V, TAPS> cy(coefy);
+		src -= margin * (stride + xgap);
+		for (int y = 0; y < height + TAPS - 1; ++y) {
+			for (int x = 0; x < width; x += V::N) {
+				V::store_s16(tmp + tmp_stride * y + x, interp_fir_u8<V, TAPS>(src + stride * y + x, xgap, cx));
+			}
+		}
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; x += V::N) {
+				interp_store<V, MODE>(dst, x, y, interp_fir_s16<V, TAPS>(tmp + tmp_stride * y + x, tmp_stride, cy), std::min(width - x, static_cast<int>(V::N)));
+			}
+		}
+	}
+}
+
+/** Reference block with margin, whose samples outside of picture are padded from picture edge into buf.
+ * bytes shall be rounded up to vector length.
+ */
+static const uint8_t* interp_padded(const uint8_t* ref, int& stride, int xpos, int ypos, int xmax, int ymax, int xgap, int margin, int bytes, int height, uint8_t* buf, int buf_stride) {
+	int left = margin * xgap;
+	int top = margin;
+	int right = (margin + 1) * xgap;
+	int bottom = margin + 1;
+	if ((0 <= xpos - margin) && (xpos * xgap + bytes + right <= xmax * xgap) && (0 <= ypos - top) && (ypos + height + bottom <= ymax)) {
+		return ref + stride * ypos + xpos * xgap;
+	}
+	int row_bytes = left + bytes + right;
+	for (int y = 0; y < top + height + bottom; ++y) {
+		int sy = ypos - top + y;
+		const uint8_t* in = ref + stride * ((sy < 0) ? 0 : ((ymax <= sy) ? ymax - 1 : sy));
+		uint8_t* out = buf + buf_stride * y;
+		for (int x = 0; x < row_bytes; ++x) {
+			int sx = xpos - margin + x / xgap;
+			sx = (sx < 0) ? 0 : ((xmax <= sx) ? xmax - 1 : sx);
+			out[x] = in[sx * xgap + x % xgap];
+		}
+	}
+	stride = buf_stride;
+	return buf + buf_stride * top + left;
+}
+
+template <int TAPS>
+static void interp_dispatch(const uint8_t* src, int stride, int xgap, const int8_t* coefx, const int8_t* coefy, int bytes, int height, const interp_dst_t& dst, int mode) {
+	switch (mode) {
+	case 0:
+		interp_block<interp_vec, TAPS, 0>(src, stride, xgap, coefx, coefy, bytes, height, dst);
+		break;
+	case 1:
+		interp_block<interp_vec, TAPS, 1>(src, stride, xgap, coefx, coefy, bytes, height, dst);
+		break;
+	default:
+		interp_block<interp_vec, TAPS, 2>(src, stride, xgap, coefx, coefy, bytes, height, dst);
+		break;
+	}
+}
+
+/** mode 0: uni-prediction into dst, 1: first of bi-prediction into pred, 2: second of bi-prediction averaged with pred into dst.
+ * pred has width samples per line.
+ */
+void interp_luma_x86(const uint8_t* ref, int src_stride, int xpos, int ypos, int xmax, int ymax, int fracx, int fracy, int width, int height, uint8_t* dst, int dst_stride, int16_t* pred, int mode) {
+	const int buf_stride = 64 + 16;
+	ALIGNVC(32) uint8_t buf[buf_stride * (64 + 7)];
+	int rounded = (width + interp_vec::N - 1) & ~(interp_vec::N - 1);
+	int stride = src_stride;
+	const uint8_t* src = interp_padded(ref, stride, xpos, ypos, xmax, ymax, 1, 3, rounded, height, buf, buf_stride);
+	interp_dst_t d = {dst, pred, dst_stride, width};
+	interp_dispatch<8>(src, stride, 1, fracx ? interp_luma_coef[fracx] : 0, fracy ? interp_luma_coef[fracy] : 0, width, height, d, mode);
+}
+
+/** Same as interp_luma_x86 except that positions and size are in chroma samples, of which Cb and Cr are interleaved.
+ */
+void interp_chroma_x86(const uint8_t* ref, int src_stride, int xpos, int ypos, int xmax, int ymax, int fracx, int fracy, int width, int height, uint8_t* dst, int dst_stride, int16_t* pred, int mode) {
+	const int buf_stride = 64 + 16;
+	ALIGNVC(32) uint8_t buf[buf_stride * (32 + 3)];
+	int bytes = width * 2;
+	int rounded = (bytes + interp_vec::N - 1) & ~(interp_vec::N - 1);
+	int stride = src_stride;
+	const uint8_t* src = interp_padded(ref, stride, xpos, ypos, xmax, ymax, 2, 1, rounded, height, buf, buf_stride);
+	interp_dst_t d = {dst, pred, dst_stride, bytes};
+	interp_dispatch<4>(src, stride, 2, fracx ? interp_chroma_coef[fracx] : 0, fracy ? interp_chroma_coef[fracy] : 0, bytes, height, d, mode);
+}
+
+/* Intra prediction: angular lines are weighted sum of 2 reference samples out of 32,
+ * which are done with inter prediction filters by doubling weights.
+ * Chroma has Cb and Cr interleaved, in 2-byte units.
+ */
+
+/** Transpose of 8x8 16-bit elements.
+ */
+static inline void transpose8x8_u16(const __m128i src[8], __m128i dst[8]) {
+	__m128i a0 = _mm_unpacklo_epi16(src[0], src[1]);
+	__m128i a1 = _mm_unpackhi_epi16(src[0], src[1]);
+	__m128i a2 = _mm_unpacklo_epi16(src[2], src[3]);
+	__m128i a3 = _mm_unpackhi_epi16(src[2], src[3]);
+	__m128i a4 = _mm_unpacklo_epi16(src[4], src[5]);
+	__m128i a5 = _mm_unpackhi_epi16(src[4], src[5]);
+	__m128i a6 = _mm_unpacklo_epi16(src[6], src[7]);
+	__m128i a7 = _mm_unpackhi_epi16(src[6], src[7]);
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+	__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+	__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+	__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+	__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+	dst[0] = _mm_unpacklo_epi64(b0, b4);
+	dst[1] = _mm_unpackhi_epi64(b0, b4);
+	dst[2] = _mm_unpacklo_epi64(b1, b5);
+	dst[3] = _mm_unpackhi_epi64(b1, b5);
+	dst[4] = _mm_unpacklo_epi64(b2, b6);
+	dst[5] = _mm_unpackhi_epi64(b2, b6);
+	dst[6] = _mm_unpacklo_epi64(b3, b7);
+	dst[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/** Stores size x size block in src, whose lines are 32 bytes apart, as transposed.
+ */
+static void intra_store_transposed(uint8_t* dst, int stride, const uint8_t* src, int size, int unit) {
+	const int src_stride = 32;
+	int tile = std::min(size, 8);
+	for (int ty = 0; ty < size; ty += 8) {
+		for (int tx = 0; tx < size; tx += 8) {
+			const uint8_t* s = src + src_stride * ty + tx * unit;
+			uint8_t* d = dst + stride * tx + ty * unit;
+			__m128i row[8];
+			for (int i = 0; i < 8; ++i) {
+				if (i < tile) {
+					row[i] = (unit == 1) ? _mm_loadl_epi64(reinterpret_cast<const __m128i*>(s + src_stride * i)) : _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + src_stride * i));
+				} else {
+					row[i] = _mm_setzero_si128();
+				}
+			}
+			if (unit == 1) {
+				__m128i col[4];
+				transpose8x8_u8(row, col);
+				for (int i = 0; i < tile; ++i) {
+					__m128i c = (i & 1) ? _mm_srli_si128(col[i >> 1], 8) : col[i >> 1];
+					if (tile == 8) {
+						_mm_storel_epi64(reinterpret_cast<__m128i*>(d + stride * i), c);
+					} else {
+						store_u32(d + stride * i, c);
+					}
+				}
+			} else {
+				__m128i col[8];
+				transpose8x8_u16(row, col);
+				for (int i = 0; i < tile; ++i) {
+					if (tile == 8) {
+						_mm_storeu_si128(reinterpret_cast<__m128i*>(d + stride * i), col[i]);
+					} else {
+						_mm_storel_epi64(reinterpret_cast<__m128i*>(d + stride * i), col[i]);
+					}
+				}
+			}
+		}
+	}
+}
+
+/** Angular prediction from ref, where line 0 starts at (inc[0] >> (5 - size_log2)) samples and line y + 1 does inc[y + 1] samples after line y.
+ * Each line is weighted with coef[y] for latter samples, and lines are columns of dst if transposed.
+ * ref shall have a vector of margin after its end.
+ */
+void intra_angular_x86(uint8_t* dst, int stride, const uint8_t* ref, const int8_t* coef, const int8_t* inc, int size_log2, int unit, bool transposed) {
+	typedef interp_vec V;
+	ALIGNVC(32) uint8_t tmp[32 * 32];
+	ALIGNVC(32) uint8_t rest[V::N];
+	int size = 1 << size_log2;
+	int width = size * unit;
+	uint8_t* out = transposed ? tmp : dst;
+	int out_stride = transposed ? 32 : stride;
+	const uint8_t* src = ref + (*inc++ >> (5 - size_log2)) * unit;
+	for (int y = 0; y < size; ++y) {
+		const int8_t weight[2] = {
+			static_cast<int8_t>((32 - coef[y]) * 2), static_cast<int8_t>(coef[y] * 2)
+		};
+		interp_coef<V, 2> c(weight);
+		uint8_t* d = out + out_stride * y;
+		for (int x = 0; x < width; x += V::N) {
+			V::type pix = V::sra6(V::add(interp_fir_u8<V, 2>(src + x, unit, c), V::set1(32)));
+			if (x + V::N <= width) {
+				V::store_u8(d + x, pix);
+			} else {
+				V::store_u8(rest, pix);
+				memcpy(d + x, rest, width - x);
+			}
+		}
+		src += inc[y] * unit;
+	}
+	if (transposed) {
+		intra_store_transposed(dst, stride, tmp, size, unit);
+	}
+}
+
+static inline __m128i intra_unit_set1(const uint8_t* src, int unit) {
+	return (unit == 1) ? _mm_set1_epi16(src[0]) : _mm_set1_epi32(src[0] | (src[1] << 16));
+}
+
+static inline void intra_store(uint8_t* dst, const __m128i& pix, int len) {
+	if (len == 4) {
+		store_u32(dst, pix);
+	} else {
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(dst), pix);
+	}
+}
+
+/** Planar prediction from ref, which has left column followed by top row of (size + 1) samples each.
+ */
+void intra_planar_x86(uint8_t* dst, int stride, const uint8_t* ref, int size_log2, int unit) {
+	int size = 1 << size_log2;
+	int width = size * unit;
+	int chunks = (width + 7) >> 3;
+	const uint8_t* top = ref + (size + 1) * unit;
+	__m128i zero = _mm_setzero_si128();
+	__m128i shift = _mm_cvtsi32_si128(size_log2 + 1);
+	__m128i left_bottom = intra_unit_set1(ref + size * unit, unit);
+	__m128i right_top = intra_unit_set1(top + size * unit, unit);
+	__m128i base = _mm_add_epi16(left_bottom, _mm_set1_epi16(static_cast<short>(size)));
+	__m128i acc[4], weight[4], inc[4];
+	for (int i = 0; i < chunks; ++i) {
+		ALIGNVC(16) int16_t xpos[8];
+		for (int j = 0; j < 8; ++j) {
+			xpos[j] = static_cast<int16_t>((i * 8 + j) >> (unit - 1));
+		}
+		__m128i x = _mm_load_si128(reinterpret_cast<const __m128i*>(xpos));
+		__m128i t = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(top + i * 8)), zero);
+		weight[i] = _mm_sub_epi16(_mm_set1_epi16(static_cast<short>(size - 1)), x);
+		acc[i] = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_add_epi16(x, _mm_set1_epi16(1)), right_top), _mm_mullo_epi16(t, _mm_set1_epi16(static_cast<short>(size - 1)))), base);
+		inc[i] = _mm_sub_epi16(left_bottom, t);
+	}
+	for (int y = 0; y < size; ++y) {
+		__m128i left = intra_unit_set1(ref + y * unit, unit);
+		for (int i = 0; i < chunks; ++i) {
+			__m128i pix = _mm_srl_epi16(_mm_add_epi16(acc[i], _mm_mullo_epi16(weight[i], left)), shift);
+			intra_store(dst + i * 8, _mm_packus_epi16(pix, pix), std::min(width, 8));
+			acc[i] = _mm_add_epi16(acc[i], inc[i]);
+		}
+		dst += stride;
+	}
+}
+
+static inline __m128i intra_load(const uint8_t* src, int len) {
+	if (len == 4) {
+		return load_u32(src);
+	} else if (len == 8) {
+		return _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+	} else {
+		return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	}
+}
+
+/** DC prediction when all of top and left samples are available.
+ * Returns DC value, which has Cb and Cr in lower and upper 16 bits for chroma.
+ */
+uint32_t intra_dc_x86(uint8_t* dst, int stride, int size_log2, int unit) {
+	ALIGNVC(16) uint8_t left[32];
+	int size = 1 << size_log2;
+	int width = size * unit;
+	int len = std::min(width, 16);
+	for (int y = 0; y < size; ++y) {
+		memcpy(left + y * unit, dst + stride * y - unit, unit);
+	}
+	__m128i zero = _mm_setzero_si128();
+	__m128i sum = zero;
+	for (int x = 0; x < width; x += 16) {
+		__m128i t = intra_load(dst - stride + x, len);
+		__m128i l = intra_load(left + x, len);
+		sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpacklo_epi8(t, zero), _mm_unpacklo_epi8(l, zero)));
+		sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpackhi_epi8(t, zero), _mm_unpackhi_epi8(l, zero)));
+	}
+	__m128i sum0 = _mm_madd_epi16(sum, (unit == 1) ? _mm_set1_epi16(1) : _mm_set1_epi32(1));
+	__m128i sum1 = _mm_madd_epi16(sum, _mm_set1_epi32(0x10000));
+	sum0 = _mm_add_epi32(sum0, _mm_srli_si128(sum0, 8));
+	sum1 = _mm_add_epi32(sum1, _mm_srli_si128(sum1, 8));
+	sum0 = _mm_add_epi32(sum0, _mm_srli_si128(sum0, 4));
+	sum1 = _mm_add_epi32(sum1, _mm_srli_si128(sum1, 4));
+	uint32_t dc0 = (static_cast<uint32_t>(_mm_cvtsi128_si32(sum0)) + size) >> (size_log2 + 1);
+	uint32_t dc1 = (static_cast<uint32_t>(_mm_cvtsi128_si32(sum1)) + size) >> (size_log2 + 1);
+	__m128i pix = (unit == 1) ? _mm_set1_epi8(static_cast<char>(dc0)) : _mm_set1_epi16(static_cast<short>(dc0 | (dc1 << 8)));
+	for (int y = 0; y < size; ++y) {
+		uint8_t* d = dst + stride * y;
+		if (width < 16) {
+			intra_store(d, pix, width);
+		} else {
+			for (int x = 0; x < width; x += 16) {
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(d + x), pix);
+			}
+		}
+	}
+	return (unit == 1) ? dc0 : (dc0 | (dc1 << 16));
+}
+
+/** [1 2 1] filter of len samples, from line[0] to line[len + 1].
+ */
+void intra_ref_filter_x86(uint8_t* dst, const uint8_t* line, int len) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i two = _mm_set1_epi16(2);
+	ALIGNVC(16) uint8_t rest[8];
+	for (int i = 0; i < len; i += 8) {
+		__m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(line + i)), zero);
+		__m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(line + i + 1)), zero);
+		__m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(line + i + 2)), zero);
+		__m128i v = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(a, c), _mm_add_epi16(_mm_slli_epi16(b, 1), two)), 2);
+		v = _mm_packus_epi16(v, v);
+		if (i + 8 <= len) {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), v);
+		} else {
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(rest), v);
+			memcpy(dst + i, rest, len - i);
+		}
+	}
+}
+
 #endif
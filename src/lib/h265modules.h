@@ -32,6 +32,7 @@
 #define VC_CHECK
 #endif
 #include "h265.h"
+#include "m2d_thread.h"
 
 #define MINV(a, b) (((a) <= (b)) ? (a) : (b))
 #define MAXV(a, b) (((a) >= (b)) ? (a) : (b))
@@ -39,6 +40,12 @@
 
 static const int H265D_MAX_FRAME_NUM = 8;
 static const int H265D_NEIGHBOUR_NUM = 16;
+static const int H265D_MAX_ENTRY_POINTS = 512;
+static const int H265D_MAX_TILE_COLUMNS = 20;
+static const int H265D_MAX_TILE_ROWS = 22;
+static const int H265D_MAX_FRAME_JOBS = 4;
+static const int H265D_FRAME_JOB_SLICES = 4;
+static const int32_t H265D_FRAME_COMPLETE = 0x7fffffff;
 
 typedef struct {
 	uint8_t sub_layer_profile_first8bit;
@@ -85,13 +92,15 @@ typedef struct {
 	h265d_vps_timing_info_t timing_info;
 } h265d_vps_t;
 
+/** Scaling lists in up-right diagonal order, with prediction resolved.
+ */
 typedef struct {
-	uint8_t scaling_list_pred_mode_flag[4][6];
-	uint32_t scaling_list_pred_matrix_id_delta[4][6];
 	uint8_t scale0[6][16];
 	uint8_t scale1[6][64];
 	uint8_t scale2[6][64];
 	uint8_t scale3[2][64];
+	uint8_t dc2[6]; // scaling_list_dc_coef_minus8 + 8
+	uint8_t dc3[2];
 } h265d_scaling_list_data_t;
 
 typedef struct {
@@ -113,10 +122,21 @@ typedef struct {
 	uint8_t matrix_coeffs;
 	uint16_t sar_width;
 	uint16_t sar_height;
+	uint8_t chroma_sample_loc_type_top_field;
+	uint8_t chroma_sample_loc_type_bottom_field;
+	uint16_t def_disp_win_offset[4];
+	uint32_t num_units_in_tick;
+	uint32_t time_scale;
 	uint32_t overscan_info_present_flag : 1;
 	uint32_t overscan_appropriate_flag : 1;
 	uint32_t video_full_range_flag : 1;
 	uint32_t colour_description_present_flag : 1;
+	uint32_t chroma_loc_info_present_flag : 1;
+	uint32_t neutral_chroma_indication_flag : 1;
+	uint32_t field_seq_flag : 1;
+	uint32_t frame_field_info_present_flag : 1;
+	uint32_t default_display_window_flag : 1;
+	uint32_t timing_info_present_flag : 1;
 } h265d_vui_parameters_t;
 
 typedef struct {
@@ -185,8 +205,8 @@ typedef struct {
 typedef struct {
 	uint16_t num_tile_columns_minus1;
 	uint16_t num_tile_rows_minus1;
-	uint16_t* column_width_minus1;
-	uint16_t* row_height_minus1;
+	uint16_t column_width_minus1[H265D_MAX_TILE_COLUMNS];
+	uint16_t row_height_minus1[H265D_MAX_TILE_ROWS];
 	uint32_t uniform_spacing_flag : 1;
 	uint32_t loop_filter_across_tiles_enabled_flag : 1;
 } h265d_tiles_t;
@@ -234,10 +254,20 @@ typedef struct {
 typedef enum {
 	TRAIL_N = 0,
 	TRAIL_R = 1,
+	TSA_N = 2,
+	TSA_R = 3,
+	STSA_N = 4,
+	STSA_R = 5,
+	RADL_N = 6,
+	RADL_R = 7,
+	RASL_N = 8,
+	RASL_R = 9,
 	BLA_W_LP = 16,
+	BLA_W_RADL = 17,
 	BLA_N_LP = 18,
 	IDR_W_RADL = 19,
 	IDR_N_LP = 20,
+	CRA_NUT = 21,
 	RSV_IRAP_VCL23 = 23,
 	VPS_NAL = 32,
 	SPS_NAL = 33,
@@ -360,6 +390,19 @@ typedef struct {
 	uint8_t reserved_flag;
 } h265d_sao_vlines_t;
 
+/** SAO stage of in-loop filters, which follows deblocking by one CTU row.
+ */
+typedef struct {
+	uint8_t* luma;
+	uint8_t* chroma;
+	int pos_x;
+	int32_t rows_done; // CTU rows filtered in current picture
+	h265d_sao_vlines_t vlines;
+	h265d_sao_hlines_t hlines[2][2];
+	uint8_t* signbuf;
+	uint8_t* lines; // pre-SAO copies of three rows for SIMD kernels
+} h265d_sao_t;
+
 typedef struct {
 	uint16_t lsb;
 	uint16_t msb;
@@ -395,6 +438,7 @@ typedef struct {
 	uint32_t deblocking_filter_override_flag : 1;
 	uint32_t deblocking_filter_disabled_flag : 1;
 	uint32_t slice_loop_filter_across_slices_enabled_flag : 1;
+	uint32_t no_rasl_output_flag : 1; // IRAP picture which starts decoding: BLA, or CRA first after start or end of sequence
 	h265d_poc_t slice_pic_order_cnt;
 	h265d_ref_pic_list_elem_t ref_list[2][16];
 	h265d_short_term_ref_pic_set_t short_term_ref_pic_set;
@@ -403,7 +447,7 @@ typedef struct {
 typedef struct {
 	uint8_t offset_len_minus1;
 	uint32_t num_entry_point_offsets;
-	uint32_t* entry_point_offset_minus1;
+	uint32_t entry_point_offset_minus1[H265D_MAX_ENTRY_POINTS]; // offsets beyond are not stored
 } h265d_entry_point_t;
 
 typedef struct {
@@ -435,9 +479,21 @@ typedef struct {
 
 typedef struct {
 	int32_t scale;
-	uint8_t** matrix;
+	int32_t qp;
 } h265d_scaling_info_t;
 
+enum {
+	H265D_SCALING_FACTOR_NUM = (6 * 16 + 6 * 64 + 6 * 256 + 2 * 1024) * 6
+};
+
+/** Dequantization factors m[x][y] * levelScale[qp % 6] of scaling lists, expanded to block size
+ * and indexed by (sizeId, matrixId, qp % 6).
+ */
+typedef struct {
+	h265d_scaling_list_data_t lists; // source of factor
+	int16_t factor[H265D_SCALING_FACTOR_NUM];
+} h265d_scaling_table_t;
+
 typedef struct {
 	uint8_t qp : 6;
 	uint8_t str : 2;
@@ -471,6 +527,10 @@ typedef struct {
 	m2d_frame_t frames[H265D_MAX_FRAME_NUM];
 	int8_t lru[H265D_MAX_FRAME_NUM];
 	h265d_dpb_t dpb;
+	m2d_mb_info_t* mb_info; // given by h265d_set_mb_info()
+	int mb_info_size;
+	class m2d_progress_t* frame_progress; // CTU rows completed in each frame, only for pictures decoded by frame threads
+	int32_t rows_ready[H265D_MAX_FRAME_NUM]; // rows of each frame already waited for
 } h265d_frame_info_t;
 
 class h265d_deblocking_t {
@@ -478,18 +538,26 @@ class h265d_deblocking_t {
 	int8_t topgap[2];
 	int8_t edgemax;
 	bool disabled_;
+	uint8_t edge_unavail_;
+	const h265d_neighbour_t* edge_[2];
 	const uint8_t (*qp_history_)[16];
 	const h265d_ref_pic_list_elem_t (*ref_list_)[16];
 	h265d_deblocking_strength_t* topedge_;
 	h265d_deblocking_strength_t* topedge_base_;
 	h265d_deblocking_strength_t boundary_[2][8 * 17];
+	bool edge_skipped(int dir, int offset_x) const {
+		return (offset_x & 7) || ((offset_x == 0) && ((edge_unavail_ >> dir) & 1));
+	}
+	const h265d_neighbour_t* edge_neighbour(int dir, int offset_x, int offset_y, const h265d_neighbour_t* neighbour) const {
+		return ((offset_x == 0) && edge_[dir]) ? edge_[dir] + (offset_y >> 2) : neighbour;
+	}
 	static h265d_deblocking_strength_t* boundary_to_fill(h265d_deblocking_strength_t* deb, int offset_x, int offset_y, int xgap, int ygap, int& org_y) {
 		int org_x = offset_x >> 3;
 		org_y = offset_y >> 2;
 		return deb + org_x * xgap + (org_y + 1) * ygap;
 	}
-	void record_tu_intra_onedir(int qpy, int dir, int offset_x, int offset_y, int unavail, int xgap, int ygap, int len, int edgemax) {
-		if ((offset_x & 7) || ((offset_x == 0) && ((unavail >> dir) & 1))) {
+	void record_tu_intra_onedir(int qpy, int dir, int offset_x, int offset_y, int xgap, int ygap, int len, int edgemax) {
+		if (edge_skipped(dir, offset_x)) {
 			return;
 		}
 		int org_y;
@@ -507,10 +575,11 @@ class h265d_deblocking_t {
 	static int strength_tu(const h265d_neighbour_t& neighbour) {
 		return neighbour.tu_intra ? 2 : (neighbour.tu_nonzero_coef ? 1 : 0);
 	}
-	void record_tu_onedir(int qpy, int dir, int offset_x, int offset_y, int unavail, int xgap, int ygap, int len, int edgemax, int strength, const h265d_neighbour_t neighbour[]) {
-		if ((offset_x & 7) || ((offset_x == 0) && ((unavail >> dir) & 1))) {
+	void record_tu_onedir(int qpy, int dir, int offset_x, int offset_y, int xgap, int ygap, int len, int edgemax, int strength, const h265d_neighbour_t neighbour[]) {
+		if (edge_skipped(dir, offset_x)) {
 			return;
 		}
+		neighbour = edge_neighbour(dir, offset_x, offset_y, neighbour);
 		int org_y;
 		h265d_deblocking_strength_t* boundary = boundary_to_fill(boundary_[dir], offset_x, offset_y, xgap, ygap, org_y);
 		int qp = qpy + 1;
@@ -559,10 +628,11 @@ class h265d_deblocking_t {
 			return inter_strength(nfrm0, nfrm1, frm0, frm1, neighbour.pred.mvd, mvxy, c_swapped, n_swapped);
 		}
 	}
-	void record_pu_onedir(int qpy, int dir, int offset_x, int offset_y, uint32_t unavail, int xgap, int ygap, int len, int edgemax, const h265d_neighbour_t* neighbour, int refidx0, int refidx1, const int16_t mvxy[][2]) {
-		if ((offset_x & 7) || ((offset_x == 0) && ((unavail >> dir) & 1))) {
+	void record_pu_onedir(int qpy, int dir, int offset_x, int offset_y, int xgap, int ygap, int len, int edgemax, const h265d_neighbour_t* neighbour, int refidx0, int refidx1, const int16_t mvxy[][2]) {
+		if (edge_skipped(dir, offset_x)) {
 			return;
 		}
+		neighbour = edge_neighbour(dir, offset_x, offset_y, neighbour);
 		int frm0 = refidx_to_frameidx(refidx0, 0);
 		int frm1 = refidx_to_frameidx(refidx1, 1);
 		int c_swapped = 0;
@@ -615,30 +685,68 @@ public:
 		topedge_ = topedge_base_ + (pos_x << (log2size - 3));
 	}
 
-	void record_tu_intra(int qpy, int size_log2, int offset_x, int offset_y, uint32_t unavail) {
+	void set_qp_history(const uint8_t qp_history[][16]) {
+		qp_history_ = qp_history;
+	}
+
+	void set_ref_list(const h265d_ref_pic_list_elem_t ref_list[][16]) {
+		ref_list_ = ref_list;
+	}
+
+	/** Edges of CTU to be filtered. Neighbours of left/top edge are given if they are
+	 * not in neighbour_left/neighbour_top, such as at tile boundaries.
+	 */
+	void set_edge(uint32_t unavail, const h265d_neighbour_t* left, const h265d_neighbour_t* top) {
+		edge_unavail_ = unavail & 3;
+		edge_[0] = left;
+		edge_[1] = top;
+	}
+
+	/** Strengths of horizontal edges at left of next CTU, which is carried over by post_deblocking().
+	 */
+	void save_left(h265d_deblocking_strength_t* dst) const {
+		int len = edgemax * 2 + 1;
+		for (int n = 0; n < edgemax; ++n) {
+			dst[n] = boundary_[1][n * len];
+		}
+	}
+
+	void restore_left(const h265d_deblocking_strength_t* src) {
+		int len = edgemax * 2 + 1;
+		for (int n = 0; n < edgemax; ++n) {
+			if (src) {
+				boundary_[1][n * len] = src[n];
+			} else {
+				boundary_[1][n * len].qp = 0;
+				boundary_[1][n * len].str = 0;
+			}
+		}
+	}
+
+	void record_tu_intra(int qpy, int size_log2, int offset_x, int offset_y) {
 		if (disabled_) {
 			return;
 		}
 		int len = 1 << (size_log2 - 2);
-		record_tu_intra_onedir(qpy, 0, offset_x, offset_y, unavail, leftgap[0], leftgap[1], len, edgemax);
-		record_tu_intra_onedir(qpy, 1, offset_y, offset_x, unavail, topgap[0], topgap[1], len, edgemax);
+		record_tu_intra_onedir(qpy, 0, offset_x, offset_y, leftgap[0], leftgap[1], len, edgemax);
+		record_tu_intra_onedir(qpy, 1, offset_y, offset_x, topgap[0], topgap[1], len, edgemax);
 	}
 
-	void record_tu(int qpy, int size_log2, int offset_x, int offset_y, uint32_t unavail, int str, const h265d_neighbour_t* left, const h265d_neighbour_t* top) {
+	void record_tu(int qpy, int size_log2, int offset_x, int offset_y, int str, const h265d_neighbour_t* left, const h265d_neighbour_t* top) {
 		if (disabled_) {
 			return;
 		}
 		int len = 1 << (size_log2 - 2);
-		record_tu_onedir(qpy, 0, offset_x, offset_y, unavail, leftgap[0], leftgap[1], len, edgemax, str, left);
-		record_tu_onedir(qpy, 1, offset_y, offset_x, unavail, topgap[0], topgap[1], len, edgemax, str, top);
+		record_tu_onedir(qpy, 0, offset_x, offset_y, leftgap[0], leftgap[1], len, edgemax, str, left);
+		record_tu_onedir(qpy, 1, offset_y, offset_x, topgap[0], topgap[1], len, edgemax, str, top);
 	}
 
-	void record_pu(int qpy, int width, int height, int offset_x, int offset_y, uint32_t unavail, const h265d_neighbour_t* left, const h265d_neighbour_t* top, int refidx0, int refidx1, const int16_t mvxy[][2]) {
+	void record_pu(int qpy, int width, int height, int offset_x, int offset_y, const h265d_neighbour_t* left, const h265d_neighbour_t* top, int refidx0, int refidx1, const int16_t mvxy[][2]) {
 		if (disabled_) {
 			return;
 		}
-		record_pu_onedir(qpy, 0, offset_x, offset_y, unavail, leftgap[0], leftgap[1], height, edgemax, left, refidx0, refidx1, mvxy);
-		record_pu_onedir(qpy, 1, offset_y, offset_x, unavail, topgap[0], topgap[1], width, edgemax, top, refidx0, refidx1, mvxy);
+		record_pu_onedir(qpy, 0, offset_x, offset_y, leftgap[0], leftgap[1], height, edgemax, left, refidx0, refidx1, mvxy);
+		record_pu_onedir(qpy, 1, offset_y, offset_x, topgap[0], topgap[1], width, edgemax, top, refidx0, refidx1, mvxy);
 	}
 
 	void pre_deblocking() {
@@ -661,6 +769,13 @@ public:
 	}
 };
 
+/** Right column of CTU at left of tile boundary, kept for deblocking of the tile at right.
+ */
+typedef struct {
+	h265d_neighbour_t neighbour[H265D_NEIGHBOUR_NUM];
+	h265d_deblocking_strength_t strength[8];
+} h265d_tile_edge_t;
+
 class frameidx_record_t {
 	uint64_t frameidx_[2];
 public:
@@ -869,28 +984,102 @@ typedef struct h265d_ctu_t {
 	const h265d_pps_t* pps;
 	h265d_neighbour_t neighbour_left[H265D_NEIGHBOUR_NUM + 2];
 	h265d_neighbour_t* neighbour_top; // use 16 bytes for each CTU
+	uint8_t tile_col, tile_row;
+	uint8_t tile_columns, tile_rows;
+	uint16_t tile_column_bd[H265D_MAX_TILE_COLUMNS + 1]; // in CTB
+	uint16_t tile_row_bd[H265D_MAX_TILE_ROWS + 1];
+	uint32_t slice_addr_ts; // first CTB of slice in tile scan
+	h265d_tile_edge_t* tile_edge_left; // [pos_y][tile_col]
+	h265d_neighbour_t* tile_edge_top; // neighbour_top before entering tile
 	uint8_t qp_history[2][16];
 	const h265d_scaling_func_t* scaling_func;
+	const h265d_scaling_table_t* scaling_table; // NULL for flat scaling
+	h265d_scaling_table_t* scaling_table_buf;
 	h265d_sao_map_t* sao_map;
 	void (*sao_read)(struct h265d_ctu_t& dst, const h265d_slice_header_t& hdr, dec_bits& st);
+	void (*ctu_decode)(struct h265d_ctu_t& dst, dec_bits& st); // specialized for CTB size
+	uint32_t (*ctu_next)(struct h265d_ctu_t& dst);
 	uint8_t* luma;
 	uint8_t* chroma;
 	colpics_t colpics;
 	h265d_frame_info_t frame_info;
 	h265d_cabac_context_t context;
+	h265d_cabac_context_t* wpp_context; // stored after 2nd CTU of each row
+	h265d_cabac_context_t ds_context; // stored at the end of slice segment, for dependent one
+	int32_t* row_progress; // CTUs decoded in each substream, for parallel WPP
 	h265d_deblocking_t deblocking;
-	h265d_sao_vlines_t sao_vlines;
-	h265d_sao_hlines_t sao_hlines[2][2];
-	uint8_t* sao_signbuf;
+	int32_t* deblocked; // CTUs deblocked in each row of current picture
+	class m2d_progress_t* deblocked_progress; // counts deblocked instead while filter thread runs
+	h265d_sao_t sao;
+	m2d_picture_stats_t* stats; // not NULL in analysis mode
+	m2d_mb_info_t* mb_info; // side data of current frame, or NULL
+	int8_t luma_only; // chroma is parsed but not reconstructed
+	int8_t stats_cu_type;
+	int8_t stats_cu_cbf;
 	int16_t pred_buffer[2][32 * 32];
 	int16_t coeff_buffer[32 * 32 * 2 + 7];
 } h265d_ctu_t;
 
+#ifdef M2D_THREADS
+#include <type_traits>
+
+/** Slice queued to a frame job. Its slice data is copied into the job.
+ */
+typedef struct {
+	h265d_slice_header_t header;
+	dec_bits st;
+} h265d_frame_slice_t;
+
+/** Picture decoded by its own thread, while the caller parses following pictures.
+ */
+struct h265d_frame_job_t {
+	h265d_ctu_t ctu;
+	h265d_sps_t sps;
+	h265d_pps_t pps;
+	h265d_frame_slice_t slices[H265D_FRAME_JOB_SLICES];
+	int slice_head;
+	int slice_num;
+	bool closed;
+	bool done;
+	uint32_t frames_used; // current and reference frames
+	uint8_t* work; // work buffers in second frame
+	byte_t* stream;
+	size_t stream_size;
+	size_t stream_used;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable cond;
+};
+
+struct h265d_frame_threads_t {
+	int num; // jobs which fit in second frame
+	int next;
+	int current; // job receiving slices of current picture, or -1
+	int32_t frame_rows[H265D_MAX_FRAME_NUM];
+	m2d_progress_t progress; // frame_rows, or H265D_FRAME_COMPLETE while no job writes the frame
+	h265d_frame_job_t jobs[H265D_MAX_FRAME_JOBS];
+	h265d_frame_threads_t() : num(0), next(0), current(-1), progress(frame_rows, H265D_MAX_FRAME_NUM) {
+		for (int i = 0; i < H265D_MAX_FRAME_NUM; ++i) {
+			frame_rows[i] = H265D_FRAME_COMPLETE;
+		}
+	}
+};
+#endif
+
 typedef struct {
 	h265d_nal_t current_nal;
+	bool irap_decoded; // false until the first IRAP picture, from start or after end of sequence
+	bool no_rasl_output; // of the last IRAP picture, whose RASL pictures are skipped
+	bool picture_open; // slices of current picture decoded, waiting for its last slice segment
+	bool nal_pending; // start code of next NAL unit consumed by lookahead
 	int (*header_callback)(void *arg, void *seq_id);
 	void *header_callback_arg;
 	dec_bits stream_i;
+	int8_t threads;
+#ifdef M2D_THREADS
+	h265d_frame_threads_t* frame_threads; // constructed in frame_threads_buf
+	std::aligned_storage<sizeof(h265d_frame_threads_t), alignof(h265d_frame_threads_t)>::type frame_threads_buf;
+#endif
 	h265d_ctu_t coding_tree_unit;
 	h265d_slice_header_t slice_header;
 	h265d_vps_t vps;
@@ -22,8 +22,6 @@
  *  DEALINGS IN THE SOFTWARE.
  */
 
-#ifndef FAST_DECODE
-
 /**iDCT 8x8 for MPEG-2.
  * This implementation is same as fast idct of reference decoder.
  */
@@ -32,6 +30,11 @@
 #include "m2d_macro.h"
 #include "idct.h"
 
+#if (defined(__GNUC__) && defined(__SSE2__)) || defined(_M_IX86) || defined(_M_AMD64)
+#define X86ASM
+#include <emmintrin.h>
+#endif
+
 #define W1 2841 /* 2048*sqrt(2)*cos(1*pi/16) */
 #define W2 2676 /* 2048*sqrt(2)*cos(2*pi/16) */
 #define W3 2408 /* 2048*sqrt(2)*cos(3*pi/16) */
@@ -422,6 +425,354 @@ void m2d_idct_inter_chroma(uint8_t *dst_base, int32_t dst_stride, int16_t *src_c
 }
 
 
+#define R0 2896 /* 4096*cos(4*pi/16) */
+#define R1 3784 /* 4096*cos(2*pi/16) */
+#define R3 1567 /* 4096*cos(6*pi/16) */
+
+/**
+ *\brief iDCT 4x4 using upper-left 4x4 coefficients of 8x8 block.
+ * This is for 1/2 scale output. Each row without AC coefficients is
+ * handled as DC only, same as m2d_idct_horizontal().
+ */
+template <int _N, typename _F>
+static inline void m2d_idct4x4_half(uint8_t *dst_base, int32_t dst_stride, const int16_t *src_coef, uint32_t coef_exist, _F _Store)
+{
+	int32_t tmp[4 * 4];
+	int32_t *t = tmp;
+	int row = 4;
+	do {
+		if ((coef_exist & 1) == 0) {
+			int32_t dc = (src_coef[0] * R0 + 256) >> 9;
+			t[0] = dc;
+			t[1] = dc;
+			t[2] = dc;
+			t[3] = dc;
+		} else {
+			int32_t e0 = (src_coef[0] + src_coef[2]) * R0 + 256;
+			int32_t e1 = (src_coef[0] - src_coef[2]) * R0 + 256;
+			int32_t o0 = src_coef[1] * R1 + src_coef[3] * R3;
+			int32_t o1 = src_coef[1] * R3 - src_coef[3] * R1;
+			t[0] = (e0 + o0) >> 9;
+			t[1] = (e1 + o1) >> 9;
+			t[2] = (e1 - o1) >> 9;
+			t[3] = (e0 - o0) >> 9;
+		}
+		src_coef += 8;
+		t += 4;
+		coef_exist >>= 1;
+	} while (--row);
+	t = tmp;
+	int column = 4;
+	do {
+		int32_t e0 = (t[0] + t[8]) * R0 + (1 << 16);
+		int32_t e1 = (t[0] - t[8]) * R0 + (1 << 16);
+		int32_t o0 = t[4] * R1 + t[12] * R3;
+		int32_t o1 = t[4] * R3 - t[12] * R1;
+		uint8_t *dst8 = dst_base;
+		dst_base += _N;
+		t++;
+		_Store(dst8, (e0 + o0) >> 17);
+		dst8 += dst_stride;
+		_Store(dst8, (e1 + o1) >> 17);
+		dst8 += dst_stride;
+		_Store(dst8, (e1 - o1) >> 17);
+		dst8 += dst_stride;
+		_Store(dst8, (e0 - o0) >> 17);
+	} while (--column);
+}
+
+/**
+ *\brief iDCT 2x2 using upper-left 2x2 coefficients of 8x8 block.
+ * This is for 1/4 scale output.
+ */
+template <int _N, typename _F>
+static inline void m2d_idct2x2_quarter(uint8_t *dst_base, int32_t dst_stride, const int16_t *src_coef, _F _Store)
+{
+	int32_t t0 = src_coef[0] + src_coef[1] + 4;
+	int32_t t1 = src_coef[0] - src_coef[1] + 4;
+	int32_t t2 = src_coef[8] + src_coef[9];
+	int32_t t3 = src_coef[8] - src_coef[9];
+	_Store(dst_base, (t0 + t2) >> 3);
+	_Store(dst_base + _N, (t1 + t3) >> 3);
+	dst_base += dst_stride;
+	_Store(dst_base, (t0 - t2) >> 3);
+	_Store(dst_base + _N, (t1 - t3) >> 3);
+}
+
+template <int _N, typename _F>
+static void m2d_idct_half(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist)
+{
+	m2d_idct4x4_half<_N>(dst_base, dst_stride, src_coef, coef_exist, _F());
+}
+
+template <int _N, typename _F>
+static void m2d_idct_quarter(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist)
+{
+	m2d_idct2x2_quarter<_N>(dst_base, dst_stride, src_coef, _F());
+}
+
+/**
+ *\brief DC only iDCT for 1/8 scale output.
+ */
+template <typename _F>
+static void m2d_idct_eighth(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist)
+{
+	_F()(dst_base, (src_coef[0] + 4) >> 3);
+}
+
+#ifdef X86ASM
+/**iDCT 8x8 by SSE2, which gives the same result as m2d_idct_horizontal() and
+ * m2d_idct_vertical(). Each pair of W* products is one pmaddwd, and 181 times
+ * is done by shifts so as to wrap around like 32-bit multiplication.
+ */
+static inline __m128i m2d_mul181_x86(__m128i x)
+{
+	__m128i t = _mm_add_epi32(_mm_slli_epi32(x, 7), _mm_slli_epi32(x, 5));
+	t = _mm_add_epi32(t, _mm_slli_epi32(x, 4));
+	t = _mm_add_epi32(t, _mm_slli_epi32(x, 2));
+	return _mm_add_epi32(t, x);
+}
+
+static inline __m128i m2d_pair_x86(int16_t a, int16_t b)
+{
+	return _mm_set_epi16(b, a, b, a, b, a, b, a);
+}
+
+/** Truncate 32-bit values into 16-bit, as stored into int16_t.
+ */
+static inline __m128i m2d_pack_trunc_x86(__m128i lo, __m128i hi)
+{
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	return _mm_packs_epi32(lo, hi);
+}
+
+static inline void m2d_transpose8x8_x86(__m128i r[8])
+{
+	__m128i a0 = _mm_unpacklo_epi16(r[0], r[1]);
+	__m128i a1 = _mm_unpackhi_epi16(r[0], r[1]);
+	__m128i a2 = _mm_unpacklo_epi16(r[2], r[3]);
+	__m128i a3 = _mm_unpackhi_epi16(r[2], r[3]);
+	__m128i a4 = _mm_unpacklo_epi16(r[4], r[5]);
+	__m128i a5 = _mm_unpackhi_epi16(r[4], r[5]);
+	__m128i a6 = _mm_unpacklo_epi16(r[6], r[7]);
+	__m128i a7 = _mm_unpackhi_epi16(r[6], r[7]);
+	__m128i b0 = _mm_unpacklo_epi32(a0, a2);
+	__m128i b1 = _mm_unpackhi_epi32(a0, a2);
+	__m128i b2 = _mm_unpacklo_epi32(a1, a3);
+	__m128i b3 = _mm_unpackhi_epi32(a1, a3);
+	__m128i b4 = _mm_unpacklo_epi32(a4, a6);
+	__m128i b5 = _mm_unpackhi_epi32(a4, a6);
+	__m128i b6 = _mm_unpacklo_epi32(a5, a7);
+	__m128i b7 = _mm_unpackhi_epi32(a5, a7);
+	r[0] = _mm_unpacklo_epi64(b0, b4);
+	r[1] = _mm_unpackhi_epi64(b0, b4);
+	r[2] = _mm_unpacklo_epi64(b1, b5);
+	r[3] = _mm_unpackhi_epi64(b1, b5);
+	r[4] = _mm_unpacklo_epi64(b2, b6);
+	r[5] = _mm_unpackhi_epi64(b2, b6);
+	r[6] = _mm_unpacklo_epi64(b3, b7);
+	r[7] = _mm_unpackhi_epi64(b3, b7);
+}
+
+/** 8-point iDCT of four lanes, s[k] holding pairs of k-th inputs interleaved as
+ * (s0, s4), (s1, s7), (s2, s6), (s3, s5). Results are given without final shift.
+ * HORIZ selects rounding of m2d_idct_horizontal(), otherwise of m2d_idct_vertical().
+ */
+template <int HORIZ>
+static inline void m2d_idct8_half_x86(const __m128i s[4], __m128i out[8])
+{
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, t;
+	if (HORIZ) {
+		__m128i round = _mm_set1_epi32(128);
+		x1 = _mm_add_epi32(_mm_madd_epi16(s[0], m2d_pair_x86(2048, 2048)), round);
+		x0 = _mm_add_epi32(_mm_madd_epi16(s[0], m2d_pair_x86(2048, -2048)), round);
+		x4 = _mm_madd_epi16(s[1], m2d_pair_x86(W1, W7));
+		x5 = _mm_madd_epi16(s[1], m2d_pair_x86(W7, -W1));
+		x3 = _mm_madd_epi16(s[2], m2d_pair_x86(W2, W6));
+		x2 = _mm_madd_epi16(s[2], m2d_pair_x86(W6, -W2));
+		x6 = _mm_madd_epi16(s[3], m2d_pair_x86(W3, W5));
+		x7 = _mm_madd_epi16(s[3], m2d_pair_x86(-W5, W3));
+	} else {
+		__m128i round = _mm_set1_epi32(4);
+		x1 = _mm_add_epi32(_mm_madd_epi16(s[0], m2d_pair_x86(256, 256)), _mm_set1_epi32(8192));
+		x0 = _mm_add_epi32(_mm_madd_epi16(s[0], m2d_pair_x86(256, -256)), _mm_set1_epi32(8192));
+		x4 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s[1], m2d_pair_x86(W1, W7)), round), 3);
+		x5 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s[1], m2d_pair_x86(W7, -W1)), round), 3);
+		x3 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s[2], m2d_pair_x86(W2, W6)), round), 3);
+		x2 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s[2], m2d_pair_x86(W6, -W2)), round), 3);
+		x6 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s[3], m2d_pair_x86(W3, W5)), round), 3);
+		x7 = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(s[3], m2d_pair_x86(-W5, W3)), round), 3);
+	}
+	t = x4;
+	x4 = _mm_sub_epi32(x4, x6);
+	x6 = _mm_add_epi32(x6, t);
+	t = x5;
+	x5 = _mm_sub_epi32(x5, x7);
+	x7 = _mm_add_epi32(x7, t);
+	t = x5;
+	x5 = _mm_srai_epi32(_mm_add_epi32(m2d_mul181_x86(_mm_add_epi32(x4, x5)), _mm_set1_epi32(128)), 8);
+	x4 = _mm_srai_epi32(_mm_add_epi32(m2d_mul181_x86(_mm_sub_epi32(x4, t)), _mm_set1_epi32(128)), 8);
+	t = x0;
+	x0 = _mm_sub_epi32(x0, x2);
+	x2 = _mm_add_epi32(t, x2);
+	t = x1;
+	x1 = _mm_sub_epi32(x1, x3);
+	x3 = _mm_add_epi32(t, x3);
+	out[0] = _mm_add_epi32(x3, x6);
+	out[1] = _mm_add_epi32(x2, x5);
+	out[2] = _mm_add_epi32(x0, x4);
+	out[3] = _mm_add_epi32(x1, x7);
+	out[4] = _mm_sub_epi32(x1, x7);
+	out[5] = _mm_sub_epi32(x0, x4);
+	out[6] = _mm_sub_epi32(x2, x5);
+	out[7] = _mm_sub_epi32(x3, x6);
+}
+
+/** 8-point iDCT of eight lanes in r[0..7], each of which is k-th input.
+ */
+template <int HORIZ>
+static inline void m2d_idct8_x86(__m128i r[8])
+{
+	__m128i s[4], lo[8], hi[8];
+	s[0] = _mm_unpacklo_epi16(r[0], r[4]);
+	s[1] = _mm_unpacklo_epi16(r[1], r[7]);
+	s[2] = _mm_unpacklo_epi16(r[2], r[6]);
+	s[3] = _mm_unpacklo_epi16(r[3], r[5]);
+	m2d_idct8_half_x86<HORIZ>(s, lo);
+	s[0] = _mm_unpackhi_epi16(r[0], r[4]);
+	s[1] = _mm_unpackhi_epi16(r[1], r[7]);
+	s[2] = _mm_unpackhi_epi16(r[2], r[6]);
+	s[3] = _mm_unpackhi_epi16(r[3], r[5]);
+	m2d_idct8_half_x86<HORIZ>(s, hi);
+	for (int i = 0; i < 8; ++i) {
+		if (HORIZ) {
+			r[i] = m2d_pack_trunc_x86(_mm_srai_epi32(lo[i], 8), _mm_srai_epi32(hi[i], 8));
+		} else {
+			r[i] = _mm_packs_epi32(_mm_srai_epi32(lo[i], 14), _mm_srai_epi32(hi[i], 14));
+		}
+	}
+}
+
+/** Store eight 16-bit results into a row of luma (_N == 1) or interleaved chroma (_N == 2),
+ * adding to destination if _ADD.
+ */
+template <int _N, int _ADD>
+static inline void m2d_idct_store_x86(uint8_t *dst, __m128i val)
+{
+	__m128i zero = _mm_setzero_si128();
+	if (_N == 1) {
+		if (_ADD) {
+			val = _mm_adds_epi16(val, _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)dst), zero));
+		}
+		_mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(val, val));
+	} else {
+		__m128i mask = _mm_set1_epi16(0x00ff);
+		__m128i a = _mm_loadl_epi64((const __m128i *)dst);
+		__m128i b = _mm_loadl_epi64((const __m128i *)(dst + 7));
+		if (_ADD) {
+			val = _mm_adds_epi16(val, _mm_unpacklo_epi64(_mm_and_si128(a, mask), _mm_srli_epi16(b, 8)));
+		}
+		val = _mm_unpacklo_epi8(_mm_packus_epi16(val, val), zero);
+		_mm_storel_epi64((__m128i *)dst, _mm_or_si128(_mm_andnot_si128(mask, a), val));
+		_mm_storel_epi64((__m128i *)(dst + 7), _mm_or_si128(_mm_and_si128(mask, b), _mm_slli_epi16(_mm_srli_si128(val, 8), 8)));
+	}
+}
+
+/**
+ *\brief iDCT 8x8 by SSE2. coef_exist selects DC only, first column only,
+ * first row only or full calculation.
+ */
+template <int _N, int _ADD>
+static void m2d_idct8x8_x86(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist)
+{
+	__m128i r[8];
+	int column_ac = src_coef[8 * 1] | src_coef[8 * 2] | src_coef[8 * 3] | src_coef[8 * 4] | src_coef[8 * 5] | src_coef[8 * 6] | src_coef[8 * 7];
+	if ((coef_exist == 0) && (column_ac == 0)) {
+		/* DC only */
+		int16_t dc = src_coef[0] * 8;
+		__m128i val = _mm_set1_epi16(((int32_t)dc * 256 + 8192) >> 14);
+		for (int y = 0; y < 8; ++y) {
+			m2d_idct_store_x86<_N, _ADD>(dst_base, val);
+			dst_base += dst_stride;
+		}
+		return;
+	} else if ((coef_exist <= 1) && (column_ac == 0)) {
+		/* first row only, which results in the same value on each row */
+		for (int i = 0; i < 8; ++i) {
+			r[i] = _mm_set1_epi16(src_coef[i]);
+		}
+		m2d_idct8_x86<1>(r);
+		__m128i row = _mm_unpacklo_epi16(r[0], r[1]);
+		row = _mm_unpacklo_epi32(row, _mm_unpacklo_epi16(r[2], r[3]));
+		row = _mm_unpacklo_epi64(row, _mm_unpacklo_epi32(_mm_unpacklo_epi16(r[4], r[5]), _mm_unpacklo_epi16(r[6], r[7])));
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(row, row), 16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(row, row), 16);
+		__m128i round = _mm_set1_epi32(8192);
+		lo = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(lo, 8), round), 14);
+		hi = _mm_srai_epi32(_mm_add_epi32(_mm_slli_epi32(hi, 8), round), 14);
+		__m128i val = _mm_packs_epi32(lo, hi);
+		for (int y = 0; y < 8; ++y) {
+			m2d_idct_store_x86<_N, _ADD>(dst_base, val);
+			dst_base += dst_stride;
+		}
+		return;
+	} else if (coef_exist == 0) {
+		/* first column only */
+		for (int i = 0; i < 8; ++i) {
+			r[i] = _mm_set1_epi16((int16_t)(src_coef[i * 8] * 8));
+		}
+	} else {
+		for (int i = 0; i < 8; ++i) {
+			r[i] = _mm_loadu_si128((const __m128i *)(src_coef + i * 8));
+		}
+		m2d_transpose8x8_x86(r);
+		m2d_idct8_x86<1>(r);
+		m2d_transpose8x8_x86(r);
+	}
+	m2d_idct8_x86<0>(r);
+	for (int y = 0; y < 8; ++y) {
+		m2d_idct_store_x86<_N, _ADD>(dst_base, r[y]);
+		dst_base += dst_stride;
+	}
+}
+#endif
+
+void (* const m2d_idct_func[4][4])(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist) = {
+	{
+#ifdef X86ASM
+		m2d_idct8x8_x86<1, 0>,
+		m2d_idct8x8_x86<2, 0>,
+		m2d_idct8x8_x86<1, 1>,
+		m2d_idct8x8_x86<2, 1>
+#else
+		m2d_idct_intra_luma,
+		m2d_idct_intra_chroma,
+		m2d_idct_inter_luma,
+		m2d_idct_inter_chroma
+#endif
+	},
+	{
+		m2d_idct_half<1, ClipStore<uint8_t> >,
+		m2d_idct_half<2, ClipStore<uint8_t> >,
+		m2d_idct_half<1, AddStore<uint8_t> >,
+		m2d_idct_half<2, AddStore<uint8_t> >
+	},
+	{
+		m2d_idct_quarter<1, ClipStore<uint8_t> >,
+		m2d_idct_quarter<2, ClipStore<uint8_t> >,
+		m2d_idct_quarter<1, AddStore<uint8_t> >,
+		m2d_idct_quarter<2, AddStore<uint8_t> >
+	},
+	{
+		m2d_idct_eighth<ClipStore<uint8_t> >,
+		m2d_idct_eighth<ClipStore<uint8_t> >,
+		m2d_idct_eighth<AddStore<uint8_t> >,
+		m2d_idct_eighth<AddStore<uint8_t> >
+	}
+};
+
+
 #ifdef __RENESAS_VERSION__
 #pragma inline_asm(m2d_idct_add_dconly8xN)
 void m2d_idct_add_dconly8xN(int32_t dc, int height, uint8_t *dst_base, int32_t dst_stride)
@@ -592,5 +943,3 @@ void m2d_idct_add_dconly8xN(int32_t dc, int height, uint8_t *dst_base, int32_t d
 	}
 }
 #endif /* __RENESAS_VERSION__ */
-
-#endif /* FAST_DECODE */
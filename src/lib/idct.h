@@ -44,6 +44,11 @@ void m2d_idct_intra_chroma(uint8_t *dst_base, int32_t dst_stride, int16_t *src_c
 void m2d_idct_inter_luma(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist);
 void m2d_idct_inter_chroma(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist);
 
+/**iDCT functions for each output scale(M2D_SCALE_*).
+ * Each row has intra luma, intra chroma, inter luma and inter chroma in this order.
+ */
+extern void (* const m2d_idct_func[4][4])(uint8_t *dst_base, int32_t dst_stride, int16_t *src_coef, uint32_t coef_exist);
+
 #ifdef __cplusplus
 }
 #endif
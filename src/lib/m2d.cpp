@@ -154,6 +154,56 @@ int m2d_find_mpeg_data(dec_bits *stream)
 	return 0;
 }
 
+/**Open bitstream on caller's stack, for probe or substreams without decoder context.
+ * Reading beyond data longjmp()s to stream->jmp.
+ */
+void m2d_probe_stream_open(dec_bits *stream, void (*loadbytes_func)(dec_bits *, int), const byte_t *data, size_t len)
+{
+	memset(stream, 0, sizeof(*stream));
+	dec_bits_open(stream, loadbytes_func);
+	dec_bits_set_callback(stream, 0, 0);
+	dec_bits_set_data(stream, data, len, 0);
+}
+
+static inline int m2d_is_escape03(const dec_bits *ths, const byte_t *pos)
+{
+	int pos_in_buf = (int)(pos - ths->buf_head_);
+	int b0 = (1 <= pos_in_buf) ? pos[-1] : ths->prev_[1];
+	int b1 = (2 <= pos_in_buf) ? pos[-2] : ths->prev_[pos_in_buf];
+	return (*pos == 3) && (b0 == 0) && (b1 == 0);
+}
+
+/**Raw position of byte-aligned stream read by m2d_load_bytes_skip03().
+ * Bytes in cache are counted back, skipping emulation prevention bytes.
+ * Returns NULL if cached bytes are out of current buffer.
+ */
+const byte_t *m2d_stream_raw_pos_skip03(const dec_bits *ths)
+{
+	const byte_t *pos = ths->buf_;
+	int rest = ths->cache_len_ >> 3;
+	while (0 < rest) {
+		if (pos <= ths->buf_head_) {
+			return 0;
+		}
+		--pos;
+		if (!m2d_is_escape03(ths, pos)) {
+			rest--;
+		}
+	}
+	return pos;
+}
+
+/**Open stream for a part of current buffer of parent, such as a substream of slice.
+ * data shall be preceded by at least two bytes of the buffer.
+ */
+void m2d_substream_open(dec_bits *stream, const dec_bits *parent, const byte_t *data, size_t len)
+{
+	m2d_probe_stream_open(stream, parent->load_bytes, data, len);
+	stream->prev_[0] = data[-2];
+	stream->prev_[1] = data[-1];
+	stream->id = parent->id;
+}
+
 static const uint8_t clip_lut[1024] = {
 	0, 0, 0, 0, 0, 0, 0, 0,
 	0, 0, 0, 0, 0, 0, 0, 0,
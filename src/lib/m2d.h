@@ -25,6 +25,7 @@
 #ifndef __M2D_H__
 #define __M2D_H__
 
+#include <string.h>
 #include "m2types.h"
 #include "bitio.h"
 
@@ -32,6 +33,38 @@
 extern "C" {
 #endif
 
+enum {
+	M2D_PICTYPE_I = 1,
+	M2D_PICTYPE_P,
+	M2D_PICTYPE_B
+};
+
+/**Category of macroblock (or coding unit of H.265) for statistics.
+ */
+enum {
+	M2D_MBTYPE_INTRA = 0,
+	M2D_MBTYPE_INTER, /**< predicted from one list */
+	M2D_MBTYPE_BI, /**< bi-predicted, including B-direct of H.264 */
+	M2D_MBTYPE_SKIP,
+	M2D_MBTYPE_NUM
+};
+
+/**Side data of one macroblock, exported by set_mb_info.
+ * Entries cover each 16x16 block of a picture in raster order.
+ * MPEG-2 field pictures fill rows of their own parity, so that macroblock
+ * row y of a field goes to row 2y of top field or 2y + 1 of bottom field.
+ * ref and mv are for each 8x8 block in raster order and for each list;
+ * ref is -1 when the list is unused. MVs are in units of each standard.
+ * With H.265, coding units smaller than 16x16 leave values of the last one.
+ */
+typedef struct {
+	int8_t type; /**< M2D_MBTYPE_* */
+	int8_t qp; /**< quantiser_scale_code for MPEG-2 */
+	uint16_t cbp; /**< coded_block_pattern; rqt_root_cbf for H.265 */
+	int8_t ref[4][2];
+	int16_t mv[4][2][2];
+} m2d_mb_info_t;
+
 typedef struct {
 	uint8_t *luma;
 	uint8_t *chroma;
@@ -39,6 +72,7 @@ typedef struct {
 	int32_t cnt;
 	int16_t width, height;
 	int16_t crop[4];
+	m2d_mb_info_t *mb_info; /**< side data of the picture, NULL unless set_mb_info */
 } m2d_frame_t;
 
 typedef struct {
@@ -61,8 +95,39 @@ typedef struct {
 	int16_t frame_num;
 	int16_t crop[4];
 	int additional_size;
+	int mb_info_num; /**< entries of m2d_mb_info_t per frame */
 } m2d_info_t;
 
+#define M2D_STATS_QP_NUM 64
+
+/**Per-picture record of analysis mode.
+ * Filled while decode_picture runs when set by set_analysis.
+ * MVs are in units of each standard (half-pel for MPEG-2, quarter-pel otherwise).
+ * QP is quantiser_scale_code for MPEG-2.
+ */
+typedef struct {
+	int8_t pic_type; /**< M2D_PICTYPE_*, most predictive type of slices */
+	int32_t bits; /**< bits of slice NAL units including start codes */
+	int32_t mb_num; /**< number of macroblocks (coding units of H.265), skipped ones included */
+	int16_t mv_min[2], mv_max[2];
+	int32_t qp_hist[M2D_STATS_QP_NUM];
+	int32_t type_hist[M2D_MBTYPE_NUM];
+} m2d_picture_stats_t;
+
+/**Stream parameters reported by probe.
+ * Taken from the first sequence header (with its extensions) or SPS only,
+ * without decoder context, frame allocation nor header_callback.
+ * MPEG-2 is reported at full resolution.
+ */
+typedef struct {
+	m2d_info_t info; /**< as get_info reports after the same header */
+	int16_t profile; /**< profile_idc; upper 4 bits of profile_and_level_indication for MPEG-2 */
+	int16_t level; /**< level_idc; lower 4 bits of profile_and_level_indication for MPEG-2 */
+	int8_t chroma_format; /**< chroma_format_idc, 1 for 4:2:0 */
+	uint32_t frame_rate_num, frame_rate_den; /**< both 0 if not signalled */
+	int luma_size, chroma_size; /**< bytes of each frame to be passed to set_frames */
+} m2d_probe_t;
+
 typedef struct {
 	size_t context_size;
 	int (*init)(void *, int, int (*)(void *, void *), void *);
@@ -72,12 +137,26 @@ typedef struct {
 	int (*decode_picture)(void *);
 	int (*peek_decoded_frame)(void *, m2d_frame_t *, int);
 	int (*get_decoded_frame)(void *, m2d_frame_t *, int);
+	int (*set_analysis)(void *, m2d_picture_stats_t *);
+	int (*set_mb_info)(void *, m2d_mb_info_t *, int);
+	int (*set_luma_only)(void *, int);
+	int (*probe)(const byte_t *, size_t, m2d_probe_t *);
+	int (*set_threads)(void *, int);
 } m2d_func_table_t;
 
 int m2d_dec_vld_unary(dec_bits *stream, const vlc_t *vld_tab, int bitlen);
 void m2d_load_bytes_skip03(dec_bits *ths, int read_bytes);
 int m2d_find_mpeg_data(dec_bits *stream);
 int m2d_next_start_code(const byte_t *org_src, int byte_len);
+void m2d_probe_stream_open(dec_bits *stream, void (*loadbytes_func)(dec_bits *, int), const byte_t *data, size_t len);
+const byte_t *m2d_stream_raw_pos_skip03(const dec_bits *stream);
+void m2d_substream_open(dec_bits *stream, const dec_bits *parent, const byte_t *data, size_t len);
+
+static inline void m2d_probe_set_frame_size(m2d_probe_t *probe)
+{
+	probe->luma_size = probe->info.src_width * probe->info.src_height;
+	probe->chroma_size = probe->luma_size >> 1;
+}
 
 static inline uint32_t get_bits32(dec_bits *ths, int bit_len)
 {
@@ -278,6 +357,92 @@ static inline int cabac_decode_bypass(m2d_cabac_t *cb, dec_bits *st)
 	}
 }
 
+static inline void m2d_stats_init(m2d_picture_stats_t *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->mv_min[0] = stats->mv_min[1] = 32767;
+	stats->mv_max[0] = stats->mv_max[1] = -32768;
+}
+
+static inline void m2d_stats_pic_type(m2d_picture_stats_t *stats, int pic_type)
+{
+	if (stats->pic_type < pic_type) {
+		stats->pic_type = pic_type;
+	}
+}
+
+static inline void m2d_stats_mb(m2d_picture_stats_t *stats, int type, int qp, int num)
+{
+	stats->mb_num += num;
+	stats->type_hist[type] += num;
+	stats->qp_hist[qp & (M2D_STATS_QP_NUM - 1)] += num;
+}
+
+static inline void m2d_stats_mv(m2d_picture_stats_t *stats, const int16_t *mv)
+{
+	for (int i = 0; i < 2; ++i) {
+		if (mv[i] < stats->mv_min[i]) {
+			stats->mv_min[i] = mv[i];
+		}
+		if (stats->mv_max[i] < mv[i]) {
+			stats->mv_max[i] = mv[i];
+		}
+	}
+}
+
+/**Entries for frame idx in buffer given by set_mb_info, or NULL if absent or too small.
+ */
+static inline m2d_mb_info_t *m2d_mb_info_frame(m2d_mb_info_t *base, int size, int idx, int mb_num)
+{
+	return (base && (0 <= idx) && ((idx + 1) * mb_num <= size)) ? base + idx * mb_num : 0;
+}
+
+static inline void m2d_mb_info_set(m2d_mb_info_t *info, int type, int qp, int cbp)
+{
+	info->type = type;
+	info->qp = qp;
+	info->cbp = cbp;
+}
+
+static inline void m2d_mb_info_mv(m2d_mb_info_t *info, int blk, int lx, int ref, const int16_t *mv)
+{
+	info->ref[blk][lx] = ref;
+	info->mv[blk][lx][0] = mv[0];
+	info->mv[blk][lx][1] = mv[1];
+}
+
+static inline void m2d_mb_info_no_mv(m2d_mb_info_t *info)
+{
+	memset(info->ref, -1, sizeof(info->ref));
+	memset(info->mv, 0, sizeof(info->mv));
+}
+
+/**Read position of stream, for counting bits of a NAL unit.
+ * Survives one replacement of input buffer by error callback.
+ */
+typedef struct {
+	const byte_t *pos;
+	const byte_t *head;
+	const byte_t *tail;
+} m2d_stream_mark_t;
+
+static inline void m2d_stream_mark(m2d_stream_mark_t *mark, dec_bits *st)
+{
+	mark->pos = dec_bits_current(st);
+	mark->head = st->buf_head_;
+	mark->tail = st->buf_tail_;
+}
+
+static inline int m2d_stream_bits_from(const m2d_stream_mark_t *mark, dec_bits *st)
+{
+	const byte_t *curr = dec_bits_current(st);
+	if (st->buf_head_ == mark->head) {
+		return (int)(curr - mark->pos) * 8;
+	} else {
+		return (int)((mark->tail - mark->pos) + (curr - st->buf_head_)) * 8;
+	}
+}
+
 static int header_dummyfunc(void *arg, void *seq_id) {return 0;}
 
 #ifdef __cplusplus
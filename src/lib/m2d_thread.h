@@ -0,0 +1,97 @@
+/** Yet Another Video decoder
+ *  Copyright 2011 Takayuki Minegishi
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *  
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *  
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT
+ *  HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,
+ *  WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ *  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ *  DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef __M2D_THREAD_H__
+#define __M2D_THREAD_H__
+
+/**Worker threads inside decode_picture.
+ * Threads are created and joined within one call so that contexts need
+ * no finalizer, except H.265 frame threads which live until their picture is
+ * output. Unavailable without C++11 threads, where decoders run serially.
+ */
+#if !defined(__RENESAS_VERSION__) && ((201103L <= __cplusplus) || (defined(_MSC_VER) && (1900 <= _MSC_VER)))
+#define M2D_THREADS
+
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "m2types.h"
+
+#define M2D_MAX_THREADS 16
+
+/**Progress of units such as CTU rows, which other threads wait on.
+ * Counters are given by caller; abort() releases every waiter.
+ */
+class m2d_progress_t {
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	int32_t *count_;
+	bool abort_;
+public:
+	m2d_progress_t(int32_t *count, int num) : count_(count), abort_(false) {
+		for (int i = 0; i < num; ++i) {
+			count[i] = 0;
+		}
+	}
+	explicit m2d_progress_t(int32_t *count) : count_(count), abort_(false) {}
+	void set(int idx, int32_t val) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			count_[idx] = val;
+		}
+		cond_.notify_all();
+	}
+	void add(int idx, int32_t val) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			count_[idx] += val;
+		}
+		cond_.notify_all();
+	}
+	bool wait(int idx, int32_t val) {
+		std::unique_lock<std::mutex> lock(mutex_);
+		while (!abort_ && (count_[idx] < val)) {
+			cond_.wait(lock);
+		}
+		return !abort_;
+	}
+	void abort() {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			abort_ = true;
+		}
+		cond_.notify_all();
+	}
+	bool aborted() {
+		std::lock_guard<std::mutex> lock(mutex_);
+		return abort_;
+	}
+};
+
+#endif
+
+#endif /* __M2D_THREAD_H__ */
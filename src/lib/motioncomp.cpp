@@ -25,6 +25,11 @@
 #include "m2d_macro.h"
 #include "motioncomp.h"
 
+#if (defined(__GNUC__) && defined(__SSE2__)) || defined(_M_IX86) || defined(_M_AMD64)
+#define X86ASM
+#include <emmintrin.h>
+#endif
+
 #define HALFPEL(x, y) ((((y) & 1) * 2) | ((x) & 1))
 
 #define X01 0x01010101
@@ -44,10 +49,6 @@ static inline uint32_t AVERAGE2(uint32_t s1, uint32_t s2)
 #define AVERAGE2_NORND(s1, s2) (((s1) & (s2)) + ((((s1) ^ (s2)) & ~X01) >> 1))
 
 
-
-#ifndef FAST_DECODE
-
-
 /** Functor that just stores passed value.
  * This is for mono-directional motion compensation.
  */
@@ -267,6 +268,7 @@ static inline void m2d_bilinear16_horiz_22_rnd_base(const uint8_t *src, uint8_t
 	} while (--height);
 }
 
+#ifndef X86ASM
 static void m2d_bilinear16_vert_22_rnd(const uint8_t *src, uint8_t *dst, int stride, int height)
 {
 	m2d_bilinear16_vert_22_rnd_base(src, dst, stride, height, Store<uint32_t>());
@@ -296,6 +298,7 @@ static void m2d_bilinear_chroma_horiz_rnd_add(const uint8_t *src, uint8_t *dst,
 {
 	m2d_bilinear16_horiz_22_rnd_base(src, dst, stride, height + 1, AveStore<uint32_t>());
 }
+#endif
 
 #endif /* __RENESAS_VERSION__ */
 
@@ -355,6 +358,7 @@ static inline void m2d_bilinear_22_22_rnd_base(const uint8_t *src, uint8_t *dst,
 	} while (--height);
 }
 
+#ifndef X86ASM
 static void m2d_bilinear_22_22_rnd(const uint8_t *src, uint8_t *dst, int stride, int height)
 {
 	m2d_bilinear_22_22_rnd_base(src, dst, stride, height, Store<uint8_t>());
@@ -364,6 +368,7 @@ static void m2d_bilinear_22_22_rnd_add(const uint8_t *src, uint8_t *dst, int str
 {
 	m2d_bilinear_22_22_rnd_base(src, dst, stride, height, AveStore<uint8_t>());
 }
+#endif
 
 
 template <typename F>
@@ -426,6 +431,7 @@ static inline void m2d_bilinear_chroma_22_22_rnd_base(const uint8_t *src, uint8_
 	} while (--height);
 }
 
+#ifndef X86ASM
 static void m2d_bilinear_chroma_22_22_rnd(const uint8_t *src, uint8_t *dst, int stride, int height)
 {
 	m2d_bilinear_chroma_22_22_rnd_base(src, dst, stride, height, Store<uint8_t>());
@@ -436,6 +442,7 @@ static void m2d_bilinear_chroma_22_22_rnd_add(const uint8_t *src, uint8_t *dst,
 {
 	m2d_bilinear_chroma_22_22_rnd_base(src, dst, stride, height, AveStore<uint8_t>());
 }
+#endif
 
 #if defined(__RENESAS_VERSION__) && (defined(_SH4ALDSP) || defined(_SH4A))
 #undef m2d_copy16xn
@@ -448,6 +455,116 @@ static void m2d_bilinear_chroma_22_22_rnd_add(const uint8_t *src, uint8_t *dst,
 #undef m2d_bilinear_chroma_horiz_rnd_add
 #endif
 
+#ifdef X86ASM
+/** Half-pel interpolation of 16 bytes width by SSE2, which is either 16 luma
+ * or 8 pairs of interleaved chroma. STEP is distance to the horizontal neighbour,
+ * and _ADD averages the prediction with destination for bi-directional MC.
+ */
+template <int _ADD>
+static inline void m2d_mc_store_x86(uint8_t *dst, __m128i val)
+{
+	if (_ADD) {
+		val = _mm_avg_epu8(val, _mm_loadu_si128((const __m128i *)dst));
+	}
+	_mm_storeu_si128((__m128i *)dst, val);
+}
+
+template <int _ADD>
+static void m2d_copy16xn_x86(const uint8_t *src, uint8_t *dst, int stride, int height)
+{
+	do {
+		m2d_mc_store_x86<_ADD>(dst, _mm_loadu_si128((const __m128i *)src));
+		src += stride;
+		dst += stride;
+	} while (--height);
+}
+
+template <int STEP, int _ADD>
+static void m2d_bilinear16_horiz_x86(const uint8_t *src, uint8_t *dst, int stride, int height)
+{
+	do {
+		__m128i s0 = _mm_loadu_si128((const __m128i *)src);
+		__m128i s1 = _mm_loadu_si128((const __m128i *)(src + STEP));
+		m2d_mc_store_x86<_ADD>(dst, _mm_avg_epu8(s0, s1));
+		src += stride;
+		dst += stride;
+	} while (--height);
+}
+
+template <int _ADD>
+static void m2d_bilinear16_vert_x86(const uint8_t *src, uint8_t *dst, int stride, int height)
+{
+	__m128i upper = _mm_loadu_si128((const __m128i *)src);
+	do {
+		src += stride;
+		__m128i lower = _mm_loadu_si128((const __m128i *)src);
+		m2d_mc_store_x86<_ADD>(dst, _mm_avg_epu8(upper, lower));
+		upper = lower;
+		dst += stride;
+	} while (--height);
+}
+
+/** Sums of horizontal pairs in 16-bit.
+ */
+template <int STEP>
+static inline void m2d_pair_sum_x86(const uint8_t *src, __m128i& lo, __m128i& hi)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i s0 = _mm_loadu_si128((const __m128i *)src);
+	__m128i s1 = _mm_loadu_si128((const __m128i *)(src + STEP));
+	lo = _mm_add_epi16(_mm_unpacklo_epi8(s0, zero), _mm_unpacklo_epi8(s1, zero));
+	hi = _mm_add_epi16(_mm_unpackhi_epi8(s0, zero), _mm_unpackhi_epi8(s1, zero));
+}
+
+template <int STEP, int _ADD>
+static void m2d_bilinear_22_22_x86(const uint8_t *src, uint8_t *dst, int stride, int height)
+{
+	__m128i round = _mm_set1_epi16(2);
+	__m128i upper_lo, upper_hi;
+	m2d_pair_sum_x86<STEP>(src, upper_lo, upper_hi);
+	upper_lo = _mm_add_epi16(upper_lo, round);
+	upper_hi = _mm_add_epi16(upper_hi, round);
+	do {
+		__m128i lower_lo, lower_hi;
+		src += stride;
+		m2d_pair_sum_x86<STEP>(src, lower_lo, lower_hi);
+		__m128i lo = _mm_srli_epi16(_mm_add_epi16(upper_lo, lower_lo), 2);
+		__m128i hi = _mm_srli_epi16(_mm_add_epi16(upper_hi, lower_hi), 2);
+		m2d_mc_store_x86<_ADD>(dst, _mm_packus_epi16(lo, hi));
+		upper_lo = _mm_add_epi16(lower_lo, round);
+		upper_hi = _mm_add_epi16(lower_hi, round);
+		dst += stride;
+	} while (--height);
+}
+
+void (* const m2d_motion_comp_luma[4])(const uint8_t *src, uint8_t *dst, int stride, int height) = {
+		m2d_copy16xn_x86<0>,
+		m2d_bilinear16_horiz_x86<1, 0>,
+		m2d_bilinear16_vert_x86<0>,
+		m2d_bilinear_22_22_x86<1, 0>
+};
+
+void (* const m2d_motion_comp_chroma[4])(const uint8_t *src, uint8_t *dst, int stride, int height) = {
+		m2d_copy16xn_x86<0>,
+		m2d_bilinear16_horiz_x86<2, 0>,
+		m2d_bilinear16_vert_x86<0>,
+		m2d_bilinear_22_22_x86<2, 0>
+};
+
+void (* const m2d_motion_comp_luma_add[4])(const uint8_t *src, uint8_t *dst, int stride, int height) = {
+		m2d_copy16xn_x86<1>,
+		m2d_bilinear16_horiz_x86<1, 1>,
+		m2d_bilinear16_vert_x86<1>,
+		m2d_bilinear_22_22_x86<1, 1>
+};
+
+void (* const m2d_motion_comp_chroma_add[4])(const uint8_t *src, uint8_t *dst, int stride, int height) = {
+		m2d_copy16xn_x86<1>,
+		m2d_bilinear16_horiz_x86<2, 1>,
+		m2d_bilinear16_vert_x86<1>,
+		m2d_bilinear_22_22_x86<2, 1>
+};
+#else
 void (* const m2d_motion_comp_luma[4])(const uint8_t *src, uint8_t *dst, int stride, int height) = {
 		m2d_copy16xn,
 		m2d_bilinear16_horiz_22_rnd,
@@ -475,6 +592,7 @@ void (* const m2d_motion_comp_chroma_add[4])(const uint8_t *src, uint8_t *dst, i
 		m2d_bilinear16_vert_22_rnd_add,
 		m2d_bilinear_chroma_22_22_rnd_add
 };
+#endif
 
 /**
  *\brief Bilinear motion compensation for 16x(16|8) block in case round-bit is active.
@@ -545,62 +663,115 @@ void m2d_motion_compensation_chroma_add(const uint8_t *src, uint8_t *dst, int st
 	m2d_motion_comp_chroma_add[HALFPEL(mvx, mvy)](src, dst, stride, height);
 }
 
-#else /* FAST_DECODE */
-
-void m2d_motion_compensation_luma(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height)
-{
-	src = src + stride * ((mvxy[1] + 8) >> 4) + ((mvxy[0] + 8) >> 4);
-	dst[0] = src[0];
-	dst[1] = src[1];
-	src += stride;
-	dst += stride;
-	dst[0] = src[0];
-	dst[1] = src[1];
-}
-
-void m2d_motion_compensation_chroma(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height)
-{
-	int mvx = mvxy[0] / 2;
-	int mvy = mvxy[1] / 2;
-	src = src + stride * ((mvy + 8) >> 4) + (((mvx + 4) >> 3) & ~1);
-	*(sint16_t *)dst = *(sint16_t *)src;
-}
-
-void m2d_copy16xn(const uint8_t *src, uint8_t *dst, int stride, int height)
+/**
+ *\brief Bilinear interpolation at arbitrary fractional position for reduced scale output.
+ *
+ *\param src Pointer to integer position in reference frame.
+ *\param dst Pointer to block of Prediction frame.
+ *\param stride Width of frame.
+ *\param width Number of bytes in a line.
+ *\param height Number of lines.
+ *\param fx Horizontal fractional position in 1 / (1 << frac_bits) pel.
+ *\param fy Vertical fractional position in 1 / (1 << frac_bits) pel.
+ *\param step Distance to the next pixel of same component (2 for interleaved chroma).
+ */
+template <typename F>
+static inline void m2d_bilinear_scaled_base(const uint8_t *src, uint8_t *dst, int stride, int width, int height, int fx, int fy, int frac_bits, int step, F _store)
 {
-	*(sint16_t *)dst = *(sint16_t *)src;
-	if (--height != 0) {
-		src += stride;
-		dst += stride;
-		*(sint16_t *)dst = *(sint16_t *)src;
+	int one = 1 << frac_bits;
+	if (fy == 0) {
+		if (fx == 0) {
+			do {
+				for (int x = 0; x < width; ++x) {
+					_store(dst + x, src[x]);
+				}
+				src += stride;
+				dst += stride;
+			} while (--height);
+		} else {
+			int rnd = one >> 1;
+			do {
+				for (int x = 0; x < width; ++x) {
+					_store(dst + x, (src[x] * (one - fx) + src[x + step] * fx + rnd) >> frac_bits);
+				}
+				src += stride;
+				dst += stride;
+			} while (--height);
+		}
+	} else if (fx == 0) {
+		int rnd = one >> 1;
+		do {
+			for (int x = 0; x < width; ++x) {
+				_store(dst + x, (src[x] * (one - fy) + src[x + stride] * fy + rnd) >> frac_bits);
+			}
+			src += stride;
+			dst += stride;
+		} while (--height);
+	} else {
+		int w0 = (one - fx) * (one - fy);
+		int w1 = fx * (one - fy);
+		int w2 = (one - fx) * fy;
+		int w3 = fx * fy;
+		int shift = frac_bits * 2;
+		int rnd = 1 << (shift - 1);
+		do {
+			for (int x = 0; x < width; ++x) {
+				const uint8_t *s = src + x;
+				_store(dst + x, (s[0] * w0 + s[step] * w1 + s[stride] * w2 + s[stride + step] * w3 + rnd) >> shift);
+			}
+			src += stride;
+			dst += stride;
+		} while (--height);
 	}
 }
 
-void m2d_motion_compensation_luma_add(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height)
+/**
+ *\brief Motion compensation for luma block of 1 / (1 << SCALE) size.
+ *
+ * Motion vector in half pel of original size is applied as 1 / (2 << SCALE) pel.
+ *\param height Number of lines in reduced size.
+ */
+template <int SCALE, typename F>
+static void m2d_motion_compensation_luma_scaled(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height)
 {
-	src = src + stride * ((mvxy[1] + 8) >> 4) + ((mvxy[0] + 8) >> 4);
-	dst[0] = (dst[0] + src[0]) >> 1;
-	dst[1] = (dst[1] + src[1]) >> 1;
-	src += stride;
-	dst += stride;
-	dst[0] = (dst[0] + src[0]) >> 1;
-	dst[1] = (dst[1] + src[1]) >> 1;
+	int mvx = mvxy[0];
+	int mvy = mvxy[1];
+	int mask = (2 << SCALE) - 1;
+	src = src + stride * (mvy >> (SCALE + 1)) + (mvx >> (SCALE + 1));
+	m2d_bilinear_scaled_base(src, dst, stride, MB_LEN >> SCALE, height, mvx & mask, mvy & mask, SCALE + 1, 1, F());
 }
 
-void m2d_motion_compensation_chroma_add(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height)
+/**
+ *\brief Motion compensation for interleaved chroma block of 1 / (1 << SCALE) size.
+ *\param height Number of lines in reduced size.
+ */
+template <int SCALE, typename F>
+static void m2d_motion_compensation_chroma_scaled(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height)
 {
 	int mvx = mvxy[0] / 2;
 	int mvy = mvxy[1] / 2;
-	src = src + stride * ((mvy + 8) >> 4) + (((mvx + 4) >> 3) & ~1);
-	dst[0] = (dst[0] + src[0]) >> 1;
-	dst[1] = (dst[1] + src[1]) >> 1;
-}
-
-#endif /* FAST_DECODE */
-
-void (* const m2d_motion_compensation[2][2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = {
-	{m2d_motion_compensation_luma, m2d_motion_compensation_chroma},
-	{m2d_motion_compensation_luma_add, m2d_motion_compensation_chroma_add},
+	int mask = (2 << SCALE) - 1;
+	src = src + stride * (mvy >> (SCALE + 1)) + (mvx >> (SCALE + 1)) * 2;
+	m2d_bilinear_scaled_base(src, dst, stride, MB_LEN >> SCALE, height, mvx & mask, mvy & mask, SCALE + 1, 2, F());
+}
+
+void (* const m2d_motion_compensation[4][2][2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = {
+	{
+		{m2d_motion_compensation_luma, m2d_motion_compensation_chroma},
+		{m2d_motion_compensation_luma_add, m2d_motion_compensation_chroma_add},
+	},
+	{
+		{m2d_motion_compensation_luma_scaled<1, Store<uint8_t> >, m2d_motion_compensation_chroma_scaled<1, Store<uint8_t> >},
+		{m2d_motion_compensation_luma_scaled<1, AveStore<uint8_t> >, m2d_motion_compensation_chroma_scaled<1, AveStore<uint8_t> >},
+	},
+	{
+		{m2d_motion_compensation_luma_scaled<2, Store<uint8_t> >, m2d_motion_compensation_chroma_scaled<2, Store<uint8_t> >},
+		{m2d_motion_compensation_luma_scaled<2, AveStore<uint8_t> >, m2d_motion_compensation_chroma_scaled<2, AveStore<uint8_t> >},
+	},
+	{
+		{m2d_motion_compensation_luma_scaled<3, Store<uint8_t> >, m2d_motion_compensation_chroma_scaled<3, Store<uint8_t> >},
+		{m2d_motion_compensation_luma_scaled<3, AveStore<uint8_t> >, m2d_motion_compensation_chroma_scaled<3, AveStore<uint8_t> >},
+	},
 };
 
 #if defined(__RENESAS_VERSION__) && (defined(_SH4ALDSP) || defined(_SH4A)) && defined(UNIT_TEST)
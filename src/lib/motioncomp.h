@@ -31,7 +31,10 @@
 extern "C" {
 #endif
 
-extern void (* const m2d_motion_compensation[2][2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height);
+/**Motion compensation functions indexed by output scale(M2D_SCALE_*),
+ * mono/bi-directional and luma/chroma.
+ */
+extern void (* const m2d_motion_compensation[4][2][2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height);
 
 #ifdef __cplusplus
 }
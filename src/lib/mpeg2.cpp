@@ -29,17 +29,9 @@
 #include "mpeg2.h"
 #include "vld.h"
 #include "motioncomp.h"
+#include "m2d_thread.h"
 
-#ifdef FAST_DECODE
-#define m2d_idct_intra_luma(dst, stride, coef, sum) ((dst)[0] = (((coef)[0] + 4) >> 3))
-#define m2d_idct_intra_chroma(dst, stride, coef, sum) m2d_idct_intra_luma(dst, stride, coef, sum)
-#define m2d_idct_inter_luma(dst, stride, coef, sum) ((dst)[0] += (((coef)[0] + 4) >> 3))
-#define m2d_idct_inter_chroma(dst, stride, coef, sum) m2d_idct_inter_luma(dst, stride, coef, sum)
-#define m2d_prefetch_mb(a, b)
-#define m2d_clear_coef(a, b) *((a) + (b)) = 0
-#else
 #include "idct.h"
-#endif
 
 #ifdef _M_IX86
 #include <crtdbg.h>
@@ -86,7 +78,7 @@ static void m2d_skip_mb_B(m2d_mb_current *mb, int mb_increment);
 static int m2d_macroblock_type_I(dec_bits *stream);
 static int m2d_macroblock_type_P(dec_bits *stream);
 static int m2d_macroblock_type_B(dec_bits *stream);
-static int m2d_decode_macroblocks(m2d_context *m2d);
+static int m2d_decode_macroblocks(m2d_mb_current *mb, dec_bits *stream);
 static void m2d_motion_vectors(m2d_mb_current *mb, dec_bits *stream, int s, int *mvxy, int8_t *ref_field);
 
 static int (* const macroblock_type_func[])(dec_bits *stream) = {
@@ -119,9 +111,10 @@ __LIBM2DEC_API int m2d_set_frames(m2d_context *m2d, int num_mem, m2d_frame_t *me
 	frames->num = num_mem;
 	memcpy(frames->frames, mem, sizeof(frames->frames[0]) * num_mem);
 	for (i = 0; i < num_mem; ++i) {
-		if (!VALID_MEM(mem[i].luma) || !VALID_MEM(mem[i].chroma)) {
+		if (!VALID_MEM(mem[i].luma) || (!VALID_MEM(mem[i].chroma) && !(m2d->mb_current->luma_only && !mem[i].chroma))) {
 			return -1;
 		}
+		frames->frames[i].mb_info = 0;
 	}
 	frames->index = -1;
 	return 0;
@@ -162,11 +155,14 @@ static void m2d_update_frames(m2d_context *m2d, m2d_frames *frames, int next_cod
 	int ref0_idx, ref1_idx;
 	m2d_frame_t *curr_frame;
 
+	m2d->frame_pending = 0;
 	curr_idx = frames->index;
 	if (curr_idx < 0) {
-		/* Just after initialization */
+		/* Just after initialization. References not decoded yet point to another frame than current one. */
 		m2d->out_state = ((next_coding_type == I_VOP) || (next_coding_type == P_VOP)) ? 1 * 2 : 0;
 		frames->index = 0;
+		set_ptrdiff(frames, 0, 1 < frames->num, &frames->frames[0]);
+		set_ptrdiff(frames, 1, 1 < frames->num, &frames->frames[0]);
 		return;
 	}
 
@@ -193,16 +189,31 @@ static void m2d_update_frames(m2d_context *m2d, m2d_frames *frames, int next_cod
 	set_ptrdiff(frames, 1, ref1_idx, curr_frame);
 }
 
-static void m2d_frames_inc_mb_x_pos(m2d_frames *frames, int inc_x)
+static int m2d_mb_info_num(const m2d_mb_current *mb, const m2d_seq_header *header)
+{
+	return mb->mbmax_x * ((header->vertical_size_value + 15) >> 4);
+}
+
+/**Attach side data to current frame if m2d_set_mb_info() has given room for it.
+ */
+static void m2d_attach_mb_info(m2d_context *m2d)
+{
+	m2d_mb_current *mb = m2d->mb_current;
+	m2d_frames *frames = mb->frames;
+	m2d_frame_t *frame = &frames->frames[frames->index];
+	mb->mb_info = frame->mb_info = m2d_mb_info_frame(frames->mb_info, frames->mb_info_size, frames->index, m2d_mb_info_num(mb, m2d->seq_header));
+}
+
+static void m2d_frames_inc_mb_x_pos(m2d_frames *frames, int inc_x, int mb_len)
 {
-	int offset_luma = inc_x * MB_LEN;
+	int offset_luma = inc_x * mb_len;
 	frames->curr_luma = frames->curr_luma + offset_luma;
 	frames->curr_chroma = frames->curr_chroma + offset_luma;
 }
 
-static void m2d_frames_inc_mb_y_pos(m2d_frames *frames, int inc_y, int width)
+static void m2d_frames_inc_mb_y_pos(m2d_frames *frames, int inc_y, int width, int mb_len)
 {
-	int offset_luma = inc_y * width * MB_LEN;
+	int offset_luma = inc_y * width * mb_len;
 	frames->curr_luma = frames->curr_luma + offset_luma;
 	frames->curr_chroma = frames->curr_chroma + (offset_luma >> 1);
 }
@@ -215,8 +226,8 @@ static void m2d_frames_set_mb_pos(m2d_mb_current *mb, int mb_x, int mb_y, int wi
 	mb->mb_y = mb_y;
 	frames->curr_luma = frame->luma;
 	frames->curr_chroma = frame->chroma;
-	m2d_frames_inc_mb_y_pos(frames, mb_y, width);
-	m2d_frames_inc_mb_x_pos(frames, mb_x);
+	m2d_frames_inc_mb_y_pos(frames, mb_y, width, mb->mb_len);
+	m2d_frames_inc_mb_x_pos(frames, mb_x, mb->mb_len);
 }
 
 void m2d_mb_set_default(m2d_mb_current *mb);
@@ -233,8 +244,14 @@ __LIBM2DEC_API int m2d_init(m2d_context *m2d, int dummy, int (*header_callback)(
 	m2d->mb_current->frames = &m2d->frames_i;
 	m2d->header_callback = header_callback ? header_callback : header_dummyfunc;
 	m2d->header_callback_arg = arg;
+	m2d->threads = 1;
 	VC_CHECK;
 	dec_bits_open(m2d->stream, 0);
+#ifdef FAST_DECODE
+	m2d_set_scale(m2d, M2D_SCALE_EIGHTH);
+#else
+	m2d_set_scale(m2d, M2D_SCALE_FULL);
+#endif
 	return 0;
 }
 
@@ -296,6 +313,7 @@ void m2d_mb_set_default(m2d_mb_current *mb)
 	mb->intra_dc_scale = 3;
 	mb->intra_dc_max = (1 << 8) - 1;
 	mb->frame_mode = 3;
+	mb->picture_structure = 3;
 	mb->zigzag = m2d_zigzag[0];
 	m2d_mb_set_mpeg2_mode(mb, 0);
 }
@@ -306,26 +324,13 @@ static void m2d_mb_set_frame_size(m2d_mb_current *mb, int width, int height)
 	int mb_y = (height + 15) >> 4;
 	mb->mbmax_x = mb_x;
 	mb->mbmax_y = mb->dct_type == 2 ? (mb_y >> 1) : mb_y;
-	width = mb_x * MB_LEN;
-	height = mb_y * MB_LEN;
-#ifdef FAST_DECODE
-	mb->frame_width = (mb_x * 2 + 15) & ~15;
-	mb->frame_height = (mb_y * 2 + 15) & ~15;
-#else
-	mb->frame_width = mb_x * 16;
-	mb->frame_height = mb_y * 16;
-#endif
+	mb->frame_width = ALIGN16(mb_x * mb->mb_len);
+	mb->frame_height = ALIGN16(mb_y * mb->mb_len);
 }
 
-static int m2d_read_seq_header(m2d_context *m2d)
+static int m2d_seq_header_fields(m2d_seq_header *header, dec_bits *stream)
 {
-	dec_bits *stream;
-	m2d_seq_header *header;
-	int bit;
 	int err = 0;
-
-	stream = m2d->stream;
-	header = m2d->seq_header;
 	header->horizontal_size_value = get_bits(stream, 12);
 	header->vertical_size_value = get_bits(stream, 12);
 	header->aspect_ratio_information = get_bits(stream, 4);
@@ -334,7 +339,21 @@ static int m2d_read_seq_header(m2d_context *m2d)
 	MARKER_BIT1(stream, err);
 	header->vbv_buffer_size = get_bits(stream, 10);
 	header->constrained_parameters_flag = get_onebit(stream);
+	header->display_width = 0;
+	header->display_height = 0;
+	return err;
+}
+
+static int m2d_read_seq_header(m2d_context *m2d)
+{
+	dec_bits *stream;
+	m2d_seq_header *header;
+	int bit;
+	int err;
 
+	stream = m2d->stream;
+	header = m2d->seq_header;
+	err = m2d_seq_header_fields(header, stream);
 	header->load_intra_quantizer_matrix = bit = get_onebit(stream);
 	m2d_set_qmat(m2d->mb_current, stream, m2d->qmat[0], bit, 0);
 	header->load_non_intra_quantizer_matrix = bit = get_onebit(stream);
@@ -355,14 +374,9 @@ static int m2d_read_extension_dummy(m2d_context *m2d)
 	return 0;
 }
 
-static int m2d_read_sequence_extension(m2d_context *m2d)
+static int m2d_sequence_extension_fields(m2d_seq_header *header, dec_bits *stream)
 {
-	dec_bits *stream;
-	m2d_seq_header *header;
 	int err = 0;
-
-	stream = m2d->stream;
-	header = m2d->seq_header;
 	header->profile_and_level = get_bits(stream, 8);
 	header->progressive_sequence = get_bits(stream, 1);
 	header->chroma_format = get_bits(stream, 2);
@@ -371,7 +385,21 @@ static int m2d_read_sequence_extension(m2d_context *m2d)
 	header->bit_rate_value |= get_bits(stream, 12) << 18;
 	MARKER_BIT1(stream, err);
 	header->vbv_buffer_size |= get_bits(stream, 8) << 10;
+	header->low_delay = get_onebit(stream);
+	header->frame_rate_extension_n = get_bits(stream, 2);
+	header->frame_rate_extension_d = get_bits(stream, 5);
+	return err;
+}
 
+static int m2d_read_sequence_extension(m2d_context *m2d)
+{
+	dec_bits *stream;
+	m2d_seq_header *header;
+	int err;
+
+	stream = m2d->stream;
+	header = m2d->seq_header;
+	err = m2d_sequence_extension_fields(header, stream);
 	m2d_mb_set_frame_size(m2d->mb_current, header->horizontal_size_value, header->vertical_size_value);
 	m2d_mb_set_mpeg2_mode(m2d->mb_current, 1);
 	m2d->header_callback(m2d->header_callback_arg, stream->id);
@@ -486,6 +514,7 @@ static int m2d_read_coding_extension(m2d_context *m2d)
 	mb->intra_dc_scale = 3 - pic->intra_dc_precision;
 	mb->intra_dc_max = (1 << (pic->intra_dc_precision + 8)) - 1;
 	mb->zigzag = m2d_zigzag[pic->alternate_scan];
+	mb->picture_structure = pic->picture_structure;
 	switch (pic->picture_structure) {
 	case 1:
 		/* FALLTHROUGH */
@@ -503,20 +532,23 @@ static int m2d_read_coding_extension(m2d_context *m2d)
 	return err;
 }
 
-static int m2d_read_display_extension(m2d_context *m2d)
+static void m2d_display_extension_fields(m2d_seq_header *header, dec_bits *stream)
 {
-	dec_bits *stream;
 	int format;
 	int width_height;
 
-	stream = m2d->stream;
 	format = get_bits(stream, 4);
 	if (format & 1) {
 		skip_bits(stream, 8 * 3);
 	}
 	width_height = get_bits(stream, 14 + 1 + 14);
-	m2d->seq_header->display_height = width_height & 0x3fff;
-	m2d->seq_header->display_width = (unsigned)width_height >> 15;
+	header->display_height = width_height & 0x3fff;
+	header->display_width = (unsigned)width_height >> 15;
+}
+
+static int m2d_read_display_extension(m2d_context *m2d)
+{
+	m2d_display_extension_fields(m2d->seq_header, m2d->stream);
 	return 0;
 }
 
@@ -605,6 +637,11 @@ static int m2d_read_picture_header(m2d_context *m2d)
 	mb = m2d->mb_current;
 	set_coding_type(mb, coding_type);
 	m2d_init_mb_pos(m2d->mb_current);
+	m2d->frame_pending = 1;
+	if (mb->stats) {
+		m2d_stats_init(mb->stats);
+		m2d_stats_pic_type(mb->stats, (coding_type <= B_VOP) ? coding_type : M2D_PICTYPE_I);
+	}
 	if ((coding_type == P_VOP) || (coding_type == B_VOP)) {
 		int r_size;
 		r_size = get_bits(stream, 4) - 1;
@@ -622,24 +659,45 @@ static int m2d_read_picture_header(m2d_context *m2d)
 	return err;
 }
 
+/**Read rest of slice header following slice_start_code.
+ */
+static void m2d_slice_header(m2d_mb_current *mb, const m2d_picture *pic, dec_bits *stream)
+{
+	mb->q_mapping = m2d_q_mapping[pic->q_scale_type];
+	mb->q_scale_code = get_bits(stream, 5);
+	mb->q_scale = mb->q_mapping[mb->q_scale_code];
+	if (get_onebit(stream) != 0) {
+		get_bits(stream, 1 * 2 + 6);
+		while (get_onebit(stream) != 0) {
+			get_bits(stream, 8);
+		}
+	}
+}
+
+static bool m2d_read_slices_parallel(m2d_context *m2d, int code_type, int *err);
+
 static int m2d_read_slice(m2d_context *m2d, int code_type)
 {
 	dec_bits *stream;
 	m2d_mb_current *mb;
 	m2d_picture *pic;
+	m2d_stream_mark_t mark;
 	int vertical_pos;
 	int err;
 
+	if (m2d_read_slices_parallel(m2d, code_type, &err)) {
+		return err;
+	}
 	stream = m2d->stream;
 	err = 0;
 
 	pic = m2d->picture;
 	mb = m2d->mb_current;
-	mb->q_mapping = m2d_q_mapping[pic->q_scale_type];
-	mb->q_scale = mb->q_mapping[get_bits(stream, 5)];
+	m2d_stream_mark(&mark, stream);
 	vertical_pos = (code_type & 255) - 1;
-	if (vertical_pos == 0) {
+	if ((vertical_pos == 0) || m2d->frame_pending) {
 		m2d_update_frames(m2d, mb->frames, pic->picture_coding_type, pic->temporal_reference);
+		m2d_attach_mb_info(m2d);
 	}
 	if (mb->mbmax_y <= vertical_pos) {
 		return 0;
@@ -648,13 +706,11 @@ static int m2d_read_slice(m2d_context *m2d, int code_type)
 		m2d_copy_slice(mb, vertical_pos - mb->mb_y);
 	}
 	m2d_frames_set_mb_pos(mb, -1, vertical_pos, mb->frame_width);
-	if (get_onebit(stream) != 0) {
-		get_bits(stream, 1 * 2 + 6);
-		while (get_onebit(stream) != 0) {
-			get_bits(stream, 8);
-		}
+	m2d_slice_header(mb, pic, stream);
+	err = m2d_decode_macroblocks(mb, stream);
+	if (mb->stats) {
+		mb->stats->bits += 32 + m2d_stream_bits_from(&mark, stream);
 	}
-	err = m2d_decode_macroblocks(m2d);
 	return err;
 /*	err |= (val == 0); */
 }
@@ -726,8 +782,14 @@ static void m2d_copy_slice(m2d_mb_current *mb, int mb_row_num_plus1)
 	dst = frm->curr_luma;
 	diff = frm->diff_to_ref[0];
 	mb_row_num = mb_row_num_plus1 - 1;
-	luma_len = width * mb_row_num * MB_LEN;
+	luma_len = width * mb_row_num * mb->mb_len;
+	if (mb->stats) {
+		return;
+	}
 	memcpy(dst, dst + diff[0], luma_len);
+	if (mb->luma_only) {
+		return;
+	}
 	dst = frm->curr_chroma;
 	memcpy(dst, dst + diff[1], luma_len >> 1);
 }
@@ -742,6 +804,7 @@ static void m2d_skip_mb_P(m2d_mb_current *mb, int mb_increment)
 	int skip_num = mb_increment - 1;
 	m2d_frames *frm = mb->frames;
 	int width = mb->frame_width;
+	int mb_len = mb->mb_len;
 	ptrdiff_t *diff = frm->diff_to_ref[0];
 	void (*inc_mb)(m2d_mb_current *mb);
 
@@ -755,9 +818,18 @@ static void m2d_skip_mb_P(m2d_mb_current *mb, int mb_increment)
 		uint8_t *luma, *chroma;
 		inc_mb(mb);
 		luma = frm->curr_luma;
-		m2d_copy16xn(luma + diff[0], luma, width, MB_LEN);
 		chroma = frm->curr_chroma;
-		m2d_copy16xn(chroma + diff[1], chroma, width, MB_LEN / 2);
+		if ((mb->scale == M2D_SCALE_FULL) && !mb->stats) {
+			m2d_copy16xn(luma + diff[0], luma, width, MB_LEN);
+			if (!mb->luma_only) {
+				m2d_copy16xn(chroma + diff[1], chroma, width, MB_LEN / 2);
+			}
+		} else {
+			static int zero_mv[2] = {0, 0};
+			void (* const * motion_comp)(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = mb->motion_comp[0];
+			motion_comp[0](luma + diff[0], luma, width, zero_mv, mb_len);
+			motion_comp[1](chroma + diff[1], chroma, width, zero_mv, mb_len >> 1);
+		}
 	} while (--skip_num);
 	m2d_mb_reset(mb);
 }
@@ -777,8 +849,9 @@ static void m2d_skip_mb_B(m2d_mb_current *mb, int mb_increment)
 	int width = mb->frame_width;
 	int mb_type = mb->type;
 	int dir = MB_PARAM(mb_type, MB_MC);
+	int mb_len = mb->mb_len;
 	ptrdiff_t *diff = frm->diff_to_ref[0];
-	void (* const * motion_comp)(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = m2d_motion_compensation[0];
+	void (* const * motion_comp)(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = mb->motion_comp[0];
 	int is_bidirectional = (dir == MB_MC);
 	int mvxy[4];
 	int16_t *mv;
@@ -797,12 +870,12 @@ static void m2d_skip_mb_B(m2d_mb_current *mb, int mb_increment)
 		uint8_t *luma, *chroma;
 		m2d_inc_mb_pos(mb);
 		luma = frm->curr_luma;
-		motion_comp[0](luma + diff[0], luma, width, mvxy, MB_LEN);
+		motion_comp[0](luma + diff[0], luma, width, mvxy, mb_len);
 		chroma = frm->curr_chroma;
-		motion_comp[1](chroma + diff[1], chroma, width, mvxy, MB_LEN / 2);
+		motion_comp[1](chroma + diff[1], chroma, width, mvxy, mb_len >> 1);
 		if (is_bidirectional) {
-			motion_comp[2](luma + diff[2], luma, width, mvxy + 2, MB_LEN);
-			motion_comp[3](chroma + diff[3], chroma, width, mvxy + 2, MB_LEN / 2);
+			motion_comp[2](luma + diff[2], luma, width, mvxy + 2, mb_len);
+			motion_comp[3](chroma + diff[3], chroma, width, mvxy + 2, mb_len >> 1);
 		}
 	} while (--skip_num);
 }
@@ -1012,7 +1085,15 @@ public:
 	}
 };
 
+enum {
+	DCT_WINDOW_BITS = (sizeof(cache_t) < 8) ? 24 : 32
+};
+
 /**Read DCT coefficients using Table B.14, 15 (Table one.)
+ * Codes are read into pairs of position and level first. Short ones are
+ * resolved by single look-up of VLD_FAST_BITLEN bits, several of them
+ * from one read of stream, while ESC and longer ones go through
+ * multi-stage tables. Inverse quantization then follows over the pairs.
  *\param mb Information about current macroblock.
  *\param stream Input bitstream class.
  *\param idx Indicates which 8x8 block is to be decoded.
@@ -1020,6 +1101,7 @@ public:
 template <int IsInter, typename IQ, typename Esc, typename Mismatch>
 static inline int parse_coef(m2d_mb_current *mb, dec_bits *stream, int dct_type, int idx, IQ _iquant, Esc _esc_level, Mismatch _mismatch)
 {
+	const vlc_dct_t *fast_tab = m2d_dct_fast_tables[dct_type];
 	const vlc_dct_t *vld_tab = m2d_dct_tables[dct_type];
 	int16_t *coef = mb->coef;
 	const uint8_t *qmat = mb->qmat[IsInter];
@@ -1027,16 +1109,51 @@ static inline int parse_coef(m2d_mb_current *mb, dec_bits *stream, int dct_type,
 	int mismatch_bit = idx ? coef[0] : 0;
 	int idx_sum = 0;
 	const int8_t *zigzag = mb->zigzag;
+	int8_t pos[64];
+	int16_t lvl[64];
+	int num = 0;
 
 	m2d_clear_coef(coef, idx);
-	do {
+	for (;;) {
+		uint32_t window = show_bits(stream, DCT_WINDOW_BITS) << (32 - DCT_WINDOW_BITS);
+		/* cache may hold less at the end of buffer */
+		int avail = (stream->cache_len_ < DCT_WINDOW_BITS) ? stream->cache_len_ : DCT_WINDOW_BITS;
+		int used = 0;
+		int eob = 0;
+		int len = 0;
+		while (used <= avail - VLD_FAST_BITLEN) {
+			const vlc_dct_t *vlc = &fast_tab[window >> (32 - VLD_FAST_BITLEN)];
+			len = vlc->length;
+			if (len == 0) {
+				break;
+			}
+			window <<= len;
+			used += len;
+			idx += vlc->run;
+			if ((vlc->run < 0) || (64 <= idx)) {
+				eob = 1;
+				break;
+			}
+			pos[num] = idx++;
+			lvl[num++] = vlc->level;
+		}
+		if (used != 0) {
+			skip_bits(stream, used);
+		}
+		if (eob) {
+			break;
+		} else if (len != 0) {
+			continue;
+		}
+
+		/* ESC or longer code */
 		int rest_len = VLD_BITLEN;
 		int bit = show_bits(stream, rest_len);
 		const vlc_dct_t *vld_tab_curr = vld_tab;
 		const vlc_dct_t *vlc = &vld_tab_curr[bit];
-		int len = vlc->length;
-		int level, run, idx_zigzag;
+		int level, run;
 
+		len = vlc->length;
 		while (len <= 0) {
 			/* additional look-up */
 			if (len < 0) {
@@ -1068,32 +1185,21 @@ static inline int parse_coef(m2d_mb_current *mb, dec_bits *stream, int dct_type,
 		if (64 <= idx) {
 			break;
 		}
-#ifdef FAST_DECODE
-		if (idx == 0) {
-#endif
-		idx_zigzag = zigzag[idx];
+		pos[num] = idx++;
+		lvl[num++] = level;
+	}
+	for (int i = 0; i < num; ++i) {
+		int idx_zigzag = zigzag[pos[i]];
+		int level;
 		if (idx_zigzag & 7) {
 			idx_sum |= 1 << ((unsigned)idx_zigzag >> 3);
 		}
-		level = _iquant(level, qmat[idx_zigzag] * q_scale);
-  		level = SATURATE(level, -2048, 2047);
+		level = _iquant(lvl[i], qmat[idx_zigzag] * q_scale);
+		level = SATURATE(level, -2048, 2047);
 		mismatch_bit += level;
 		coef[idx_zigzag] = level;
-#ifdef FAST_DECODE
-		}
-#endif
-	} while (++idx);
-#ifndef FAST_DECODE
-#if 1
-	idx_sum = _mismatch(mismatch_bit, idx_sum, coef);
-#else
-	if (!(mismatch_bit & 1)) {
-		coef[63] ^= 1;
-		idx_sum |= 1 << 7;
 	}
-#endif
-#endif
-	return idx_sum;
+	return _mismatch(mismatch_bit, idx_sum, coef);
 }
 
 
@@ -1117,7 +1223,7 @@ static int m2d_parse_coef_mpeg1_inter(m2d_mb_current *mb, dec_bits *stream, int
 	return parse_coef<1>(mb, stream, 0, idx, InterScaling(), EscapeLevelMpeg1(), MismatchMpeg1());
 }
 
-#define LUMA_BLOCK_OFFSET(idx, wid, dct_type) ((dct_type == 0) ? ((((idx) & 1) + (-((idx) & 2) & (wid))) * (MB_LEN / 2)) : (((idx) & 1) * (MB_LEN / 2) + (-((idx) & 2) & (wid))))
+#define LUMA_BLOCK_OFFSET(idx, wid, dct_type, mb_len) ((dct_type == 0) ? ((((idx) & 1) + (-((idx) & 2) & (wid))) * ((mb_len) / 2)) : (((idx) & 1) * ((mb_len) / 2) + (-((idx) & 2) & (wid))))
 
 #ifdef DUMP_COEF
 int coefs[64];
@@ -1141,7 +1247,7 @@ static void m2d_parse_intra_block_luma(m2d_mb_current *mb, dec_bits *stream, int
 #ifdef DUMP_COEF
 	coefs[sum_coef]++;
 #endif
-	m2d_idct_intra_luma(mb->frames->curr_luma + LUMA_BLOCK_OFFSET(block_idx, mb->frame_width, mb->dct_type), mb->frame_width << mb->dct_type, mb->coef, sum_coef);
+	mb->idct[0](mb->frames->curr_luma + LUMA_BLOCK_OFFSET(block_idx, mb->frame_width, mb->dct_type, mb->mb_len), mb->frame_width << mb->dct_type, mb->coef, sum_coef);
 }
 
 static void m2d_parse_intra_block_chroma(m2d_mb_current *mb, dec_bits *stream, int block_idx)
@@ -1149,7 +1255,7 @@ static void m2d_parse_intra_block_chroma(m2d_mb_current *mb, dec_bits *stream, i
 	int sum_coef;
 	mb->coef[0] = m2d_parse_intra_dc(mb, stream, block_idx + 1);
 	sum_coef = mb->parse_coef[0](mb, stream, 1);
-	m2d_idct_intra_chroma(mb->frames->curr_chroma + block_idx, mb->frame_width, mb->coef, sum_coef);
+	mb->idct[1](mb->frames->curr_chroma + block_idx, mb->frame_width, mb->coef, sum_coef);
 }
 
 enum {
@@ -1165,7 +1271,8 @@ static int m2d_parse_intra_macroblock(m2d_mb_current *mb, dec_bits *stream)
 	int i;
 
 	if (MB_PARAM(mb->type, MB_QUANT)) {
-		mb->q_scale = mb->q_mapping[get_bits(stream, 5)];
+		mb->q_scale_code = get_bits(stream, 5);
+		mb->q_scale = mb->q_mapping[mb->q_scale_code];
 	}
 	if (mb->intra_vlc_format & CONCEALMENT_MV) {
 		int mvxy[4];
@@ -1276,30 +1383,29 @@ static void m2d_motion_vectors(m2d_mb_current *mb, dec_bits *stream, int s, int
 
 static void m2d_motion_comp(m2d_mb_current *mb, int s, int is_bidirectional, int *mvxy, int8_t *ref_field)
 {
-	void (* const * motion_comp)(const uint8_t *, uint8_t *, int, int *, int) = m2d_motion_compensation[is_bidirectional];
+	void (* const * motion_comp)(const uint8_t *, uint8_t *, int, int *, int) = mb->motion_comp[is_bidirectional];
 	m2d_frames *frames = mb->frames;
 	ptrdiff_t *dif = frames->diff_to_ref[s];
 	int width = mb->frame_width;
+	int mb_len = mb->mb_len;
 	uint8_t *luma = frames->curr_luma;
 	uint8_t *chroma = frames->curr_chroma;
 	uint8_t *src_luma = luma + dif[0];
 	uint8_t *src_chroma = chroma + dif[1];
 
 	if (mb->motion_type->mv_count == 1) {
-		motion_comp[0](src_luma, luma, width, mvxy, MB_LEN);
-		motion_comp[1](src_chroma, chroma, width, mvxy, MB_LEN / 2);
+		motion_comp[0](src_luma, luma, width, mvxy, mb_len);
+		motion_comp[1](src_chroma, chroma, width, mvxy, mb_len >> 1);
 	} else {
 		for (int i = 0; i < 2; ++i) {
 			int src_offset = *ref_field++ ? width : 0;
-			motion_comp[0](src_luma + src_offset, luma, width * 2, mvxy, MB_LEN / 2);
-#ifdef FAST_DECODE
-			if (i == 0) {
-				src_offset = 0;
-#endif
-				motion_comp[1](src_chroma + src_offset, chroma, width * 2, mvxy, MB_LEN / 4);
-#ifdef FAST_DECODE
+			motion_comp[0](src_luma + src_offset, luma, width * 2, mvxy, mb_len >> 1);
+			if (4 <= mb_len) {
+				motion_comp[1](src_chroma + src_offset, chroma, width * 2, mvxy, mb_len >> 2);
+			} else if (i == 0) {
+				/* chroma has only one line at 1/8 scale */
+				motion_comp[1](src_chroma, chroma, width, mvxy, 1);
 			}
-#endif
 			mvxy += 2;
 			luma += width;
 			chroma += width;
@@ -1343,13 +1449,13 @@ static uint32_t m2d_parse_inter_block(m2d_mb_current *mb, dec_bits *stream, int
 static void m2d_parse_inter_block_luma(m2d_mb_current *mb, dec_bits *stream, int block_idx)
 {
 	int sum_coef = m2d_parse_inter_block(mb, stream, block_idx);
-	m2d_idct_inter_luma(mb->frames->curr_luma + LUMA_BLOCK_OFFSET(block_idx, mb->frame_width, mb->dct_type), mb->frame_width << mb->dct_type, mb->coef, sum_coef);
+	mb->idct[2](mb->frames->curr_luma + LUMA_BLOCK_OFFSET(block_idx, mb->frame_width, mb->dct_type, mb->mb_len), mb->frame_width << mb->dct_type, mb->coef, sum_coef);
 }
 
 static void m2d_parse_inter_block_chroma(m2d_mb_current *mb, dec_bits *stream, int block_idx)
 {
 	int sum_coef = m2d_parse_inter_block(mb, stream, block_idx);
-	m2d_idct_inter_chroma(mb->frames->curr_chroma + block_idx, mb->frame_width, mb->coef, sum_coef);
+	mb->idct[3](mb->frames->curr_chroma + block_idx, mb->frame_width, mb->coef, sum_coef);
 }
 
 /**Read macroblock layer data and store.
@@ -1361,7 +1467,8 @@ static int m2d_parse_inter_macroblock(m2d_mb_current *mb, dec_bits *stream)
 	int err = 0;
 
 	if (MB_PARAM(mb_type, MB_QUANT)) {
-		mb->q_scale = mb->q_mapping[get_bits(stream, 5)];
+		mb->q_scale_code = get_bits(stream, 5);
+		mb->q_scale = mb->q_mapping[mb->q_scale_code];
 	}
 	if (MB_PARAM(mb_type, MB_MC)) {
 		int mvxy[4];
@@ -1381,6 +1488,7 @@ static int m2d_parse_inter_macroblock(m2d_mb_current *mb, dec_bits *stream)
 	if (MB_PARAM(mb_type, MB_PATTERN)) {
 		int cbp = m2d_coded_block_pattern(mb, stream);
 		int i;
+		mb->cbp = cbp;
 		for (i = 0; i < 4; ++i) {
 			if (cbp & (1 << (5 - i))) {
 				m2d_parse_inter_block_luma(mb, stream, i);
@@ -1472,10 +1580,10 @@ static void m2d_inc_mb_pos(m2d_mb_current *mb)
 			inc_x -= mb_width;
 			inc_y += 1;
 		} while (mb_width < x);
-		m2d_frames_inc_mb_y_pos(mb->frames, inc_y, mb->frame_width);
+		m2d_frames_inc_mb_y_pos(mb->frames, inc_y, mb->frame_width, mb->mb_len);
 		mb->mb_y += inc_y;
 	}
-	m2d_frames_inc_mb_x_pos(mb->frames, inc_x);
+	m2d_frames_inc_mb_x_pos(mb->frames, inc_x, mb->mb_len);
 	mb->mb_x = x;
 	if ((x & 1) == 0) {
 		m2d_prefetch_mb(mb->frames->curr_luma, mb->frame_width);
@@ -1497,21 +1605,139 @@ static void m2d_skip_rest_slices(m2d_mb_current *m2d)
 {
 }
 
+static int m2d_mb_category(int type)
+{
+	if (MB_PARAM(type, MB_INTRA)) {
+		return M2D_MBTYPE_INTRA;
+	} else if ((type & MB_MC) == MB_MC) {
+		return M2D_MBTYPE_BI;
+	} else {
+		return M2D_MBTYPE_INTER;
+	}
+}
+
+/**Record current macroblock for analysis mode.
+ * Second MV of each direction is decoded only by field or 16x8 MC.
+ */
+static void m2d_stats_macroblock(m2d_mb_current *mb)
+{
+	int type = mb->type;
+	int mv_count = mb->motion_type->mv_count;
+
+	m2d_stats_mb(mb->stats, m2d_mb_category(type), mb->q_scale_code, 1);
+	for (int s = 0; s < 2; ++s) {
+		if (MB_PARAM(type, s ? MB_BACKWARD : MB_FORWARD)) {
+			for (int i = 0; i < mv_count; ++i) {
+				m2d_stats_mv(mb->stats, mb->mv[s].mv[i]);
+			}
+		}
+	}
+}
+
+/**Fill side data of a macroblock.
+ * Non-intra type without motion compensation means zero forward MV.
+ */
+static void m2d_mb_info_store(const m2d_mb_current *mb, m2d_mb_info_t *info, int type, int category, int cbp)
+{
+	static const int16_t zero_mv[2] = {0, 0};
+
+	m2d_mb_info_set(info, category, mb->q_scale_code, cbp);
+	m2d_mb_info_no_mv(info);
+	if (MB_PARAM(type, MB_INTRA)) {
+		return;
+	}
+	for (int blk = 0; blk < 4; ++blk) {
+		if (!MB_PARAM(type, MB_MC)) {
+			m2d_mb_info_mv(info, blk, 0, 0, zero_mv);
+		}
+		for (int s = 0; s < 2; ++s) {
+			if (MB_PARAM(type, s ? MB_BACKWARD : MB_FORWARD)) {
+				m2d_mb_info_mv(info, blk, s, 0, mb->mv[s].mv[0]);
+			}
+		}
+	}
+}
+
+/**Entry of side data for macroblock at (mb_x, mb_y), or NULL if out of frame.
+ * Rows of field picture are interleaved with those of the other field.
+ */
+static m2d_mb_info_t *m2d_mb_info_at(const m2d_mb_current *mb, int mb_x, int mb_y)
+{
+	if (mb->picture_structure != 3) {
+		mb_y = mb_y * 2 + (mb->picture_structure == 2);
+	}
+	return (mb_y < mb->mbmax_y) ? mb->mb_info + mb_y * mb->mbmax_x + mb_x : 0;
+}
+
+static void m2d_mb_info_macroblock(m2d_mb_current *mb)
+{
+	int type = mb->type;
+	int cbp = MB_PARAM(type, MB_INTRA) ? 0x3f : (MB_PARAM(type, MB_PATTERN) ? mb->cbp : 0);
+	m2d_mb_info_t *info = m2d_mb_info_at(mb, mb->mb_x, mb->mb_y);
+	if (info) {
+		m2d_mb_info_store(mb, info, type, m2d_mb_category(type), cbp);
+	}
+}
+
+/**Fill side data of macroblocks to be skipped, following current one.
+ * Skipped ones of B picture inherit MVs of the previous macroblock.
+ */
+static void m2d_mb_info_skipped(m2d_mb_current *mb, int skip_num)
+{
+	int type = (mb->skip_mb == m2d_skip_mb_B) ? (mb->type & MB_MC) : 0;
+	int x = mb->mb_x;
+	int y = mb->mb_y;
+	m2d_mb_info_t *prev = 0;
+
+	while (0 < skip_num--) {
+		m2d_mb_info_t *info;
+		if (mb->mbmax_x <= ++x) {
+			x = 0;
+			y++;
+		}
+		info = m2d_mb_info_at(mb, x, y);
+		if (!info) {
+			break;
+		}
+		if (prev) {
+			*info = *prev;
+		} else {
+			m2d_mb_info_store(mb, info, type, M2D_MBTYPE_SKIP, 0);
+		}
+		prev = info;
+	}
+}
+
 /**Do macroblocks loop for one slice.
  */
-static int m2d_decode_macroblocks(m2d_context *m2d)
+static int m2d_decode_macroblocks(m2d_mb_current *mb, dec_bits *stream)
 {
 	int err = 0;
-	m2d_mb_current *mb = m2d->mb_current;
-	dec_bits *stream = m2d->stream;
 	m2d_mb_reset(mb);
 	do {
 		int mb_inc = m2d_macroblock_address_increment(stream);
+		if ((mb->parse_coef == m2d_parse_coef[1]) && (mb->mbmax_x <= mb->mb_x + mb_inc)) {
+			/* MPEG-2 slice does not leave its macroblock row */
+			err = M2D_ERR_BIT;
+			break;
+		}
 		if (1 < mb_inc) {
+			if (mb->mb_info) {
+				m2d_mb_info_skipped(mb, mb_inc - 1);
+			}
 			mb->skip_mb(mb, mb_inc);
+			if (mb->stats) {
+				m2d_stats_mb(mb->stats, M2D_MBTYPE_SKIP, mb->q_scale_code, mb_inc - 1);
+			}
 		}
 		m2d_inc_mb_pos(mb);
 		err = m2d_parse_macroblock(mb, stream);
+		if (mb->stats) {
+			m2d_stats_macroblock(mb);
+		}
+		if (mb->mb_info) {
+			m2d_mb_info_macroblock(mb);
+		}
 		if (m2d_is_last(mb)) {
 			m2d_init_mb_pos(mb);
 			m2d_skip_rest_slices(mb);
@@ -1523,21 +1749,197 @@ static int m2d_decode_macroblocks(m2d_context *m2d)
 	return err;
 }
 
-static void store_frame_info(m2d_frame_t *frame, const m2d_frames *frames, int idx, const m2d_seq_header *header)
+#ifdef M2D_THREADS
+enum {
+	M2D_MAX_SLICES = 0xaf
+};
+
+/**Slice located in current buffer, and where decoding of it has ended.
+ */
+typedef struct {
+	const byte_t *data; /**< following slice_start_code */
+	const byte_t *tail; /**< start code of next one */
+	int vertical_pos;
+	int mb_x;
+	int mb_y;
+	int last; /**< reached the last macroblock of picture */
+	int err; /**< negative if decoding of the slice has failed */
+} m2d_slice_t;
+
+struct m2d_slice_job_t {
+	const m2d_mb_current *base;
+	const m2d_picture *picture;
+	const dec_bits *parent;
+	m2d_slice_t slice[M2D_MAX_SLICES];
+	int num;
+	std::atomic<int> next;
+	m2d_slice_job_t(const m2d_mb_current *mb, const m2d_picture *pic, const dec_bits *stream) : base(mb), picture(pic), parent(stream), num(0), next(0) {}
+};
+
+/**Locate slices from the one just started, as long as current buffer holds their end.
+ * Vertical positions shall increase so that each slice has its own macroblock row.
+ * Returns number of slices.
+ */
+static int m2d_slices_locate(m2d_slice_job_t& job, int code_type, dec_bits *stream)
 {
-	*frame = frames->frames[idx];
-	frame->width =
-#ifdef FAST_DECODE
-		(unsigned)((header->horizontal_size_value + 15) & ~15) >> 3;
-#else
-		header->horizontal_size_value;
-#endif
-	frame->height =
-#ifdef FAST_DECODE
-		(unsigned)((header->vertical_size_value + 15) & ~15) >> 3;
+	const byte_t *pos = dec_bits_current(stream);
+	const byte_t *tail = dec_bits_tail(stream);
+	int prev_pos = -1;
+	int num = 0;
+
+	while (num < M2D_MAX_SLICES) {
+		int vertical_pos = code_type - 1;
+		int len = m2d_next_start_code(pos, (int)(tail - pos));
+		if ((len < 0) || (tail - pos <= len) || (vertical_pos <= prev_pos)) {
+			break;
+		}
+		m2d_slice_t& slice = job.slice[num++];
+		slice.data = pos;
+		slice.tail = pos + len - 3;
+		slice.vertical_pos = vertical_pos;
+		prev_pos = vertical_pos;
+		code_type = pos[len];
+		pos += len + 1;
+		if (0xaf <= (unsigned)(code_type - 1)) {
+			break;
+		}
+	}
+	return num;
+}
+
+static void m2d_slice_decode(const m2d_slice_job_t& job, m2d_mb_current *mb, m2d_slice_t& slice)
+{
+	dec_bits stream;
+
+	slice.last = 0;
+	slice.err = 0;
+	if (mb->mbmax_y <= slice.vertical_pos) {
+		return;
+	}
+	/* start code following is included so that the end of slice is visible */
+	m2d_substream_open(&stream, job.parent, slice.data, slice.tail + 3 - slice.data);
+	m2d_frames_set_mb_pos(mb, -1, slice.vertical_pos, mb->frame_width);
+	if (setjmp(stream.jmp) == 0) {
+		m2d_slice_header(mb, job.picture, &stream);
+		int err = m2d_decode_macroblocks(mb, &stream);
+		slice.last = (err == 1);
+		slice.err = (err < 0) ? err : 0;
+	} else {
+		/* ran over the end of its own data */
+		slice.err = M2D_ERR_BIT;
+	}
+	slice.mb_x = mb->mb_x;
+	slice.mb_y = mb->mb_y;
+}
+
+static void m2d_slice_worker(m2d_slice_job_t& job)
+{
+	m2d_mb_current mb = *job.base;
+	m2d_frames frames = *job.base->frames;
+	int idx;
+
+	mb.frames = &frames;
+	while ((idx = job.next++) < job.num) {
+		m2d_slice_decode(job, &mb, job.slice[idx]);
+	}
+}
+
+/**Follow slices in order as serial decoding does, copying rows which none of them has covered.
+ * Stream continues from the end of slice which has completed the picture, or else the last one.
+ * Returns 1 if the picture has been completed, or else error of the first slice failed.
+ */
+static int m2d_slices_finish(m2d_mb_current *mb, const m2d_slice_job_t& job, dec_bits *stream)
+{
+	const byte_t *end = job.slice[job.num - 1].tail;
+	int err = 0;
+
+	for (int i = 0; i < job.num; ++i) {
+		const m2d_slice_t& slice = job.slice[i];
+		if (mb->mbmax_y <= slice.vertical_pos) {
+			break;
+		}
+		if (1 < slice.vertical_pos - mb->mb_y) {
+			m2d_copy_slice(mb, slice.vertical_pos - mb->mb_y);
+		}
+		if ((err == 0) && (slice.err < 0)) {
+			err = slice.err;
+		}
+		if (slice.last) {
+			m2d_init_mb_pos(mb);
+			end = slice.tail;
+			err = 1;
+			break;
+		}
+		m2d_frames_set_mb_pos(mb, slice.mb_x, slice.mb_y, mb->frame_width);
+	}
+	skip_bytes(stream, (int)(end - dec_bits_current(stream)));
+	return err;
+}
+
+/**Whether current frame is also referred to, as too few frames are given for references to have their own.
+ */
+static int m2d_frame_referred(const m2d_frames *frames, int coding_type)
+{
+	return ((coding_type != I_VOP) && (frames->diff_to_ref[0][0] == 0)) || ((coding_type == B_VOP) && (frames->diff_to_ref[1][0] == 0));
+}
+
+/**Decode slices of MPEG-2 picture by m2d->threads threads including the caller.
+ * Returns false if they are to be decoded serially, as in analysis mode.
+ */
+static bool m2d_read_slices_parallel(m2d_context *m2d, int code_type, int *err)
+{
+	m2d_mb_current *mb = m2d->mb_current;
+	dec_bits *stream = m2d->stream;
+	m2d_picture *pic = m2d->picture;
+
+	if ((m2d->threads <= 1) || mb->stats || (mb->parse_coef != m2d_parse_coef[1])) {
+		return false;
+	}
+	m2d_slice_job_t job(mb, pic, stream);
+	job.num = m2d_slices_locate(job, code_type, stream);
+	if (job.num < 2) {
+		return false;
+	}
+	if ((job.slice[0].vertical_pos == 0) || m2d->frame_pending) {
+		m2d_update_frames(m2d, mb->frames, pic->picture_coding_type, pic->temporal_reference);
+		m2d_attach_mb_info(m2d);
+	}
+	int thread_num = ((m2d->threads < job.num) ? m2d->threads : job.num) - 1;
+	if (m2d_frame_referred(mb->frames, pic->picture_coding_type)) {
+		/* slices in order by caller alone */
+		thread_num = 0;
+	}
+	std::thread threads[M2D_MAX_THREADS];
+	int spawned = 0;
+	try {
+		while (spawned < thread_num) {
+			threads[spawned] = std::thread(m2d_slice_worker, std::ref(job));
+			spawned++;
+		}
+	} catch (const std::system_error&) {
+		/* remaining slices are taken by running threads */
+	}
+	m2d_slice_worker(job);
+	for (int i = 0; i < spawned; ++i) {
+		threads[i].join();
+	}
+	*err = m2d_slices_finish(mb, job, stream);
+	return true;
+}
 #else
-		header->vertical_size_value;
+static bool m2d_read_slices_parallel(m2d_context *m2d, int code_type, int *err)
+{
+	return false;
+}
 #endif
+
+#define SCALED_LEN(len, scale) (((len) + (1 << (scale)) - 1) >> (scale))
+
+static void store_frame_info(m2d_frame_t *frame, const m2d_frames *frames, int idx, const m2d_seq_header *header, int scale)
+{
+	*frame = frames->frames[idx];
+	frame->width = SCALED_LEN(header->horizontal_size_value, scale);
+	frame->height = SCALED_LEN(header->vertical_size_value, scale);
 }
 
 __LIBM2DEC_API int m2d_peek_decoded_frame(m2d_context *m2d, m2d_frame_t *frame, int is_end)
@@ -1556,7 +1958,7 @@ __LIBM2DEC_API int m2d_peek_decoded_frame(m2d_context *m2d, m2d_frame_t *frame,
 	} else {
 		idx = frames->idx_of_ref[0];
 	}
-	store_frame_info(frame, frames, idx, m2d->seq_header);
+	store_frame_info(frame, frames, idx, m2d->seq_header, m2d->mb_current->scale);
 	if (m2d->picture->picture_coding_type != B_VOP) {
 		switch (m2d->out_state >> 1) {
 		case 0:
@@ -1607,6 +2009,12 @@ __LIBM2DEC_API int m2d_decode_data(m2d_context *m2d)
 	stream = m2d->stream;
 	err = 0;
 	do {
+		/* m2d_dispatch_one_nal() leaves its own jmp behind, which must not be
+		 * used when data runs out while looking for the next start code. */
+		if (setjmp(stream->jmp) != 0) {
+			err = -1;
+			break;
+		}
 		if (0 <= (err = m2d_find_mpeg_data(stream))) {
 			int code_type = get_bits(stream, 8);
 			err = m2d_dispatch_one_nal(m2d, code_type);
@@ -1661,27 +2069,242 @@ __LIBM2DEC_API int m2d_read_header(m2d_context *m2d, const byte_t *data, size_t
 	return err;
 }
 
-__LIBM2DEC_API int m2d_get_info(m2d_context *m2d, m2d_info_t *info)
-{
-	int src_width, src_height;
-	if (!m2d || !info) {
-		return -1;
-	}
-	src_width = m2d->seq_header->horizontal_size_value;
-	src_height = m2d->seq_header->vertical_size_value;
-	info->src_width = (src_width + 15) & ~15;
-	info->src_height = (src_height + 15) & ~15;
-	info->disp_width = m2d->seq_header->display_width;
-	info->disp_height = m2d->seq_header->display_height;
+/** Sizes of the sequence, for both m2d_get_info() and m2d_probe().
+ * Display size defaults to the frame size without sequence display extension.
+ */
+static void m2d_seq_info(const m2d_mb_current *mb, const m2d_seq_header *header, m2d_info_t *info)
+{
+	int scale = mb->scale;
+	int src_width = SCALED_LEN(header->horizontal_size_value, scale);
+	int src_height = SCALED_LEN(header->vertical_size_value, scale);
+	info->src_width = mb->frame_width;
+	info->src_height = mb->frame_height;
+	info->disp_width = header->display_width ? SCALED_LEN(header->display_width, scale) : src_width;
+	info->disp_height = header->display_height ? SCALED_LEN(header->display_height, scale) : src_height;
 	info->frame_num = 3;
 	info->crop[0] = 0;
 	info->crop[1] = info->src_width - src_width;
 	info->crop[2] = 0;
 	info->crop[3] = info->src_height - src_height;
 	info->additional_size = 0;
+	info->mb_info_num = m2d_mb_info_num(mb, header);
+}
+
+__LIBM2DEC_API int m2d_get_info(m2d_context *m2d, m2d_info_t *info)
+{
+	if (!m2d || !info) {
+		return -1;
+	}
+	m2d_seq_info(m2d->mb_current, m2d->seq_header, info);
 	return 0;
 }
 
+static const uint16_t m2d_frame_rate[16][2] = {
+	{0, 0}, {24000, 1001}, {24, 1}, {25, 1},
+	{30000, 1001}, {30, 1}, {50, 1}, {60000, 1001},
+	{60, 1}, {0, 0}, {0, 0}, {0, 0},
+	{0, 0}, {0, 0}, {0, 0}, {0, 0}
+};
+
+/**Read sequence header and following extensions from stream.
+ * Quantizer matrices are skipped since nowhere to store.
+ * found becomes 1 after sequence header, 2 after sequence extension.
+ */
+static void m2d_probe_headers(m2d_seq_header *header, int *found, dec_bits *stream)
+{
+	do {
+		if (m2d_find_mpeg_data(stream) < 0) {
+			return;
+		}
+	} while (get_bits(stream, 8) != 0xb3);
+	m2d_seq_header_fields(header, stream);
+	for (int i = 0; i < 2; ++i) {
+		if (get_onebit(stream)) {
+			for (int j = 0; j < 64; ++j) {
+				skip_bits(stream, 8);
+			}
+		}
+	}
+	*found = 1;
+	while ((0 <= m2d_find_mpeg_data(stream)) && (get_bits(stream, 8) == 0xb5)) {
+		int id = get_bits(stream, 4);
+		if (id == 1) {
+			m2d_sequence_extension_fields(header, stream);
+			*found = 2;
+		} else if (id == 2) {
+			m2d_display_extension_fields(header, stream);
+		}
+	}
+}
+
+/**Report stream parameters from the first sequence header without context.
+ */
+__LIBM2DEC_API int m2d_probe(const byte_t *data, size_t len, m2d_probe_t *probe)
+{
+	dec_bits stream;
+	m2d_seq_header header;
+	m2d_mb_current mb;
+	int found;
+
+	if (!data || !len || !probe) {
+		return -1;
+	}
+	memset(&header, 0, sizeof(header));
+	header.chroma_format = 1;
+	found = 0;
+	m2d_probe_stream_open(&stream, 0, data, len);
+	if (setjmp(stream.jmp) == 0) {
+		m2d_probe_headers(&header, &found, &stream);
+	}
+	if (found == 0) {
+		return -1;
+	}
+	memset(&mb, 0, sizeof(mb));
+	mb.mb_len = MB_LEN;
+	m2d_mb_set_frame_size(&mb, header.horizontal_size_value, header.vertical_size_value);
+	m2d_seq_info(&mb, &header, &probe->info);
+	if (found == 2) {
+		probe->profile = header.profile_and_level >> 4;
+		probe->level = header.profile_and_level & 15;
+	} else {
+		probe->profile = 0;
+		probe->level = 0;
+	}
+	probe->chroma_format = header.chroma_format;
+	probe->frame_rate_num = m2d_frame_rate[header.frame_rate_code][0] * (header.frame_rate_extension_n + 1);
+	probe->frame_rate_den = m2d_frame_rate[header.frame_rate_code][1] * (header.frame_rate_extension_d + 1);
+	m2d_probe_set_frame_size(probe);
+	if (1 < header.chroma_format) {
+		/* 4:2:2 and 4:4:4 */
+		probe->chroma_size = probe->luma_size << (header.chroma_format - 2);
+	}
+	return 0;
+}
+
+static void m2d_idct_none(uint8_t *dst, int32_t stride, int16_t *coef, uint32_t coef_exist) {}
+static void m2d_motion_comp_none(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) {}
+
+static void (* const m2d_idct_none_func[4])(uint8_t *dst, int32_t stride, int16_t *coef, uint32_t coef_exist) = {
+	m2d_idct_none, m2d_idct_none, m2d_idct_none, m2d_idct_none
+};
+
+static void (* const m2d_motion_comp_none_func[2][2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = {
+	{m2d_motion_comp_none, m2d_motion_comp_none},
+	{m2d_motion_comp_none, m2d_motion_comp_none}
+};
+
+/**Select iDCT and motion compensation, or nothing in analysis mode.
+ * Luma-only mode replaces chroma ones with nothing.
+ */
+static void m2d_set_reconstruction(m2d_mb_current *mb)
+{
+	if (mb->stats) {
+		mb->idct = m2d_idct_none_func;
+		mb->motion_comp = m2d_motion_comp_none_func;
+	} else if (mb->luma_only) {
+		void (* const *idct)(uint8_t *dst, int32_t stride, int16_t *coef, uint32_t coef_exist) = m2d_idct_func[mb->scale];
+		void (* const (*motion_comp)[2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height) = m2d_motion_compensation[mb->scale];
+		for (int i = 0; i < 2; ++i) {
+			mb->idct_sel[i * 2] = idct[i * 2];
+			mb->idct_sel[i * 2 + 1] = m2d_idct_none;
+			mb->motion_comp_sel[i][0] = motion_comp[i][0];
+			mb->motion_comp_sel[i][1] = m2d_motion_comp_none;
+		}
+		mb->idct = mb->idct_sel;
+		mb->motion_comp = mb->motion_comp_sel;
+	} else {
+		mb->idct = m2d_idct_func[mb->scale];
+		mb->motion_comp = m2d_motion_compensation[mb->scale];
+	}
+}
+
+/**Set output scale of reconstructed frames.
+ * Width and height of frames are divided by (1 << scale). Frames
+ * passed to m2d_set_frames() shall have the size m2d_get_info() reports
+ * after calling this. It is not to be changed while decoding a sequence
+ * because reference frames shall have the same scale.
+ *\param scale One of M2D_SCALE_*.
+ */
+__LIBM2DEC_API int m2d_set_scale(m2d_context *m2d, int scale)
+{
+	m2d_mb_current *mb;
+	m2d_seq_header *header;
+
+	if (!m2d || ((unsigned)scale > M2D_SCALE_EIGHTH)) {
+		return -1;
+	}
+	mb = m2d->mb_current;
+	mb->scale = scale;
+	mb->mb_len = MB_LEN >> scale;
+	m2d_set_reconstruction(mb);
+	header = m2d->seq_header;
+	m2d_mb_set_frame_size(mb, header->horizontal_size_value, header->vertical_size_value);
+	return 0;
+}
+
+/**Switch to analysis mode, which only parses streams.
+ * Frames are not reconstructed while stats is not NULL. Instead, stats
+ * is filled with a record of each picture decoded by m2d_decode_data().
+ * Frames still have to be set by m2d_set_frames().
+ */
+__LIBM2DEC_API int m2d_set_analysis(m2d_context *m2d, m2d_picture_stats_t *stats)
+{
+	if (!m2d) {
+		return -1;
+	}
+	m2d->mb_current->stats = stats;
+	m2d_set_reconstruction(m2d->mb_current);
+	return 0;
+}
+
+/**Export side data of macroblocks with each decoded frame.
+ * mb_info holds size entries, which are split among frames by
+ * mb_info_num of m2d_get_info(). Frames without room have NULL mb_info.
+ * NULL stops export.
+ */
+__LIBM2DEC_API int m2d_set_mb_info(m2d_context *m2d, m2d_mb_info_t *mb_info, int size)
+{
+	if (!m2d || (size < 0)) {
+		return -1;
+	}
+	m2d->mb_current->frames->mb_info = mb_info;
+	m2d->mb_current->frames->mb_info_size = size;
+	m2d->mb_current->mb_info = 0;
+	return 0;
+}
+
+/**Reconstruct luma only. Chroma is still parsed.
+ * chroma of frames may be NULL if this is set before m2d_set_frames().
+ */
+__LIBM2DEC_API int m2d_set_luma_only(m2d_context *m2d, int luma_only)
+{
+	if (!m2d) {
+		return -1;
+	}
+	m2d->mb_current->luma_only = (luma_only != 0);
+	m2d_set_reconstruction(m2d->mb_current);
+	return 0;
+}
+
+/**Request number of decoding threads.
+ * Slices of MPEG-2 pictures are decoded in parallel, each by its own
+ * macroblock context. MPEG-1 and analysis mode are decoded serially.
+ * Returns number of threads to be used.
+ */
+__LIBM2DEC_API int m2d_set_threads(m2d_context *m2d, int num)
+{
+	if (!m2d || (num < 1)) {
+		return -1;
+	}
+#ifdef M2D_THREADS
+	num = (num < M2D_MAX_THREADS) ? num : M2D_MAX_THREADS;
+#else
+	num = 1;
+#endif
+	m2d->threads = num;
+	return num;
+}
+
 __LIBM2DEC_API int m2d_skip_frames(m2d_context *m2d, int frame_num)
 {
 	int err;
@@ -1715,13 +2338,6 @@ __LIBM2DEC_API int m2d_skip_frames(m2d_context *m2d, int frame_num)
 
 #ifndef NDEBUG
 
-#ifdef FAST_DECODE
-int test_parse_coef()
-{
-	return 0;
-}
-#else
-
 #include <vector>
 #include <algorithm>
 #include "txt2bin.h"
@@ -1794,7 +2410,6 @@ int test_parse_coef()
 	return err;
 }
 
-#endif /* FAST_DECODE */
 #endif /* NDEBUG */
 
 const m2d_func_table_t m2d_func_ = {
@@ -1805,7 +2420,12 @@ const m2d_func_table_t m2d_func_ = {
 	(int (*)(void *, int, m2d_frame_t *, uint8_t *, int))m2d_set_frames,
 	(int (*)(void *))m2d_decode_data,
 	(int (*)(void *, m2d_frame_t *, int))m2d_peek_decoded_frame,
-	(int (*)(void *, m2d_frame_t *, int))m2d_get_decoded_frame
+	(int (*)(void *, m2d_frame_t *, int))m2d_get_decoded_frame,
+	(int (*)(void *, m2d_picture_stats_t *))m2d_set_analysis,
+	(int (*)(void *, m2d_mb_info_t *, int))m2d_set_mb_info,
+	(int (*)(void *, int))m2d_set_luma_only,
+	m2d_probe,
+	(int (*)(void *, int))m2d_set_threads
 };
 
 const m2d_func_table_t * const m2d_func = &m2d_func_;
@@ -36,11 +36,16 @@ extern "C" {
 
 #define ALIGN16(x) (((x) + 15) & ~15)
 
-#ifdef FAST_DECODE
-#define MB_LEN 2
-#else
 #define MB_LEN 16
-#endif
+
+/**Output scale of reconstructed frames, as shift amount of width/height.
+ */
+enum {
+	M2D_SCALE_FULL = 0,
+	M2D_SCALE_HALF,
+	M2D_SCALE_QUARTER,
+	M2D_SCALE_EIGHTH
+};
 
 enum {
 	I_VOP = 1,
@@ -74,6 +79,8 @@ typedef struct {
 	unsigned progressive_sequence : 1;
 	unsigned chroma_format : 2;
 	unsigned low_delay : 1;
+	unsigned frame_rate_extension_n : 2;
+	unsigned frame_rate_extension_d : 5;
 } m2d_seq_header;
 
 typedef struct {
@@ -122,6 +129,8 @@ typedef struct {
 	int index;
 	m2d_frame_t frames[MAX_FRAME_NUM];
 	int lru[MAX_FRAME_NUM];
+	m2d_mb_info_t *mb_info; /**< given by m2d_set_mb_info() */
+	int mb_info_size;
 } m2d_frames;
 
 
@@ -146,6 +155,9 @@ typedef struct {
 typedef struct m2d_mb_current_t {
 	int16_t frame_width; /**< Width of frame (multiples of 16) */
 	int16_t frame_height; /**< Height of frame (multiples of 16 or 32) */
+	int8_t scale; /**< One of M2D_SCALE_* */
+	int8_t luma_only; /**< chroma is parsed but not reconstructed */
+	int8_t mb_len; /**< Width of reconstructed luma macroblock, MB_LEN >> scale */
 	uint8_t mbmax_x;
 	uint8_t mbmax_y;
 	int8_t mb_x;
@@ -154,6 +166,8 @@ typedef struct m2d_mb_current_t {
 	int8_t intra_dc_scale;
 	int16_t intra_dc_max;
 	int16_t q_scale;
+	int8_t q_scale_code;
+	int8_t cbp;
 	int16_t dc_pred[3];
 	int16_t dct_type;
 	int8_t r_size[2][2]; /**< f_code - 1 */
@@ -164,10 +178,17 @@ typedef struct m2d_mb_current_t {
 	const uint8_t *qmat[4];
 	const int8_t *zigzag;
 	int frame_mode;
+	int picture_structure; /**< 1: top field, 2: bottom field, 3: frame */
 	int (* const *parse_coef)(struct m2d_mb_current_t *mb, dec_bits *stream, int idx);
 	void (*skip_mb)(struct m2d_mb_current_t *mb, int mb_increment);
 	int (*macroblock_type)(dec_bits *stream); /**< switch according to frame */
+	void (* const *idct)(uint8_t *dst, int32_t stride, int16_t *coef, uint32_t coef_exist); /**< intra luma/chroma, inter luma/chroma */
+	void (* const (*motion_comp)[2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height);
+	void (*idct_sel[4])(uint8_t *dst, int32_t stride, int16_t *coef, uint32_t coef_exist); /**< storage of idct in luma-only mode */
+	void (*motion_comp_sel[2][2])(const uint8_t *src, uint8_t *dst, int stride, int *mvxy, int height); /**< storage of motion_comp in luma-only mode */
 	int intra_vlc_format;
+	m2d_picture_stats_t *stats; /**< not NULL in analysis mode */
+	m2d_mb_info_t *mb_info; /**< side data of current frame, or NULL */
 	int16_t coef[MB_LEN * MB_LEN / 4];
 } m2d_mb_current;
 
@@ -195,6 +216,8 @@ typedef struct {
 	int (*header_callback)(void *arg, void *seq_id);
 	void *header_callback_arg;
 	int out_state;
+	int frame_pending; /**< picture header has been read, but no frame is assigned to the picture yet */
+	int threads; /**< slices of a picture are decoded by up to this number of threads */
 	m2d_seq_header seq_header_i;
 	m2d_gop_header gop_header_i;
 	dec_bits stream_i;
@@ -220,6 +243,12 @@ __LIBM2DEC_API int m2d_decode_data(m2d_context *m2d);
 __LIBM2DEC_API int m2d_peek_decoded_frame(m2d_context *m2d, m2d_frame_t *frame, int is_end);
 __LIBM2DEC_API int m2d_get_decoded_frame(m2d_context *m2d, m2d_frame_t *frame, int is_end);
 __LIBM2DEC_API int m2d_skip_frames(m2d_context *m2d, int frame_num);
+__LIBM2DEC_API int m2d_set_scale(m2d_context *m2d, int scale);
+__LIBM2DEC_API int m2d_set_analysis(m2d_context *m2d, m2d_picture_stats_t *stats);
+__LIBM2DEC_API int m2d_set_mb_info(m2d_context *m2d, m2d_mb_info_t *mb_info, int size);
+__LIBM2DEC_API int m2d_set_luma_only(m2d_context *m2d, int luma_only);
+__LIBM2DEC_API int m2d_probe(const byte_t *data, size_t len, m2d_probe_t *probe);
+__LIBM2DEC_API int m2d_set_threads(m2d_context *m2d, int num);
 
 extern const m2d_func_table_t * const m2d_func;
 
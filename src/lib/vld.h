@@ -6,7 +6,8 @@ extern "C" {
 #endif
 
 enum {
-	VLD_BITLEN = 7
+	VLD_BITLEN = 7,
+	VLD_FAST_BITLEN = 10
 };
 
 /** Mapping of Q scale indicator and Q scale.
@@ -330,6 +331,534 @@ static const vlc_dct_t * const m2d_dct_tables[4] = {
 	m2d_dct_table1_bit7
 };
 
+/** Single look-up of codes up to VLD_FAST_BITLEN bits including sign and end of block,
+ * expanded from the tables above. Zero length stands for ESC and longer codes.
+ */
+static const vlc_dct_t m2d_dct_table0_bit10[1024] = {
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{2, 4, 8}, {2, 4, 8}, {2, 4, 8}, {2, 4, 8},
+	{2, 5, 8}, {2, 5, 8}, {2, 5, 8}, {2, 5, 8},
+	{9, 2, 8}, {9, 2, 8}, {9, 2, 8}, {9, 2, 8},
+	{9, 3, 8}, {9, 3, 8}, {9, 3, 8}, {9, 3, 8},
+	{0, 8, 8}, {0, 8, 8}, {0, 8, 8}, {0, 8, 8},
+	{0, 9, 8}, {0, 9, 8}, {0, 9, 8}, {0, 9, 8},
+	{8, 2, 8}, {8, 2, 8}, {8, 2, 8}, {8, 2, 8},
+	{8, 3, 8}, {8, 3, 8}, {8, 3, 8}, {8, 3, 8},
+	{7, 2, 7}, {7, 2, 7}, {7, 2, 7}, {7, 2, 7},
+	{7, 2, 7}, {7, 2, 7}, {7, 2, 7}, {7, 2, 7},
+	{7, 3, 7}, {7, 3, 7}, {7, 3, 7}, {7, 3, 7},
+	{7, 3, 7}, {7, 3, 7}, {7, 3, 7}, {7, 3, 7},
+	{6, 2, 7}, {6, 2, 7}, {6, 2, 7}, {6, 2, 7},
+	{6, 2, 7}, {6, 2, 7}, {6, 2, 7}, {6, 2, 7},
+	{6, 3, 7}, {6, 3, 7}, {6, 3, 7}, {6, 3, 7},
+	{6, 3, 7}, {6, 3, 7}, {6, 3, 7}, {6, 3, 7},
+	{1, 4, 7}, {1, 4, 7}, {1, 4, 7}, {1, 4, 7},
+	{1, 4, 7}, {1, 4, 7}, {1, 4, 7}, {1, 4, 7},
+	{1, 5, 7}, {1, 5, 7}, {1, 5, 7}, {1, 5, 7},
+	{1, 5, 7}, {1, 5, 7}, {1, 5, 7}, {1, 5, 7},
+	{5, 2, 7}, {5, 2, 7}, {5, 2, 7}, {5, 2, 7},
+	{5, 2, 7}, {5, 2, 7}, {5, 2, 7}, {5, 2, 7},
+	{5, 3, 7}, {5, 3, 7}, {5, 3, 7}, {5, 3, 7},
+	{5, 3, 7}, {5, 3, 7}, {5, 3, 7}, {5, 3, 7},
+	{13, 2, 9}, {13, 2, 9}, {13, 3, 9}, {13, 3, 9},
+	{0, 12, 9}, {0, 12, 9}, {0, 13, 9}, {0, 13, 9},
+	{12, 2, 9}, {12, 2, 9}, {12, 3, 9}, {12, 3, 9},
+	{11, 2, 9}, {11, 2, 9}, {11, 3, 9}, {11, 3, 9},
+	{3, 4, 9}, {3, 4, 9}, {3, 5, 9}, {3, 5, 9},
+	{1, 6, 9}, {1, 6, 9}, {1, 7, 9}, {1, 7, 9},
+	{0, 10, 9}, {0, 10, 9}, {0, 11, 9}, {0, 11, 9},
+	{10, 2, 9}, {10, 2, 9}, {10, 3, 9}, {10, 3, 9},
+	{0, 6, 6}, {0, 6, 6}, {0, 6, 6}, {0, 6, 6},
+	{0, 6, 6}, {0, 6, 6}, {0, 6, 6}, {0, 6, 6},
+	{0, 6, 6}, {0, 6, 6}, {0, 6, 6}, {0, 6, 6},
+	{0, 6, 6}, {0, 6, 6}, {0, 6, 6}, {0, 6, 6},
+	{0, 7, 6}, {0, 7, 6}, {0, 7, 6}, {0, 7, 6},
+	{0, 7, 6}, {0, 7, 6}, {0, 7, 6}, {0, 7, 6},
+	{0, 7, 6}, {0, 7, 6}, {0, 7, 6}, {0, 7, 6},
+	{0, 7, 6}, {0, 7, 6}, {0, 7, 6}, {0, 7, 6},
+	{4, 2, 6}, {4, 2, 6}, {4, 2, 6}, {4, 2, 6},
+	{4, 2, 6}, {4, 2, 6}, {4, 2, 6}, {4, 2, 6},
+	{4, 2, 6}, {4, 2, 6}, {4, 2, 6}, {4, 2, 6},
+	{4, 2, 6}, {4, 2, 6}, {4, 2, 6}, {4, 2, 6},
+	{4, 3, 6}, {4, 3, 6}, {4, 3, 6}, {4, 3, 6},
+	{4, 3, 6}, {4, 3, 6}, {4, 3, 6}, {4, 3, 6},
+	{4, 3, 6}, {4, 3, 6}, {4, 3, 6}, {4, 3, 6},
+	{4, 3, 6}, {4, 3, 6}, {4, 3, 6}, {4, 3, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 4, 5}, {0, 4, 5}, {0, 4, 5}, {0, 4, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{0, 5, 5}, {0, 5, 5}, {0, 5, 5}, {0, 5, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 2, 5}, {2, 2, 5}, {2, 2, 5}, {2, 2, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{2, 3, 5}, {2, 3, 5}, {2, 3, 5}, {2, 3, 5},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2}, {-1, 3, 2},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+};
+
+static const vlc_dct_t m2d_dct_table1_bit10[1024] = {
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{5, 4, 10}, {5, 5, 10}, {14, 2, 10}, {14, 3, 10},
+	{0, 0, 0}, {0, 0, 0}, {15, 2, 10}, {15, 3, 10},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+	{7, 2, 8}, {7, 2, 8}, {7, 2, 8}, {7, 2, 8},
+	{7, 3, 8}, {7, 3, 8}, {7, 3, 8}, {7, 3, 8},
+	{8, 2, 8}, {8, 2, 8}, {8, 2, 8}, {8, 2, 8},
+	{8, 3, 8}, {8, 3, 8}, {8, 3, 8}, {8, 3, 8},
+	{6, 2, 8}, {6, 2, 8}, {6, 2, 8}, {6, 2, 8},
+	{6, 3, 8}, {6, 3, 8}, {6, 3, 8}, {6, 3, 8},
+	{2, 4, 8}, {2, 4, 8}, {2, 4, 8}, {2, 4, 8},
+	{2, 5, 8}, {2, 5, 8}, {2, 5, 8}, {2, 5, 8},
+	{0, 14, 7}, {0, 14, 7}, {0, 14, 7}, {0, 14, 7},
+	{0, 14, 7}, {0, 14, 7}, {0, 14, 7}, {0, 14, 7},
+	{0, 15, 7}, {0, 15, 7}, {0, 15, 7}, {0, 15, 7},
+	{0, 15, 7}, {0, 15, 7}, {0, 15, 7}, {0, 15, 7},
+	{0, 12, 7}, {0, 12, 7}, {0, 12, 7}, {0, 12, 7},
+	{0, 12, 7}, {0, 12, 7}, {0, 12, 7}, {0, 12, 7},
+	{0, 13, 7}, {0, 13, 7}, {0, 13, 7}, {0, 13, 7},
+	{0, 13, 7}, {0, 13, 7}, {0, 13, 7}, {0, 13, 7},
+	{4, 2, 7}, {4, 2, 7}, {4, 2, 7}, {4, 2, 7},
+	{4, 2, 7}, {4, 2, 7}, {4, 2, 7}, {4, 2, 7},
+	{4, 3, 7}, {4, 3, 7}, {4, 3, 7}, {4, 3, 7},
+	{4, 3, 7}, {4, 3, 7}, {4, 3, 7}, {4, 3, 7},
+	{5, 2, 7}, {5, 2, 7}, {5, 2, 7}, {5, 2, 7},
+	{5, 2, 7}, {5, 2, 7}, {5, 2, 7}, {5, 2, 7},
+	{5, 3, 7}, {5, 3, 7}, {5, 3, 7}, {5, 3, 7},
+	{5, 3, 7}, {5, 3, 7}, {5, 3, 7}, {5, 3, 7},
+	{1, 10, 9}, {1, 10, 9}, {1, 11, 9}, {1, 11, 9},
+	{11, 2, 9}, {11, 2, 9}, {11, 3, 9}, {11, 3, 9},
+	{0, 22, 9}, {0, 22, 9}, {0, 23, 9}, {0, 23, 9},
+	{0, 20, 9}, {0, 20, 9}, {0, 21, 9}, {0, 21, 9},
+	{13, 2, 9}, {13, 2, 9}, {13, 3, 9}, {13, 3, 9},
+	{12, 2, 9}, {12, 2, 9}, {12, 3, 9}, {12, 3, 9},
+	{3, 4, 9}, {3, 4, 9}, {3, 5, 9}, {3, 5, 9},
+	{1, 8, 9}, {1, 8, 9}, {1, 9, 9}, {1, 9, 9},
+	{2, 2, 6}, {2, 2, 6}, {2, 2, 6}, {2, 2, 6},
+	{2, 2, 6}, {2, 2, 6}, {2, 2, 6}, {2, 2, 6},
+	{2, 2, 6}, {2, 2, 6}, {2, 2, 6}, {2, 2, 6},
+	{2, 2, 6}, {2, 2, 6}, {2, 2, 6}, {2, 2, 6},
+	{2, 3, 6}, {2, 3, 6}, {2, 3, 6}, {2, 3, 6},
+	{2, 3, 6}, {2, 3, 6}, {2, 3, 6}, {2, 3, 6},
+	{2, 3, 6}, {2, 3, 6}, {2, 3, 6}, {2, 3, 6},
+	{2, 3, 6}, {2, 3, 6}, {2, 3, 6}, {2, 3, 6},
+	{1, 4, 6}, {1, 4, 6}, {1, 4, 6}, {1, 4, 6},
+	{1, 4, 6}, {1, 4, 6}, {1, 4, 6}, {1, 4, 6},
+	{1, 4, 6}, {1, 4, 6}, {1, 4, 6}, {1, 4, 6},
+	{1, 4, 6}, {1, 4, 6}, {1, 4, 6}, {1, 4, 6},
+	{1, 5, 6}, {1, 5, 6}, {1, 5, 6}, {1, 5, 6},
+	{1, 5, 6}, {1, 5, 6}, {1, 5, 6}, {1, 5, 6},
+	{1, 5, 6}, {1, 5, 6}, {1, 5, 6}, {1, 5, 6},
+	{1, 5, 6}, {1, 5, 6}, {1, 5, 6}, {1, 5, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 2, 6}, {3, 2, 6}, {3, 2, 6}, {3, 2, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{3, 3, 6}, {3, 3, 6}, {3, 3, 6}, {3, 3, 6},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 2, 4}, {1, 2, 4}, {1, 2, 4}, {1, 2, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{1, 3, 4}, {1, 3, 4}, {1, 3, 4}, {1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4}, {-1, 3, 4},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 6, 5}, {0, 6, 5}, {0, 6, 5}, {0, 6, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 7, 5}, {0, 7, 5}, {0, 7, 5}, {0, 7, 5},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 2, 3}, {0, 2, 3}, {0, 2, 3}, {0, 2, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 3, 3}, {0, 3, 3}, {0, 3, 3}, {0, 3, 3},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 4, 4}, {0, 4, 4}, {0, 4, 4}, {0, 4, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 5, 4}, {0, 5, 4}, {0, 5, 4}, {0, 5, 4},
+	{0, 8, 6}, {0, 8, 6}, {0, 8, 6}, {0, 8, 6},
+	{0, 8, 6}, {0, 8, 6}, {0, 8, 6}, {0, 8, 6},
+	{0, 8, 6}, {0, 8, 6}, {0, 8, 6}, {0, 8, 6},
+	{0, 8, 6}, {0, 8, 6}, {0, 8, 6}, {0, 8, 6},
+	{0, 9, 6}, {0, 9, 6}, {0, 9, 6}, {0, 9, 6},
+	{0, 9, 6}, {0, 9, 6}, {0, 9, 6}, {0, 9, 6},
+	{0, 9, 6}, {0, 9, 6}, {0, 9, 6}, {0, 9, 6},
+	{0, 9, 6}, {0, 9, 6}, {0, 9, 6}, {0, 9, 6},
+	{0, 10, 6}, {0, 10, 6}, {0, 10, 6}, {0, 10, 6},
+	{0, 10, 6}, {0, 10, 6}, {0, 10, 6}, {0, 10, 6},
+	{0, 10, 6}, {0, 10, 6}, {0, 10, 6}, {0, 10, 6},
+	{0, 10, 6}, {0, 10, 6}, {0, 10, 6}, {0, 10, 6},
+	{0, 11, 6}, {0, 11, 6}, {0, 11, 6}, {0, 11, 6},
+	{0, 11, 6}, {0, 11, 6}, {0, 11, 6}, {0, 11, 6},
+	{0, 11, 6}, {0, 11, 6}, {0, 11, 6}, {0, 11, 6},
+	{0, 11, 6}, {0, 11, 6}, {0, 11, 6}, {0, 11, 6},
+	{9, 2, 8}, {9, 2, 8}, {9, 2, 8}, {9, 2, 8},
+	{9, 3, 8}, {9, 3, 8}, {9, 3, 8}, {9, 3, 8},
+	{1, 6, 8}, {1, 6, 8}, {1, 6, 8}, {1, 6, 8},
+	{1, 7, 8}, {1, 7, 8}, {1, 7, 8}, {1, 7, 8},
+	{10, 2, 8}, {10, 2, 8}, {10, 2, 8}, {10, 2, 8},
+	{10, 3, 8}, {10, 3, 8}, {10, 3, 8}, {10, 3, 8},
+	{0, 16, 8}, {0, 16, 8}, {0, 16, 8}, {0, 16, 8},
+	{0, 17, 8}, {0, 17, 8}, {0, 17, 8}, {0, 17, 8},
+	{0, 18, 8}, {0, 18, 8}, {0, 18, 8}, {0, 18, 8},
+	{0, 19, 8}, {0, 19, 8}, {0, 19, 8}, {0, 19, 8},
+	{0, 24, 9}, {0, 24, 9}, {0, 25, 9}, {0, 25, 9},
+	{0, 26, 9}, {0, 26, 9}, {0, 27, 9}, {0, 27, 9},
+	{2, 6, 9}, {2, 6, 9}, {2, 7, 9}, {2, 7, 9},
+	{4, 4, 9}, {4, 4, 9}, {4, 5, 9}, {4, 5, 9},
+	{0, 28, 9}, {0, 28, 9}, {0, 29, 9}, {0, 29, 9},
+	{0, 30, 9}, {0, 30, 9}, {0, 31, 9}, {0, 31, 9},
+};
+
+static const vlc_dct_t * const m2d_dct_fast_tables[4] = {
+	m2d_dct_table0_bit10,
+	m2d_dct_table1_bit10,
+	m2d_dct_table0_bit10,
+	m2d_dct_table1_bit10
+};
+
 
 /** This is generated from standard document using vldbuild.rb. */
 static const vlc_t mb_inc_bit4[62] = {
@@ -1,3 +1,31 @@
 #!/bin/sh
+# test.sh [threads]
+# Frames decoded by the given number of threads (default: 4) shall match
+# single-threaded ones. If SCALAR_DEC points to h264dec configured with
+# CXXFLAGS=-U__SSE2__, its frames shall match SIMD ones as well.
+DATA=$(cd ../data && pwd)
+DEC=$(pwd)/src/app/h264dec
+THREADS=${1:-4}
+
 ls ../data/h264/*.264 | parallel src/app/h264dec -O
 for f in *.out; do echo $f; cmp ../data/h264/${f%out}md5 $f; done
+
+decode_all() {
+	mkdir -p $1 && (cd $1 && ls $DATA/h264/*.264 $DATA/h265/*.265 $DATA/m2v/*.m2v 2>/dev/null | parallel $2 -O -t $3)
+}
+compare_all() {
+	for f in $1/*.out; do echo $f $2; cmp $f $2/${f##*/}; done
+}
+
+decode_all t1 $DEC 1
+# HEVC streams with reference output, such as DSLICE_*/ENTP_* of dependent slice segments
+for f in $DATA/h265/*.md5; do
+	[ -f $f ] || continue
+	g=${f##*/}; echo $g; cmp $f t1/${g%md5}out
+done
+decode_all t$THREADS $DEC $THREADS
+compare_all t1 t$THREADS
+if [ -n "$SCALAR_DEC" ]; then
+	decode_all scalar $SCALAR_DEC 1
+	compare_all t1 scalar
+fi